@@ -0,0 +1,71 @@
+#ifndef ALLOC_TRACE_H
+#define ALLOC_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup alloc-trace alloc-trace: Binary allocation tracer
+ *
+ * Writes fixed-size allocation events into a file through a memory mapped
+ * window, so recording an event is a store into memory and the kernel does
+ * the writing.  Optionally takes a sample every `sample_interval` allocated
+ * bytes, with the stack at that point.  Stacks are interned: the first time
+ * one is seen, a STACK event with its text is written and samples refer to it
+ * by id.  Not thread-safe, use one per runtime.
+ *
+ * The file starts with an AllocTraceHeader, followed by events of
+ * header.event_size bytes.  A STACK event is followed by its text, padded to
+ * a multiple of the event size.  lib/alloc-trace.js reads these files.
+ * @{
+ */
+typedef struct alloc_trace AllocTrace;
+
+/* writes the current stack as "outer;inner" frames to buf, returns its length */
+typedef size_t AllocTraceStackFunc(void* opaque, char* buf, size_t size);
+
+#define ALLOC_TRACE_MAGIC "QJSALLOC"
+#define ALLOC_TRACE_VERSION 1
+
+/* alloc_trace_open() flags */
+#define ALLOC_TRACE_EVENTS 1 /* record every malloc(), free() and realloc() */
+#define ALLOC_TRACE_FREES 2  /* record free() and realloc(), to tell which samples are still in use */
+
+enum {
+  ALLOC_TRACE_MALLOC = 'A',
+  ALLOC_TRACE_FREE = 'F',
+  ALLOC_TRACE_REALLOC = 'R',
+  ALLOC_TRACE_SAMPLE = 'S',
+  ALLOC_TRACE_STACK = 'K',
+};
+
+typedef struct {
+  char magic[8];
+  uint32_t version, event_size;
+  uint32_t header_size; /* offset of the first event */
+  uint32_t flags;
+  uint64_t sample_interval;
+  uint64_t start; /* CLOCK_REALTIME in ns */
+  uint8_t reserved[24];
+} AllocTraceHeader;
+
+typedef struct {
+  uint8_t type;
+  uint8_t reserved[3];
+  uint32_t stack; /* SAMPLE, STACK: stack id */
+  uint64_t time;  /* ns since alloc_trace_open() */
+  uint64_t ptr;
+  uint64_t size; /* MALLOC, REALLOC, SAMPLE: requested size, FREE: usable size, STACK: text length */
+  uint64_t arg;  /* REALLOC: previous pointer, SAMPLE: bytes the sample stands for */
+} AllocTraceEvent;
+
+AllocTrace* alloc_trace_open(const char* file, int flags, uint64_t sample_interval, AllocTraceStackFunc*, void* opaque);
+void alloc_trace_malloc(AllocTrace*, void* ptr, size_t size);
+void alloc_trace_free(AllocTrace*, void* ptr, size_t usable);
+void alloc_trace_realloc(AllocTrace*, void* old, void* ptr, size_t size);
+int alloc_trace_close(AllocTrace*);
+
+/**
+ * @}
+ */
+#endif /* defined(ALLOC_TRACE_H) */
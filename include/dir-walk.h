@@ -0,0 +1,52 @@
+#ifndef DIR_WALK_H
+#define DIR_WALK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cutils.h>
+#include "getdents.h"
+
+/**
+ * \defgroup dir-walk dir-walk: Parallel recursive directory walker
+ *
+ * Subdirectories are read on a small pool of threads with getdents(), using
+ * the entry type the kernel returns and calling lstat() only when it is
+ * unknown.  Entries are filtered by type, depth and glob patterns (see
+ * glob-set) on the worker threads and handed over in batches.  Directories
+ * matching an exclude pattern, or below which no include pattern can match,
+ * are not descended into.  Symbolic links are not followed.
+ * @{
+ */
+typedef struct dir_walk DirWalk;
+
+typedef struct {
+  const char* const* include;
+  size_t ninclude;
+  const char* const* exclude;
+  size_t nexclude;
+  int types;     /* TYPE_* mask of the entries to report */
+  int max_depth; /* < 0 for no limit, entries directly in the root have depth 1 */
+  int threads;
+  size_t batch_size;
+} DirWalkOptions;
+
+/* a batch holds count entries, each one a type byte followed by the 0-terminated path */
+typedef struct dir_walk_batch {
+  struct dir_walk_batch* next;
+  size_t count, len, capacity;
+  char* data;
+} DirWalkBatch;
+
+void dir_walk_options(DirWalkOptions*);
+DirWalk* dir_walk_new(const char* root, const DirWalkOptions*);
+int dir_walk_fd(DirWalk*);
+DirWalkBatch* dir_walk_next(DirWalk*, BOOL* done);
+int dir_walk_error(DirWalk*);
+void dir_walk_cancel(DirWalk*);
+void dir_walk_free(DirWalk*);
+void dir_walk_batch_free(DirWalkBatch*);
+
+/**
+ * @}
+ */
+#endif /* defined(DIR_WALK_H) */
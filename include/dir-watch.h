@@ -0,0 +1,53 @@
+#ifndef DIR_WATCH_H
+#define DIR_WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cutils.h>
+
+/**
+ * \defgroup dir-watch dir-watch: Recursive inotify watcher
+ *
+ * Watches a directory tree, adding watches for subdirectories as they are
+ * created or moved in and dropping them when they go away.  The watch
+ * descriptor to path mapping is kept here.  Events are coalesced per path
+ * (their masks OR'ed together) and handed out as one change set once no
+ * event arrived for `delay` milliseconds, or at the latest `max_delay`
+ * milliseconds after the first one.  The timer is a timerfd, so both
+ * descriptors can be polled by an event loop.
+ *
+ * Only events in `mask` are reported, but IN_CREATE, IN_MOVED_FROM and
+ * IN_MOVED_TO are always watched so that subdirectories are followed.
+ *
+ * When the kernel queue overflows, the tree is rescanned for directories
+ * that are not watched yet and the change set is flagged as incomplete.
+ * @{
+ */
+typedef struct dir_watch DirWatch;
+
+typedef struct {
+  uint32_t mask;
+  uint32_t delay, max_delay;
+  const char* const* exclude;
+  size_t nexclude;
+} DirWatchOptions;
+
+typedef struct {
+  char* path;
+  uint32_t mask;
+} DirWatchChange;
+
+void dir_watch_options(DirWatchOptions*);
+DirWatch* dir_watch_new(const char* root, const DirWatchOptions*);
+int dir_watch_fd(DirWatch*);
+int dir_watch_timerfd(DirWatch*);
+int dir_watch_read(DirWatch*);
+DirWatchChange* dir_watch_take(DirWatch*, size_t* count, BOOL* overflow);
+size_t dir_watch_count(DirWatch*);
+void dir_watch_changes_free(DirWatchChange*, size_t count);
+void dir_watch_free(DirWatch*);
+
+/**
+ * @}
+ */
+#endif /* defined(DIR_WATCH_H) */
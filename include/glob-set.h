@@ -0,0 +1,75 @@
+#ifndef GLOB_SET_H
+#define GLOB_SET_H
+
+#include <stddef.h>
+#include <cutils.h>
+
+/**
+ * \defgroup glob-set glob-set: Compiled sets of glob patterns
+ *
+ * Include and exclude patterns are brace-expanded, split into path components
+ * and merged into a single trie.  Literal components are looked up in a hash
+ * table per node, components with wildcards are kept sorted by their last
+ * character and '**' becomes a node matching any number of components.  A
+ * path is matched by stepping the set of live nodes through its components,
+ * so all patterns are tried in one pass, and a directory from which no include
+ * pattern can be reached anymore does not need to be read.
+ *
+ * A path is excluded when it or one of its parent directories matches an
+ * exclude pattern.  Without include patterns every path not excluded matches.
+ * @{
+ */
+typedef struct glob_set GlobSet;
+typedef struct glob_node GlobNode;
+
+/* glob_set_new() flags */
+#define GLOB_SET_PERIOD 1    /* wildcards don't match a leading '.' */
+#define GLOB_SET_MATCHBASE 2 /* patterns without a '/' match the name at any depth */
+
+/* glob_set_add() flags */
+#define GLOB_SET_EXCLUDE 1
+
+/* result of glob_set_step() and glob_set_match() */
+#define GLOB_SET_MATCH 1
+#define GLOB_SET_EXCLUDED 2
+#define GLOB_SET_DESCEND 4 /* paths below this one can still match */
+
+/* the live trie nodes after some path components */
+typedef struct {
+  const GlobNode** nodes;
+  size_t count, size;
+  int result;
+} GlobState;
+
+/* keeps the states of the previous path, so consecutive paths sharing parent directories are stepped only once */
+typedef struct {
+  GlobState* states;
+  size_t *ends, depth, capacity;
+  char* path;
+  size_t len, size;
+} GlobCursor;
+
+GlobSet* glob_set_new(int flags);
+int glob_set_add(GlobSet*, const char* pattern, size_t len, int flags);
+size_t glob_set_count(const GlobSet*, int flags);
+void glob_set_free(GlobSet*);
+int glob_set_start(const GlobSet*, GlobState*);
+int glob_set_step(const GlobSet*, const GlobState* in, const char* name, size_t len, GlobState* out);
+int glob_set_match(const GlobSet*, const char* path, size_t len);
+void glob_state_move(GlobState* to, GlobState* from);
+void glob_state_free(GlobState*);
+void glob_cursor_init(GlobCursor*);
+int glob_cursor_match(const GlobSet*, GlobCursor*, const char* path, size_t len);
+void glob_cursor_free(GlobCursor*);
+
+static inline void
+glob_state_init(GlobState* st) {
+  st->nodes = 0;
+  st->count = st->size = 0;
+  st->result = 0;
+}
+
+/**
+ * @}
+ */
+#endif /* defined(GLOB_SET_H) */
@@ -0,0 +1,39 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup histogram histogram: HDR-style log-linear histogram
+ *
+ * Values are counted in buckets whose width doubles with every power of two,
+ * each power of two split into enough sub-buckets that any recorded value is
+ * known to the given number of significant decimal figures.  Recording a
+ * value is a shift and an increment; the bucket array only grows when a value
+ * larger than all previous ones is recorded.
+ * @{
+ */
+typedef struct {
+  uint64_t* counts;
+  size_t ncounts, nused; /* allocated, up to the highest bucket recorded */
+  uint32_t sub_bits, unit_shift;
+  uint64_t lowest, highest;
+  uint64_t total, exceeds; /* values recorded, values above highest */
+  uint64_t min, max;
+  double sum;
+} Histogram;
+
+int histogram_init(Histogram*, uint64_t lowest, uint64_t highest, int figures);
+int histogram_record(Histogram*, uint64_t value);
+int histogram_add(Histogram*, const Histogram* other);
+void histogram_reset(Histogram*);
+uint64_t histogram_percentile(const Histogram*, double percentile);
+double histogram_mean(const Histogram*);
+double histogram_stddev(const Histogram*);
+void histogram_free(Histogram*);
+
+/**
+ * @}
+ */
+#endif /* defined(HISTOGRAM_H) */
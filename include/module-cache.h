@@ -0,0 +1,79 @@
+#ifndef MODULE_CACHE_H
+#define MODULE_CACHE_H
+
+#include <quickjs.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <cutils.h>
+
+/**
+ * \defgroup module-cache module-cache: On-disk bytecode cache for ES modules
+ *
+ * Compiled modules are stored as JS_WriteObject() bytecode in one file per
+ * source path.  An entry is used when the source's mtime and size are
+ * unchanged; otherwise (or always, in MODULE_CACHE_HASH mode) the source is
+ * hashed and the entry is reused only when the content hash matches.
+ * Entries written by a different engine version are ignored.
+ * @{
+ */
+typedef enum {
+  MODULE_CACHE_OFF = 0,
+  MODULE_CACHE_MTIME,
+  MODULE_CACHE_HASH,
+} ModuleCacheMode;
+
+typedef struct {
+  ModuleCacheMode mode;
+  char* dir;
+  uint64_t version;
+  /* shared by the worker threads, which compile through the same cache */
+  _Atomic(uint32_t) hits, misses, writes;
+} ModuleCache;
+
+int module_cache_mode(const char* name);
+char* module_cache_default_dir(void);
+int module_cache_init(ModuleCache*, const char* dir, ModuleCacheMode mode, const char* version);
+void module_cache_free(ModuleCache*);
+int module_cache_clear(ModuleCache*);
+JSValue module_cache_compile(JSContext*, ModuleCache*, const char* filename);
+
+/**
+ * A startup image holds the bytecode of every module a run compiled, plus
+ * the module resolutions it made, in one file.  Loading it replaces the
+ * per-module cache lookups, filesystem probing and parsing of later runs.
+ * Module entries are checked against their source's mtime and size when
+ * used.  Resolutions are only valid in the directory the image was saved
+ * in.
+ */
+typedef struct {
+  char* name;
+  uint8_t* bytecode;
+  size_t bytecode_len;
+  int64_t mtime_sec, mtime_nsec;
+  uint64_t size;
+  BOOL owned;
+} ModuleImageEntry;
+
+typedef struct {
+  uint64_t version;
+  uint8_t* data;
+  char* cwd;
+  ModuleImageEntry* modules;
+  size_t nmodules, cmodules;
+  char** resolutions;
+  size_t nresolutions, cresolutions;
+} ModuleImage;
+
+void module_image_init(ModuleImage*, const char* version);
+void module_image_free(ModuleImage*);
+int module_image_load(ModuleImage*, const char* file);
+int module_image_save(ModuleImage*, const char* file);
+ModuleImageEntry* module_image_find(ModuleImage*, const char* name);
+JSValue module_image_read(JSContext*, ModuleImage*, const char* name);
+int module_image_add(JSContext*, ModuleImage*, const char* name, JSValueConst module);
+int module_image_resolution(ModuleImage*, const char* base, const char* specifier, const char* result);
+
+/**
+ * @}
+ */
+#endif /* defined(MODULE_CACHE_H) */
@@ -0,0 +1,62 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <cutils.h>
+
+/**
+ * \defgroup path-cache path-cache: Memoized stat() results and path lookups
+ *
+ * A hash table of stat() results (positive and negative) and of arbitrary
+ * string results keyed by a namespace character and two strings, e.g. a
+ * base directory and a module specifier.  Relative keys are only valid for
+ * one working directory, so the whole cache is flushed when it changes.
+ * With watching enabled (inotify), any change in a directory that has been
+ * looked at flushes the cache as well.  Without watching, entries live for
+ * PATH_CACHE_TTL milliseconds, so files created or removed later are seen.
+ * The working directory is compared at most once per PATH_CACHE_TTL.
+ * @{
+ */
+#define PATH_CACHE_TTL 100
+
+enum {
+  PATH_TYPE_NONE = 0,
+  PATH_TYPE_FILE,
+  PATH_TYPE_DIR,
+  PATH_TYPE_OTHER,
+};
+
+typedef struct path_cache_entry PathCacheEntry;
+
+typedef struct {
+  PathCacheEntry** table;
+  size_t capacity, count;
+  char* cwd;
+  int watch_fd;
+  int64_t checked, flushed;
+  uint32_t hits, misses;
+} PathCache;
+
+void path_cache_init(PathCache*, BOOL watch);
+void path_cache_clear(PathCache*);
+void path_cache_free(PathCache*);
+BOOL path_cache_validate(PathCache*);
+int path_cache_type(PathCache*, const char* path);
+BOOL path_cache_get(PathCache*, char ns, const char* a, const char* b, const char** result);
+void path_cache_put(PathCache*, char ns, const char* a, const char* b, const char* result);
+
+static inline BOOL
+path_cache_isfile(PathCache* pc, const char* path) {
+  return path_cache_type(pc, path) == PATH_TYPE_FILE;
+}
+
+static inline BOOL
+path_cache_exists(PathCache* pc, const char* path) {
+  return path_cache_type(pc, path) != PATH_TYPE_NONE;
+}
+
+/**
+ * @}
+ */
+#endif /* defined(PATH_CACHE_H) */
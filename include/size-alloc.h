@@ -0,0 +1,46 @@
+#ifndef SIZE_ALLOC_H
+#define SIZE_ALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup size-alloc size-alloc: Size-class slab allocator
+ *
+ * Small allocations are rounded up to one of a few size classes and carved
+ * from 64 KiB slabs holding blocks of a single class: a fresh slab hands out
+ * blocks with a bump pointer, freed blocks go on the slab's free list.  Slabs
+ * themselves are bump-allocated from 4 MiB arenas inside one address range
+ * reserved at startup, so the size of any block is found from its address
+ * alone.  An arena whose slabs are all empty again is reset: its pages are
+ * given back and its bump pointer starts over.
+ *
+ * Larger allocations are left to the caller (size_alloc_malloc() returns NULL
+ * for them).  An allocator must only be used by one thread at a time.
+ * @{
+ */
+typedef struct size_alloc SizeAlloc;
+
+#define SIZE_ALLOC_MAX 1024 /* largest size served from slabs */
+
+/* counters, for dumps */
+typedef struct {
+  size_t blocks;      /* blocks in use */
+  size_t block_bytes; /* bytes in use, rounded up to size classes */
+  size_t slabs;       /* slabs holding blocks */
+  size_t arenas;      /* arenas owned */
+  size_t resets;      /* arenas emptied and reset */
+} SizeAllocStats;
+
+SizeAlloc* size_alloc_new(void);
+void* size_alloc_malloc(SizeAlloc*, size_t size);
+void size_alloc_free(SizeAlloc*, void* ptr);
+size_t size_alloc_usable_size(const void* ptr);
+size_t size_alloc_class_size(size_t size);
+void size_alloc_stats(const SizeAlloc*, SizeAllocStats*);
+void size_alloc_destroy(SizeAlloc*);
+
+/**
+ * @}
+ */
+#endif /* defined(SIZE_ALLOC_H) */
@@ -89,6 +89,30 @@ reader_getc(Reader* rd) {
 
 ssize_t transform_urldecode(Reader*, Writer*);
 
+#ifdef HAVE_MMAP
+/**
+ * A sliding window over a memory mapped file.  Only `window` bytes (rounded
+ * to pages) are mapped at a time, the mapping follows the cursor and is
+ * extended with mremap() where possible.  Writable windows grow the file in
+ * window sized steps and truncate it to the written length when freed.
+ */
+typedef struct MappedWindow {
+  int fd;
+  bool writable, close_on_end;
+  uint8_t* base;
+  uint64_t start, pos, end, length;
+  size_t size, window, page;
+  const char* syscall; /* the call that failed last, errno holds its error */
+} MappedWindow;
+
+int mapwindow_init(MappedWindow*, int fd, size_t window, bool writable, bool close_on_end);
+uint8_t* mapwindow_at(MappedWindow*, uint64_t pos, size_t need, size_t* avail);
+int mapwindow_refresh(MappedWindow*);
+void mapwindow_free(MappedWindow*);
+Reader reader_from_mapwindow(MappedWindow*);
+Writer writer_from_mapwindow(MappedWindow*);
+#endif
+
 /**
  * @}
  */
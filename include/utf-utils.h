@@ -0,0 +1,33 @@
+#ifndef UTF_UTILS_H
+#define UTF_UTILS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * \defgroup utf-utils utf-utils: Bulk UTF-8/16/32 transcoding
+ *
+ * ASCII runs are handled 16/32 bytes at a time with SSE2, AVX2 or NEON
+ * (whichever the compiler targets), everything else by a validating scalar
+ * decoder.  All converters stop at the first invalid or truncated sequence
+ * and report how much input they consumed.  swap_bytes selects the byte
+ * order of the UTF-16/32 side opposite to the host's.
+ * @{
+ */
+
+#define UTF_REPLACEMENT_CHAR 0xfffd
+
+size_t utf_ascii_prefix(const uint8_t*, size_t);
+int utf8_decode(const uint8_t*, size_t, uint32_t*);
+size_t utf8_validate(const uint8_t*, size_t, bool* truncated);
+size_t utf8_utf16_units(const uint8_t*, size_t);
+size_t utf8_to_utf16(const uint8_t*, size_t, uint16_t*, bool swap_bytes, size_t* consumed);
+size_t utf8_to_utf32(const uint8_t*, size_t, uint32_t*, bool swap_bytes, size_t* consumed);
+size_t utf16_to_utf8(const uint16_t*, size_t, uint8_t*, bool swap_bytes, size_t* consumed);
+size_t utf32_to_utf8(const uint32_t*, size_t, uint8_t*, bool swap_bytes, size_t* consumed);
+
+/**
+ * @}
+ */
+#endif /* defined(UTF_UTILS_H) */
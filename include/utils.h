@@ -1218,6 +1218,7 @@ void js_call_handler(JSContext*, JSValueConst, JSValueConst, int, JSValueConst[]
 void* js_sab_alloc(void*, size_t);
 void js_sab_free(void*, void*);
 void js_sab_dup(void*, void*);
+void js_sab_init(JSRuntime*);
 
 /*JSWorkerMessagePipe* js_new_message_pipe(void);
 JSWorkerMessagePipe* js_dup_message_pipe(JSWorkerMessagePipe*);*/
@@ -1234,6 +1235,9 @@ JSValue js_error_stack(JSContext*);
 JSValue js_iohandler_fn(JSContext*, BOOL write, const char* global_obj);
 BOOL js_iohandler_set(JSContext*, JSValueConst set_handler, int fd, JSValue handler);
 
+extern JSContext* (*js_thread_context_new)(JSRuntime*);
+extern void (*js_thread_context_free)(JSContext*);
+
 JSValue js_promise_new(JSContext*, JSValue resolving_funcs[2]);
 JSValue js_promise_immediate(JSContext*, BOOL reject, JSValueConst promise);
 JSValue js_promise_resolve(JSContext*, JSValueConst promise);
@@ -1292,6 +1296,11 @@ void js_stackframe_dump(JSContext*, JSValueConst, DynBuf*);
 void js_stack_dump(JSContext*, JSValueConst, DynBuf*);
 char* js_stack_tostring(JSContext*, JSValueConst);
 JSValue js_stack_get(JSContext*);
+size_t js_stack_frames(JSRuntime*, char* buf, size_t size, int max_frames);
+size_t js_pending_jobs(JSRuntime*);
+size_t js_malloc_size(JSRuntime*);
+size_t js_gc_threshold(JSRuntime*);
+JSFreeArrayBufferDataFunc* js_arraybuffer_free_func(JSValueConst);
 void js_stack_print(JSContext*, JSValueConst);
 
 struct OffsetLength;
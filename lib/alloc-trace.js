@@ -0,0 +1,257 @@
+/*
+ * Reads the binary traces written by qjsm --alloc-trace / --alloc-sample
+ * (see include/alloc-trace.h) and aggregates them per call site.
+ *
+ *   qjsm lib/alloc-trace.js [--top N] [--inuse] [--folded] FILE
+ *
+ * --folded prints one 'outer;inner bytes' line per stack, the input format
+ * of flamegraph.pl.  --inuse counts only sampled allocations that were not
+ * freed before the trace ended (needs the FREE and REALLOC events, which
+ * --alloc-sample records).
+ */
+import * as std from 'std';
+
+const MAGIC = 'QJSALLOC';
+
+export const MALLOC = 'A';
+export const FREE = 'F';
+export const REALLOC = 'R';
+export const SAMPLE = 'S';
+export const STACK = 'K';
+
+/* header flags */
+export const EVENTS = 1;
+export const FREES = 2;
+
+/* traces are written in host byte order, little endian on everything we run on */
+const u64 = (dv, offset) => dv.getUint32(offset, true) + dv.getUint32(offset + 4, true) * 2 ** 32;
+
+function text(buf, offset, length) {
+  const bytes = new Uint8Array(buf, offset, length);
+  let s = '';
+
+  for(let i = 0; i < length; i += 4096) s += String.fromCharCode(...bytes.subarray(i, i + 4096));
+
+  return s;
+}
+
+export function readHeader(buf) {
+  const dv = new DataView(buf);
+
+  if(buf.byteLength < 64 || text(buf, 0, 8) != MAGIC) throw new Error(`not an allocation trace`);
+
+  return {
+    version: dv.getUint32(8, true),
+    eventSize: dv.getUint32(12, true),
+    headerSize: dv.getUint32(16, true),
+    flags: dv.getUint32(20, true),
+    sampleInterval: u64(dv, 24),
+    start: u64(dv, 32) / 1e6,
+  };
+}
+
+/* yields { type, stack, time, ptr, size, arg } for every event, STACK events carry the stack text */
+export function* readEvents(buf) {
+  const { eventSize, headerSize } = readHeader(buf);
+  const dv = new DataView(buf);
+
+  for(let offset = headerSize; offset + eventSize <= buf.byteLength; offset += eventSize) {
+    const type = dv.getUint8(offset);
+
+    /* a trace not closed properly ends with zeroed slots */
+    if(type == 0) break;
+
+    const event = {
+      type: String.fromCharCode(type),
+      stack: dv.getUint32(offset + 4, true),
+      time: u64(dv, offset + 8),
+      ptr: u64(dv, offset + 16),
+      size: u64(dv, offset + 24),
+      arg: u64(dv, offset + 32),
+    };
+
+    if(event.type == STACK) {
+      event.text = text(buf, offset + eventSize, Math.min(event.size, buf.byteLength - offset - eventSize));
+      offset += Math.ceil(event.size / eventSize) * eventSize;
+    }
+
+    yield event;
+  }
+}
+
+/**
+ * Aggregates a trace into
+ *
+ *   sites:  Map of stack text -> { samples, bytes, inuse }
+ *   totals: { mallocs, frees, reallocs, samples, allocated, live, peak }
+ *
+ * bytes are the bytes the samples stand for, allocated/live/peak come from
+ * the individual events when those were recorded.
+ */
+export function aggregate(buf) {
+  const header = readHeader(buf),
+    events = !!(header.flags & EVENTS);
+  const stacks = new Map(),
+    sites = new Map(),
+    sizes = new Map(),
+    sampled = new Map();
+  const totals = { mallocs: 0, frees: 0, reallocs: 0, samples: 0, allocated: 0, live: 0, peak: 0 };
+
+  const release = ptr => {
+    const size = sizes.get(ptr);
+
+    if(size !== undefined) {
+      totals.live -= size;
+      sizes.delete(ptr);
+    }
+
+    const samples = sampled.get(ptr);
+
+    if(samples) {
+      for(const { site, bytes } of samples) site.inuse -= bytes;
+
+      sampled.delete(ptr);
+    }
+  };
+
+
+  const allocate = (ptr, size) => {
+    totals.allocated += size;
+    totals.live += size;
+    sizes.set(ptr, size);
+
+    if(totals.live > totals.peak) totals.peak = totals.live;
+  };
+
+  for(const e of readEvents(buf)) {
+    switch (e.type) {
+      case STACK:
+        stacks.set(e.stack, e.text || '<runtime>');
+        break;
+
+      case MALLOC:
+        totals.mallocs++;
+        allocate(e.ptr, e.size);
+        break;
+
+      case FREE:
+        totals.frees++;
+        release(e.ptr);
+        break;
+
+      case REALLOC: {
+        totals.reallocs++;
+
+        /* a failed realloc() leaves the block as it was */
+        if(!e.ptr && e.size) break;
+
+        /* the samples of the block stay in use at its new address, which may be the same */
+        const samples = e.ptr && sampled.get(e.arg);
+
+        if(samples) sampled.delete(e.arg);
+
+        release(e.arg);
+
+        if(samples) sampled.set(e.ptr, [...(sampled.get(e.ptr) ?? []), ...samples]);
+        if(e.ptr && events) allocate(e.ptr, e.size);
+        break;
+      }
+
+      case SAMPLE: {
+        const stack = stacks.get(e.stack) ?? '<unknown>';
+        let site = sites.get(stack);
+
+        if(!site) sites.set(stack, (site = { samples: 0, bytes: 0, inuse: 0 }));
+
+        site.samples++;
+        site.bytes += e.arg;
+        site.inuse += e.arg;
+        totals.samples++;
+        sampled.set(e.ptr, [...(sampled.get(e.ptr) ?? []), { site, bytes: e.arg }]);
+        break;
+      }
+    }
+  }
+
+  return { header, sites, totals };
+}
+
+/* flamegraph.pl input: one 'outer;inner bytes' line per stack */
+export function folded({ sites }, inuse = false) {
+  let s = '';
+
+  for(const [stack, site] of sites) {
+    const bytes = inuse ? site.inuse : site.bytes;
+
+    if(bytes > 0) s += `${stack.replace(/ /g, '_')} ${bytes}\n`;
+  }
+
+  return s;
+}
+
+/* allocation totals per innermost frame, largest first */
+export function report({ header, sites, totals }, top = 20, inuse = false) {
+  const frames = new Map();
+
+  for(const [stack, site] of sites) {
+    const frame = stack.slice(stack.lastIndexOf(';') + 1);
+    const entry = frames.get(frame) ?? { samples: 0, bytes: 0 };
+
+    entry.samples += site.samples;
+    entry.bytes += inuse ? site.inuse : site.bytes;
+    frames.set(frame, entry);
+  }
+
+  let s = '';
+
+  if(totals.mallocs) s += `${totals.mallocs} mallocs, ${totals.reallocs} reallocs, ${totals.frees} frees, ${totals.allocated} bytes allocated, peak ${totals.peak}, live at end ${totals.live}\n`;
+
+  if(totals.samples) {
+    s += `${totals.samples} samples every ${header.sampleInterval} bytes\n\n`;
+    s += `${'bytes'.padStart(14)} ${'samples'.padStart(8)}  site\n`;
+
+    for(const [frame, { samples, bytes }] of [...frames].sort((a, b) => b[1].bytes - a[1].bytes).slice(0, top))
+      if(bytes > 0) s += `${(bytes + '').padStart(14)} ${(samples + '').padStart(8)}  ${frame}\n`;
+  }
+
+  return s;
+}
+
+export function load(file) {
+  const f = std.open(file, 'rb');
+
+  if(!f) throw new Error(`cannot open '${file}'`);
+
+  f.seek(0, std.SEEK_END);
+  const buf = new ArrayBuffer(f.tell());
+  f.seek(0, std.SEEK_SET);
+  f.read(buf, 0, buf.byteLength);
+  f.close();
+
+  return buf;
+}
+
+function main(...args) {
+  let top = 20,
+    inuse = false,
+    flame = false,
+    file;
+
+  for(let i = 0; i < args.length; i++) {
+    if(args[i] == '--top') top = +args[++i];
+    else if(args[i] == '--inuse') inuse = true;
+    else if(args[i] == '--folded') flame = true;
+    else file = args[i];
+  }
+
+  if(!file) {
+    std.err.puts(`usage: alloc-trace.js [--top N] [--inuse] [--folded] FILE\n`);
+    std.exit(1);
+  }
+
+  const result = aggregate(load(file));
+
+  std.out.puts(flame ? folded(result, inuse) : report(result, top, inuse));
+}
+
+if(/alloc-trace\.js$/.test(globalThis.scriptArgs?.[0] ?? '')) main(...scriptArgs.slice(1));
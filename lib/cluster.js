@@ -0,0 +1,34 @@
+import { Worker } from 'os';
+import { AsyncSocket, reuseport } from 'sockets';
+
+/*
+ * Spreads accept() load over several qjsm worker contexts: the primary opens
+ * one SO_REUSEPORT listener per worker and passes its fd along, each worker
+ * adopts it and drains its own backlog with acceptMany().
+ */
+
+export function listen(addr, script, options = {}) {
+  const { workers = 4, backlog } = options;
+  const fds = reuseport(addr, workers, backlog);
+
+  return fds.map((fd, id) => {
+    const worker = new Worker(script);
+
+    worker.postMessage({ type: 'listen', fd, id });
+    return worker;
+  });
+}
+
+export function serve(onconnection, max) {
+  const { parent } = Worker;
+
+  parent.onmessage = async ({ data }) => {
+    if(data?.type != 'listen') return;
+
+    const sock = AsyncSocket.adopt(data.fd, true);
+
+    for await(const batch of sock.connections(max)) for(const conn of batch) onconnection(conn, data.id);
+  };
+}
+
+export default { listen, serve };
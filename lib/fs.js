@@ -1,9 +1,11 @@
+import * as aio from 'aio';
 import { EventEmitter } from 'events';
 import { basename, extname } from 'path';
 import { filename, mmap, munmap } from 'mmap';
+import { watch as watchTree } from 'directory';
 import * as std from 'std';
 import * as os from 'os';
-import { IN_ATTRIB, IN_CLOSE_WRITE, IN_CREATE, IN_DELETE, IN_DELETE_SELF, IN_MODIFY, IN_MOVED_TO, IN_MOVE_SELF, access as sys_access, error as sys_error, fchmod as sys_fchmod, fchown as sys_fchown, fdatasync as sys_fdatasync, fstat as sys_fstat, fsync as sys_fsync, ftruncate as sys_ftruncate, futimes as sys_futimes, link as sys_link, symlink as sys_symlink, isNumber, isString, isObject, isArrayBuffer, mkstemp, tempnam, toArrayBuffer, toString, watch, } from 'misc';
+import { IN_ATTRIB, IN_CLOSE_WRITE, IN_CREATE, IN_DELETE, IN_DELETE_SELF, IN_MODIFY, IN_MOVED_FROM, IN_MOVED_TO, IN_MOVE_SELF, access as sys_access, error as sys_error, fchmod as sys_fchmod, fchown as sys_fchown, fdatasync as sys_fdatasync, fstat as sys_fstat, fsync as sys_fsync, ftruncate as sys_ftruncate, futimes as sys_futimes, link as sys_link, symlink as sys_symlink, isNumber, isString, isObject, isArrayBuffer, mkstemp, tempnam, toArrayBuffer, toString, watch, } from 'misc';
 import { TextEncoder, TextDecoder } from 'textcode';
 import { SyscallError } from 'syscallerror';
 //import { ReadableStream, WritableStream } from 'stream';
@@ -24,8 +26,6 @@ const { EINVAL, EIO, EACCES, EEXIST, ENOSPC, ENOSYS, EBUSY, ENOENT, EPERM } = st
 const EAGAIN = 11,
   EWOULDBLOCK = 11;
 
-const COPY_BUF_SIZE = 65536;
-
 export const stdin = std.in;
 export const stdout = std.out;
 export const stderr = std.err;
@@ -702,42 +702,8 @@ export function linkSync(existingPath, newPath) {
   if(sys_link(existingPath, newPath) == -1) throw new SyscallError(`link`, sys_error().errno);
 }
 
-export function copyFileSync(src, dest, flags) {
-  const { COPYFILE_EXCL, COPYFILE_FICLONE, COPYFILE_FICLONE_FORCE } = constants;
-
-  if(flags & (COPYFILE_FICLONE | COPYFILE_FICLONE_FORCE)) {
-    try {
-      if(sys_link(src, dest) != -1) return;
-    } catch(e) {}
-    if(flags & COPYFILE_FICLONE_FORCE) throw new Error(`Unable to link '${src}' to '${dest}'`);
-  }
-
-  const { size, mode } = statSync(src);
-
-  const r = openSync(src, 'rb'),
-    w = openSync(dest, 'w' + (flags & COPYFILE_EXCL ? 'x' : '') + 'b', mode);
-
-  const len = size < COPY_BUF_SIZE ? size : COPY_BUF_SIZE,
-    rem = size < COPY_BUF_SIZE ? 0 : size % COPY_BUF_SIZE,
-    ofs = 0;
-
-  let pos = 0,
-    buf = new ArrayBuffer(len);
-
-  for(let i = 0; len + pos + rem <= size; i++, pos = len * i) {
-    readSync(r, buf, ofs, len, pos);
-    writeSync(w, buf, ofs, len, pos);
-  }
-
-  if(rem) {
-    buf = new ArrayBuffer(rem);
-
-    readSync(r, buf, ofs, rem, pos);
-    writeSync(w, buf, ofs, rem, pos);
-  }
-
-  closeSync(r);
-  closeSync(w);
+export function copyFileSync(src, dest, flags = 0) {
+  aio.copyFileSync(src, dest, flags);
 }
 
 export function existsSync(path) {
@@ -935,73 +901,125 @@ export async function readFully(input, buf, start = 0, n) {
   return start;
 }
 
-export async function open(filename, flags = 'file', mode = 0o644) {
-  const errorObj = { errno: 0 };
-  const file = std.open(filename, flags, errorObj);
+const openFlags = {
+  r: O_RDONLY,
+  'r+': O_RDWR,
+  w: O_WRONLY | O_CREAT | O_TRUNC,
+  'w+': O_RDWR | O_CREAT | O_TRUNC,
+  a: O_WRONLY | O_CREAT | O_APPEND,
+  'a+': O_RDWR | O_CREAT | O_APPEND,
+};
 
-  if(file == null || errorObj.errno) {
-    throw MakeError(`Error opening '${filename}' (${flags})`, -errorObj.errno, filename, 'open');
-  }
+/**
+ * Translate fopen() style flags ('r', 'w+', 'wx', ...) to open() flags
+ *
+ * @param      {String}  flags
+ * @return     {Number}
+ */
+function parseFlags(flags) {
+  const key = flags.replace(/[bx]/g, '');
 
-  return new FileHandle(file);
+  if(!(key in openFlags)) throw new TypeError(`invalid flags '${flags}'`);
+
+  return openFlags[key] | (flags.includes('x') ? O_EXCL : 0);
 }
 
-export async function close(fd) {
-  return closeSync(fd);
+/**
+ * Translate open() flags to fdopen() flags
+ *
+ * @param      {Number}  flags
+ * @return     {String}
+ */
+function fdopenFlags(flags) {
+  const append = flags & O_APPEND;
+
+  switch (flags & (O_RDONLY | O_WRONLY | O_RDWR)) {
+    case O_RDWR:
+      return append ? 'a+' : 'r+';
+    case O_WRONLY:
+      return append ? 'a' : 'w';
+    default:
+      return 'r';
+  }
 }
 
-export async function copyFile(src, dest) {
-  const { COPYFILE_EXCL, COPYFILE_FICLONE, COPYFILE_FICLONE_FORCE } = constants;
+export async function open(filename, flags = 'r', mode = 0o644) {
+  const oflags = isNumber(flags) ? flags : parseFlags(flags);
+  let fd, file;
 
-  if(flags & (COPYFILE_FICLONE | COPYFILE_FICLONE_FORCE)) {
-    if(sys_link(src, dest) != -1) return;
-    if(flags & COPYFILE_FICLONE_FORCE) throw new Error(`Unable to link '${src}' to '${dest}'`);
+  try {
+    fd = await aio.open(filename, oflags, mode);
+  } catch(e) {
+    throw MakeError(`Error opening '${filename}' (${flags})`, e.errno, filename, 'open');
   }
 
-  const { size, mode } = await sys_stat(src);
+  const errorObj = { errno: 0 };
 
-  const r = await open(src, 'rb'),
-    w = await open(dest, 'wb', mode);
+  if(!(file = std.fdopen(fd, fdopenFlags(oflags), errorObj)) || errorObj.errno) {
+    os.close(fd);
+    throw MakeError(`Error opening '${filename}' (${flags})`, errorObj.errno, filename, 'fdopen');
+  }
 
-  const len = size < COPY_BUF_SIZE ? size : COPY_BUF_SIZE,
-    rem = size < COPY_BUF_SIZE ? 0 : size % COPY_BUF_SIZE,
-    ofs = 0;
+  return new FileHandle(file);
+}
 
-  let pos = 0,
-    buf = new ArrayBuffer(len);
+export async function close(fd) {
+  if(isNumber(fd)) return aio.close(fd);
 
-  for(let i = 0; len + pos + rem <= size; i++, pos = len * i) {
-    await read(r, buf, ofs, len, pos);
-    await write(w, buf, ofs, len, pos);
-  }
+  return closeSync(fd);
+}
 
-  if(rem) {
-    buf = new ArrayBuffer(rem);
+/* The copy runs on the aio thread pool.  onProgress(copied, total) is called while it does. */
+export async function copyFile(src, dest, flags = 0, onProgress) {
+  await aio.copyFile(src, dest, flags, onProgress);
+}
 
-    await read(r, buf, ofs, rem, pos);
-    await write(w, buf, ofs, rem, pos);
+export async function exists(path) {
+  try {
+    await aio.stat(path);
+    return true;
+  } catch(e) {
+    return false;
   }
+}
+
+export async function fsync(fd) {
+  if(!isNumber(fd)) fd.flush();
 
-  await close(r);
-  await close(w);
+  return aio.fsync(fileno(fd));
 }
 
-export async function exists(path) {
-  return existsSync(path);
+export async function fdatasync(fd) {
+  if(!isNumber(fd)) fd.flush();
+
+  return aio.fdatasync(fileno(fd));
 }
 
 export async function lstat(path) {
-  return lstatSync(path);
+  return new Stats(await aio.lstat(path));
 }
 
-export async function mkdir(path) {
-  return mkdirSync(path);
+export async function mkdir(path, mode = 0o777) {
+  return aio.mkdir(path, mode);
 }
 
-export async function read(fd, buf, offset, length) {
+/*
+ * Numeric descriptors of regular files are read and written on the aio
+ * thread pool.  Pipes, sockets and terminals would tie up a pool thread
+ * until data arrives, so they wait for the event loop instead.
+ */
+function isRegularFd(fd) {
+  const [st] = sys_fstat(fd);
+
+  return (st.mode & os.S_IFMT) == os.S_IFREG;
+}
+
+export async function read(fd, buf, offset, length, position) {
   const args = throwIfNull(InvalidBuffer(2), bufferArguments, buf, offset, length);
   let ret;
 
+  if(isNumber(fd) && isRegularFd(fd)) return aio.read(fd, ...args, position);
+
   do {
     await waitRead(fd);
     errno = 0;
@@ -1011,22 +1029,32 @@ export async function read(fd, buf, offset, length) {
   return ret;
 }
 
+export async function readdir(path) {
+  return aio.readdir(path);
+}
+
 export async function stat(path) {
-  return statSync(path);
+  return new Stats(await aio.stat(path));
 }
 
 export async function symlink(target, path) {
-  return symlinkSync(target, path);
+  return aio.symlink(target, path);
 }
 
 export async function tmpfile() {
   return tmpfileSync();
 }
 
-export async function write(fd, buf, offset, length) {
+export async function unlink(path) {
+  return aio.unlink(path);
+}
+
+export async function write(fd, buf, offset, length, position) {
   const args = throwIfNull(InvalidBuffer(2), stringOrBufferArguments, buf, offset, length);
   let ret;
 
+  if(isNumber(fd) && isRegularFd(fd)) return aio.write(fd, ...args, position);
+
   do {
     await waitWrite(fd);
     errno = 0;
@@ -1115,6 +1143,28 @@ export function watch(filename, options = {}, callback = (eventType, filename) =
 
   options.mask ??= IN_MODIFY | IN_MOVE_SELF | IN_MOVED_TO | IN_DELETE | IN_DELETE_SELF | IN_CREATE | IN_CLOSE_WRITE | IN_ATTRIB;
 
+  if(options.recursive) {
+    const { mask, delay, maxDelay, exclude } = options;
+    const prefix = filename.replace(/\/*$/, '/');
+    let tree;
+
+    try {
+      tree = watchTree(
+        filename,
+        changes => {
+          for(const [path, mask] of changes)
+            ret.emit(mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF) ? 'rename' : 'change', path.startsWith(prefix) ? path.slice(prefix.length) : path);
+        },
+        { mask: mask | IN_MOVED_FROM, delay, maxDelay, exclude },
+      );
+    } catch(err) {
+      return err;
+    }
+
+    ret.close = () => tree.close();
+    return ret;
+  }
+
   try {
     fd = watch();
     wd = watch(fd, filename, options.mask);
@@ -1324,9 +1374,11 @@ export default {
   createWriteStream,
   exists,
   existsSync,
+  fdatasync,
   fdopenSync,
   fileno,
   fopenSync,
+  fsync,
   getcwd,
   gets,
   isatty,
@@ -1347,6 +1399,7 @@ export default {
   readAllSync,
   readFileSync,
   readSync,
+  readdir,
   readdirSync,
   reader,
   readerSync,
@@ -1366,6 +1419,7 @@ export default {
   tempnamSync,
   tmpfile,
   tmpfileSync,
+  unlink,
   unlinkSync,
   waitRead,
   waitWrite,
@@ -1,13 +1,219 @@
-import { getPerformanceCounter } from 'misc';
-let timeOrigin = getPerformanceCounter();
+import * as perf from 'perf';
+import { now, timeOrigin, Timeline, Histogram } from 'perf';
+import { setTimeout, clearTimeout } from 'os';
+
+export { now, Histogram };
+
+export class PerformanceEntry {
+  toJSON() {
+    const { name, entryType, startTime, duration, detail } = this;
+    return { name, entryType, startTime, duration, detail };
+  }
+
+  get [Symbol.toStringTag]() {
+    return this.constructor.name;
+  }
+}
+
+export class PerformanceMark extends PerformanceEntry {}
+export class PerformanceMeasure extends PerformanceEntry {}
+
+/* marks and measures are kept natively, entry objects are made on demand */
+const timeline = new Timeline(PerformanceMark.prototype, PerformanceMeasure.prototype);
+
+const observers = new Set();
+let pending = false;
+
+/* observers get all entries since the last delivery in one callback */
+function deliver() {
+  pending = false;
+
+  for(const observer of [...observers]) {
+    const entries = observer.takeRecords();
+
+    if(entries.length) observer.callback.call(observer, new PerformanceObserverEntryList(entries), observer);
+  }
+}
+
+function schedule() {
+  if(!pending) {
+    pending = true;
+    Promise.resolve().then(deliver);
+  }
+}
+
+function enqueue(entry) {
+  for(const observer of observers)
+    if(observer.types.has(entry.entryType)) {
+      observer.buffer.push(entry);
+      schedule();
+    }
+
+  return entry;
+}
+
+export class PerformanceObserverEntryList {
+  #entries;
+
+  constructor(entries) {
+    this.#entries = entries.sort((a, b) => a.startTime - b.startTime);
+  }
+
+  getEntries() {
+    return [...this.#entries];
+  }
+
+  getEntriesByType(type) {
+    return this.#entries.filter(e => e.entryType == type);
+  }
+
+  getEntriesByName(name, type) {
+    return this.#entries.filter(e => e.name == name && (type === undefined || e.entryType == type));
+  }
+}
+
+export class PerformanceObserver {
+  static supportedEntryTypes = ['function', 'mark', 'measure'];
+
+  constructor(callback) {
+    if(typeof callback != 'function') throw new TypeError('callback must be a function');
+
+    this.callback = callback;
+    this.types = new Set();
+    this.buffer = [];
+  }
+
+  observe({ entryTypes, type, buffered } = {}) {
+    for(const t of entryTypes ?? [type]) if(PerformanceObserver.supportedEntryTypes.includes(t)) this.types.add(t);
+
+    observers.add(this);
+
+    if(buffered && type && type != 'function') {
+      this.buffer.push(...timeline.entries(type));
+      schedule();
+    }
+  }
+
+  disconnect() {
+    observers.delete(this);
+    this.types.clear();
+    this.buffer = [];
+  }
+
+  takeRecords() {
+    const { buffer } = this;
+    this.buffer = [];
+    return buffer;
+  }
+}
+
+export function mark(name, { startTime = now(), detail = null } = {}) {
+  return enqueue(timeline.mark(name, startTime, detail));
+}
+
+/*
+ * measure(name[, startMark[, endMark]]) or
+ * measure(name, { start, end, duration, detail })
+ */
+export function measure(name, startOrOptions, endMark) {
+  let start, end, duration, detail;
+
+  if(typeof startOrOptions == 'object' && startOrOptions !== null) ({ start, end, duration, detail } = startOrOptions);
+  else [start, end] = [startOrOptions, endMark];
+
+  start = start === undefined ? undefined : timeline.time(start);
+  end = end === undefined ? undefined : timeline.time(end);
+
+  if(duration !== undefined) {
+    if(end === undefined) end = (start ?? 0) + duration;
+    else if(start === undefined) start = end - duration;
+  }
+
+  return enqueue(timeline.measure(name, start ?? 0, end ?? now(), detail ?? null));
+}
+
+export function timerify(fn, { histogram } = {}) {
+  function timerified(...args) {
+    const startTime = now();
+    const done = () => {
+      const duration = now() - startTime;
+
+      if(histogram) histogram.record(Math.max(1, Math.round(duration * 1e6)));
+
+      if(observers.size) {
+        const entry = Object.assign(Object.create(PerformanceEntry.prototype), { name: fn.name, entryType: 'function', startTime, duration, detail: args });
+
+        enqueue(entry);
+      }
+    };
+    const result = new.target ? Reflect.construct(fn, args, new.target) : fn.apply(this, args);
+
+    if(result instanceof Promise) return result.finally(done);
+
+    done();
+    return result;
+  }
+
+  return Object.defineProperties(timerified, {
+    name: { value: `timerified ${fn.name}`, configurable: true },
+    length: { value: fn.length, configurable: true },
+  });
+}
+
+export function createHistogram(options) {
+  return new Histogram(options);
+}
+
+/*
+ * Values are how many nanoseconds late the event loop was for a timer
+ * firing every 'resolution' milliseconds.  Call disable() when done, the
+ * enabled monitor keeps the event loop running.
+ */
+export function monitorEventLoopDelay({ resolution = 10 } = {}) {
+  if(perf.monitorEventLoopDelay) return perf.monitorEventLoopDelay(resolution);
+
+  /* no timerfd: sample from an os timer */
+  const histogram = new Histogram({ highest: 3600e9 });
+  let timer, due;
+
+  const tick = () => {
+    const t = now();
+
+    histogram.record(Math.max(1, Math.round((t - due) * 1e6)));
+    due = t + resolution;
+    timer = setTimeout(tick, resolution);
+  };
+
+  return Object.assign(histogram, {
+    enable() {
+      if(timer) return false;
+
+      due = now() + resolution;
+      timer = setTimeout(tick, resolution);
+      return true;
+    },
+    disable() {
+      if(!timer) return false;
+
+      clearTimeout(timer);
+      timer = undefined;
+      return true;
+    },
+  });
+}
 
 export const performance = {
   now,
   timeOrigin,
+  mark,
+  measure,
+  timerify,
+  getEntries: () => timeline.entries(),
+  getEntriesByName: (name, type) => timeline.entries(type, name),
+  getEntriesByType: type => timeline.entries(type),
+  clearMarks: name => timeline.clear('mark', name),
+  clearMeasures: name => timeline.clear('measure', name),
+  toJSON: () => ({ timeOrigin }),
 };
 
-export function now() {
-  return getPerformanceCounter() - timeOrigin;
-}
-
 export default performance;
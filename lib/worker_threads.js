@@ -0,0 +1,191 @@
+import { Worker as ThreadWorker, parent, workerData, isMainThread, threadId, availableParallelism } from 'threads';
+import { EventEmitter } from 'events';
+
+export { workerData, isMainThread, threadId, availableParallelism };
+
+const toError = ({ name, message, stack }) => Object.assign(new Error(message), { name, stack });
+
+/* a 'threads' Worker emitting 'message', 'error' and 'exit' */
+export class Worker extends EventEmitter {
+  #worker;
+
+  constructor(filename, options) {
+    super();
+
+    const worker = (this.#worker = new ThreadWorker(filename, options));
+
+    worker.onmessage = ({ data }) => this.emit('message', data);
+    worker.onerror = error => this.emit('error', error);
+    worker.onexit = code => this.emit('exit', code);
+  }
+
+  get threadId() {
+    return this.#worker.threadId;
+  }
+
+  postMessage(value, transfer) {
+    this.#worker.postMessage(value, transfer);
+  }
+
+  /* resolves to the exit code */
+  terminate() {
+    return new Promise(resolve => {
+      if(!this.#worker.running) return resolve(1);
+
+      this.once('exit', resolve);
+      this.#worker.terminate();
+    });
+  }
+}
+
+/* in a worker: the worker keeps running while 'message' has listeners */
+class MessagePort extends EventEmitter {
+  #listen() {
+    parent.onmessage = this.rawListeners('message')?.length ? ({ data }) => this.emit('message', data) : null;
+  }
+
+  on(event, listener) {
+    super.on(event, listener);
+    if(event == 'message') this.#listen();
+  }
+
+  removeListener(event, listener) {
+    super.removeListener(event, listener);
+    if(event == 'message') this.#listen();
+  }
+
+  removeAllListeners(event) {
+    super.removeAllListeners(event);
+    this.#listen();
+  }
+
+  postMessage(value, transfer) {
+    parent.postMessage(value, transfer);
+  }
+
+  close() {
+    super.removeAllListeners();
+    parent.onmessage = null;
+  }
+}
+
+export const parentPort = parent && new MessagePort();
+
+/*
+ * In a pool worker: answer every task with fn(task).  What fn returns (or
+ * the promise resolves to) goes back to WorkerPool.run(), a throw rejects it.
+ */
+export function handleTasks(fn) {
+  parent.onmessage = async ({ data }) => {
+    try {
+      parent.postMessage({ result: await fn(data) });
+    } catch(error) {
+      const { name, message, stack } = error instanceof Error ? error : new Error(String(error));
+
+      parent.postMessage({ error: { name, message, stack } });
+    }
+  };
+}
+
+/*
+ * Runs tasks on up to 'size' workers of the script 'filename', which calls
+ * handleTasks().  Workers are started on demand and kept until close().
+ */
+export class WorkerPool {
+  #filename;
+  #options;
+  #workers = new Set();
+  #idle = [];
+  #jobs = new Map();
+  #queue = [];
+
+  constructor(filename, { size = availableParallelism(), ...options } = {}) {
+    this.#filename = filename;
+    this.#options = options;
+    this.size = size;
+  }
+
+  get pending() {
+    return this.#queue.length;
+  }
+
+  get running() {
+    return this.#jobs.size;
+  }
+
+  run(task, transfer) {
+    return new Promise((resolve, reject) => {
+      this.#queue.push({ task, transfer, resolve, reject });
+      this.#next();
+    });
+  }
+
+  /* terminates all workers, queued tasks are rejected */
+  close() {
+    for(const { reject } of this.#queue.splice(0)) reject(new Error('pool closed'));
+
+    for(const worker of this.#workers) worker.terminate();
+  }
+
+  #next() {
+    while(this.#queue.length) {
+      let worker = this.#idle.pop();
+
+      if(!worker) {
+        if(this.#workers.size >= this.size) return;
+
+        worker = this.#spawn();
+      }
+
+      const job = this.#queue.shift();
+
+      this.#jobs.set(worker, job);
+
+      try {
+        worker.postMessage(job.task, job.transfer);
+      } catch(error) {
+        this.#jobs.delete(worker);
+        this.#idle.push(worker);
+        job.reject(error);
+      }
+    }
+  }
+
+  #done(worker) {
+    const job = this.#jobs.get(worker);
+
+    this.#jobs.delete(worker);
+    return job;
+  }
+
+  #spawn() {
+    const worker = new ThreadWorker(this.#filename, this.#options);
+
+    worker.onmessage = ({ data }) => {
+      const job = this.#done(worker);
+
+      this.#idle.push(worker);
+
+      if(job) {
+        if('error' in data) job.reject(toError(data.error));
+        else job.resolve(data.result);
+      }
+
+      this.#next();
+    };
+
+    worker.onerror = error => this.#done(worker)?.reject(error);
+
+    worker.onexit = code => {
+      this.#workers.delete(worker);
+      this.#idle = this.#idle.filter(w => w !== worker);
+      this.#done(worker)?.reject(new Error(`worker exited with code ${code}`));
+      this.#next();
+    };
+
+    this.#workers.add(worker);
+    return worker;
+  }
+}
+
+export default { Worker, WorkerPool, parentPort, workerData, isMainThread, threadId, availableParallelism, handleTasks };
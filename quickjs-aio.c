@@ -0,0 +1,1186 @@
+#include "defines.h"
+#include "utils.h"
+#include "quickjs-syscallerror.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+/**
+ * \defgroup quickjs-aio quickjs-aio: Thread pool for blocking file system calls
+ *
+ * Every call is queued to a pool of worker threads and returns a promise.
+ * Finished requests are handed back to the thread that issued them and are
+ * settled from a read handler on a pipe, so a stalled disk or network file
+ * system blocks a worker thread instead of the event loop.  The read handler
+ * and the pipe only exist while requests are pending.  When the handler is
+ * dropped with requests outstanding (the runtime or worker goes away), the
+ * queued ones are cancelled, the running ones waited for, and none of their
+ * promises is settled.
+ *
+ * Buffers passed to read() and write() are referenced until the request has
+ * finished; they must not be detached in the meantime.
+ *
+ * copyFile() lets the kernel do the copying where it can: it tries a FICLONE
+ * reflink, then copy_file_range(), then sendfile(), and falls back to a
+ * read()/write() loop with a large buffer.  Progress is reported by waking
+ * up the event loop at most every AIO_PROGRESS_INTERVAL milliseconds.
+ * @{
+ */
+
+#define AIO_THREADS_DEFAULT 4
+#define AIO_THREADS_MAX 256
+
+#define AIO_COPY_CHUNK (64 << 20)
+#define AIO_COPY_BUFFER (1 << 20)
+#define AIO_PROGRESS_INTERVAL 100
+
+/* the same values as the COPYFILE_* constants of lib/fs.js */
+#define AIO_COPYFILE_EXCL 1
+#define AIO_COPYFILE_FICLONE 2
+#define AIO_COPYFILE_FICLONE_FORCE 4
+
+typedef enum {
+  AIO_STAT = 0,
+  AIO_LSTAT,
+  AIO_FSTAT,
+  AIO_OPEN,
+  AIO_CLOSE,
+  AIO_READ,
+  AIO_WRITE,
+  AIO_FSYNC,
+  AIO_FDATASYNC,
+  AIO_READDIR,
+  AIO_UNLINK,
+  AIO_MKDIR,
+  AIO_ACCESS,
+  AIO_SYMLINK,
+  AIO_COPYFILE,
+} AioOp;
+
+static const char* const aio_syscalls[] = {
+    "stat",
+    "lstat",
+    "fstat",
+    "open",
+    "close",
+    "read",
+    "write",
+    "fsync",
+    "fdatasync",
+    "readdir",
+    "unlink",
+    "mkdir",
+    "access",
+    "symlink",
+    "copyfile",
+};
+
+typedef struct aio_loop AioLoop;
+
+typedef struct aio_request {
+  struct aio_request *next, *active_next;
+  AioOp op;
+  AioLoop* loop;
+  JSContext* ctx;
+  JSValue resolving_funcs[2], buffer, progress;
+  char *path, *path2;
+  int fd, flags, mode;
+  uint8_t* data;
+  size_t length;
+  int64_t position;
+  /* results, written by the worker thread */
+  int64_t result;
+  int error;
+  const char* syscall;
+  struct stat st;
+  char* names;
+  size_t names_len;
+  /* copyFile() progress, read by the JS thread while the copy runs */
+  BOOL want_progress;
+  _Atomic(int64_t) copied, total;
+  _Atomic(int) notify;
+} AioRequest;
+
+#ifdef HAVE_PTHREAD_H
+/* per JS thread with pending requests: those finished by the pool, waiting to be settled */
+struct aio_loop {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  AioRequest* done;
+  int fds[2];
+  uint32_t pending;
+  /* pending requests with a progress callback, only used by the JS thread */
+  AioRequest* active;
+};
+
+static JSClassID js_aio_loop_class_id = 0;
+
+/* owned by the read handler on its pipe, freed together with it */
+static thread_local AioLoop* aio_loop = 0;
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  AioRequest *head, *tail;
+  uint32_t threads, idle, max_threads;
+} aio_pool = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    0,
+    0,
+    0,
+    0,
+    0,
+};
+#endif
+
+static void
+aio_readdir(AioRequest* req) {
+  struct dirent* ent;
+  size_t capacity = 0;
+  DIR* d;
+
+  if(!(d = opendir(req->path))) {
+    req->result = -1;
+    req->error = errno;
+    return;
+  }
+
+  while((ent = readdir(d))) {
+    size_t len = strlen(ent->d_name) + 1;
+
+    if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+      continue;
+
+    if(req->names_len + len > capacity) {
+      char* names;
+
+      capacity = (req->names_len + len) * 2;
+
+      if(!(names = realloc(req->names, capacity))) {
+        req->error = ENOMEM;
+        break;
+      }
+
+      req->names = names;
+    }
+
+    memcpy(req->names + req->names_len, ent->d_name, len);
+    req->names_len += len;
+    req->result++;
+  }
+
+  closedir(d);
+
+  if(req->error)
+    req->result = -1;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void
+aio_wakeup(AioLoop* loop) {
+  while(write(loop->fds[1], "", 1) == -1 && errno == EINTR) {}
+}
+#endif
+
+static int64_t
+aio_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Record that \param copied bytes have been copied, waking up the event loop when progress is wanted
+ */
+static void
+aio_copy_progress(AioRequest* req, int64_t copied, int64_t* last) {
+  atomic_store(&req->copied, copied);
+
+#ifdef HAVE_PTHREAD_H
+  int64_t now;
+
+  if(req->want_progress && (now = aio_now()) - *last >= AIO_PROGRESS_INTERVAL) {
+    *last = now;
+
+    if(!atomic_exchange(&req->notify, 1))
+      aio_wakeup(req->loop);
+  }
+#endif
+}
+
+/* errors which mean that a copy method isn't supported for this pair of files */
+static BOOL
+aio_copy_unsupported(int error) {
+  return error == EINVAL || error == EXDEV || error == ENOSYS || error == EOPNOTSUPP || error == ENOTSUP ||
+         error == EBADF || error == ETXTBSY;
+}
+
+/**
+ * @brief Copy the file req->path to req->path2
+ *
+ * Sets req->result to the number of bytes copied.  On error, req->syscall
+ * names the call that failed and a destination file it created is removed.
+ */
+static void
+aio_copy(AioRequest* req) {
+  int sfd, dfd = -1;
+  struct stat st, dst;
+  int64_t copied = 0, last = aio_now();
+  ssize_t n;
+  char* buf = 0;
+  BOOL created = FALSE;
+
+  req->syscall = "open";
+
+  if((sfd = open(req->path, O_RDONLY | O_CLOEXEC)) == -1)
+    goto fail;
+
+  req->syscall = "fstat";
+
+  if(fstat(sfd, &st) == -1)
+    goto fail;
+
+  atomic_store(&req->total, st.st_size);
+
+  /* opening the source itself with O_TRUNC would destroy it */
+  req->syscall = "stat";
+
+  if(!stat(req->path2, &dst) && dst.st_dev == st.st_dev && dst.st_ino == st.st_ino) {
+    errno = EINVAL;
+    goto fail;
+  }
+
+  req->syscall = "open";
+
+  /* only a file created here may be removed on failure, never an existing one */
+  for(;;) {
+    if((dfd = open(req->path2, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 0777)) != -1) {
+      created = TRUE;
+      break;
+    }
+
+    if(errno != EEXIST || (req->flags & AIO_COPYFILE_EXCL))
+      goto fail;
+
+    if((dfd = open(req->path2, O_WRONLY | O_TRUNC | O_CLOEXEC)) != -1)
+      break;
+
+    /* removed in between: try to create it again */
+    if(errno != ENOENT)
+      goto fail;
+  }
+
+  if(req->flags & (AIO_COPYFILE_FICLONE | AIO_COPYFILE_FICLONE_FORCE)) {
+    req->syscall = "ioctl";
+
+#ifdef FICLONE
+    if(ioctl(dfd, FICLONE, sfd) == 0) {
+      aio_copy_progress(req, copied = st.st_size, &last);
+      goto done;
+    }
+#else
+    errno = ENOTSUP;
+#endif
+
+    if(req->flags & AIO_COPYFILE_FICLONE_FORCE)
+      goto fail;
+  }
+
+  /*
+   * Files in procfs or sysfs report a size of 0 and copy_file_range() or
+   * sendfile() copy nothing from them, so an end of file right away is
+   * checked with the read()/write() loop.
+   */
+#ifdef HAVE_COPY_FILE_RANGE
+  req->syscall = "copy_file_range";
+
+  while((n = copy_file_range(sfd, 0, dfd, 0, AIO_COPY_CHUNK, 0)) > 0)
+    aio_copy_progress(req, copied += n, &last);
+
+  if(n == 0 && copied > 0)
+    goto done;
+  if(n == -1 && (copied > 0 || !aio_copy_unsupported(errno)))
+    goto fail;
+#endif
+
+#ifdef HAVE_SENDFILE
+  req->syscall = "sendfile";
+
+  while((n = sendfile(dfd, sfd, 0, AIO_COPY_CHUNK)) > 0)
+    aio_copy_progress(req, copied += n, &last);
+
+  if(n == 0 && copied > 0)
+    goto done;
+  if(n == -1 && (copied > 0 || !aio_copy_unsupported(errno)))
+    goto fail;
+#endif
+
+  if(!(buf = malloc(AIO_COPY_BUFFER))) {
+    req->syscall = "malloc";
+    errno = ENOMEM;
+    goto fail;
+  }
+
+  for(;;) {
+    req->syscall = "read";
+
+    if((n = read(sfd, buf, AIO_COPY_BUFFER)) == 0)
+      break;
+
+    if(n == -1) {
+      if(errno == EINTR)
+        continue;
+
+      goto fail;
+    }
+
+    req->syscall = "write";
+
+    for(ssize_t pos = 0, r; pos < n; pos += r)
+      if((r = write(dfd, buf + pos, n - pos)) == -1) {
+        if(errno != EINTR)
+          goto fail;
+
+        r = 0;
+      }
+
+    aio_copy_progress(req, copied += n, &last);
+  }
+
+done:
+  /* close() reports delayed write errors on some file systems */
+  req->syscall = "close";
+  n = close(dfd);
+  dfd = -1;
+
+  if(n == -1)
+    goto fail;
+
+  req->result = copied;
+  req->error = 0;
+  goto end;
+
+fail:
+  req->result = -1;
+  req->error = errno;
+
+  if(dfd != -1)
+    close(dfd);
+  if(created)
+    unlink(req->path2);
+
+end:
+  if(sfd != -1)
+    close(sfd);
+  if(buf)
+    free(buf);
+}
+
+/**
+ * @brief Perform the system call of \param req, on a worker thread
+ */
+static void
+aio_run(AioRequest* req) {
+  int64_t r = 0;
+
+  switch(req->op) {
+    case AIO_STAT: r = stat(req->path, &req->st); break;
+#ifdef _WIN32
+    case AIO_LSTAT: r = stat(req->path, &req->st); break;
+#else
+    case AIO_LSTAT: r = lstat(req->path, &req->st); break;
+#endif
+    case AIO_FSTAT: r = fstat(req->fd, &req->st); break;
+    case AIO_OPEN: r = open(req->path, req->flags, req->mode); break;
+    case AIO_CLOSE: r = close(req->fd); break;
+    case AIO_READ:
+#ifndef _WIN32
+      if(req->position >= 0)
+        r = pread(req->fd, req->data, req->length, req->position);
+      else
+#endif
+        r = read(req->fd, req->data, req->length);
+      break;
+    case AIO_WRITE:
+#ifndef _WIN32
+      if(req->position >= 0)
+        r = pwrite(req->fd, req->data, req->length, req->position);
+      else
+#endif
+        r = write(req->fd, req->data, req->length);
+      break;
+#ifdef HAVE_FSYNC
+    case AIO_FSYNC: r = fsync(req->fd); break;
+#endif
+#ifdef HAVE_FDATASYNC
+    case AIO_FDATASYNC: r = fdatasync(req->fd); break;
+#elif defined(HAVE_FSYNC)
+    case AIO_FDATASYNC: r = fsync(req->fd); break;
+#endif
+    case AIO_READDIR: aio_readdir(req); return;
+    case AIO_COPYFILE: aio_copy(req); return;
+    case AIO_UNLINK: r = unlink(req->path); break;
+#ifdef _WIN32
+    case AIO_MKDIR: r = mkdir(req->path); break;
+#else
+    case AIO_MKDIR: r = mkdir(req->path, req->mode); break;
+#endif
+    case AIO_ACCESS: r = access(req->path, req->mode); break;
+#ifdef HAVE_SYMLINK
+    case AIO_SYMLINK: r = symlink(req->path, req->path2); break;
+#endif
+    default: r = -1; errno = ENOSYS; break;
+  }
+
+  req->result = r;
+  req->error = r == -1 ? errno : 0;
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * @brief Hand a finished request back to its thread and wake up its event loop
+ */
+static void
+aio_complete(AioRequest* req) {
+  AioLoop* loop = req->loop;
+
+  /* the loop may be freed as soon as the lock is released */
+  pthread_mutex_lock(&loop->lock);
+  req->next = loop->done;
+  loop->done = req;
+  aio_wakeup(loop);
+  pthread_cond_signal(&loop->cond);
+  pthread_mutex_unlock(&loop->lock);
+}
+
+static void*
+aio_thread(void* arg) {
+  AioRequest* req;
+
+  for(;;) {
+    pthread_mutex_lock(&aio_pool.lock);
+
+    while(!aio_pool.head) {
+      aio_pool.idle++;
+      pthread_cond_wait(&aio_pool.cond, &aio_pool.lock);
+      aio_pool.idle--;
+    }
+
+    req = aio_pool.head;
+
+    if(!(aio_pool.head = req->next))
+      aio_pool.tail = 0;
+
+    pthread_mutex_unlock(&aio_pool.lock);
+
+    aio_run(req);
+    aio_complete(req);
+  }
+
+  return 0;
+}
+
+static uint32_t
+aio_max_threads(void) {
+  const char* s;
+
+  if(!aio_pool.max_threads)
+    aio_pool.max_threads = (s = getenv("QJSM_AIO_THREADS")) && atoi(s) > 0 ? MIN_NUM(atoi(s), AIO_THREADS_MAX)
+                                                                          : AIO_THREADS_DEFAULT;
+
+  return aio_pool.max_threads;
+}
+
+/**
+ * @brief Queue \param req, starting another worker if none is idle
+ */
+static int
+aio_queue(AioRequest* req) {
+  int ret = 0;
+
+  req->next = 0;
+
+  pthread_mutex_lock(&aio_pool.lock);
+
+  if(aio_pool.tail)
+    aio_pool.tail->next = req;
+  else
+    aio_pool.head = req;
+
+  aio_pool.tail = req;
+
+  if(aio_pool.idle == 0 && aio_pool.threads < aio_max_threads()) {
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    if(pthread_create(&thread, &attr, aio_thread, 0) == 0)
+      aio_pool.threads++;
+    else if(aio_pool.threads == 0)
+      ret = -1;
+
+    pthread_attr_destroy(&attr);
+  } else {
+    pthread_cond_signal(&aio_pool.cond);
+  }
+
+  /* no worker could be started, so the queue holds only this request */
+  if(ret)
+    aio_pool.head = aio_pool.tail = 0;
+
+  pthread_mutex_unlock(&aio_pool.lock);
+  return ret;
+}
+#endif
+
+static JSValue
+aio_stat_object(JSContext* ctx, const struct stat* st) {
+  JSValue obj = JS_NewObject(ctx);
+
+  JS_SetPropertyStr(ctx, obj, "dev", JS_NewInt64(ctx, st->st_dev));
+  JS_SetPropertyStr(ctx, obj, "ino", JS_NewInt64(ctx, st->st_ino));
+  JS_SetPropertyStr(ctx, obj, "mode", JS_NewInt32(ctx, st->st_mode));
+  JS_SetPropertyStr(ctx, obj, "nlink", JS_NewInt64(ctx, st->st_nlink));
+  JS_SetPropertyStr(ctx, obj, "uid", JS_NewInt64(ctx, st->st_uid));
+  JS_SetPropertyStr(ctx, obj, "gid", JS_NewInt64(ctx, st->st_gid));
+  JS_SetPropertyStr(ctx, obj, "rdev", JS_NewInt64(ctx, st->st_rdev));
+  JS_SetPropertyStr(ctx, obj, "size", JS_NewInt64(ctx, st->st_size));
+#if !defined(_WIN32)
+  JS_SetPropertyStr(ctx, obj, "blocks", JS_NewInt64(ctx, st->st_blocks));
+#endif
+
+#if defined(_WIN32) || defined(__dietlibc__) || defined(__ANDROID__)
+  JS_SetPropertyStr(ctx, obj, "atime", JS_NewInt64(ctx, (int64_t)st->st_atime * 1000));
+  JS_SetPropertyStr(ctx, obj, "mtime", JS_NewInt64(ctx, (int64_t)st->st_mtime * 1000));
+  JS_SetPropertyStr(ctx, obj, "ctime", JS_NewInt64(ctx, (int64_t)st->st_ctime * 1000));
+#elif defined(__APPLE__)
+  JS_SetPropertyStr(ctx,
+                    obj,
+                    "atime",
+                    JS_NewInt64(ctx, (int64_t)st->st_atimespec.tv_sec * 1000 + st->st_atimespec.tv_nsec / 1000000));
+  JS_SetPropertyStr(ctx,
+                    obj,
+                    "mtime",
+                    JS_NewInt64(ctx, (int64_t)st->st_mtimespec.tv_sec * 1000 + st->st_mtimespec.tv_nsec / 1000000));
+  JS_SetPropertyStr(ctx,
+                    obj,
+                    "ctime",
+                    JS_NewInt64(ctx, (int64_t)st->st_ctimespec.tv_sec * 1000 + st->st_ctimespec.tv_nsec / 1000000));
+#else
+  JS_SetPropertyStr(
+      ctx, obj, "atime", JS_NewInt64(ctx, (int64_t)st->st_atim.tv_sec * 1000 + st->st_atim.tv_nsec / 1000000));
+  JS_SetPropertyStr(
+      ctx, obj, "mtime", JS_NewInt64(ctx, (int64_t)st->st_mtim.tv_sec * 1000 + st->st_mtim.tv_nsec / 1000000));
+  JS_SetPropertyStr(
+      ctx, obj, "ctime", JS_NewInt64(ctx, (int64_t)st->st_ctim.tv_sec * 1000 + st->st_ctim.tv_nsec / 1000000));
+#endif
+
+  return obj;
+}
+
+static JSValue
+aio_result(JSContext* ctx, AioRequest* req) {
+  switch(req->op) {
+    case AIO_STAT:
+    case AIO_LSTAT:
+    case AIO_FSTAT: return aio_stat_object(ctx, &req->st);
+    case AIO_OPEN:
+    case AIO_READ:
+    case AIO_WRITE:
+    case AIO_COPYFILE: return JS_NewInt64(ctx, req->result);
+    case AIO_READDIR: {
+      JSValue ret = JS_NewArray(ctx);
+      size_t pos = 0;
+
+      for(uint32_t i = 0; pos < req->names_len; i++) {
+        JS_SetPropertyUint32(ctx, ret, i, JS_NewString(ctx, req->names + pos));
+        pos += strlen(req->names + pos) + 1;
+      }
+
+      return ret;
+    }
+    default: return JS_UNDEFINED;
+  }
+}
+
+static void
+aio_free(JSRuntime* rt, AioRequest* req) {
+  JS_FreeValueRT(rt, req->resolving_funcs[0]);
+  JS_FreeValueRT(rt, req->resolving_funcs[1]);
+  JS_FreeValueRT(rt, req->buffer);
+  JS_FreeValueRT(rt, req->progress);
+
+  if(req->path)
+    js_free_rt(rt, req->path);
+  if(req->path2)
+    js_free_rt(rt, req->path2);
+  if(req->names)
+    free(req->names);
+
+  js_free_rt(rt, req);
+}
+
+static void
+aio_settle(AioRequest* req) {
+  JSContext* ctx = req->ctx;
+  BOOL reject = req->result == -1;
+  JSValue value = reject ? js_syscallerror_new(ctx, req->syscall ? req->syscall : aio_syscalls[req->op], req->error)
+                         : aio_result(ctx, req);
+  JSValue ret = JS_Call(ctx, req->resolving_funcs[reject], JS_UNDEFINED, 1, (JSValueConst*)&value);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, value);
+}
+
+/**
+ * @brief Call progress(copied, total) of \param req
+ */
+static void
+aio_progress(AioRequest* req) {
+  JSContext* ctx = req->ctx;
+  JSValue args[2] = {
+      JS_NewInt64(ctx, atomic_load(&req->copied)),
+      JS_NewInt64(ctx, atomic_load(&req->total)),
+  };
+  JSValue ret = JS_Call(ctx, req->progress, JS_UNDEFINED, countof(args), (JSValueConst*)args);
+
+  if(JS_IsException(ret)) {
+    JSValue error = JS_GetException(ctx);
+
+    js_error_print(ctx, error);
+    JS_FreeValue(ctx, error);
+  }
+
+  JS_FreeValue(ctx, ret);
+}
+
+#ifdef HAVE_PTHREAD_H
+static void
+aio_unlink_active(AioLoop* loop, AioRequest* req) {
+  for(AioRequest** ptr = &loop->active; *ptr; ptr = &(*ptr)->active_next)
+    if(*ptr == req) {
+      *ptr = req->active_next;
+      break;
+    }
+}
+
+static void
+aio_loop_close(JSContext* ctx, AioLoop* loop) {
+  JSValue set_handler = js_iohandler_fn(ctx, FALSE, 0);
+
+  if(aio_loop == loop)
+    aio_loop = 0;
+
+  /* frees the handler, the loop goes with it */
+  js_iohandler_set(ctx, set_handler, loop->fds[0], JS_NULL);
+  JS_FreeValue(ctx, set_handler);
+}
+
+static JSValue
+js_aio_handler(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue* data) {
+  AioLoop* loop = JS_GetOpaque(data[0], js_aio_loop_class_id);
+  AioRequest *list, *reversed = 0, *req;
+  char buf[64];
+
+  /* drain the wake-up bytes */
+  while(read(loop->fds[0], buf, sizeof(buf)) > 0) {}
+
+  pthread_mutex_lock(&loop->lock);
+  list = loop->done;
+  loop->done = 0;
+  pthread_mutex_unlock(&loop->lock);
+
+  for(req = loop->active; req; req = req->active_next)
+    if(atomic_exchange(&req->notify, 0))
+      aio_progress(req);
+
+  /* settle in order of completion */
+  while((req = list)) {
+    list = req->next;
+    req->next = reversed;
+    reversed = req;
+  }
+
+  while((req = reversed)) {
+    reversed = req->next;
+    loop->pending--;
+
+    if(req->want_progress) {
+      aio_unlink_active(loop, req);
+
+      if(req->result != -1)
+        aio_progress(req);
+    }
+
+    aio_settle(req);
+    aio_free(JS_GetRuntime(ctx), req);
+  }
+
+  if(loop->pending == 0)
+    aio_loop_close(ctx, loop);
+
+  return JS_UNDEFINED;
+}
+
+/**
+ * @brief Free the loop once its read handler is gone
+ *
+ * That happens when the last request was settled, or with requests pending
+ * when the handlers of the runtime are freed.  Queued requests are then
+ * taken off the queue, running ones are waited for, as they use the loop and
+ * the buffers, and all of them are dropped without settling their promises.
+ */
+static void
+js_aio_loop_finalizer(JSRuntime* rt, JSValue val) {
+  AioLoop* loop;
+  AioRequest *req, **ptr, *cancelled = 0;
+  uint32_t n = 0;
+
+  if(!(loop = JS_GetOpaque(val, js_aio_loop_class_id)))
+    return;
+
+  pthread_mutex_lock(&aio_pool.lock);
+  aio_pool.tail = 0;
+
+  for(ptr = &aio_pool.head; (req = *ptr);) {
+    if(req->loop == loop) {
+      *ptr = req->next;
+      req->next = cancelled;
+      cancelled = req;
+      n++;
+    } else {
+      aio_pool.tail = req;
+      ptr = &req->next;
+    }
+  }
+
+  pthread_mutex_unlock(&aio_pool.lock);
+
+  pthread_mutex_lock(&loop->lock);
+
+  for(;;) {
+    uint32_t finished = n;
+
+    for(req = loop->done; req; req = req->next)
+      finished++;
+
+    if(finished >= loop->pending)
+      break;
+
+    pthread_cond_wait(&loop->cond, &loop->lock);
+  }
+
+  pthread_mutex_unlock(&loop->lock);
+
+  while((req = loop->done)) {
+    loop->done = req->next;
+    aio_free(rt, req);
+  }
+
+  while((req = cancelled)) {
+    cancelled = req->next;
+    aio_free(rt, req);
+  }
+
+  if(aio_loop == loop)
+    aio_loop = 0;
+
+  close(loop->fds[0]);
+  close(loop->fds[1]);
+  pthread_cond_destroy(&loop->cond);
+  pthread_mutex_destroy(&loop->lock);
+  free(loop);
+}
+
+static JSClassDef js_aio_loop_class = {
+    .class_name = "AioLoop",
+    .finalizer = js_aio_loop_finalizer,
+};
+
+/**
+ * @brief Create the loop of this thread and watch its pipe
+ *
+ * @return  0 on success, -1 if requests have to run synchronously
+ */
+static int
+aio_loop_new(JSContext* ctx) {
+  AioLoop* loop;
+  JSValue obj, handler, set_handler;
+
+  if(!(loop = calloc(1, sizeof(AioLoop))))
+    return -1;
+
+  if(pipe(loop->fds) == -1) {
+    free(loop);
+    return -1;
+  }
+
+  /* a full pipe means the loop has not woken up yet, nothing is lost */
+  fcntl(loop->fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(loop->fds[1], F_SETFL, O_NONBLOCK);
+  fcntl(loop->fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(loop->fds[1], F_SETFD, FD_CLOEXEC);
+  pthread_mutex_init(&loop->lock, 0);
+  pthread_cond_init(&loop->cond, 0);
+
+  if(JS_IsException((obj = JS_NewObjectClass(ctx, js_aio_loop_class_id)))) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    close(loop->fds[0]);
+    close(loop->fds[1]);
+    pthread_cond_destroy(&loop->cond);
+    pthread_mutex_destroy(&loop->lock);
+    free(loop);
+    return -1;
+  }
+
+  /* from here on the loop belongs to the object, then to the handler */
+  JS_SetOpaque(obj, loop);
+  handler = JS_NewCFunctionData(ctx, js_aio_handler, 0, 0, 1, &obj);
+  JS_FreeValue(ctx, obj);
+  set_handler = js_iohandler_fn(ctx, FALSE, 0);
+
+  if(JS_IsException(handler) || JS_IsException(set_handler)) {
+    JS_FreeValue(ctx, handler);
+    JS_FreeValue(ctx, set_handler);
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return -1;
+  }
+
+  if(!js_iohandler_set(ctx, set_handler, loop->fds[0], handler)) {
+    JS_FreeValue(ctx, set_handler);
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return -1;
+  }
+
+  JS_FreeValue(ctx, set_handler);
+  aio_loop = loop;
+  return 0;
+}
+#endif
+
+/**
+ * @brief Start \param req, returns the promise for its result
+ */
+static JSValue
+aio_submit(JSContext* ctx, AioRequest* req) {
+  JSValue promise;
+
+  req->ctx = ctx;
+
+  if(JS_IsException((promise = js_promise_new(ctx, req->resolving_funcs)))) {
+    req->resolving_funcs[0] = req->resolving_funcs[1] = JS_UNDEFINED;
+    aio_free(JS_GetRuntime(ctx), req);
+    return JS_EXCEPTION;
+  }
+
+#ifdef HAVE_PTHREAD_H
+  if(aio_loop || aio_loop_new(ctx) == 0) {
+    AioLoop* loop = aio_loop;
+
+    req->loop = loop;
+
+    if(aio_queue(req) == 0) {
+      loop->pending++;
+
+      if(req->want_progress) {
+        req->active_next = loop->active;
+        loop->active = req;
+      }
+
+      return promise;
+    }
+
+    req->loop = 0;
+
+    if(loop->pending == 0)
+      aio_loop_close(ctx, loop);
+  }
+#endif
+
+  /* no threads: run it right away */
+  req->want_progress = FALSE;
+  aio_run(req);
+  aio_settle(req);
+  aio_free(JS_GetRuntime(ctx), req);
+
+  return promise;
+}
+
+/**
+ * @brief Get a pointer to \param length bytes at \param offset of an ArrayBuffer or typed array
+ *
+ * @return  the pointer, or NULL with an exception thrown
+ */
+static uint8_t*
+aio_buffer(JSContext* ctx, JSValueConst value, int64_t offset, int64_t* length) {
+  size_t size, byte_offset = 0, bytes_per_element;
+  uint8_t* ptr;
+  JSValue buffer;
+
+  if(!(ptr = JS_GetArrayBuffer(ctx, &size, value))) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+
+    buffer = JS_GetTypedArrayBuffer(ctx, value, &byte_offset, &size, &bytes_per_element);
+
+    if(JS_IsException(buffer)) {
+      JS_FreeValue(ctx, JS_GetException(ctx));
+      JS_ThrowTypeError(ctx, "argument 2 must be an ArrayBuffer or a typed array");
+      return 0;
+    }
+
+    ptr = JS_GetArrayBuffer(ctx, &bytes_per_element, buffer);
+    JS_FreeValue(ctx, buffer);
+
+    if(!ptr)
+      return 0;
+
+    ptr += byte_offset;
+  }
+
+  if(offset < 0 || (size_t)offset > size) {
+    JS_ThrowRangeError(ctx, "offset %" PRId64 " out of range (buffer size %zu)", offset, size);
+    return 0;
+  }
+
+  if(*length < 0 || (size_t)(offset + *length) > size)
+    *length = size - offset;
+
+  return ptr + offset;
+}
+
+static JSValue
+js_aio_call(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  AioRequest* req;
+
+  if(!(req = js_mallocz(ctx, sizeof(AioRequest))))
+    return JS_EXCEPTION;
+
+  req->op = magic;
+  req->fd = -1;
+  req->position = -1;
+  req->buffer = req->progress = JS_UNDEFINED;
+  req->resolving_funcs[0] = req->resolving_funcs[1] = JS_UNDEFINED;
+
+  switch(magic) {
+    case AIO_FSTAT:
+    case AIO_CLOSE:
+    case AIO_FSYNC:
+    case AIO_FDATASYNC:
+    case AIO_READ:
+    case AIO_WRITE: {
+      if(JS_ToInt32(ctx, &req->fd, argv[0]))
+        goto fail;
+
+      if(magic == AIO_READ || magic == AIO_WRITE) {
+        int64_t offset = 0, length = -1;
+
+        if(argc > 2 && !JS_IsUndefined(argv[2]) && JS_ToInt64(ctx, &offset, argv[2]))
+          goto fail;
+        if(argc > 3 && !JS_IsUndefined(argv[3]) && JS_ToInt64(ctx, &length, argv[3]))
+          goto fail;
+        if(argc > 4 && JS_IsNumber(argv[4]) && JS_ToInt64(ctx, &req->position, argv[4]))
+          goto fail;
+
+        if(!(req->data = aio_buffer(ctx, argv[1], offset, &length)))
+          goto fail;
+
+        req->length = length;
+        req->buffer = JS_DupValue(ctx, argv[1]);
+      }
+
+      break;
+    }
+
+    default: {
+      if(!(req->path = js_tostring(ctx, argv[0])))
+        goto fail;
+
+      if((magic == AIO_SYMLINK || magic == AIO_COPYFILE) && !(req->path2 = js_tostring(ctx, argv[1])))
+        goto fail;
+
+      if(magic == AIO_OPEN) {
+        req->flags = O_RDONLY;
+        req->mode = 0666;
+
+        if(argc > 1 && JS_ToInt32(ctx, &req->flags, argv[1]))
+          goto fail;
+        if(argc > 2 && !JS_IsUndefined(argv[2]) && JS_ToInt32(ctx, &req->mode, argv[2]))
+          goto fail;
+
+#ifdef O_CLOEXEC
+        req->flags |= O_CLOEXEC;
+#endif
+      } else if(magic == AIO_MKDIR) {
+        req->mode = 0777;
+
+        if(argc > 1 && !JS_IsUndefined(argv[1]) && JS_ToInt32(ctx, &req->mode, argv[1]))
+          goto fail;
+      } else if(magic == AIO_COPYFILE) {
+        if(argc > 2 && !JS_IsUndefined(argv[2]) && JS_ToInt32(ctx, &req->flags, argv[2]))
+          goto fail;
+
+        if(argc > 3 && JS_IsFunction(ctx, argv[3])) {
+          req->progress = JS_DupValue(ctx, argv[3]);
+          req->want_progress = TRUE;
+        }
+      } else if(magic == AIO_ACCESS) {
+        req->mode = F_OK;
+
+        if(argc > 1 && !JS_IsUndefined(argv[1]) && JS_ToInt32(ctx, &req->mode, argv[1]))
+          goto fail;
+      }
+
+      break;
+    }
+  }
+
+  return aio_submit(ctx, req);
+
+fail:
+  aio_free(JS_GetRuntime(ctx), req);
+  return JS_EXCEPTION;
+}
+
+/**
+ * aio.copyFileSync(src, dest[, flags])
+ *
+ * The same copy as aio.copyFile(), on the calling thread.  Returns the
+ * number of bytes copied.
+ */
+static JSValue
+js_aio_copyfile_sync(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  AioRequest req;
+  JSValue ret = JS_EXCEPTION;
+
+  memset(&req, 0, sizeof(req));
+  req.op = AIO_COPYFILE;
+
+  if(!(req.path = js_tostring(ctx, argv[0])) || !(req.path2 = js_tostring(ctx, argv[1])))
+    goto end;
+
+  if(argc > 2 && !JS_IsUndefined(argv[2]) && JS_ToInt32(ctx, &req.flags, argv[2]))
+    goto end;
+
+  aio_copy(&req);
+
+  if(req.result == -1)
+    JS_Throw(ctx, js_syscallerror_new(ctx, req.syscall, req.error));
+  else
+    ret = JS_NewInt64(ctx, req.result);
+
+end:
+  if(req.path)
+    js_free(ctx, req.path);
+  if(req.path2)
+    js_free(ctx, req.path2);
+
+  return ret;
+}
+
+/**
+ * aio.threads([n])
+ *
+ * Returns the maximum number of worker threads, after setting it to n.
+ */
+static JSValue
+js_aio_threads(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+#ifdef HAVE_PTHREAD_H
+  int32_t n = 0;
+  uint32_t ret;
+
+  if(argc > 0 && !JS_IsUndefined(argv[0]) && JS_ToInt32(ctx, &n, argv[0]))
+    return JS_EXCEPTION;
+
+  pthread_mutex_lock(&aio_pool.lock);
+
+  if(n > 0)
+    aio_pool.max_threads = MIN_NUM(n, AIO_THREADS_MAX);
+
+  ret = aio_max_threads();
+  pthread_mutex_unlock(&aio_pool.lock);
+
+  return JS_NewUint32(ctx, ret);
+#else
+  return JS_NewUint32(ctx, 0);
+#endif
+}
+
+static const JSCFunctionListEntry js_aio_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("stat", 1, js_aio_call, AIO_STAT),
+    JS_CFUNC_MAGIC_DEF("lstat", 1, js_aio_call, AIO_LSTAT),
+    JS_CFUNC_MAGIC_DEF("fstat", 1, js_aio_call, AIO_FSTAT),
+    JS_CFUNC_MAGIC_DEF("open", 3, js_aio_call, AIO_OPEN),
+    JS_CFUNC_MAGIC_DEF("close", 1, js_aio_call, AIO_CLOSE),
+    JS_CFUNC_MAGIC_DEF("read", 5, js_aio_call, AIO_READ),
+    JS_CFUNC_MAGIC_DEF("write", 5, js_aio_call, AIO_WRITE),
+    JS_CFUNC_MAGIC_DEF("fsync", 1, js_aio_call, AIO_FSYNC),
+    JS_CFUNC_MAGIC_DEF("fdatasync", 1, js_aio_call, AIO_FDATASYNC),
+    JS_CFUNC_MAGIC_DEF("readdir", 1, js_aio_call, AIO_READDIR),
+    JS_CFUNC_MAGIC_DEF("unlink", 1, js_aio_call, AIO_UNLINK),
+    JS_CFUNC_MAGIC_DEF("mkdir", 2, js_aio_call, AIO_MKDIR),
+    JS_CFUNC_MAGIC_DEF("access", 2, js_aio_call, AIO_ACCESS),
+    JS_CFUNC_MAGIC_DEF("symlink", 2, js_aio_call, AIO_SYMLINK),
+    JS_CFUNC_MAGIC_DEF("copyFile", 4, js_aio_call, AIO_COPYFILE),
+    JS_CFUNC_DEF("copyFileSync", 3, js_aio_copyfile_sync),
+    JS_CFUNC_DEF("threads", 0, js_aio_threads),
+    JS_PROP_INT32_DEF("COPYFILE_EXCL", AIO_COPYFILE_EXCL, JS_PROP_CONFIGURABLE),
+    JS_PROP_INT32_DEF("COPYFILE_FICLONE", AIO_COPYFILE_FICLONE, JS_PROP_CONFIGURABLE),
+    JS_PROP_INT32_DEF("COPYFILE_FICLONE_FORCE", AIO_COPYFILE_FICLONE_FORCE, JS_PROP_CONFIGURABLE),
+};
+
+static int
+js_aio_init(JSContext* ctx, JSModuleDef* m) {
+  /* rejections are SyscallError objects */
+  if(!js_syscallerror_class_id)
+    js_syscallerror_init(ctx, 0);
+
+#ifdef HAVE_PTHREAD_H
+  JS_NewClassID(&js_aio_loop_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_aio_loop_class_id, &js_aio_loop_class);
+#endif
+
+  if(m)
+    JS_SetModuleExportList(ctx, m, js_aio_funcs, countof(js_aio_funcs));
+
+  return 0;
+}
+
+#if defined(JS_SHARED_LIBRARY) && defined(JS_AIO_MODULE)
+#define JS_INIT_MODULE js_init_module
+#else
+#define JS_INIT_MODULE js_init_module_aio
+#endif
+
+VISIBLE JSModuleDef*
+JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
+  JSModuleDef* m;
+
+  if((m = JS_NewCModule(ctx, module_name, js_aio_init)))
+    JS_AddModuleExportList(ctx, m, js_aio_funcs, countof(js_aio_funcs));
+
+  return m;
+}
+
+/**
+ * @}
+ */
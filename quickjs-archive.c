@@ -5,6 +5,15 @@
 #include "utils.h"
 #include "buffer-utils.h"
 #include "debug.h"
+#include <unistd.h>
+#include <errno.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#endif
 
 /**
  * \addtogroup quickjs-archive
@@ -12,14 +21,26 @@
  */
 
 VISIBLE JSClassID js_archive_class_id = 0, js_archive_iterator_class_id = 0, js_archiveentry_class_id = 0,
-                  js_archivematch_class_id = 0;
-static JSValue archive_proto, archive_ctor, iterator_proto, entry_proto, entry_ctor, match_proto, match_ctor;
+                  js_archivematch_class_id = 0, js_archive_asynciterator_class_id = 0;
+static thread_local JSValue archive_proto, archive_ctor, iterator_proto, asynciterator_proto, entry_proto, entry_ctor, match_proto,
+    match_ctor;
 
-typedef enum { READ = 0, WRITE = 1 } archive_mode;
+typedef enum { READ = 0, WRITE = 1, ASYNC = 2 } archive_mode;
 
 static JSValue js_archive_wrap(JSContext* ctx, JSValueConst proto, struct archive* ar);
 static JSValue js_archiveentry_wrap(JSContext* ctx, JSValueConst proto, struct archive_entry* ent);
 
+/*
+ * Opaque data of an Archive.  Stream input keeps its socket end in
+ * pending_fd until iterate() opens it on the reader thread.
+ */
+typedef struct {
+  struct archive* ar;
+  int pending_fd;
+  uint32_t block_size;
+  JSValue stream, writer;
+} ArchiveObject;
+
 typedef struct {
   JSValue archive;
 } ArchiveInstance;
@@ -32,7 +53,7 @@ typedef struct {
 typedef struct {
   int fd;
   JSContext* ctx;
-  JSValue this_obj, open, write, close;
+  JSValue this_obj, open, write, close, status;
 } ArchiveVirtual;
 
 /* Returns size actually written, zero on EOF, -1 on error. */
@@ -82,19 +103,347 @@ archive_destroy(struct archive* ar, void* client_data) {
   JS_FreeValue(ctx, cb->write);
   JS_FreeValue(ctx, cb->close);
   JS_FreeValue(ctx, cb->this_obj);
+  JS_FreeValue(ctx, cb->status);
 
   js_free(ctx, cb);
   return 0;
 }
 
+/* Callback-based reading from a raw file descriptor, closing it at the end */
+typedef struct {
+  int fd;
+  size_t block_size;
+  uint8_t buf[];
+} ArchiveFd;
+
+static la_ssize_t
+archivefd_read(struct archive* ar, void* client_data, const void** buffer) {
+  ArchiveFd* af = client_data;
+  ssize_t r;
+
+  while((r = read(af->fd, af->buf, af->block_size)) == -1 && errno == EINTR) {}
+
+  if(r == -1)
+    archive_set_error(ar, errno, "read() failed: %s", strerror(errno));
+
+  *buffer = af->buf;
+  return r;
+}
+
+static int
+archivefd_close(struct archive* ar, void* client_data) {
+  ArchiveFd* af = client_data;
+
+  close(af->fd);
+  free(af);
+  return ARCHIVE_OK;
+}
+
+static int
+archivefd_open(struct archive* ar, int fd, size_t block_size) {
+  ArchiveFd* af;
+
+  if(!(af = malloc(sizeof(ArchiveFd) + block_size))) {
+    archive_set_error(ar, ENOMEM, "out of memory");
+    close(fd);
+    return ARCHIVE_FATAL;
+  }
+
+  af->fd = fd;
+  af->block_size = block_size;
+
+  return archive_read_open(ar, af, 0, archivefd_read, archivefd_close);
+}
+
+/* Records the reason of a rejected write() in the status object (data[0]) */
+static JSValue
+archive_write_rejected(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  if(!js_has_propertystr(ctx, data[0], "error"))
+    JS_SetPropertyStr(ctx, data[0], "error", argc > 0 ? JS_DupValue(ctx, argv[0]) : JS_UNDEFINED);
+
+  return JS_UNDEFINED;
+}
+
+/*
+ * Feeds an archive being written into a WritableStream's writer.  The
+ * write() promises are not awaited here: a rejection fails the next write,
+ * and archive.ready exposes the writer's backpressure.
+ */
+static la_ssize_t
+archive_write_stream(struct archive* ar, void* client_data, const void* buffer, size_t length) {
+  ArchiveVirtual* cb = client_data;
+  JSContext* ctx = cb->ctx;
+  JSValue buf, chunk, ret;
+
+  if(js_has_propertystr(ctx, cb->status, "error")) {
+    JSValue error = JS_GetPropertyStr(ctx, cb->status, "error");
+    const char* msg = JS_ToCString(ctx, error);
+
+    archive_set_error(ar, EIO, "WritableStream write() rejected: %s", msg ? msg : "unknown error");
+
+    if(msg)
+      JS_FreeCString(ctx, msg);
+    else
+      JS_FreeValue(ctx, JS_GetException(ctx));
+
+    JS_FreeValue(ctx, error);
+    return -1;
+  }
+
+  buf = JS_NewArrayBufferCopy(ctx, buffer, length);
+  chunk = js_typedarray_new(ctx, 8, FALSE, FALSE, buf);
+  ret = JS_Call(ctx, cb->write, cb->this_obj, 1, &chunk);
+
+  JS_FreeValue(ctx, chunk);
+  JS_FreeValue(ctx, buf);
+
+  if(JS_IsException(ret)) {
+    archive_set_error(ar, EIO, "WritableStream write() failed");
+    return -1;
+  }
+
+  if(js_is_promise(ctx, ret)) {
+    JSValue fn = JS_NewCFunctionData(ctx, archive_write_rejected, 1, 0, 1, &cb->status);
+    JSValue tmp = js_invoke(ctx, ret, "catch", 1, &fn);
+
+    JS_FreeValue(ctx, tmp);
+    JS_FreeValue(ctx, fn);
+  }
+
+  JS_FreeValue(ctx, ret);
+  return length;
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * Pumps a ReadableStream (or any async iterator) into one end of a socket
+ * pair, the other end being read by the archive on the background thread
+ * started with archive.iterate().  The pump only issues the next read()
+ * when the previous chunk has been written completely, so the amount of
+ * data in flight is bounded by the socket buffer.
+ */
+typedef struct {
+  int ref_count;
+  int fd;
+  BOOL waiting;
+  JSValue reader, read;
+  uint8_t* buf;
+  size_t len, pos;
+} ArchivePump;
+
+static void archivepump_next(JSContext*, ArchivePump*);
+
+static ArchivePump*
+archivepump_dup(ArchivePump* pump) {
+  ++pump->ref_count;
+  return pump;
+}
+
+static void
+archivepump_close(ArchivePump* pump) {
+  if(pump->fd >= 0) {
+    close(pump->fd);
+    pump->fd = -1;
+  }
+}
+
+static void
+archivepump_free(JSRuntime* rt, void* ptr) {
+  ArchivePump* pump = ptr;
+
+  if(--pump->ref_count == 0) {
+    archivepump_close(pump);
+    JS_FreeValueRT(rt, pump->reader);
+    JS_FreeValueRT(rt, pump->read);
+
+    if(pump->buf)
+      js_free_rt(rt, pump->buf);
+
+    js_free_rt(rt, pump);
+  }
+}
+
+static void
+archivepump_handler(JSContext* ctx, ArchivePump* pump, JSValueConst func) {
+  JSValue set_handler, args[2], ret;
+
+  if(JS_IsException((set_handler = js_iohandler_fn(ctx, TRUE, 0))))
+    return;
+
+  args[0] = JS_NewInt32(ctx, pump->fd);
+  args[1] = func;
+
+  ret = JS_Call(ctx, set_handler, JS_UNDEFINED, countof(args), args);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, set_handler);
+}
+
+static JSValue archivepump_writable(JSContext*, JSValueConst, int, JSValueConst[], int, void*);
+
+static void
+archivepump_flush(JSContext* ctx, ArchivePump* pump) {
+  while(pump->pos < pump->len) {
+    ssize_t r = send(pump->fd, pump->buf + pump->pos, pump->len - pump->pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    if(r > 0) {
+      pump->pos += r;
+      continue;
+    }
+
+    if(r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      if(!pump->waiting) {
+        JSValue fn = js_function_cclosure(ctx, archivepump_writable, 0, 0, archivepump_dup(pump), archivepump_free);
+
+        archivepump_handler(ctx, pump, fn);
+        JS_FreeValue(ctx, fn);
+        pump->waiting = TRUE;
+      }
+
+      return;
+    }
+
+    /* reader went away */
+    archivepump_close(pump);
+    break;
+  }
+
+  js_free(ctx, pump->buf);
+  pump->buf = 0;
+  pump->len = pump->pos = 0;
+
+  if(pump->waiting) {
+    archivepump_handler(ctx, pump, JS_NULL);
+    pump->waiting = FALSE;
+  }
+
+  if(pump->fd >= 0)
+    archivepump_next(ctx, pump);
+}
+
+static JSValue
+archivepump_writable(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  archivepump_flush(ctx, opaque);
+  return JS_UNDEFINED;
+}
+
+static JSValue
+archivepump_chunk(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  ArchivePump* pump = opaque;
+  InputBuffer input;
+  JSValue value;
+
+  /* rejected or done */
+  if(magic || js_get_propertystr_bool(ctx, argv[0], "done")) {
+    archivepump_close(pump);
+    return JS_UNDEFINED;
+  }
+
+  value = JS_GetPropertyStr(ctx, argv[0], "value");
+  input = js_input_chars(ctx, value);
+  JS_FreeValue(ctx, value);
+
+  pump->len = input_buffer_length(&input);
+  pump->pos = 0;
+
+  if((pump->buf = js_malloc(ctx, MAX_NUM(pump->len, 1))))
+    memcpy(pump->buf, input_buffer_data(&input), pump->len);
+  else
+    pump->len = 0;
+
+  input_buffer_free(&input, ctx);
+
+  archivepump_flush(ctx, pump);
+  return JS_UNDEFINED;
+}
+
+static void
+archivepump_next(JSContext* ctx, ArchivePump* pump) {
+  JSValue result, promise, args[2], ret;
+
+  result = JS_Call(ctx, pump->read, pump->reader, 0, 0);
+
+  if(JS_IsException(result)) {
+    archivepump_close(pump);
+    return;
+  }
+
+  promise = js_promise_adopt(ctx, result);
+  JS_FreeValue(ctx, result);
+
+  args[0] = js_function_cclosure(ctx, archivepump_chunk, 1, 0, archivepump_dup(pump), archivepump_free);
+  args[1] = js_function_cclosure(ctx, archivepump_chunk, 1, 1, archivepump_dup(pump), archivepump_free);
+
+  ret = js_invoke(ctx, promise, "then", countof(args), args);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, args[0]);
+  JS_FreeValue(ctx, args[1]);
+  JS_FreeValue(ctx, promise);
+}
+
+/* Starts pumping the stream and returns the fd the archive should read from */
+static int
+archivepump_start(JSContext* ctx, JSValueConst stream) {
+  ArchivePump* pump;
+  JSValue reader;
+  int sv[2];
+
+  if(js_has_propertystr(ctx, stream, "getReader"))
+    reader = js_invoke(ctx, stream, "getReader", 0, 0);
+  else
+    reader = js_iterator_new(ctx, stream);
+
+  if(JS_IsException(reader))
+    return -1;
+
+  if(!JS_IsObject(reader)) {
+    JS_ThrowTypeError(ctx, "argument must be a ReadableStream or an async iterable");
+    return -1;
+  }
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == -1) {
+    JS_FreeValue(ctx, reader);
+    JS_ThrowInternalError(ctx, "socketpair() failed: %s", strerror(errno));
+    return -1;
+  }
+
+  if(!(pump = js_mallocz(ctx, sizeof(ArchivePump)))) {
+    JS_FreeValue(ctx, reader);
+    close(sv[0]);
+    close(sv[1]);
+    return -1;
+  }
+
+  pump->ref_count = 1;
+  pump->fd = sv[1];
+  pump->reader = reader;
+  pump->read = JS_GetPropertyStr(ctx, reader, js_has_propertystr(ctx, reader, "read") ? "read" : "next");
+
+  archivepump_next(ctx, pump);
+  archivepump_free(JS_GetRuntime(ctx), pump);
+
+  return sv[0];
+}
+#endif
+
+static inline ArchiveObject*
+js_archive_object(JSValueConst value) {
+  return JS_GetOpaque(value, js_archive_class_id);
+}
+
 static inline struct archive*
 js_archive_data(JSValueConst value) {
-  return JS_GetOpaque(value, js_archive_class_id);
+  ArchiveObject* ao = js_archive_object(value);
+
+  return ao ? ao->ar : 0;
 }
 
 static inline struct archive*
 js_archive_data2(JSContext* ctx, JSValueConst value) {
-  return JS_GetOpaque2(ctx, value, js_archive_class_id);
+  ArchiveObject* ao = JS_GetOpaque2(ctx, value, js_archive_class_id);
+
+  return ao ? ao->ar : 0;
 }
 
 static inline struct archive_entry*
@@ -117,9 +466,99 @@ js_archive_mode(JSContext* ctx, JSValueConst this_val) {
   return js_get_propertystr_int32(ctx, this_val, "mode");
 }
 
+/* stream input not yet opened by iterate() */
+static inline BOOL
+js_archive_pending(JSContext* ctx, JSValueConst this_val) {
+  ArchiveObject* ao = js_archive_object(this_val);
+
+  return ao && ao->pending_fd >= 0;
+}
+
+#define ARCHIVE_SNAPSHOT_FILTERS 8
+
+/*
+ * State of a struct archive as seen by the getters, taken by the thread
+ * that owns it.  Format and filter names are static strings in libarchive,
+ * the error string is copied.
+ */
+typedef struct {
+  uint32_t file_count;
+  int64_t position;
+  int err;
+  char* error;
+  const char* format;
+  int num_filters;
+  const char* filters[ARCHIVE_SNAPSHOT_FILTERS];
+} ArchiveSnapshot;
+
+static const char* const archive_snapshot_props[] = {
+    "fileCount",
+    "position",
+    "errno",
+    "error",
+    "format",
+    "compression",
+    "filters",
+};
+
+static void
+archive_snapshot(struct archive* ar, ArchiveSnapshot* snap) {
+  const char* err = archive_error_string(ar);
+
+  snap->file_count = archive_file_count(ar);
+  snap->position = archive_filter_bytes(ar, -1);
+  snap->err = archive_errno(ar);
+  snap->error = err ? strdup(err) : 0;
+  snap->format = archive_format_name(ar);
+  snap->num_filters = MIN_NUM(archive_filter_count(ar), ARCHIVE_SNAPSHOT_FILTERS);
+
+  for(int i = 0; i < snap->num_filters; i++)
+    snap->filters[i] = archive_filter_name(ar, i);
+}
+
+static void
+archive_snapshot_free(ArchiveSnapshot* snap) {
+  free(snap->error);
+  snap->error = 0;
+}
+
+static JSValue
+js_archive_cstring(JSContext* ctx, const char* s) {
+  return s ? JS_NewString(ctx, s) : JS_NULL;
+}
+
 static void
 js_archive_set_mode(JSContext* ctx, JSValueConst this_val, int mode) {
   JS_DefinePropertyValueStr(ctx, this_val, "mode", JS_NewInt32(ctx, mode), JS_PROP_CONFIGURABLE);
+
+  /* drop the snapshot shadowing the getters while in ASYNC mode */
+  if(mode != ASYNC)
+    for(size_t i = 0; i < countof(archive_snapshot_props); i++)
+      js_delete_propertystr(ctx, this_val, archive_snapshot_props[i]);
+}
+
+/*
+ * While a background thread reads the archive, the getters reading its state
+ * are shadowed by own properties holding it as of the last consumed block.
+ */
+static void
+js_archive_set_snapshot(JSContext* ctx, JSValueConst this_val, const ArchiveSnapshot* snap) {
+  JSValue filters = JS_NewArray(ctx);
+
+  for(int i = 0; i < snap->num_filters; i++)
+    JS_SetPropertyUint32(ctx, filters, i, js_archive_cstring(ctx, snap->filters[i]));
+
+  JS_DefinePropertyValueStr(ctx, this_val, "fileCount", JS_NewUint32(ctx, snap->file_count), JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValueStr(ctx, this_val, "position", JS_NewInt64(ctx, snap->position), JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValueStr(ctx, this_val, "errno", JS_NewInt32(ctx, snap->err), JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValueStr(ctx, this_val, "error", js_archive_cstring(ctx, snap->error), JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValueStr(ctx, this_val, "format", js_archive_cstring(ctx, snap->format), JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValueStr(ctx,
+                            this_val,
+                            "compression",
+                            js_archive_cstring(ctx, snap->num_filters > 0 ? snap->filters[0] : 0),
+                            JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValueStr(ctx, this_val, "filters", filters, JS_PROP_CONFIGURABLE);
 }
 
 static inline JSValue
@@ -166,12 +605,24 @@ js_archive_wrap(JSContext* ctx, JSValueConst proto, struct archive* ar) {
   if(JS_IsNull(proto) || JS_IsUndefined(proto))
     proto = JS_DupValue(ctx, archive_proto);
 
+  ArchiveObject* ao;
+
+  if(!(ao = js_mallocz(ctx, sizeof(ArchiveObject))))
+    return JS_EXCEPTION;
+
   /* using new_target to get the prototype is necessary when the class is extended. */
   JSValue obj = JS_NewObjectProtoClass(ctx, proto, js_archive_class_id);
-  if(JS_IsException(obj))
+  if(JS_IsException(obj)) {
+    js_free(ctx, ao);
     goto fail;
+  }
 
-  JS_SetOpaque(obj, ar);
+  ao->ar = ar;
+  ao->pending_fd = -1;
+  ao->stream = JS_UNDEFINED;
+  ao->writer = JS_UNDEFINED;
+
+  JS_SetOpaque(obj, ao);
   return obj;
 
 fail:
@@ -189,7 +640,7 @@ enum {
 static JSValue
 js_archive_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
   struct archive* ar = 0;
-  JSValue ret = JS_UNDEFINED, proto = JS_GetPropertyStr(ctx, this_val, "prototype");
+  JSValue ret = JS_UNDEFINED, proto = JS_GetPropertyStr(ctx, this_val, "prototype"), writer = JS_UNDEFINED;
 
   switch(magic) {
     case METHOD_READ: {
@@ -206,10 +657,47 @@ js_archive_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
       if(argc > 1 && JS_IsNumber(argv[1]))
         JS_ToUint32(ctx, &block_size, argv[1]);
 
-      wchar_t* filename = js_towstring(ctx, argv[0]);
-      int r = archive_read_open_filename_w(ar, filename, block_size);
+      int r;
+
+      if(JS_IsNumber(argv[0])) {
+        int32_t fd = -1;
+
+        JS_ToInt32(ctx, &fd, argv[0]);
+        r = archive_read_open_fd(ar, fd, block_size);
+#ifdef HAVE_PTHREAD_H
+      } else if(JS_IsObject(argv[0]) && !js_is_arraybuffer(ctx, argv[0])) {
+        /*
+         * stream input: opened on the background thread by iterate(), as
+         * opening reads from the socket only this thread feeds
+         */
+        ArchiveObject* ao;
+        int fd;
+
+        if((fd = archivepump_start(ctx, argv[0])) == -1) {
+          archive_read_free(ar);
+          return JS_EXCEPTION;
+        }
+
+        if(JS_IsException((ret = js_archive_wrap(ctx, proto, ar)))) {
+          close(fd);
+          archive_read_free(ar);
+          return ret;
+        }
+
+        ao = js_archive_object(ret);
+        ao->pending_fd = fd;
+        ao->block_size = block_size;
+        ao->stream = JS_DupValue(ctx, argv[0]);
+
+        js_archive_set_mode(ctx, ret, READ);
+        return ret;
+#endif
+      } else {
+        wchar_t* filename = js_towstring(ctx, argv[0]);
 
-      js_free(ctx, filename);
+        r = archive_read_open_filename_w(ar, filename, block_size);
+        js_free(ctx, filename);
+      }
 
       if(r != ARCHIVE_OK) {
         ret = JS_ThrowInternalError(ctx, "libarchive error: %s", archive_error_string(ar));
@@ -239,6 +727,45 @@ js_archive_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
         r = archive_write_open_filename_w(ar, filename);
 
         js_free(ctx, filename);
+      } else if(JS_IsNumber(argv[0])) {
+        int32_t fd = -1;
+
+        JS_ToInt32(ctx, &fd, argv[0]);
+
+        if(argc > 1 && (f = JS_ToCString(ctx, argv[1]))) {
+          archive_write_set_format_filter_by_ext(ar, f);
+          JS_FreeCString(ctx, f);
+        }
+
+        r = archive_write_open_fd(ar, fd);
+      } else if(JS_IsObject(argv[0]) && js_has_propertystr(ctx, argv[0], "getWriter")) {
+        ArchiveVirtual* cb;
+
+        if(argc > 1 && (f = JS_ToCString(ctx, argv[1]))) {
+          archive_write_set_format_filter_by_ext(ar, f);
+          JS_FreeCString(ctx, f);
+        }
+
+        if(JS_IsException((writer = js_invoke(ctx, argv[0], "getWriter", 0, 0)))) {
+          archive_write_free(ar);
+          return JS_EXCEPTION;
+        }
+
+        if(!(cb = js_malloc(ctx, sizeof(ArchiveVirtual)))) {
+          JS_FreeValue(ctx, writer);
+          archive_write_free(ar);
+          return JS_ThrowOutOfMemory(ctx);
+        }
+
+        cb->fd = -1;
+        cb->ctx = ctx;
+        cb->this_obj = writer;
+        cb->open = JS_UNDEFINED;
+        cb->write = JS_GetPropertyStr(ctx, writer, "write");
+        cb->close = JS_GetPropertyStr(ctx, writer, "close");
+        cb->status = JS_NewObject(ctx);
+
+        r = archive_write_open2(ar, cb, NULL, &archive_write_stream, &archive_close, &archive_destroy);
       } else if(JS_IsObject(argv[0])) {
         ArchiveVirtual* cb;
 
@@ -261,6 +788,7 @@ js_archive_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
         cb->open = JS_GetPropertyStr(ctx, argv[0], "open");
         cb->write = JS_GetPropertyStr(ctx, argv[0], "write");
         cb->close = JS_GetPropertyStr(ctx, argv[0], "close");
+        cb->status = JS_UNDEFINED;
 
         archive_open_callback* open = JS_IsFunction(ctx, cb->open) ? &archive_open : NULL;
         archive_write_callback* write = JS_IsFunction(ctx, cb->write) ? &archive_write : NULL;
@@ -282,6 +810,10 @@ js_archive_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
 
   ret = js_archive_wrap(ctx, proto, ar);
   JS_DefinePropertyValueStr(ctx, ret, "file", JS_DupValue(ctx, argv[0]), JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE);
+
+  /* owned by the write callbacks, kept for archive.ready */
+  if(JS_IsObject(writer) && !JS_IsException(ret))
+    js_archive_object(ret)->writer = JS_DupValue(ctx, writer);
   js_archive_set_mode(ctx, ret, magic == METHOD_READ ? READ : WRITE);
 
   return ret;
@@ -298,6 +830,7 @@ enum {
   PROP_READ_HEADER_POSITION,
   PROP_HAS_ENCRYPTED_ENTRIES,
   PROP_BLOCKSIZE,
+  PROP_READY,
 };
 
 static JSValue
@@ -308,6 +841,10 @@ js_archive_get(JSContext* ctx, JSValueConst this_val, int magic) {
   if(!(ar = js_archive_data2(ctx, this_val)))
     return JS_EXCEPTION;
 
+  /* the reader thread owns the archive, its snapshot shadows these getters */
+  if(magic <= PROP_POSITION && js_archive_mode(ctx, this_val) == ASYNC)
+    return JS_ThrowInternalError(ctx, "archive is being read asynchronously");
+
   switch(magic) {
     case PROP_ERRNO: {
       ret = JS_NewInt32(ctx, archive_errno(ar));
@@ -380,6 +917,19 @@ js_archive_get(JSContext* ctx, JSValueConst this_val, int magic) {
 
       break;
     }
+
+    case PROP_READY: {
+      ArchiveObject* ao = js_archive_object(this_val);
+
+      /* the WritableStream writer's backpressure, resolved for any other output */
+      if(JS_IsObject(ao->writer)) {
+        ret = JS_GetPropertyStr(ctx, ao->writer, "ready");
+      } else {
+        ret = js_promise_resolve(ctx, JS_UNDEFINED);
+      }
+
+      break;
+    }
   }
 
   return ret;
@@ -442,10 +992,14 @@ fail:
 
 static JSValue
 js_archive_open(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ArchiveObject* ao;
   struct archive* ar;
   int r;
 
-  if((ar = js_archive_data(this_val)))
+  if(!(ao = JS_GetOpaque2(ctx, this_val, js_archive_class_id)))
+    return JS_EXCEPTION;
+
+  if(ao->ar)
     return JS_ThrowInternalError(ctx, "Archive already open");
 
   ar = archive_read_new();
@@ -453,7 +1007,7 @@ js_archive_open(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst ar
   archive_read_support_filter_all(ar);
   archive_read_support_format_all(ar);
   archive_read_support_filter_all(ar);
-  JS_SetOpaque(this_val, ar);
+  ao->ar = ar;
 
   uint32_t block_size = 10240;
 
@@ -515,6 +1069,9 @@ js_archive_read(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst ar
   if(js_archive_mode(ctx, this_val) != READ)
     return JS_ThrowInternalError(ctx, "archive not in read mode");
 
+  if(js_archive_pending(ctx, this_val))
+    return JS_ThrowInternalError(ctx, "stream input can only be read with iterate()");
+
   if(!(ar = js_archive_data2(ctx, this_val)))
     return JS_EXCEPTION;
 
@@ -598,293 +1155,1562 @@ js_archive_write(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst a
     return archive_write_finish_entry(ar) == ARCHIVE_OK ? JS_TRUE : JS_FALSE;
   }
 
-  JSValue ret = JS_UNDEFINED;
-  BOOL in_entry = js_has_propertystr(ctx, this_val, "entry");
+  JSValue ret = JS_UNDEFINED;
+  BOOL in_entry = js_has_propertystr(ctx, this_val, "entry");
+
+  while(argc > 0) {
+    struct archive_entry* ent;
+
+    if((ent = js_archiveentry_data(argv[0]))) {
+
+      if(in_entry)
+        archive_write_finish_entry(ar);
+
+      ret = archive_write_header(ar, ent) == ARCHIVE_OK ? JS_TRUE : JS_FALSE;
+
+      JS_DefinePropertyValueStr(ctx, this_val, "entry", JS_DupValue(ctx, argv[0]), JS_PROP_CONFIGURABLE);
+      argv++;
+      argc--;
+      continue;
+    }
+
+    int n = 1;
+    InputBuffer input = js_input_chars(ctx, argv[0]);
+
+    if(argc > 1)
+      n += js_offset_length(ctx, input.size, argc, argv, 1, &input.range);
+
+    const uint8_t* buf = input_buffer_data(&input);
+    size_t len = input_buffer_length(&input);
+    size_t block_size = archive_write_get_bytes_per_block(ar);
+    int64_t r, bytes = 0;
+
+    while(len > 0) {
+      size_t nb = MIN_NUM(block_size, len);
+
+      r = archive_write_data(ar, buf, len);
+
+      if(r > 0) {
+        len -= r;
+        buf += r;
+        bytes += r;
+        continue;
+      }
+
+      break;
+    }
+
+    ret = JS_NewInt64(ctx, bytes);
+
+    input_buffer_free(&input, ctx);
+
+    argv += n;
+    argc -= n;
+  }
+
+  return ret;
+}
+
+static JSValue
+js_archive_skip(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  struct archive* ar;
+
+  if(!(ar = js_archive_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(js_archive_mode(ctx, this_val) == READ)
+    return js_archive_return(ctx, this_val, archive_read_data_skip(ar));
+
+  return JS_UNDEFINED;
+}
+
+static JSValue
+js_archive_seek(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  struct archive* ar;
+  int64_t r, offset = 0;
+  int32_t whence = SEEK_SET;
+
+  if(!(ar = js_archive_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  JS_ToInt64(ctx, &offset, argv[0]);
+  JS_ToInt32(ctx, &whence, argv[1]);
+
+  r = archive_seek_data(ar, offset, whence);
+
+  return js_archive_return(ctx, this_val, r);
+}
+
+static JSValue
+js_archive_extract(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  JSValue ret = JS_UNDEFINED;
+  struct archive* ar;
+  struct archive_entry* ent;
+  int32_t flags;
+  ArchiveEntryRef* aeref = 0;
+
+  if(js_archive_mode(ctx, this_val) != READ)
+    return JS_ThrowInternalError(ctx, "archive not in read mode");
+
+  if(js_archive_pending(ctx, this_val))
+    return JS_ThrowInternalError(ctx, "stream input can only be read with iterate()");
+
+  if(!(ar = js_archive_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(!(ent = js_archiveentry_data2(ctx, argv[0])))
+    return JS_EXCEPTION;
+
+  if(argc >= 2)
+    JS_ToInt32(ctx, &flags, argv[1]);
+
+  if(argc >= 3) {
+    if(!(aeref = js_malloc(ctx, sizeof(ArchiveEntryRef))))
+      return JS_EXCEPTION;
+
+    aeref->ctx = ctx;
+    aeref->callback = argv[2];
+    aeref->args[0] = this_val;
+    aeref->args[1] = argv[0];
+
+    archive_read_extract_set_progress_callback(ar, js_archive_progress_callback, aeref);
+  }
+
+  ret = js_archive_return(ctx, this_val, archive_read_extract(ar, ent, flags));
+
+  if(aeref) {
+    archive_read_extract_set_progress_callback(ar, 0, 0);
+    js_free(ctx, aeref);
+  }
+
+  return ret;
+}
+
+static JSValue
+js_archive_filterbytes(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  JSValue ret = JS_UNDEFINED;
+  struct archive* ar;
+  int32_t index = -1;
+
+  if(!(ar = js_archive_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(argc >= 1)
+    JS_ToInt32(ctx, &index, argv[0]);
+
+  ret = JS_NewInt64(ctx, archive_filter_bytes(ar, index));
+
+  return ret;
+}
+
+static JSValue
+js_archive_close(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  JSValue ret = JS_UNDEFINED;
+  struct archive* ar;
+
+  if((ar = js_archive_data(this_val))) {
+    if(js_archive_mode(ctx, this_val) == ASYNC)
+      return JS_ThrowInternalError(ctx, "archive is being read asynchronously");
+
+    if(js_archive_mode(ctx, this_val) == WRITE)
+      if(js_has_propertystr(ctx, this_val, "entry"))
+        archive_write_finish_entry(ar);
+
+    int r = js_archive_mode(ctx, this_val) == WRITE ? archive_write_close(ar) : archive_read_close(ar);
+
+    ret = r == ARCHIVE_OK ? JS_TRUE : JS_FALSE;
+
+    js_delete_propertystr(ctx, this_val, "eof");
+    js_delete_propertystr(ctx, this_val, "mode");
+    js_delete_propertystr(ctx, this_val, "entry");
+  }
+
+  return ret;
+}
+
+static JSValue
+js_archive_version(JSContext* ctx, JSValueConst this_val) {
+  return JS_NewString(ctx, archive_version_details());
+}
+
+static JSValue
+js_archive_next(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  struct archive* ar;
+  struct archive_entry* ent = NULL;
+  int result = ARCHIVE_EOF;
+
+  if(js_archive_mode(ctx, this_val) != READ)
+    return JS_ThrowInternalError(ctx, "archive not in read mode");
+
+  if(js_archive_pending(ctx, this_val))
+    return JS_ThrowInternalError(ctx, "stream input can only be read with iterate()");
+
+  if(!(ar = js_archive_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  js_delete_propertystr(ctx, this_val, "entry");
+
+  BOOL eof = js_get_propertystr_bool(ctx, this_val, "eof");
+
+  if(!eof) {
+    if(!(ent = archive_entry_new2(ar)))
+      return JS_ThrowOutOfMemory(ctx);
+
+    result = archive_read_next_header2(ar, ent);
+  } else {
+    result = ARCHIVE_EOF;
+  }
+
+  JSValue ret;
+
+  switch(result) {
+    case ARCHIVE_EOF:
+    case ARCHIVE_FATAL: {
+      ret = eof ? JS_NULL : js_archive_return(ctx, this_val, result);
+      break;
+    }
+
+    default: {
+      ret = js_archiveentry_wrap(ctx, entry_proto, ent);
+      JS_DefinePropertyValueStr(ctx, this_val, "entry", JS_DupValue(ctx, ret), JS_PROP_CONFIGURABLE);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static JSValue
+js_archive_iterator(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  if(js_archive_mode(ctx, this_val) != READ)
+    return JS_ThrowInternalError(ctx, "archive not in read mode");
+
+  if(js_archive_pending(ctx, this_val))
+    return JS_ThrowInternalError(ctx, "stream input can only be read with iterate()");
+
+  JSValue ret = JS_NewObjectProtoClass(ctx, iterator_proto, js_archive_iterator_class_id);
+  struct archive* ar;
+
+  if((ar = js_archive_data(this_val))) {
+    JS_SetOpaque(ret, ar);
+    JS_DefinePropertyValueStr(ctx, ret, "archive", JS_DupValue(ctx, this_val), JS_PROP_CONFIGURABLE);
+  }
+
+  return ret;
+}
+
+static JSValue
+js_archive_iterator_next(JSContext* ctx, JSValueConst iter, int argc, JSValueConst argv[], BOOL* pdone, int magic) {
+  struct archive* ar;
+  struct archive_entry* ent = NULL;
+  int result = ARCHIVE_EOF;
+
+  if(!(ar = JS_GetOpaque2(ctx, iter, js_archive_iterator_class_id)))
+    return JS_EXCEPTION;
+
+  JSValue this_val = JS_GetPropertyStr(ctx, iter, "archive");
+
+  BOOL eof = js_get_propertystr_bool(ctx, this_val, "eof");
+
+  if(!eof) {
+    if(!(ent = archive_entry_new2(ar)))
+      return JS_ThrowOutOfMemory(ctx);
+
+    result = archive_read_next_header2(ar, ent);
+  }
+
+  switch(result) {
+    case ARCHIVE_EOF: {
+      JS_DefinePropertyValueStr(ctx, this_val, "eof", JS_TRUE, JS_PROP_CONFIGURABLE);
+      *pdone = TRUE;
+      return JS_UNDEFINED;
+    }
+
+    case ARCHIVE_FATAL: {
+      *pdone = TRUE;
+      return JS_ThrowInternalError(ctx, "libarchive error: %s", archive_error_string(ar));
+    }
+  }
+
+  if(result == ARCHIVE_WARN) {
+    fprintf(stderr, "WARNING: %s\n", archive_error_string(ar));
+    archive_clear_error(ar);
+  }
+
+  *pdone = FALSE;
+
+  return js_archiveentry_wrap(ctx, entry_proto, ent);
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * Asynchronous reading: a background thread runs archive_read_next_header2()
+ * and archive_read_data_block() (or archive_read_extract()) and hands the
+ * results to the JS thread through a bounded ring.  The JS side is woken up
+ * through a pipe registered with os.setReadHandler().
+ */
+typedef struct {
+  struct archive_entry* entry;
+  void* data;
+  size_t size;
+  int64_t offset;
+  int result;
+  char* error;
+  ArchiveSnapshot status;
+} ArchiveBlock;
+
+typedef struct {
+  struct archive* ar;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  ArchiveBlock* ring;
+  uint32_t capacity, head, count;
+  BOOL running, done, cancel;
+  int extract_flags;
+  int open_fd, block_size;
+  int fds[2];
+  JSValue archive, entry, pending[2];
+} ArchiveReader;
+
+static ArchiveReader*
+js_archivereader_data(JSValueConst value) {
+  return JS_GetOpaque(value, js_archive_asynciterator_class_id);
+}
+
+static void
+archiveblock_free(ArchiveBlock* blk) {
+  if(blk->entry)
+    archive_entry_free(blk->entry);
+
+  free(blk->data);
+  free(blk->error);
+  archive_snapshot_free(&blk->status);
+  memset(blk, 0, sizeof(ArchiveBlock));
+}
+
+/* Called on the reader thread, blocks while the ring is full. */
+static BOOL
+archivereader_push(ArchiveReader* rd, ArchiveBlock* blk) {
+  /* only this thread touches the archive while it runs */
+  archive_snapshot(rd->ar, &blk->status);
+
+  pthread_mutex_lock(&rd->lock);
+
+  while(rd->count == rd->capacity && !rd->cancel)
+    pthread_cond_wait(&rd->cond, &rd->lock);
+
+  if(rd->cancel) {
+    pthread_mutex_unlock(&rd->lock);
+    archiveblock_free(blk);
+    return FALSE;
+  }
+
+  rd->ring[(rd->head + rd->count) % rd->capacity] = *blk;
+  rd->count++;
+  pthread_mutex_unlock(&rd->lock);
+
+  /* wake up the JS thread */
+  while(write(rd->fds[1], "", 1) == -1 && errno == EINTR) {}
+
+  return TRUE;
+}
+
+static BOOL
+archivereader_pop(ArchiveReader* rd, ArchiveBlock* blk) {
+  BOOL ret = FALSE;
+
+  pthread_mutex_lock(&rd->lock);
+
+  if(rd->count > 0) {
+    *blk = rd->ring[rd->head];
+    rd->head = (rd->head + 1) % rd->capacity;
+    rd->count--;
+    ret = TRUE;
+    pthread_cond_signal(&rd->cond);
+  }
+
+  pthread_mutex_unlock(&rd->lock);
+  return ret;
+}
+
+static BOOL
+archivereader_error(ArchiveReader* rd, int result) {
+  const char* msg = archive_error_string(rd->ar);
+  ArchiveBlock blk = {.result = result, .error = strdup(msg ? msg : "unknown error")};
+
+  return archivereader_push(rd, &blk);
+}
+
+static void*
+archivereader_thread(void* arg) {
+  ArchiveReader* rd = arg;
+  int r;
+
+  /* stream input is opened here, as opening already reads from it */
+  if(rd->open_fd >= 0) {
+    if((r = archivefd_open(rd->ar, rd->open_fd, rd->block_size)) != ARCHIVE_OK) {
+      /* the close callback already closed it */
+      pthread_mutex_lock(&rd->lock);
+      rd->open_fd = -1;
+      pthread_mutex_unlock(&rd->lock);
+
+      archivereader_error(rd, r);
+      goto end;
+    }
+  }
+
+  for(;;) {
+    ArchiveBlock blk = {0};
+
+    if(!(blk.entry = archive_entry_new2(rd->ar))) {
+      ArchiveBlock err = {.result = ARCHIVE_FATAL, .error = strdup("out of memory")};
+      archivereader_push(rd, &err);
+      break;
+    }
+
+    if((r = archive_read_next_header2(rd->ar, blk.entry)) == ARCHIVE_EOF) {
+      archive_entry_free(blk.entry);
+      blk.entry = 0;
+      blk.result = ARCHIVE_EOF;
+      archivereader_push(rd, &blk);
+      break;
+    }
+
+    if(r < ARCHIVE_WARN) {
+      archive_entry_free(blk.entry);
+      archivereader_error(rd, r);
+      break;
+    }
+
+    if(rd->extract_flags >= 0) {
+      /* extract first, then report the entry */
+      if((r = archive_read_extract(rd->ar, blk.entry, rd->extract_flags)) < ARCHIVE_WARN) {
+        archive_entry_free(blk.entry);
+        archivereader_error(rd, r);
+        break;
+      }
+
+      if(!archivereader_push(rd, &blk))
+        break;
+
+      continue;
+    }
+
+    if(!archivereader_push(rd, &blk))
+      break;
+
+    for(;;) {
+      const void* data;
+      size_t size;
+      __LA_INT64_T offset;
+
+      if((r = archive_read_data_block(rd->ar, &data, &size, &offset)) == ARCHIVE_EOF)
+        break;
+
+      if(r < ARCHIVE_WARN) {
+        archivereader_error(rd, r);
+        goto end;
+      }
+
+      blk = (ArchiveBlock){.size = size, .offset = offset};
+
+      if(size > 0) {
+        if(!(blk.data = malloc(size))) {
+          ArchiveBlock err = {.result = ARCHIVE_FATAL, .error = strdup("out of memory")};
+          archivereader_push(rd, &err);
+          goto end;
+        }
+
+        memcpy(blk.data, data, size);
+      }
+
+      if(!archivereader_push(rd, &blk))
+        goto end;
+    }
+  }
+
+end:
+  pthread_mutex_lock(&rd->lock);
+  rd->done = TRUE;
+  pthread_mutex_unlock(&rd->lock);
+
+  while(write(rd->fds[1], "", 1) == -1 && errno == EINTR) {}
+
+  return 0;
+}
+
+static void
+archivereader_stop(ArchiveReader* rd) {
+  ArchiveBlock blk;
+
+  if(rd->running) {
+    pthread_mutex_lock(&rd->lock);
+    rd->cancel = TRUE;
+    pthread_cond_broadcast(&rd->cond);
+
+    /*
+     * stream input: the thread may be blocked reading the socket that only
+     * this (JS) thread feeds.  Shutting down both directions gives it EOF
+     * and makes the pump's next send() fail, so the join cannot deadlock.
+     */
+    if(rd->open_fd >= 0 && !rd->done)
+      shutdown(rd->open_fd, SHUT_RDWR);
+
+    pthread_mutex_unlock(&rd->lock);
+
+    pthread_join(rd->thread, 0);
+    rd->running = FALSE;
+  }
+
+  while(archivereader_pop(rd, &blk))
+    archiveblock_free(&blk);
+}
+
+static void
+js_archive_free_block(JSRuntime* rt, void* opaque, void* ptr) {
+  free(ptr);
+}
+
+/* Converts a block from the ring into an iterator result; consumes the block. */
+static JSValue
+js_archivereader_result(JSContext* ctx, ArchiveReader* rd, ArchiveBlock* blk, BOOL* reject) {
+  JSValue value, ret;
+
+  *reject = FALSE;
+
+  js_archive_set_snapshot(ctx, rd->archive, &blk->status);
+
+  if(blk->error) {
+    *reject = TRUE;
+    ret = JS_NewError(ctx);
+    JS_SetPropertyStr(ctx, ret, "message", JS_NewString(ctx, blk->error));
+    JS_SetPropertyStr(ctx, ret, "errno", JS_NewInt32(ctx, blk->result));
+    archiveblock_free(blk);
+    archivereader_stop(rd);
+    js_archive_set_mode(ctx, rd->archive, READ);
+    return ret;
+  }
+
+  if(blk->result == ARCHIVE_EOF) {
+    archivereader_stop(rd);
+    js_archive_set_mode(ctx, rd->archive, READ);
+    JS_DefinePropertyValueStr(ctx, rd->archive, "eof", JS_TRUE, JS_PROP_CONFIGURABLE);
+    return js_iterator_result(ctx, JS_UNDEFINED, TRUE);
+  }
+
+  if(blk->entry) {
+    JS_FreeValue(ctx, rd->entry);
+    rd->entry = js_archiveentry_wrap(ctx, entry_proto, blk->entry);
+    blk->entry = 0;
+  }
+
+  value = JS_NewObject(ctx);
+  JS_SetPropertyStr(ctx, value, "entry", JS_DupValue(ctx, rd->entry));
+
+  if(blk->data || blk->size) {
+    JS_SetPropertyStr(
+        ctx, value, "data", JS_NewArrayBuffer(ctx, blk->data, blk->size, js_archive_free_block, 0, FALSE));
+    JS_SetPropertyStr(ctx, value, "offset", JS_NewInt64(ctx, blk->offset));
+    blk->data = 0;
+  } else {
+    JS_SetPropertyStr(ctx, value, "data", JS_NULL);
+  }
+
+  archiveblock_free(blk);
+
+  ret = js_iterator_result(ctx, value, FALSE);
+  JS_FreeValue(ctx, value);
+  return ret;
+}
+
+static void
+js_archivereader_settle(JSContext* ctx, ArchiveReader* rd, JSValueConst result, BOOL reject) {
+  JSValue ret = JS_Call(ctx, rd->pending[reject], JS_UNDEFINED, 1, &result);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, rd->pending[0]);
+  JS_FreeValue(ctx, rd->pending[1]);
+  rd->pending[0] = rd->pending[1] = JS_UNDEFINED;
+}
+
+static JSValue
+js_archivereader_ready(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  ArchiveReader* rd;
+  ArchiveBlock blk;
+  char buf[64];
+  BOOL reject;
+
+  if(!(rd = js_archivereader_data(data[0])))
+    return JS_UNDEFINED;
+
+  /* drain the wake-up bytes */
+  while(read(rd->fds[0], buf, sizeof(buf)) == sizeof(buf)) {}
+
+  if(!JS_IsFunction(ctx, rd->pending[0]))
+    return JS_UNDEFINED;
+
+  if(archivereader_pop(rd, &blk)) {
+    JSValue args[2] = {JS_NewInt32(ctx, rd->fds[0]), JS_NULL};
+    JSValue ret = JS_Call(ctx, data[1], JS_UNDEFINED, countof(args), args);
+    JSValue result = js_archivereader_result(ctx, rd, &blk, &reject);
+
+    JS_FreeValue(ctx, ret);
+    js_archivereader_settle(ctx, rd, result, reject);
+    JS_FreeValue(ctx, result);
+  }
+
+  return JS_UNDEFINED;
+}
+
+static JSValue
+js_archive_asynciterator_next(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ArchiveReader* rd;
+  ArchiveBlock blk;
+  JSValue promise, set_handler, args[2], ret;
+  BOOL reject;
+
+  if(!(rd = JS_GetOpaque2(ctx, this_val, js_archive_asynciterator_class_id)))
+    return JS_EXCEPTION;
+
+  if(JS_IsFunction(ctx, rd->pending[0]))
+    return JS_ThrowInternalError(ctx, "ArchiveAsyncIterator: next() already pending");
+
+  promise = JS_NewPromiseCapability(ctx, rd->pending);
+  if(JS_IsException(promise))
+    return promise;
+
+  if(archivereader_pop(rd, &blk)) {
+    JSValue result = js_archivereader_result(ctx, rd, &blk, &reject);
+
+    js_archivereader_settle(ctx, rd, result, reject);
+    JS_FreeValue(ctx, result);
+    return promise;
+  }
+
+  if(!rd->running) {
+    JSValue result = js_iterator_result(ctx, JS_UNDEFINED, TRUE);
+
+    js_archivereader_settle(ctx, rd, result, FALSE);
+    JS_FreeValue(ctx, result);
+    return promise;
+  }
+
+  if(JS_IsException((set_handler = js_iohandler_fn(ctx, FALSE, 0)))) {
+    JS_FreeValue(ctx, promise);
+    return JS_EXCEPTION;
+  }
+
+  JSValueConst data[] = {this_val, set_handler};
+
+  args[0] = JS_NewInt32(ctx, rd->fds[0]);
+  args[1] = JS_NewCFunctionData(ctx, js_archivereader_ready, 0, 0, countof(data), data);
+
+  ret = JS_Call(ctx, set_handler, JS_UNDEFINED, countof(args), args);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, args[1]);
+  JS_FreeValue(ctx, set_handler);
+
+  return promise;
+}
+
+static JSValue
+js_archive_asynciterator_return(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ArchiveReader* rd;
+  JSValue result, ret;
+
+  if(!(rd = JS_GetOpaque2(ctx, this_val, js_archive_asynciterator_class_id)))
+    return JS_EXCEPTION;
+
+  if(rd->running) {
+    archivereader_stop(rd);
+    js_archive_set_mode(ctx, rd->archive, READ);
+  }
+
+  result = js_iterator_result(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, TRUE);
+  ret = js_promise_resolve(ctx, result);
+  JS_FreeValue(ctx, result);
+
+  return ret;
+}
+
+static JSValue
+js_archive_asynciterator_self(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  return JS_DupValue(ctx, this_val);
+}
+
+/**
+ * archive.iterate({ highWaterMark, extract })
+ *
+ * Returns an async iterator yielding { entry, data, offset }, with data ===
+ * null for the header of each entry.  When `extract` is given, entries are
+ * extracted to disk with these flags on the background thread instead.
+ */
+static JSValue
+js_archive_iterate(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  struct archive* ar;
+  ArchiveReader* rd;
+  uint32_t capacity = 16;
+  int32_t extract_flags = -1;
+  ArchiveSnapshot status;
+  JSValue obj;
+
+  if(js_archive_mode(ctx, this_val) != READ)
+    return JS_ThrowInternalError(ctx, "archive not in read mode");
+
+  if(!(ar = js_archive_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(argc > 0 && JS_IsObject(argv[0])) {
+    if(js_has_propertystr(ctx, argv[0], "highWaterMark"))
+      capacity = MAX_NUM(js_get_propertystr_int32(ctx, argv[0], "highWaterMark"), 1);
+
+    if(js_has_propertystr(ctx, argv[0], "extract"))
+      extract_flags = js_get_propertystr_int32(ctx, argv[0], "extract");
+  }
+
+  if(!(rd = js_mallocz(ctx, sizeof(ArchiveReader))))
+    return JS_EXCEPTION;
+
+  if(!(rd->ring = js_mallocz(ctx, sizeof(ArchiveBlock) * capacity))) {
+    js_free(ctx, rd);
+    return JS_EXCEPTION;
+  }
+
+  if(pipe(rd->fds) == -1) {
+    js_free(ctx, rd->ring);
+    js_free(ctx, rd);
+    return JS_ThrowInternalError(ctx, "pipe() failed: %s", strerror(errno));
+  }
+
+  /* a full pipe already means a wake-up is pending, so never block on it */
+  fcntl(rd->fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(rd->fds[1], F_SETFL, O_NONBLOCK);
+
+  rd->ar = ar;
+  rd->capacity = capacity;
+  rd->extract_flags = extract_flags;
+  rd->open_fd = -1;
+
+  if(js_archive_pending(ctx, this_val)) {
+    ArchiveObject* ao = js_archive_object(this_val);
+
+    /* the reader thread takes over the fd */
+    rd->open_fd = ao->pending_fd;
+    rd->block_size = ao->block_size;
+    ao->pending_fd = -1;
+  }
+  rd->archive = JS_DupValue(ctx, this_val);
+  rd->entry = JS_NULL;
+  rd->pending[0] = rd->pending[1] = JS_UNDEFINED;
+
+  pthread_mutex_init(&rd->lock, 0);
+  pthread_cond_init(&rd->cond, 0);
+
+  obj = JS_NewObjectProtoClass(ctx, asynciterator_proto, js_archive_asynciterator_class_id);
+  JS_SetOpaque(obj, rd);
+
+  archive_snapshot(ar, &status);
+
+  if(pthread_create(&rd->thread, 0, archivereader_thread, rd)) {
+    if(rd->open_fd >= 0)
+      close(rd->open_fd);
+
+    archive_snapshot_free(&status);
+    JS_FreeValue(ctx, obj);
+    return JS_ThrowInternalError(ctx, "pthread_create() failed");
+  }
+
+  rd->running = TRUE;
+  js_archive_set_mode(ctx, this_val, ASYNC);
+  js_archive_set_snapshot(ctx, this_val, &status);
+  archive_snapshot_free(&status);
+
+  return obj;
+}
+
+static void
+js_archive_asynciterator_finalizer(JSRuntime* rt, JSValue val) {
+  ArchiveReader* rd;
+
+  if((rd = js_archivereader_data(val))) {
+    archivereader_stop(rd);
+
+    close(rd->fds[0]);
+    close(rd->fds[1]);
+    pthread_mutex_destroy(&rd->lock);
+    pthread_cond_destroy(&rd->cond);
+
+    JS_FreeValueRT(rt, rd->entry);
+    JS_FreeValueRT(rt, rd->pending[0]);
+    JS_FreeValueRT(rt, rd->pending[1]);
+    JS_FreeValueRT(rt, rd->archive);
+
+    js_free_rt(rt, rd->ring);
+    js_free_rt(rt, rd);
+  }
+}
+
+static JSClassDef js_archive_asynciterator_class = {
+    .class_name = "ArchiveAsyncIterator",
+    .finalizer = js_archive_asynciterator_finalizer,
+};
+
+static const JSCFunctionListEntry js_archive_asynciterator_funcs[] = {
+    JS_CFUNC_DEF("next", 0, js_archive_asynciterator_next),
+    JS_CFUNC_DEF("return", 0, js_archive_asynciterator_return),
+    JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, js_archive_asynciterator_self),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "ArchiveAsyncIterator", JS_PROP_CONFIGURABLE),
+};
+
+/**
+ * Parallel extraction: a single decoder thread reads (and decompresses) the
+ * archive once.  Entries up to ARCHIVE_JOB_MAX bytes are buffered and
+ * handed to writer threads through a bounded job queue, larger ones are
+ * streamed to disk by the decoder itself.  Completions are collected on the
+ * JS thread and reported through js_archive_progress_callback() in archive
+ * order.  Hard links are deferred until all threads are done, as their
+ * target may be extracted by another thread.
+ *
+ * Entries are written below the canonical destination; names that are
+ * absolute or contain '..' are rejected, and both the pathname and the
+ * hard link target go through archive_write_disk's own checks.
+ */
+#define ARCHIVE_JOB_MAX (1 << 20)
+#define ARCHIVE_JOB_BYTES (64 << 20)
+
+typedef struct {
+  int index, result;
+  char *pathname, *hardlink, *error;
+  struct archive_entry* entry;
+} ArchiveCompletion;
+
+typedef struct archive_job {
+  struct archive_job* next;
+  int index;
+  struct archive_entry* entry;
+  uint8_t* data;
+  size_t size;
+} ArchiveJob;
+
+typedef struct {
+  int ref_count;
+  char *filename, *dest;
+  int flags, threads, workers, started, running, count;
+  pthread_t* tids;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int fds[2];
+  ArchiveJob *jobs, **jobs_tail;
+  size_t njobs, job_bytes;
+  BOOL eof;
+  ArchiveCompletion *queue, **slots;
+  size_t nqueue, qcap, nslots, cursor;
+  char* error;
+  JSValue archive, progress, resolving_funcs[2];
+} ArchiveExtractor;
+
+static char*
+archive_path_join(const char* dir, const char* path) {
+  size_t dlen, plen;
+  char* ret;
+
+  if(!path)
+    return 0;
+
+  dlen = strlen(dir);
+  plen = strlen(path);
+
+  if((ret = malloc(dlen + plen + 2))) {
+    memcpy(ret, dir, dlen);
+    ret[dlen] = '/';
+    memcpy(&ret[dlen + 1], path, plen + 1);
+  }
+
+  return ret;
+}
+
+/* TRUE when an entry name would leave the destination directory */
+static BOOL
+archive_path_escapes(const char* path) {
+  if(path[0] == '/')
+    return TRUE;
+
+  while(*path) {
+    size_t n = strcspn(path, "/");
+
+    if(n == 2 && path[0] == '.' && path[1] == '.')
+      return TRUE;
+
+    path += n;
+
+    while(*path == '/')
+      path++;
+  }
+
+  return FALSE;
+}
+
+static char*
+archive_error_dup(struct archive* ar) {
+  const char* msg;
+
+  return strdup((msg = archive_error_string(ar)) ? msg : "unknown error");
+}
+
+static void
+archiveextractor_post(ArchiveExtractor* ex, ArchiveCompletion* c) {
+  pthread_mutex_lock(&ex->lock);
+
+  if(ex->nqueue == ex->qcap) {
+    size_t cap = ex->qcap ? ex->qcap * 2 : 64;
+    ArchiveCompletion* q;
+
+    if(!(q = realloc(ex->queue, sizeof(ArchiveCompletion) * cap))) {
+      pthread_mutex_unlock(&ex->lock);
+      return;
+    }
+
+    ex->queue = q;
+    ex->qcap = cap;
+  }
+
+  ex->queue[ex->nqueue++] = *c;
+  pthread_mutex_unlock(&ex->lock);
+
+  while(write(ex->fds[1], "", 1) == -1 && errno == EINTR) {}
+}
+
+/* Called when a thread is done, wakes up the JS thread a last time */
+static void
+archiveextractor_exit(ArchiveExtractor* ex) {
+  pthread_mutex_lock(&ex->lock);
+  ex->running--;
+  pthread_mutex_unlock(&ex->lock);
+
+  while(write(ex->fds[1], "", 1) == -1 && errno == EINTR) {}
+}
+
+static void
+archivejob_free(ArchiveJob* job) {
+  archive_entry_free(job->entry);
+  free(job->data);
+  free(job);
+}
+
+/* Decoder side, blocks while the queue is full */
+static void
+archiveextractor_push(ArchiveExtractor* ex, ArchiveJob* job) {
+  size_t cap = ex->workers * 4;
+
+  pthread_mutex_lock(&ex->lock);
+
+  while(ex->njobs >= cap || (ex->njobs > 0 && ex->job_bytes + job->size > ARCHIVE_JOB_BYTES))
+    pthread_cond_wait(&ex->cond, &ex->lock);
+
+  job->next = 0;
+  *ex->jobs_tail = job;
+  ex->jobs_tail = &job->next;
+  ex->njobs++;
+  ex->job_bytes += job->size;
+
+  pthread_cond_broadcast(&ex->cond);
+  pthread_mutex_unlock(&ex->lock);
+}
+
+/* Writer side, returns NULL when the decoder is done and the queue empty */
+static ArchiveJob*
+archiveextractor_pop(ArchiveExtractor* ex) {
+  ArchiveJob* job;
+
+  pthread_mutex_lock(&ex->lock);
+
+  while(!ex->jobs && !ex->eof)
+    pthread_cond_wait(&ex->cond, &ex->lock);
+
+  if((job = ex->jobs)) {
+    if(!(ex->jobs = job->next))
+      ex->jobs_tail = &ex->jobs;
+
+    ex->njobs--;
+    ex->job_bytes -= job->size;
+    pthread_cond_broadcast(&ex->cond);
+  }
+
+  pthread_mutex_unlock(&ex->lock);
+  return job;
+}
+
+static int
+archive_copy_data(struct archive* ar, struct archive* aw) {
+  const void* buf;
+  size_t size;
+  __LA_INT64_T offset;
+  int r;
+
+  for(;;) {
+    if((r = archive_read_data_block(ar, &buf, &size, &offset)) == ARCHIVE_EOF)
+      return ARCHIVE_OK;
+
+    if(r < ARCHIVE_WARN)
+      return r;
+
+    if((r = archive_write_data_block(aw, buf, size, offset)) < ARCHIVE_WARN)
+      return r;
+  }
+}
+
+/* Reads the data of the current entry into a buffer of 'size' bytes */
+static int
+archive_read_job(struct archive* ar, uint8_t* data, size_t size) {
+  const void* buf;
+  size_t len;
+  __LA_INT64_T offset;
+  int r;
+
+  /* sparse entries leave holes */
+  memset(data, 0, size);
+
+  for(;;) {
+    if((r = archive_read_data_block(ar, &buf, &len, &offset)) == ARCHIVE_EOF)
+      return ARCHIVE_OK;
+
+    if(r < ARCHIVE_WARN)
+      return r;
+
+    if(offset < 0 || (size_t)offset > size || len > size - offset) {
+      archive_set_error(ar, ARCHIVE_ERRNO_MISC, "entry data exceeds its size");
+      return ARCHIVE_FATAL;
+    }
+
+    memcpy(data + offset, buf, len);
+  }
+}
+
+/* Writes an entry with the data either read from 'ar' or buffered in 'data' */
+static int
+archive_write_entry(struct archive* disk, struct archive_entry* ent, struct archive* ar, const uint8_t* data) {
+  int r;
+
+  if((r = archive_write_header(disk, ent)) >= ARCHIVE_WARN && archive_entry_size(ent) > 0) {
+    if(ar)
+      r = archive_copy_data(ar, disk);
+    else
+      r = archive_write_data_block(disk, data, archive_entry_size(ent), 0);
+  }
+
+  if(r >= ARCHIVE_WARN)
+    r = archive_write_finish_entry(disk);
+
+  return r;
+}
+
+static struct archive*
+archiveextractor_disk(ArchiveExtractor* ex) {
+  struct archive* disk = archive_write_disk_new();
+
+  /* names are joined to the (absolute) destination after checking them */
+  archive_write_disk_set_options(disk, ex->flags & ~ARCHIVE_EXTRACT_SECURE_NOABSOLUTEPATHS);
+  archive_write_disk_set_standard_lookup(disk);
+  return disk;
+}
+
+static void*
+archiveextractor_writer(void* arg) {
+  ArchiveExtractor* ex = arg;
+  struct archive* disk = archiveextractor_disk(ex);
+  ArchiveJob* job;
+
+  while((job = archiveextractor_pop(ex))) {
+    ArchiveCompletion c = {job->index, ARCHIVE_OK, strdup(archive_entry_pathname(job->entry)), 0, 0};
+
+    if((c.result = archive_write_entry(disk, job->entry, 0, job->data)) < ARCHIVE_WARN)
+      c.error = archive_error_dup(disk);
+
+    archiveextractor_post(ex, &c);
+    archivejob_free(job);
+  }
+
+  archive_write_free(disk);
+  archiveextractor_exit(ex);
+  return 0;
+}
+
+static void*
+archiveextractor_thread(void* arg) {
+  ArchiveExtractor* ex = arg;
+  struct archive *ar = archive_read_new(), *disk = archiveextractor_disk(ex);
+  struct archive_entry* ent;
+  int i = 0, r;
+
+  archive_read_support_filter_all(ar);
+  archive_read_support_format_all(ar);
+
+  if((r = archive_read_open_filename(ar, ex->filename, 65536)) != ARCHIVE_OK) {
+    ArchiveCompletion c = {-1, r, 0, 0, archive_error_dup(ar)};
+    archiveextractor_post(ex, &c);
+    goto end;
+  }
+
+  for(;; i++) {
+    ArchiveCompletion c = {i, ARCHIVE_OK, 0, 0, 0};
+    const char* link;
+    int64_t size;
 
-  while(argc > 0) {
-    struct archive_entry* ent;
+    if((r = archive_read_next_header(ar, &ent)) == ARCHIVE_EOF)
+      break;
 
-    if((ent = js_archiveentry_data(argv[0]))) {
+    if(r < ARCHIVE_WARN) {
+      c.result = r;
+      c.error = archive_error_dup(ar);
+      archiveextractor_post(ex, &c);
+      break;
+    }
 
-      if(in_entry)
-        archive_write_finish_entry(ar);
+    link = archive_entry_hardlink(ent);
 
-      ret = archive_write_header(ar, ent) == ARCHIVE_OK ? JS_TRUE : JS_FALSE;
+    if(!archive_entry_pathname(ent) || archive_path_escapes(archive_entry_pathname(ent)) ||
+       (link && archive_path_escapes(link))) {
+      const char* name = archive_entry_pathname(ent);
 
-      JS_DefinePropertyValueStr(ctx, this_val, "entry", JS_DupValue(ctx, argv[0]), JS_PROP_CONFIGURABLE);
-      argv++;
-      argc--;
+      c.result = ARCHIVE_FAILED;
+      c.error = strdup(name ? "entry name escapes the destination" : "entry without a pathname");
+      c.pathname = name ? strdup(name) : 0;
+      archiveextractor_post(ex, &c);
       continue;
     }
 
-    int n = 1;
-    InputBuffer input = js_input_chars(ctx, argv[0]);
+    if(!(c.pathname = archive_path_join(ex->dest, archive_entry_pathname(ent)))) {
+      c.result = ARCHIVE_FATAL;
+      c.error = strdup("out of memory");
+      archiveextractor_post(ex, &c);
+      break;
+    }
 
-    if(argc > 1)
-      n += js_offset_length(ctx, input.size, argc, argv, 1, &input.range);
+    /* written through archive_write_disk once every other entry is on disk */
+    if(link) {
+      if(!(c.hardlink = archive_path_join(ex->dest, link)) || !(c.entry = archive_entry_clone(ent))) {
+        free(c.pathname);
+        free(c.hardlink);
+        c = (ArchiveCompletion){i, ARCHIVE_FATAL, 0, 0, strdup("out of memory"), 0};
+        archiveextractor_post(ex, &c);
+        break;
+      }
 
-    const uint8_t* buf = input_buffer_data(&input);
-    size_t len = input_buffer_length(&input);
-    size_t block_size = archive_write_get_bytes_per_block(ar);
-    int64_t r, bytes = 0;
+      archive_entry_set_pathname(c.entry, c.pathname);
+      archive_entry_set_hardlink(c.entry, c.hardlink);
+      archive_entry_set_size(c.entry, 0);
+      archiveextractor_post(ex, &c);
+      continue;
+    }
 
-    while(len > 0) {
-      size_t nb = MIN_NUM(block_size, len);
+    archive_entry_set_pathname(ent, c.pathname);
+    size = archive_entry_size_is_set(ent) ? archive_entry_size(ent) : -1;
 
-      r = archive_write_data(ar, buf, len);
+    if(ex->workers > 0 && size >= 0 && size <= ARCHIVE_JOB_MAX) {
+      ArchiveJob* job;
 
-      if(r > 0) {
-        len -= r;
-        buf += r;
-        bytes += r;
-        continue;
+      if(!(job = calloc(1, sizeof(ArchiveJob))) || !(job->entry = archive_entry_clone(ent)) ||
+         (size > 0 && !(job->data = malloc(size)))) {
+        if(job)
+          archivejob_free(job);
+
+        c.result = ARCHIVE_FATAL;
+        c.error = strdup("out of memory");
+        archiveextractor_post(ex, &c);
+        break;
       }
 
-      break;
-    }
+      job->index = i;
+      job->size = size;
 
-    ret = JS_NewInt64(ctx, bytes);
+      if(size > 0 && (r = archive_read_job(ar, job->data, size)) < ARCHIVE_WARN) {
+        archivejob_free(job);
+        c.result = r;
+        c.error = archive_error_dup(ar);
+        archiveextractor_post(ex, &c);
+        break;
+      }
 
-    input_buffer_free(&input, ctx);
+      /* the writer reports it */
+      free(c.pathname);
+      archiveextractor_push(ex, job);
+      continue;
+    }
 
-    argv += n;
-    argc -= n;
+    if((c.result = archive_write_entry(disk, ent, ar, 0)) < ARCHIVE_WARN)
+      c.error = archive_error_dup(archive_error_string(disk) ? disk : ar);
+
+    archiveextractor_post(ex, &c);
   }
 
-  return ret;
-}
+end:
+  archive_read_free(ar);
+  archive_write_free(disk);
 
-static JSValue
-js_archive_skip(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
-  struct archive* ar;
+  pthread_mutex_lock(&ex->lock);
+  ex->count = i;
+  ex->eof = TRUE;
+  pthread_cond_broadcast(&ex->cond);
+  pthread_mutex_unlock(&ex->lock);
 
-  if(!(ar = js_archive_data2(ctx, this_val)))
-    return JS_EXCEPTION;
+  archiveextractor_exit(ex);
+  return 0;
+}
 
-  if(js_archive_mode(ctx, this_val) == READ)
-    return js_archive_return(ctx, this_val, archive_read_data_skip(ar));
+static void
+archivecompletion_clear(ArchiveCompletion* c) {
+  if(c->entry)
+    archive_entry_free(c->entry);
 
-  return JS_UNDEFINED;
+  free(c->pathname);
+  free(c->hardlink);
+  free(c->error);
 }
 
-static JSValue
-js_archive_seek(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
-  struct archive* ar;
-  int64_t r, offset = 0;
-  int32_t whence = SEEK_SET;
-
-  if(!(ar = js_archive_data2(ctx, this_val)))
-    return JS_EXCEPTION;
+static void
+archivecompletion_free(ArchiveCompletion* c) {
+  archivecompletion_clear(c);
+  free(c);
+}
 
-  JS_ToInt64(ctx, &offset, argv[0]);
-  JS_ToInt32(ctx, &whence, argv[1]);
+static void
+archiveextractor_free(JSRuntime* rt, void* ptr) {
+  ArchiveExtractor* ex = ptr;
 
-  r = archive_seek_data(ar, offset, whence);
+  if(--ex->ref_count > 0)
+    return;
 
-  return js_archive_return(ctx, this_val, r);
-}
+  for(int i = 0; i < ex->started; i++)
+    pthread_join(ex->tids[i], 0);
 
-static JSValue
-js_archive_extract(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
-  JSValue ret = JS_UNDEFINED;
-  struct archive* ar;
-  struct archive_entry* ent;
-  int32_t flags;
-  ArchiveEntryRef* aeref = 0;
+  while(ex->jobs) {
+    ArchiveJob* job = ex->jobs;
 
-  if(js_archive_mode(ctx, this_val) != READ)
-    return JS_ThrowInternalError(ctx, "archive not in read mode");
+    ex->jobs = job->next;
+    archivejob_free(job);
+  }
 
-  if(!(ar = js_archive_data2(ctx, this_val)))
-    return JS_EXCEPTION;
+  for(size_t i = 0; i < ex->nqueue; i++)
+    archivecompletion_clear(&ex->queue[i]);
 
-  if(!(ent = js_archiveentry_data2(ctx, argv[0])))
-    return JS_EXCEPTION;
+  for(size_t i = 0; i < ex->nslots; i++)
+    if(ex->slots[i])
+      archivecompletion_free(ex->slots[i]);
 
-  if(argc >= 2)
-    JS_ToInt32(ctx, &flags, argv[1]);
+  close(ex->fds[0]);
+  close(ex->fds[1]);
+  pthread_mutex_destroy(&ex->lock);
+  pthread_cond_destroy(&ex->cond);
 
-  if(argc >= 3) {
-    if(!(aeref = js_malloc(ctx, sizeof(ArchiveEntryRef))))
-      return JS_EXCEPTION;
+  free(ex->queue);
+  free(ex->slots);
+  free(ex->error);
+  js_free_rt(rt, ex->filename);
+  free(ex->dest);
+  js_free_rt(rt, ex->tids);
 
-    aeref->ctx = ctx;
-    aeref->callback = argv[2];
-    aeref->args[0] = this_val;
-    aeref->args[1] = argv[0];
+  JS_FreeValueRT(rt, ex->archive);
+  JS_FreeValueRT(rt, ex->progress);
+  JS_FreeValueRT(rt, ex->resolving_funcs[0]);
+  JS_FreeValueRT(rt, ex->resolving_funcs[1]);
 
-    archive_read_extract_set_progress_callback(ar, js_archive_progress_callback, aeref);
-  }
+  js_free_rt(rt, ex);
+}
 
-  ret = js_archive_return(ctx, this_val, archive_read_extract(ar, ent, flags));
+/* Moves queued completions into their slots, returns FALSE on OOM */
+static BOOL
+archiveextractor_collect(ArchiveExtractor* ex, BOOL* finished) {
+  ArchiveCompletion* queue;
+  size_t n;
 
-  if(aeref) {
-    archive_read_extract_set_progress_callback(ar, 0, 0);
-    js_free(ctx, aeref);
-  }
+  pthread_mutex_lock(&ex->lock);
+  queue = ex->queue;
+  n = ex->nqueue;
+  ex->queue = 0;
+  ex->nqueue = ex->qcap = 0;
+  *finished = ex->running == 0;
+  pthread_mutex_unlock(&ex->lock);
 
-  return ret;
-}
+  for(size_t i = 0; i < n; i++) {
+    ArchiveCompletion* c = &queue[i];
 
-static JSValue
-js_archive_filterbytes(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
-  JSValue ret = JS_UNDEFINED;
-  struct archive* ar;
-  int32_t index = -1;
+    if(c->error && !ex->error)
+      ex->error = strdup(c->error);
 
-  if(!(ar = js_archive_data2(ctx, this_val)))
-    return JS_EXCEPTION;
+    if(c->index < 0) {
+      archivecompletion_clear(c);
+      continue;
+    }
 
-  if(argc >= 1)
-    JS_ToInt32(ctx, &index, argv[0]);
+    if((size_t)c->index >= ex->nslots) {
+      size_t nslots = MAX_NUM((size_t)c->index + 1, ex->nslots * 2);
+      ArchiveCompletion** slots;
 
-  ret = JS_NewInt64(ctx, archive_filter_bytes(ar, index));
+      if(!(slots = realloc(ex->slots, sizeof(ArchiveCompletion*) * nslots)))
+        return FALSE;
 
-  return ret;
-}
+      memset(&slots[ex->nslots], 0, sizeof(ArchiveCompletion*) * (nslots - ex->nslots));
+      ex->slots = slots;
+      ex->nslots = nslots;
+    }
 
-static JSValue
-js_archive_close(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
-  JSValue ret = JS_UNDEFINED;
-  struct archive* ar;
+    if((ex->slots[c->index] = malloc(sizeof(ArchiveCompletion))))
+      *ex->slots[c->index] = *c;
+  }
 
-  if((ar = js_archive_data(this_val))) {
+  free(queue);
+  return TRUE;
+}
 
-    if(js_archive_mode(ctx, this_val) == WRITE)
-      if(js_has_propertystr(ctx, this_val, "entry"))
-        archive_write_finish_entry(ar);
+static void
+archiveextractor_report(JSContext* ctx, ArchiveExtractor* ex, ArchiveCompletion* c) {
+  ArchiveEntryRef aeref = {ctx, ex->progress, {ex->archive, JS_UNDEFINED}};
+  JSValue info;
 
-    int r = js_archive_mode(ctx, this_val) == WRITE ? archive_write_close(ar) : archive_read_close(ar);
+  if(!JS_IsFunction(ctx, ex->progress))
+    return;
 
-    ret = r == ARCHIVE_OK ? JS_TRUE : JS_FALSE;
+  info = JS_NewObject(ctx);
+  JS_SetPropertyStr(ctx, info, "index", JS_NewInt32(ctx, c->index));
+  JS_SetPropertyStr(ctx, info, "pathname", c->pathname ? JS_NewString(ctx, c->pathname) : JS_NULL);
+  JS_SetPropertyStr(ctx, info, "result", JS_NewInt32(ctx, c->result));
 
-    js_delete_propertystr(ctx, this_val, "eof");
-    js_delete_propertystr(ctx, this_val, "mode");
-    js_delete_propertystr(ctx, this_val, "entry");
-  }
+  if(c->hardlink)
+    JS_SetPropertyStr(ctx, info, "hardlink", JS_NewString(ctx, c->hardlink));
 
-  return ret;
+  aeref.args[1] = info;
+  js_archive_progress_callback(&aeref);
+  JS_FreeValue(ctx, info);
 }
 
 static JSValue
-js_archive_version(JSContext* ctx, JSValueConst this_val) {
-  return JS_NewString(ctx, archive_version_details());
-}
+archiveextractor_ready(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, void* opaque) {
+  ArchiveExtractor* ex = opaque;
+  struct archive* disk = 0;
+  BOOL finished = FALSE;
+  char buf[256];
 
-static JSValue
-js_archive_next(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
-  struct archive* ar;
-  struct archive_entry* ent = NULL;
-  int result = ARCHIVE_EOF;
+  while(read(ex->fds[0], buf, sizeof(buf)) == sizeof(buf)) {}
 
-  if(js_archive_mode(ctx, this_val) != READ)
-    return JS_ThrowInternalError(ctx, "archive not in read mode");
+  if(!archiveextractor_collect(ex, &finished) && !ex->error)
+    ex->error = strdup("out of memory");
 
-  if(!(ar = js_archive_data2(ctx, this_val)))
-    return JS_EXCEPTION;
+  while(ex->cursor < ex->nslots && ex->slots[ex->cursor]) {
+    ArchiveCompletion* c = ex->slots[ex->cursor];
 
-  js_delete_propertystr(ctx, this_val, "entry");
+    /* hard links wait until every regular file is on disk */
+    if(c->entry) {
+      if(!finished)
+        break;
 
-  BOOL eof = js_get_propertystr_bool(ctx, this_val, "eof");
+      if(!disk)
+        disk = archiveextractor_disk(ex);
 
-  if(!eof) {
-    if(!(ent = archive_entry_new2(ar)))
-      return JS_ThrowOutOfMemory(ctx);
+      if((c->result = archive_write_entry(disk, c->entry, 0, 0)) < ARCHIVE_WARN && !ex->error)
+        ex->error = archive_error_dup(disk);
+    }
 
-    result = archive_read_next_header2(ar, ent);
-  } else {
-    result = ARCHIVE_EOF;
+    archiveextractor_report(ctx, ex, c);
+    archivecompletion_free(c);
+    ex->slots[ex->cursor++] = 0;
   }
 
-  JSValue ret;
+  if(disk)
+    archive_write_free(disk);
 
-  switch(result) {
-    case ARCHIVE_EOF:
-    case ARCHIVE_FATAL: {
-      ret = eof ? JS_NULL : js_archive_return(ctx, this_val, result);
-      break;
+  /* on error the slots of unextracted entries never fill up */
+  if(finished && (ex->error || ex->cursor >= (size_t)ex->count)) {
+    JSValue set_handler, args[2] = {JS_NewInt32(ctx, ex->fds[0]), JS_NULL}, ret, value;
+
+    if(!JS_IsException((set_handler = js_iohandler_fn(ctx, FALSE, 0)))) {
+      ret = JS_Call(ctx, set_handler, JS_UNDEFINED, countof(args), args);
+      JS_FreeValue(ctx, ret);
+      JS_FreeValue(ctx, set_handler);
     }
 
-    default: {
-      ret = js_archiveentry_wrap(ctx, entry_proto, ent);
-      JS_DefinePropertyValueStr(ctx, this_val, "entry", JS_DupValue(ctx, ret), JS_PROP_CONFIGURABLE);
-      break;
+    if(ex->error) {
+      value = JS_NewError(ctx);
+      JS_SetPropertyStr(ctx, value, "message", JS_NewString(ctx, ex->error));
+    } else {
+      value = JS_NewInt32(ctx, ex->count);
     }
+
+    ret = JS_Call(ctx, ex->resolving_funcs[ex->error ? 1 : 0], JS_UNDEFINED, 1, &value);
+    JS_FreeValue(ctx, ret);
+    JS_FreeValue(ctx, value);
   }
 
-  return ret;
+  return JS_UNDEFINED;
 }
 
+/**
+ * archive.extractAll(dest, { threads, flags, progress })
+ *
+ * Extracts the whole archive (which must have been opened from a file)
+ * below `dest` (created if missing) using `threads` threads: one decoding
+ * the archive, the others writing entries to disk.  `progress(archive, info)` is called
+ * once per entry in archive order.  Resolves to the entry count.
+ */
 static JSValue
-js_archive_iterator(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
-  if(js_archive_mode(ctx, this_val) != READ)
-    return JS_ThrowInternalError(ctx, "archive not in read mode");
+js_archive_extractall(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ArchiveExtractor* ex;
+  JSValue promise, file, set_handler, args[2], ret;
+  int32_t threads = 4,
+          flags = ARCHIVE_EXTRACT_TIME | ARCHIVE_EXTRACT_PERM | ARCHIVE_EXTRACT_SECURE_NODOTDOT |
+                  ARCHIVE_EXTRACT_SECURE_SYMLINKS;
+  char *dest, *path;
+
+  if(!JS_IsString((file = JS_GetPropertyStr(ctx, this_val, "file")))) {
+    JS_FreeValue(ctx, file);
+    return JS_ThrowTypeError(ctx, "extractAll() requires an archive opened from a file");
+  }
 
-  JSValue ret = JS_NewObjectProtoClass(ctx, iterator_proto, js_archive_iterator_class_id);
-  struct archive* ar;
+  if(argc > 1 && JS_IsObject(argv[1])) {
+    if(js_has_propertystr(ctx, argv[1], "threads"))
+      threads = CLAMP_NUM(js_get_propertystr_int32(ctx, argv[1], "threads"), 1, 256);
 
-  if((ar = js_archive_data(this_val))) {
-    JS_SetOpaque(ret, ar);
-    JS_DefinePropertyValueStr(ctx, ret, "archive", JS_DupValue(ctx, this_val), JS_PROP_CONFIGURABLE);
+    if(js_has_propertystr(ctx, argv[1], "flags"))
+      flags = js_get_propertystr_int32(ctx, argv[1], "flags");
   }
 
-  return ret;
-}
+  if(!(path = js_tostring(ctx, argv[0]))) {
+    JS_FreeValue(ctx, file);
+    return JS_EXCEPTION;
+  }
 
-static JSValue
-js_archive_iterator_next(JSContext* ctx, JSValueConst iter, int argc, JSValueConst argv[], BOOL* pdone, int magic) {
-  struct archive* ar;
-  struct archive_entry* ent = NULL;
-  int result = ARCHIVE_EOF;
+  /* entries are joined to the canonical path, free of symlinks and '..' */
+  mkdir(path, 0777);
+  dest = realpath(path, 0);
+  js_free(ctx, path);
 
-  if(!(ar = JS_GetOpaque2(ctx, iter, js_archive_iterator_class_id)))
+  if(!dest) {
+    JS_FreeValue(ctx, file);
+    return JS_ThrowInternalError(ctx, "extractAll(): %s", strerror(errno));
+  }
+
+  if(!(ex = js_mallocz(ctx, sizeof(ArchiveExtractor)))) {
+    free(dest);
+    JS_FreeValue(ctx, file);
     return JS_EXCEPTION;
+  }
 
-  JSValue this_val = JS_GetPropertyStr(ctx, iter, "archive");
+  ex->ref_count = 1;
+  ex->filename = js_tostring(ctx, file);
+  ex->dest = dest;
+  ex->flags = flags;
+  ex->threads = threads;
+  ex->jobs_tail = &ex->jobs;
+  ex->archive = JS_DupValue(ctx, this_val);
+  ex->progress = argc > 1 && JS_IsObject(argv[1]) ? JS_GetPropertyStr(ctx, argv[1], "progress") : JS_UNDEFINED;
+  ex->resolving_funcs[0] = ex->resolving_funcs[1] = JS_UNDEFINED;
+  ex->fds[0] = ex->fds[1] = -1;
+  pthread_mutex_init(&ex->lock, 0);
+  pthread_cond_init(&ex->cond, 0);
+
+  JS_FreeValue(ctx, file);
+
+  promise = JS_NewPromiseCapability(ctx, ex->resolving_funcs);
+
+  if(JS_IsException(promise) || !(ex->tids = js_mallocz(ctx, sizeof(pthread_t) * threads)) || pipe(ex->fds) == -1) {
+    ex->threads = 0;
+    archiveextractor_free(JS_GetRuntime(ctx), ex);
+    JS_FreeValue(ctx, promise);
+    return JS_ThrowInternalError(ctx, "extractAll() setup failed");
+  }
 
-  BOOL eof = js_get_propertystr_bool(ctx, this_val, "eof");
+  fcntl(ex->fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(ex->fds[1], F_SETFL, O_NONBLOCK);
 
-  if(!eof) {
-    if(!(ent = archive_entry_new2(ar)))
-      return JS_ThrowOutOfMemory(ctx);
+  pthread_mutex_lock(&ex->lock);
 
-    result = archive_read_next_header2(ar, ent);
+  /* the writers first, so the decoder knows how many there are */
+  for(int i = 0; i < threads - 1; i++) {
+    if(pthread_create(&ex->tids[ex->started], 0, archiveextractor_writer, ex))
+      break;
+
+    ex->started++;
+    ex->workers++;
+    ex->running++;
   }
 
-  switch(result) {
-    case ARCHIVE_EOF: {
-      JS_DefinePropertyValueStr(ctx, this_val, "eof", JS_TRUE, JS_PROP_CONFIGURABLE);
-      *pdone = TRUE;
-      return JS_UNDEFINED;
-    }
+  if(pthread_create(&ex->tids[ex->started], 0, archiveextractor_thread, ex)) {
+    ex->error = strdup("pthread_create() failed");
 
-    case ARCHIVE_FATAL: {
-      *pdone = TRUE;
-      return JS_ThrowInternalError(ctx, "libarchive error: %s", archive_error_string(ar));
-    }
+    /* let the writers exit */
+    ex->eof = TRUE;
+    pthread_cond_broadcast(&ex->cond);
+  } else {
+    ex->started++;
+    ex->running++;
   }
 
-  if(result == ARCHIVE_WARN) {
-    fprintf(stderr, "WARNING: %s\n", archive_error_string(ar));
-    archive_clear_error(ar);
+  pthread_mutex_unlock(&ex->lock);
+
+  /* nothing would ever wake up the handler */
+  if(ex->started == 0) {
+    JSValue error = JS_NewError(ctx);
+
+    JS_SetPropertyStr(ctx, error, "message", JS_NewString(ctx, ex->error ? ex->error : "pthread_create() failed"));
+    ret = JS_Call(ctx, ex->resolving_funcs[1], JS_UNDEFINED, 1, &error);
+
+    JS_FreeValue(ctx, ret);
+    JS_FreeValue(ctx, error);
+    archiveextractor_free(JS_GetRuntime(ctx), ex);
+    return promise;
   }
 
-  *pdone = FALSE;
+  if(JS_IsException((set_handler = js_iohandler_fn(ctx, FALSE, 0)))) {
+    archiveextractor_free(JS_GetRuntime(ctx), ex);
+    JS_FreeValue(ctx, promise);
+    return JS_EXCEPTION;
+  }
 
-  return js_archiveentry_wrap(ctx, entry_proto, ent);
+  args[0] = JS_NewInt32(ctx, ex->fds[0]);
+  args[1] = js_function_cclosure(ctx, archiveextractor_ready, 0, 0, ex, archiveextractor_free);
+
+  ret = JS_Call(ctx, set_handler, JS_UNDEFINED, countof(args), args);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, args[1]);
+  JS_FreeValue(ctx, set_handler);
+
+  return promise;
 }
+#endif
 
 static void
 js_archive_finalizer(JSRuntime* rt, JSValue val) {
-  struct archive* ar;
+  ArchiveObject* ao;
+
+  if((ao = js_archive_object(val))) {
+    if(ao->ar)
+      archive_free(ao->ar);
+
+    if(ao->pending_fd >= 0)
+      close(ao->pending_fd);
+
+    JS_FreeValueRT(rt, ao->stream);
+    JS_FreeValueRT(rt, ao->writer);
+    js_free_rt(rt, ao);
+  }
+}
 
-  if((ar = js_archive_data(val)))
-    archive_free(ar);
+static void
+js_archive_mark(JSRuntime* rt, JSValueConst val, JS_MarkFunc* mark_func) {
+  ArchiveObject* ao;
+
+  if((ao = js_archive_object(val))) {
+    JS_MarkValue(rt, ao->stream, mark_func);
+    JS_MarkValue(rt, ao->writer, mark_func);
+  }
 }
 
 static JSClassDef js_archive_class = {
     .class_name = "Archive",
     .finalizer = js_archive_finalizer,
+    .gc_mark = js_archive_mark,
 };
 
 static const JSCFunctionListEntry js_archive_funcs[] = {
@@ -898,6 +2724,7 @@ static const JSCFunctionListEntry js_archive_funcs[] = {
     JS_CGETSET_MAGIC_DEF("hasEncryptedEntries", js_archive_get, 0, PROP_HAS_ENCRYPTED_ENTRIES),
     JS_CGETSET_MAGIC_DEF("blockSize", js_archive_get, js_archive_set, PROP_BLOCKSIZE),
     JS_CGETSET_MAGIC_DEF("fileCount", js_archive_get, 0, PROP_FILECOUNT),
+    JS_CGETSET_MAGIC_DEF("ready", js_archive_get, 0, PROP_READY),
     JS_CFUNC_DEF("next", 0, js_archive_next),
     JS_CFUNC_DEF("open", 1, js_archive_open),
     JS_CFUNC_DEF("read", 1, js_archive_read),
@@ -908,6 +2735,11 @@ static const JSCFunctionListEntry js_archive_funcs[] = {
     JS_CFUNC_DEF("filterBytes", 1, js_archive_filterbytes),
     JS_CFUNC_DEF("close", 0, js_archive_close),
     JS_CFUNC_DEF("[Symbol.iterator]", 0, js_archive_iterator),
+#ifdef HAVE_PTHREAD_H
+    JS_CFUNC_DEF("iterate", 0, js_archive_iterate),
+    JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, js_archive_iterate),
+    JS_CFUNC_DEF("extractAll", 1, js_archive_extractall),
+#endif
     JS_PROP_INT32_DEF("READ", 0, JS_PROP_CONFIGURABLE),
     JS_PROP_INT32_DEF("WRITE", 1, JS_PROP_CONFIGURABLE),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "Archive", JS_PROP_CONFIGURABLE),
@@ -1991,6 +3823,17 @@ js_archive_init(JSContext* ctx, JSModuleDef* m) {
   JS_SetPropertyFunctionList(ctx, iterator_proto, js_archive_iterator_funcs, countof(js_archive_iterator_funcs));
   JS_SetClassProto(ctx, js_archive_iterator_class_id, iterator_proto);
 
+#ifdef HAVE_PTHREAD_H
+  JS_NewClassID(&js_archive_asynciterator_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_archive_asynciterator_class_id, &js_archive_asynciterator_class);
+
+  asynciterator_proto = JS_NewObject(ctx);
+
+  JS_SetPropertyFunctionList(
+      ctx, asynciterator_proto, js_archive_asynciterator_funcs, countof(js_archive_asynciterator_funcs));
+  JS_SetClassProto(ctx, js_archive_asynciterator_class_id, asynciterator_proto);
+#endif
+
   JS_NewClassID(&js_archiveentry_class_id);
   JS_NewClass(JS_GetRuntime(ctx), js_archiveentry_class_id, &js_archiveentry_class);
 
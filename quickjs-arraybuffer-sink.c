@@ -12,7 +12,7 @@
  * @{
  */
 VISIBLE JSClassID js_arraybuffer_sink_class_id = 0;
-static JSValue arraybuffer_sink_proto, arraybuffer_sink_ctor;
+static thread_local JSValue arraybuffer_sink_proto, arraybuffer_sink_ctor;
 
 static JSValue
 js_arraybuffer_sink_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
@@ -11,7 +11,7 @@
  */
 
 JSClassID js_blob_class_id = 0;
-static JSValue blob_proto, blob_ctor;
+static thread_local JSValue blob_proto, blob_ctor;
 
 static Blob*
 blob_new(JSContext* ctx, const char* type) {
@@ -37,7 +37,7 @@ enum {
 };
 
 VISIBLE JSClassID js_child_process_class_id = 0;
-static JSValue child_process_proto, child_process_ctor;
+static thread_local JSValue child_process_proto, child_process_ctor;
 
 ChildProcess*
 js_child_process_data(JSValueConst value) {
@@ -16,7 +16,7 @@
  * @{
  */
 VISIBLE JSClassID js_deep_iterator_class_id = 0;
-static JSValue deep_functions, deep_iterator_proto, deep_iterator_ctor;
+static thread_local JSValue deep_functions, deep_iterator_proto, deep_iterator_ctor;
 
 typedef enum {
   YIELD_MASK = 1,
@@ -1,16 +1,27 @@
 #include "defines.h"
 #include "getdents.h"
+#include "dir-walk.h"
+#include "dir-watch.h"
 #include "utils.h"
 #include "char-utils.h"
 #include <errno.h>
+#include <math.h>
 #include <string.h>
+#include <unistd.h>
 
 /**
  * \defgroup quickjs-directory quickjs-directory: Directory reader
  * @{
  */
-VISIBLE JSClassID js_directory_class_id = 0;
-static JSValue directory_proto, directory_ctor;
+VISIBLE JSClassID js_directory_class_id = 0, js_directory_walk_class_id = 0, js_directory_watch_class_id = 0;
+static thread_local JSValue directory_proto, directory_ctor, directory_walk_proto, directory_watch_proto;
+
+typedef struct {
+  DirWalk* walk;
+  char* root;
+  int flags;
+  JSValue pending[2];
+} DirectoryWalk;
 
 enum {
   FLAG_NAME = 1,
@@ -257,6 +268,486 @@ js_directory_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueCons
   return ret;
 }
 
+static JSValue
+directory_walk_entry(JSContext* ctx, const char* path, int type, int dflags) {
+  JSValue name = JS_UNDEFINED, ret = JS_UNDEFINED;
+
+  if(dflags & FLAG_NAME)
+    name = (dflags & FLAG_BUFFER) ? JS_NewArrayBufferCopy(ctx, (const uint8_t*)path, strlen(path))
+                                  : JS_NewString(ctx, path);
+
+  switch(dflags & FLAG_BOTH) {
+    case FLAG_NAME: {
+      ret = name;
+      break;
+    }
+
+    case FLAG_TYPE: {
+      ret = JS_NewInt32(ctx, type);
+      break;
+    }
+
+    case FLAG_BOTH: {
+      ret = JS_NewArray(ctx);
+
+      JS_SetPropertyUint32(ctx, ret, 0, name);
+      JS_SetPropertyUint32(ctx, ret, 1, JS_NewInt32(ctx, type));
+      break;
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Settle the pending next() of \param dw if a batch is ready or the walk has finished
+ *
+ * @return  TRUE if it was settled
+ */
+static BOOL
+directory_walk_settle(JSContext* ctx, DirectoryWalk* dw) {
+  DirWalkBatch* b;
+  JSValue result, ret;
+  BOOL done, reject = FALSE;
+  int error;
+
+  if(!(b = dir_walk_next(dw->walk, &done)) && !done)
+    return FALSE;
+
+  if(b) {
+    JSValue value = JS_NewArray(ctx);
+    const char* p = b->data;
+
+    for(uint32_t i = 0; i < b->count; i++) {
+      int type = (uint8_t)*p++;
+
+      JS_SetPropertyUint32(ctx, value, i, directory_walk_entry(ctx, p, type, dw->flags));
+      p += strlen(p) + 1;
+    }
+
+    dir_walk_batch_free(b);
+    result = js_iterator_result(ctx, value, FALSE);
+    JS_FreeValue(ctx, value);
+  } else if((error = dir_walk_error(dw->walk))) {
+    JS_ThrowInternalError(ctx, "walk(%s) failed: %s", dw->root, strerror(error));
+    result = JS_GetException(ctx);
+    reject = TRUE;
+  } else {
+    result = js_iterator_result(ctx, JS_UNDEFINED, TRUE);
+  }
+
+  ret = JS_Call(ctx, dw->pending[reject], JS_UNDEFINED, 1, (JSValueConst*)&result);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, result);
+  JS_FreeValue(ctx, dw->pending[0]);
+  JS_FreeValue(ctx, dw->pending[1]);
+  dw->pending[0] = dw->pending[1] = JS_UNDEFINED;
+
+  return TRUE;
+}
+
+static JSValue
+js_directory_walk_ready(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  DirectoryWalk* dw;
+  char buf[64];
+
+  if(!(dw = JS_GetOpaque(data[0], js_directory_walk_class_id)))
+    return JS_UNDEFINED;
+
+  /* drain the wake-up bytes */
+  while(read(dir_walk_fd(dw->walk), buf, sizeof(buf)) > 0) {}
+
+  if(JS_IsFunction(ctx, dw->pending[0]) && directory_walk_settle(ctx, dw)) {
+    JSValue args[2] = {JS_NewInt32(ctx, dir_walk_fd(dw->walk)), JS_NULL};
+    JSValue ret = JS_Call(ctx, data[1], JS_UNDEFINED, countof(args), args);
+
+    JS_FreeValue(ctx, ret);
+  }
+
+  return JS_UNDEFINED;
+}
+
+static JSValue
+js_directory_walk_next(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  DirectoryWalk* dw;
+  JSValue promise, set_handler, args[2], ret;
+
+  if(!(dw = JS_GetOpaque2(ctx, this_val, js_directory_walk_class_id)))
+    return JS_EXCEPTION;
+
+  if(JS_IsFunction(ctx, dw->pending[0]))
+    return JS_ThrowInternalError(ctx, "DirectoryWalk: next() already pending");
+
+  if(JS_IsException((promise = js_promise_new(ctx, dw->pending))))
+    return promise;
+
+  if(directory_walk_settle(ctx, dw))
+    return promise;
+
+  if(JS_IsException((set_handler = js_iohandler_fn(ctx, FALSE, 0)))) {
+    JS_FreeValue(ctx, promise);
+    return JS_EXCEPTION;
+  }
+
+  JSValueConst data[] = {this_val, set_handler};
+
+  args[0] = JS_NewInt32(ctx, dir_walk_fd(dw->walk));
+  args[1] = JS_NewCFunctionData(ctx, js_directory_walk_ready, 0, 0, countof(data), data);
+
+  ret = JS_Call(ctx, set_handler, JS_UNDEFINED, countof(args), args);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, args[1]);
+  JS_FreeValue(ctx, set_handler);
+
+  return promise;
+}
+
+static JSValue
+js_directory_walk_return(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  DirectoryWalk* dw;
+  JSValue result, ret;
+
+  if(!(dw = JS_GetOpaque2(ctx, this_val, js_directory_walk_class_id)))
+    return JS_EXCEPTION;
+
+  dir_walk_cancel(dw->walk);
+
+  result = js_iterator_result(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, TRUE);
+  ret = js_promise_resolve(ctx, result);
+  JS_FreeValue(ctx, result);
+
+  return ret;
+}
+
+static JSValue
+js_directory_walk_self(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  return JS_DupValue(ctx, this_val);
+}
+
+static void
+directory_walk_patterns(JSContext* ctx, JSValueConst value, char*** patterns, size_t* n) {
+  if(JS_IsUndefined(value) || JS_IsNull(value))
+    return;
+
+  if(js_is_array(ctx, value)) {
+    *patterns = js_array_to_argv(ctx, n, value);
+  } else if((*patterns = js_mallocz(ctx, sizeof(char*) * 2))) {
+    (*patterns)[0] = js_tostring(ctx, value);
+    *n = 1;
+  }
+}
+
+/**
+ * walk(root[, { include, exclude, types, maxDepth, threads, batchSize, flags }])
+ *
+ * Returns an async iterator over the entries below root, yielding arrays of
+ * up to batchSize entries.  Each entry is formatted as by Directory's next()
+ * according to flags, with the path including root.  include and exclude
+ * are glob patterns (a string or an array), matched against the path
+ * relative to root when they contain a '/' and against the name otherwise.
+ * Entries matching an exclude pattern are skipped, and so are their
+ * contents when they are directories.
+ */
+static JSValue
+js_directory_walk(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  DirWalkOptions opts;
+  DirectoryWalk* dw;
+  char **include = 0, **exclude = 0;
+  JSValue obj = JS_EXCEPTION;
+
+  dir_walk_options(&opts);
+
+  if(!(dw = js_mallocz(ctx, sizeof(DirectoryWalk))))
+    return JS_EXCEPTION;
+
+  dw->flags = FLAG_BOTH;
+  dw->pending[0] = dw->pending[1] = JS_UNDEFINED;
+
+  if(!(dw->root = js_tostring(ctx, argv[0])))
+    goto fail;
+
+  if(argc > 1 && JS_IsObject(argv[1])) {
+    JSValue value;
+
+    value = JS_GetPropertyStr(ctx, argv[1], "include");
+    directory_walk_patterns(ctx, value, &include, &opts.ninclude);
+    JS_FreeValue(ctx, value);
+
+    value = JS_GetPropertyStr(ctx, argv[1], "exclude");
+    directory_walk_patterns(ctx, value, &exclude, &opts.nexclude);
+    JS_FreeValue(ctx, value);
+
+    if(js_has_propertystr(ctx, argv[1], "types"))
+      opts.types = js_get_propertystr_int32(ctx, argv[1], "types");
+
+    if(js_has_propertystr(ctx, argv[1], "maxDepth")) {
+      double depth = -1;
+
+      value = JS_GetPropertyStr(ctx, argv[1], "maxDepth");
+      JS_ToFloat64(ctx, &depth, value);
+      JS_FreeValue(ctx, value);
+
+      if(isfinite(depth))
+        opts.max_depth = depth;
+    }
+
+    if(js_has_propertystr(ctx, argv[1], "threads"))
+      opts.threads = js_get_propertystr_int32(ctx, argv[1], "threads");
+
+    if(js_has_propertystr(ctx, argv[1], "batchSize"))
+      opts.batch_size = MAX_NUM(js_get_propertystr_int32(ctx, argv[1], "batchSize"), 1);
+
+    if(js_has_propertystr(ctx, argv[1], "flags"))
+      dw->flags = js_get_propertystr_int32(ctx, argv[1], "flags");
+  }
+
+  opts.include = (const char* const*)include;
+  opts.exclude = (const char* const*)exclude;
+
+  if(!(dw->walk = dir_walk_new(dw->root, &opts))) {
+    JS_ThrowOutOfMemory(ctx);
+    goto fail;
+  }
+
+  if(JS_IsException((obj = JS_NewObjectProtoClass(ctx, directory_walk_proto, js_directory_walk_class_id))))
+    goto fail;
+
+  JS_SetOpaque(obj, dw);
+  dw = 0;
+
+fail:
+  if(include)
+    js_strv_free(ctx, include);
+  if(exclude)
+    js_strv_free(ctx, exclude);
+
+  if(dw) {
+    if(dw->walk)
+      dir_walk_free(dw->walk);
+    if(dw->root)
+      js_free(ctx, dw->root);
+
+    js_free(ctx, dw);
+  }
+
+  return obj;
+}
+
+static void
+js_directory_walk_finalizer(JSRuntime* rt, JSValue val) {
+  DirectoryWalk* dw;
+
+  if((dw = JS_GetOpaque(val, js_directory_walk_class_id))) {
+    dir_walk_free(dw->walk);
+
+    JS_FreeValueRT(rt, dw->pending[0]);
+    JS_FreeValueRT(rt, dw->pending[1]);
+
+    js_free_rt(rt, dw->root);
+    js_free_rt(rt, dw);
+  }
+}
+
+#ifdef HAVE_INOTIFY
+typedef struct {
+  DirWatch* watch;
+  JSValue callback;
+} DirectoryWatch;
+
+static JSValue
+js_directory_watch_ready(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  DirectoryWatch* dw;
+  DirWatchChange* changes;
+  size_t count;
+  BOOL overflow;
+
+  if(!(dw = JS_GetOpaque(data[0], js_directory_watch_class_id)) || !dw->watch)
+    return JS_UNDEFINED;
+
+  if(magic == 0) {
+    if(dir_watch_read(dw->watch) == -1)
+      return JS_ThrowInternalError(ctx, "reading inotify events failed: %s", strerror(errno));
+
+    return JS_UNDEFINED;
+  }
+
+  if((changes = dir_watch_take(dw->watch, &count, &overflow)) || overflow) {
+    JSValue args[2] = {JS_NewArray(ctx), JS_NewBool(ctx, overflow)}, ret;
+
+    for(size_t i = 0; i < count; i++) {
+      JSValue change = JS_NewArray(ctx);
+
+      JS_SetPropertyUint32(ctx, change, 0, JS_NewString(ctx, changes[i].path));
+      JS_SetPropertyUint32(ctx, change, 1, JS_NewUint32(ctx, changes[i].mask));
+      JS_SetPropertyUint32(ctx, args[0], i, change);
+    }
+
+    if(changes)
+      dir_watch_changes_free(changes, count);
+
+    ret = JS_Call(ctx, dw->callback, JS_UNDEFINED, countof(args), args);
+    JS_FreeValue(ctx, args[0]);
+
+    if(JS_IsException(ret))
+      return ret;
+
+    JS_FreeValue(ctx, ret);
+  }
+
+  return JS_UNDEFINED;
+}
+
+static int
+directory_watch_handlers(JSContext* ctx, DirectoryWatch* dw, JSValueConst obj) {
+  JSValue set_handler;
+
+  if(JS_IsException((set_handler = js_iohandler_fn(ctx, FALSE, 0))))
+    return -1;
+
+  js_iohandler_set(ctx,
+                   set_handler,
+                   dir_watch_fd(dw->watch),
+                   JS_IsNull(obj) ? JS_NULL : JS_NewCFunctionData(ctx, js_directory_watch_ready, 0, 0, 1, &obj));
+  js_iohandler_set(ctx,
+                   set_handler,
+                   dir_watch_timerfd(dw->watch),
+                   JS_IsNull(obj) ? JS_NULL : JS_NewCFunctionData(ctx, js_directory_watch_ready, 0, 1, 1, &obj));
+
+  JS_FreeValue(ctx, set_handler);
+  return 0;
+}
+
+static void
+directory_watch_close(JSRuntime* rt, DirectoryWatch* dw) {
+  if(dw->watch) {
+    dir_watch_free(dw->watch);
+    dw->watch = 0;
+  }
+
+  JS_FreeValueRT(rt, dw->callback);
+  dw->callback = JS_UNDEFINED;
+}
+
+/**
+ * watch(root, callback[, { delay, maxDelay, mask, exclude }])
+ *
+ * Watches the directory tree below root.  callback(changes, overflow) is
+ * called with an array of [path, mask] for every path that had events in
+ * the last change set, mask being the IN_* flags of all of them.  Only the
+ * events in mask are reported (subdirectories are followed regardless).  When
+ * overflow is true, events were lost and the tree should be rescanned.
+ * Directories matching an exclude pattern are not watched.
+ */
+static JSValue
+js_directory_watch(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  DirWatchOptions opts;
+  DirectoryWatch* dw;
+  char *root, **exclude = 0;
+  JSValue obj = JS_EXCEPTION;
+
+  if(!JS_IsFunction(ctx, argv[1]))
+    return JS_ThrowTypeError(ctx, "argument 2 must be a function");
+
+  if(!(root = js_tostring(ctx, argv[0])))
+    return JS_EXCEPTION;
+
+  dir_watch_options(&opts);
+
+  if(argc > 2 && JS_IsObject(argv[2])) {
+    JSValue value = JS_GetPropertyStr(ctx, argv[2], "exclude");
+
+    directory_walk_patterns(ctx, value, &exclude, &opts.nexclude);
+    JS_FreeValue(ctx, value);
+
+    /* undefined options keep their defaults */
+    value = JS_GetPropertyStr(ctx, argv[2], "delay");
+    if(!JS_IsUndefined(value))
+      opts.delay = MAX_NUM(js_toint32(ctx, value), 0);
+    JS_FreeValue(ctx, value);
+
+    value = JS_GetPropertyStr(ctx, argv[2], "maxDelay");
+    if(!JS_IsUndefined(value))
+      opts.max_delay = MAX_NUM(js_toint32(ctx, value), 0);
+    JS_FreeValue(ctx, value);
+
+    value = JS_GetPropertyStr(ctx, argv[2], "mask");
+    if(!JS_IsUndefined(value))
+      opts.mask = js_touint64(ctx, value);
+    JS_FreeValue(ctx, value);
+  }
+
+  opts.exclude = (const char* const*)exclude;
+
+  if(!(dw = js_mallocz(ctx, sizeof(DirectoryWatch))))
+    goto end;
+
+  if(!(dw->watch = dir_watch_new(root, &opts))) {
+    JS_ThrowInternalError(ctx, "watch(%s) failed: %s", root, strerror(errno));
+    js_free(ctx, dw);
+    goto end;
+  }
+
+  dw->callback = JS_DupValue(ctx, argv[1]);
+
+  if(JS_IsException((obj = JS_NewObjectProtoClass(ctx, directory_watch_proto, js_directory_watch_class_id)))) {
+    directory_watch_close(JS_GetRuntime(ctx), dw);
+    js_free(ctx, dw);
+    goto end;
+  }
+
+  JS_SetOpaque(obj, dw);
+
+  if(directory_watch_handlers(ctx, dw, obj)) {
+    JS_FreeValue(ctx, obj);
+    obj = JS_EXCEPTION;
+  }
+
+end:
+  if(exclude)
+    js_strv_free(ctx, exclude);
+
+  js_free(ctx, root);
+  return obj;
+}
+
+static JSValue
+js_directory_watch_close(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  DirectoryWatch* dw;
+
+  if(!(dw = JS_GetOpaque2(ctx, this_val, js_directory_watch_class_id)))
+    return JS_EXCEPTION;
+
+  if(dw->watch) {
+    directory_watch_handlers(ctx, dw, JS_NULL);
+    directory_watch_close(JS_GetRuntime(ctx), dw);
+  }
+
+  return JS_UNDEFINED;
+}
+
+static JSValue
+js_directory_watch_count(JSContext* ctx, JSValueConst this_val) {
+  DirectoryWatch* dw;
+
+  if(!(dw = JS_GetOpaque2(ctx, this_val, js_directory_watch_class_id)))
+    return JS_EXCEPTION;
+
+  return JS_NewInt64(ctx, dw->watch ? dir_watch_count(dw->watch) : 0);
+}
+
+static void
+js_directory_watch_finalizer(JSRuntime* rt, JSValue val) {
+  DirectoryWatch* dw;
+
+  if((dw = JS_GetOpaque(val, js_directory_watch_class_id))) {
+    directory_watch_close(rt, dw);
+    js_free_rt(rt, dw);
+  }
+}
+#endif
+
 static void
 js_directory_finalizer(JSRuntime* rt, JSValue val) {
   Directory* directory;
@@ -284,6 +775,38 @@ static const JSCFunctionListEntry js_directory_funcs[] = {
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "Directory", JS_PROP_CONFIGURABLE),
 };
 
+static JSClassDef js_directory_walk_class = {
+    .class_name = "DirectoryWalk",
+    .finalizer = js_directory_walk_finalizer,
+};
+
+static const JSCFunctionListEntry js_directory_walk_funcs[] = {
+    JS_CFUNC_DEF("next", 0, js_directory_walk_next),
+    JS_CFUNC_DEF("return", 0, js_directory_walk_return),
+    JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, js_directory_walk_self),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "DirectoryWalk", JS_PROP_CONFIGURABLE),
+};
+
+#ifdef HAVE_INOTIFY
+static JSClassDef js_directory_watch_class = {
+    .class_name = "DirectoryWatch",
+    .finalizer = js_directory_watch_finalizer,
+};
+
+static const JSCFunctionListEntry js_directory_watch_funcs[] = {
+    JS_CFUNC_DEF("close", 0, js_directory_watch_close),
+    JS_CGETSET_DEF("watches", js_directory_watch_count, 0),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "DirectoryWatch", JS_PROP_CONFIGURABLE),
+};
+#endif
+
+static const JSCFunctionListEntry js_directory_module_funcs[] = {
+    JS_CFUNC_DEF("walk", 1, js_directory_walk),
+#ifdef HAVE_INOTIFY
+    JS_CFUNC_DEF("watch", 2, js_directory_watch),
+#endif
+};
+
 static const JSCFunctionListEntry js_directory_static[] = {
     JS_PROP_INT32_DEF("NAME", FLAG_NAME, JS_PROP_ENUMERABLE),
     JS_PROP_INT32_DEF("TYPE", FLAG_TYPE, JS_PROP_ENUMERABLE),
@@ -316,9 +839,26 @@ js_directory_init(JSContext* ctx, JSModuleDef* m) {
   JS_SetClassProto(ctx, js_directory_class_id, directory_proto);
   JS_SetConstructor(ctx, directory_ctor, directory_proto);
 
+  JS_NewClassID(&js_directory_walk_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_directory_walk_class_id, &js_directory_walk_class);
+
+  directory_walk_proto = JS_NewObject(ctx);
+  JS_SetPropertyFunctionList(ctx, directory_walk_proto, js_directory_walk_funcs, countof(js_directory_walk_funcs));
+  JS_SetClassProto(ctx, js_directory_walk_class_id, directory_walk_proto);
+
+#ifdef HAVE_INOTIFY
+  JS_NewClassID(&js_directory_watch_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_directory_watch_class_id, &js_directory_watch_class);
+
+  directory_watch_proto = JS_NewObject(ctx);
+  JS_SetPropertyFunctionList(ctx, directory_watch_proto, js_directory_watch_funcs, countof(js_directory_watch_funcs));
+  JS_SetClassProto(ctx, js_directory_watch_class_id, directory_watch_proto);
+#endif
+
   if(m) {
     JS_SetModuleExport(ctx, m, "Directory", directory_ctor);
     JS_SetModuleExportList(ctx, m, js_directory_static, countof(js_directory_static));
+    JS_SetModuleExportList(ctx, m, js_directory_module_funcs, countof(js_directory_module_funcs));
 
     const char* module_name = module_namecstr(ctx, m);
 
@@ -344,6 +884,7 @@ JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
   if((m = JS_NewCModule(ctx, module_name, js_directory_init))) {
     JS_AddModuleExport(ctx, m, "Directory");
     JS_AddModuleExportList(ctx, m, js_directory_static, countof(js_directory_static));
+    JS_AddModuleExportList(ctx, m, js_directory_module_funcs, countof(js_directory_module_funcs));
   }
 
   return m;
@@ -11,7 +11,7 @@
  */
 
 VISIBLE JSClassID js_gpio_class_id = 0;
-static JSValue gpio_proto, gpio_ctor;
+static thread_local JSValue gpio_proto, gpio_ctor;
 
 enum {
   GPIO_METHOD_INIT_PIN = 0,
@@ -538,6 +538,20 @@ js_sab_dup(void* opaque, void* ptr) {
   atomic_add_int(&sab->ref_count, 1);
 }
 
+/**
+ * @brief Allocate the SharedArrayBuffers of \param rt with js_sab_alloc(), unless it already has SAB functions
+ *
+ * quickjs-libc's use the same header, either can be shared between threads
+ * with js_sab_dup() and js_sab_free().
+ */
+void
+js_sab_init(JSRuntime* rt) {
+  static const JSSharedArrayBufferFunctions sab_funcs = {js_sab_alloc, js_sab_free, js_sab_dup, 0};
+
+  if(!rt->sab_funcs.sab_alloc)
+    JS_SetSharedArrayBufferFunctions(rt, &sab_funcs);
+}
+
 JSValueConst
 js_cstring_value(const char* ptr) {
   return JS_MKPTR(JS_TAG_STRING, (JSString*)(void*)(ptr - offsetof(JSString, u)));
@@ -642,6 +656,130 @@ js_stack_get(JSContext* ctx) {
 }
 #endif
 
+static size_t
+js_atom_copy(JSRuntime* rt, JSAtom atom, char* buf, size_t size) {
+  JSAtomStruct* p;
+  size_t i, n;
+
+  /* tagged integer atoms have bit 31 set */
+  if(atom == JS_ATOM_NULL || (atom & (1U << 31)) || atom >= (JSAtom)rt->atom_size || !(p = rt->atom_array[atom]))
+    return 0;
+
+  n = MIN_NUM((size_t)p->len, size);
+
+  for(i = 0; i < n; i++)
+    if(p->is_wide_char)
+      buf[i] = p->u.str16[i] < 0x80 ? p->u.str16[i] : '?';
+    else
+      buf[i] = p->u.str8[i] < 0x80 ? p->u.str8[i] : '?';
+
+  return n;
+}
+
+/**
+ * @brief Write the current JS stack to \param buf as "function (file:line)" frames, outermost first, separated by ';'
+ *
+ * Names are read from the atom table in place, nothing is allocated, so this
+ * can be called from within the allocator.  The line is where the function is
+ * defined.
+ *
+ * @return  length written, not 0-terminated
+ */
+size_t
+js_stack_frames(JSRuntime* rt, char* buf, size_t size, int max_frames) {
+  JSStackFrame *sf, *frames[64];
+  size_t n = 0, pos = 0;
+
+  for(sf = rt->current_stack_frame; sf && n < countof(frames) && (int)n < max_frames; sf = sf->prev_frame)
+    frames[n++] = sf;
+
+  while(n > 0) {
+    JSValueConst func = frames[--n]->cur_func;
+    JSFunctionBytecode* b = 0;
+    char line[16];
+    size_t len;
+
+    if(JS_VALUE_GET_TAG(func) == JS_TAG_OBJECT && JS_VALUE_GET_OBJ(func)->class_id == JS_CLASS_BYTECODE_FUNCTION)
+      b = JS_VALUE_GET_OBJ(func)->u.func.function_bytecode;
+
+    if(pos && pos < size)
+      buf[pos++] = ';';
+
+    if(!b) {
+      len = MIN_NUM(sizeof("<native>") - 1, size - pos);
+      memcpy(&buf[pos], "<native>", len);
+      pos += len;
+      continue;
+    }
+
+    if(!(len = js_atom_copy(rt, b->func_name, &buf[pos], size - pos))) {
+      len = MIN_NUM(sizeof("<anonymous>") - 1, size - pos);
+      memcpy(&buf[pos], "<anonymous>", len);
+    }
+
+    pos += len;
+
+    if(b->has_debug && pos + 2 < size) {
+      buf[pos++] = ' ';
+      buf[pos++] = '(';
+      pos += js_atom_copy(rt, b->debug.filename, &buf[pos], size - pos);
+      len = snprintf(line, sizeof(line), ":%d)", b->debug.line_num);
+      len = MIN_NUM(len, size - pos);
+      memcpy(&buf[pos], line, len);
+      pos += len;
+    }
+  }
+
+  return pos;
+}
+
+/**
+ * @brief Number of jobs (promise reactions, module evaluation steps) queued on \param rt
+ */
+size_t
+js_pending_jobs(JSRuntime* rt) {
+  struct list_head* el;
+  size_t n = 0;
+
+  list_for_each(el, &rt->job_list) n++;
+
+  return n;
+}
+
+/**
+ * @brief Bytes currently allocated by \param rt, the figure the GC threshold is compared to
+ */
+size_t
+js_malloc_size(JSRuntime* rt) {
+  return rt->malloc_state.malloc_size;
+}
+
+/**
+ * @brief Size at which \param rt runs its next automatic GC, moved past the live size after each one
+ */
+size_t
+js_gc_threshold(JSRuntime* rt) {
+  return rt->malloc_gc_threshold;
+}
+
+/**
+ * @brief The function releasing the memory of the ArrayBuffer \param value, tells who allocated it
+ */
+JSFreeArrayBufferDataFunc*
+js_arraybuffer_free_func(JSValueConst value) {
+  JSObject* p;
+
+  if(JS_VALUE_GET_TAG(value) != JS_TAG_OBJECT)
+    return 0;
+
+  p = JS_VALUE_GET_OBJ(value);
+
+  if(p->class_id != JS_CLASS_ARRAY_BUFFER && p->class_id != JS_CLASS_SHARED_ARRAY_BUFFER)
+    return 0;
+
+  return p->u.array_buffer->free_func;
+}
+
 const JSOpCode js_opcodes[/*OP_COUNT + (OP_TEMP_END - OP_TEMP_START)*/] = {
 //#define FMT(f)
 #define def(id, size, n_pop, n_push, f)
@@ -3,7 +3,7 @@
 #include "json.h"
 
 VISIBLE JSClassID js_json_parser_class_id = 0;
-static JSValue json_parser_proto, json_parser_ctor;
+static thread_local JSValue json_parser_proto, json_parser_ctor;
 
 struct js_json_parser_opaque {
   JSContext* ctx;
@@ -22,8 +22,8 @@ typedef struct {
 } JSLexerRule;
 
 VISIBLE JSClassID js_token_class_id = 0, js_lexer_class_id = 0;
-static JSValue token_proto, token_ctor;
-static JSValue lexer_proto, lexer_ctor;
+static thread_local JSValue token_proto, token_ctor;
+static thread_local JSValue lexer_proto, lexer_ctor;
 
 static JSValue
 offsetlength_toarray(OffsetLength offs_len, JSContext* ctx) {
@@ -21,6 +21,21 @@ typedef union Node {
   };
 } Node;
 
+/**
+ * Position index over the nodes of a List.
+ *
+ * nodes[offset + i] is the node at position i for every i < valid.  The
+ * prefix is extended on demand by list_at() and kept up to date by pushes
+ * and shifts at either end, so queue/deque usage stays O(1) and positional
+ * access is O(1) amortized.  Insertions and removals in the middle only drop
+ * the cached prefix, they never touch the nodes themselves.
+ */
+typedef struct {
+  union Node** nodes;
+  size_t offset, valid, capacity;
+  BOOL disabled;
+} ListIndex;
+
 typedef union {
   Node node;
   struct list_head header;
@@ -29,9 +44,13 @@ typedef union {
     int ref_count;
     JSValue _dummy;
     size_t size;
+    ListIndex index;
   };
 } List;
 
+/* Lists shorter than this are walked instead of indexed */
+#define LIST_INDEX_MIN 16
+
 typedef enum {
   NORMAL = 0,
   REVERSE = 1,
@@ -57,7 +76,7 @@ static JSValue js_node_wrap(JSContext*, JSValueConst, Node*);
 static JSValue js_list_wrap(JSContext*, JSValueConst, List*);
 
 VISIBLE JSClassID js_list_class_id = 0, js_list_iterator_class_id = 0, js_node_class_id = 0;
-static JSValue list_proto, list_ctor, list_iterator_proto, list_iterator_ctor, node_proto, node_ctor;
+static thread_local JSValue list_proto, list_ctor, list_iterator_proto, list_iterator_ctor, node_proto, node_ctor;
 
 static inline List*
 js_list_data2(JSContext* ctx, JSValueConst value) {
@@ -186,11 +205,110 @@ list_new(JSContext* ctx) {
     list->ref_count = 1;
     list->size = 0;
     list->_dummy = JS_UNINITIALIZED;
+    memset(&list->index, 0, sizeof(ListIndex));
   }
 
   return list;
 }
 
+/**
+ * @brief Make room for \param front entries before and \param count entries from the current offset
+ */
+static BOOL
+list_index_reserve(List* list, size_t front, size_t count, JSContext* ctx) {
+  ListIndex* idx = &list->index;
+  size_t need = front + count, cap = idx->capacity, offset;
+
+  if(idx->offset >= front && idx->offset + count <= cap)
+    return TRUE;
+
+  if(cap < need + (need >> 2)) {
+    Node** nodes;
+
+    for(cap = MAX_NUM(cap, LIST_INDEX_MIN); cap < need + (need >> 2);)
+      cap <<= 1;
+
+    if(!(nodes = js_realloc(ctx, idx->nodes, cap * sizeof(Node*))))
+      return FALSE;
+
+    idx->nodes = nodes;
+    idx->capacity = cap;
+  }
+
+  /* leave some slack in front for unshift(), most of it at the back for push() */
+  offset = front + ((cap - need) >> 2);
+
+  if(idx->valid)
+    memmove(idx->nodes + offset, idx->nodes + idx->offset, idx->valid * sizeof(Node*));
+
+  idx->offset = offset;
+  return TRUE;
+}
+
+static inline void
+list_index_invalidate(List* list) {
+  list->index.valid = 0;
+}
+
+static void
+list_index_free(List* list, JSRuntime* rt) {
+  ListIndex* idx = &list->index;
+
+  if(idx->nodes)
+    js_free_rt(rt, idx->nodes);
+
+  idx->nodes = NULL;
+  idx->offset = idx->valid = idx->capacity = 0;
+}
+
+/**
+ * @brief Update the index after \param node has been linked into \param list
+ */
+static void
+list_index_insert(List* list, Node* node, JSContext* ctx) {
+  ListIndex* idx = &list->index;
+
+  if(!idx->nodes)
+    return;
+
+  if(node->prev == &list->node) {
+    if(idx->valid) {
+      if(list_index_reserve(list, 1, idx->valid, ctx)) {
+        idx->nodes[--idx->offset] = node;
+        ++idx->valid;
+      } else {
+        list_index_invalidate(list);
+      }
+    }
+  } else if(node->next == &list->node) {
+    if(idx->valid + 1 == list->size && list_index_reserve(list, 0, idx->valid + 1, ctx))
+      idx->nodes[idx->offset + idx->valid++] = node;
+  } else {
+    list_index_invalidate(list);
+  }
+}
+
+/**
+ * @brief Update the index before \param node is unlinked from \param list
+ */
+static void
+list_index_erase(List* list, Node* node) {
+  ListIndex* idx = &list->index;
+
+  if(!idx->valid)
+    return;
+
+  if(node->prev == &list->node) {
+    ++idx->offset;
+    --idx->valid;
+  } else if(node->next == &list->node) {
+    if(idx->valid == list->size)
+      --idx->valid;
+  } else {
+    list_index_invalidate(list);
+  }
+}
+
 /**
  * @brief Insert a new node after \param prev or at the head
  */
@@ -202,6 +320,7 @@ list_insert(List* list, JSValueConst value, Node* prev, JSContext* ctx) {
     list_add(&node->link, prev ? &prev->link : &list->header);
 
     ++list->size;
+    list_index_insert(list, node, ctx);
   }
 
   return node;
@@ -218,6 +337,7 @@ list_insert_before(List* list, JSValueConst value, Node* next, JSContext* ctx) {
     list_add_tail(&node->link, next ? &next->link : &list->header);
 
     ++list->size;
+    list_index_insert(list, node, ctx);
   }
 
   return node;
@@ -228,6 +348,7 @@ list_insert_before(List* list, JSValueConst value, Node* next, JSContext* ctx) {
  */
 static void
 list_erase(List* list, Node* node, JSContext* ctx) {
+  list_index_erase(list, node);
   list_del(&node->link);
   --list->size;
 
@@ -253,14 +374,36 @@ list_has(List* list, int64_t index) {
   return index >= -size && index < size;
 }
 
+/**
+ * @brief Return the node at position \param index (negative counts from the tail)
+ *
+ * Positions inside the indexed prefix are looked up directly.  Otherwise the
+ * prefix is extended up to \param index, unless walking from the tail is
+ * shorter, so no lookup costs more than the plain walk from the nearer end.
+ */
 static Node*
-list_at(List* list, int64_t index) {
+list_at(List* list, int64_t index, JSContext* ctx) {
+  ListIndex* idx = &list->index;
+
   index = WRAP_NUM(index, (int64_t)list->size);
 
   if(index < (int64_t)list->size && index >= 0) {
     struct list_head* ptr;
     int64_t from_back = (list->size - 1) - index;
 
+    if((size_t)index < idx->valid)
+      return idx->nodes[idx->offset + index];
+
+    if(!idx->disabled && list->size >= LIST_INDEX_MIN && from_back >= index - (int64_t)idx->valid &&
+       list_index_reserve(list, 0, index + 1, ctx)) {
+      Node* node = idx->valid ? idx->nodes[idx->offset + idx->valid - 1]->next : list->head;
+
+      for(; idx->valid <= (size_t)index; node = node->next)
+        idx->nodes[idx->offset + idx->valid++] = node;
+
+      return idx->nodes[idx->offset + index];
+    }
+
     if(from_back < index)
       list_for_each_prev(ptr, &list->header) {
         if(from_back-- == 0)
@@ -284,6 +427,8 @@ list_clear(List* list, JSRuntime* rt) {
 
   init_list_head(&list->header);
   list->size = 0;
+
+  list_index_free(list, rt);
 }
 
 static void
@@ -388,9 +533,229 @@ list_sort_cmp(struct list_head* a, struct list_head* b, void* opaque) {
 static void
 list_sort(List* list, JSValueConst pred, JSContext* ctx) {
   SortClosure sc = {ctx, pred};
+
+  list_index_invalidate(list);
   __list_sort(&list->header, list_sort_cmp, &sc);
 }
 
+typedef enum {
+  SORT_AUTO = 0,
+  SORT_NUMBER,
+  SORT_STRING,
+} SortType;
+
+typedef struct {
+  union {
+    double num;
+    struct {
+      const char* str;
+      size_t len;
+    };
+  };
+  BOOL last; /* NaN or undefined key, placed after all others in either direction */
+  Node* node;
+} SortEntry;
+
+/* Runs of this length are insertion sorted before merging */
+#define SORT_RUN 16
+
+static SortType
+sort_type(const char* name) {
+  if(!strcmp(name, "auto"))
+    return SORT_AUTO;
+  if(!strcmp(name, "number"))
+    return SORT_NUMBER;
+  if(!strcmp(name, "string"))
+    return SORT_STRING;
+
+  return -1;
+}
+
+/**
+ * @brief Compare two sort keys in direction \param dir, numbers numerically, strings bytewise
+ * (code point order), NaN and undefined keys last regardless of \param dir
+ */
+static inline int
+sort_entry_cmp(const SortEntry* a, const SortEntry* b, SortType type, int dir) {
+  if(a->last || b->last)
+    return a->last - b->last;
+
+  if(type == SORT_NUMBER)
+    return ((a->num > b->num) - (a->num < b->num)) * dir;
+
+  int r = memcmp(a->str, b->str, MIN_NUM(a->len, b->len));
+
+  return (r ? (r > 0) - (r < 0) : (a->len > b->len) - (a->len < b->len)) * dir;
+}
+
+/**
+ * @brief Stable bottom-up merge sort of \param n entries, using \param tmp as scratch space
+ */
+static void
+sort_entries(SortEntry* entries, SortEntry* tmp, size_t n, SortType type, int dir) {
+  SortEntry *src = entries, *dst = tmp, *swap;
+
+  for(size_t i = 0; i < n; i += SORT_RUN) {
+    size_t end = MIN_NUM(i + SORT_RUN, n);
+
+    for(size_t j = i + 1; j < end; j++) {
+      SortEntry e = src[j];
+      size_t k = j;
+
+      for(; k > i && sort_entry_cmp(&src[k - 1], &e, type, dir) > 0; --k)
+        src[k] = src[k - 1];
+
+      src[k] = e;
+    }
+  }
+
+  for(size_t width = SORT_RUN; width < n; width <<= 1) {
+    for(size_t i = 0; i < n; i += 2 * width) {
+      size_t mid = MIN_NUM(i + width, n), end = MIN_NUM(i + 2 * width, n), l = i, r = mid, o = i;
+
+      /* already in order: copy the pair of runs as a whole */
+      if(mid >= end || sort_entry_cmp(&src[mid - 1], &src[mid], type, dir) <= 0) {
+        memcpy(dst + i, src + i, (end - i) * sizeof(SortEntry));
+        continue;
+      }
+
+      while(l < mid && r < end)
+        dst[o++] = sort_entry_cmp(&src[r], &src[l], type, dir) < 0 ? src[r++] : src[l++];
+
+      memcpy(dst + o, src + l, (mid - l) * sizeof(SortEntry));
+      o += mid - l;
+      memcpy(dst + o, src + r, (end - r) * sizeof(SortEntry));
+    }
+
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  if(src != entries)
+    memcpy(entries, src, n * sizeof(SortEntry));
+}
+
+/**
+ * @brief Sort \param list by keys computed once per node
+ *
+ * The key is the node value, the property \param key of it, or the return
+ * value of \param key when it is a function.  Keys are converted to numbers
+ * or strings (SORT_AUTO picks numbers when all defined keys are numbers), then
+ * the (key, node) pairs are merge sorted natively and the nodes relinked in
+ * order.  Undefined and NaN keys keep their relative order at the end.
+ *
+ * @return 0 on success, -1 on exception (the list is left unchanged)
+ */
+static int
+list_sort_keys(List* list, JSValueConst list_obj, JSValueConst key, SortType type, int dir, JSContext* ctx) {
+  size_t i = 0, n = list->size, converted = 0;
+  SortEntry* entries;
+  JSValue* keys;
+  JSAtom prop = JS_ATOM_NULL;
+  struct list_head* ptr;
+  int ret = -1;
+
+  if(n < 2)
+    return 0;
+
+  if(!(entries = js_mallocz(ctx, 2 * n * sizeof(SortEntry))))
+    return -1;
+
+  if(!(keys = js_mallocz(ctx, n * sizeof(JSValue)))) {
+    js_free(ctx, entries);
+    return -1;
+  }
+
+  if(!JS_IsUndefined(key) && !JS_IsFunction(ctx, key) && (prop = JS_ValueToAtom(ctx, key)) == JS_ATOM_NULL)
+    goto fail;
+
+  list_for_each(ptr, &list->header) entries[i++].node = node_dup(list_entry(ptr, Node, link));
+
+  for(i = 0; i < n; i++) {
+    Node* node = entries[i].node;
+
+    if(JS_IsFunction(ctx, key))
+      keys[i] = node_call(node, key, list_obj, i, ctx);
+    else if(prop != JS_ATOM_NULL)
+      keys[i] = JS_GetProperty(ctx, node->value, prop);
+    else
+      keys[i] = JS_DupValue(ctx, node->value);
+
+    if(JS_IsException(keys[i]))
+      goto fail;
+  }
+
+  if(type == SORT_AUTO) {
+    type = SORT_NUMBER;
+
+    for(i = 0; i < n; i++)
+      if(!JS_IsNumber(keys[i]) && !JS_IsUndefined(keys[i])) {
+        type = SORT_STRING;
+        break;
+      }
+  }
+
+  for(converted = 0; converted < n; converted++) {
+    SortEntry* e = &entries[converted];
+
+    if((e->last = JS_IsUndefined(keys[converted])))
+      continue;
+
+    if(type == SORT_NUMBER ? JS_ToFloat64(ctx, &e->num, keys[converted]) != 0
+                           : !(e->str = JS_ToCStringLen(ctx, &e->len, keys[converted])))
+      goto fail;
+
+    if(type == SORT_NUMBER)
+      e->last = isnan(e->num);
+  }
+
+  /* a key function, valueOf() or toString() might have modified the list */
+  i = 0;
+
+  list_for_each(ptr, &list->header) {
+    if(i == n || entries[i].node != list_entry(ptr, Node, link))
+      break;
+
+    ++i;
+  }
+
+  if(i != n || list->size != n) {
+    JS_ThrowInternalError(ctx, "List modified during sort");
+    goto fail;
+  }
+
+  sort_entries(entries, entries + n, n, type, dir);
+
+  init_list_head(&list->header);
+
+  for(i = 0; i < n; i++)
+    list_add_tail(&entries[i].node->link, &list->header);
+
+  list_index_invalidate(list);
+  ret = 0;
+
+fail:
+  if(type == SORT_STRING)
+    for(i = 0; i < converted; i++)
+      if(entries[i].str)
+        JS_FreeCString(ctx, entries[i].str);
+
+  for(i = 0; i < n; i++) {
+    JS_FreeValue(ctx, keys[i]);
+
+    if(entries[i].node)
+      node_free(entries[i].node, ctx);
+  }
+
+  if(prop != JS_ATOM_NULL)
+    JS_FreeAtom(ctx, prop);
+
+  js_free(ctx, keys);
+  js_free(ctx, entries);
+  return ret;
+}
+
 static ListIterator*
 list_iterator_new(Node* node, Node* header, IteratorType type, JSContext* ctx) {
   ListIterator* iter;
@@ -806,7 +1171,7 @@ js_list_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst arg
         ret = js_list_iterator_new(ctx, tmp->next, &list->node, REVERSE);
       } else {
         tmp = node->next;
-        for(int i = argc - 1; i >= 1; i++)
+        for(int i = argc - 1; i >= 1; i--)
           list_insert(list, argv[i], node, ctx);
 
         ret = js_list_iterator_new(ctx, tmp->prev, &list->node, NORMAL);
@@ -890,7 +1255,6 @@ enum {
   LIST_REDUCE,
   LIST_REDUCE_RIGHT,
   LIST_SOME,
-  LIST_SORT,
 };
 
 static JSValue
@@ -935,15 +1299,17 @@ js_list_method2(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst ar
 
       break;
     }
-    /*case LIST_AT: {
-      if((index = js_toindex_name(ctx, argv[0], list->size, "argument 1")) == -1)
+    case LIST_AT: {
+      Node* node;
+
+      if(JS_ToInt64Ext(ctx, &index, argv[0]))
         return JS_EXCEPTION;
 
-      if((node = list_at(list, index)))
+      if((node = list_at(list, index, ctx)))
         ret = JS_DupValue(ctx, node->value);
 
       break;
-    }*/
+    }
     case LIST_INCLUDES: {
       Node *n1, *n2;
       BOOL result = FALSE;
@@ -1034,11 +1400,15 @@ js_list_method2(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst ar
       if(!(other = list_new(ctx)))
         return JS_EXCEPTION;
 
-      struct list_head removed = list_unlink(&start->link, &end->link);
+      /* an empty range only inserts */
+      if(start != end) {
+        struct list_head removed = list_unlink(&start->link, &end->link);
 
-      list_splice(&removed, &other->header);
+        list_splice(&removed, &other->header);
+      }
 
       list->size -= other->size = list_size(&other->header);
+      list_index_invalidate(list);
 
       for(int i = 2; i < argc; i++)
         list_insert_before(list, argv[i], end, ctx);
@@ -1078,12 +1448,14 @@ js_list_method2(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst ar
 
       list_del(&list->header);
       __list_add(&list->header, node->link.prev, &node->link);
+      list_index_invalidate(list);
 
       ret = JS_DupValue(ctx, this_val);
       break;
     }
     case LIST_REVERSE: {
       __list_reverse(&list->header);
+      list_index_invalidate(list);
 
       ret = JS_DupValue(ctx, this_val);
       break;
@@ -1299,25 +1671,76 @@ js_list_functional(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst
 
       break;
     }
-    case LIST_SORT: {
-      JSValue pred =
-          argc > 0 ? JS_DupValue(ctx, argv[0]) : JS_Eval(ctx, "(a, b) => a - b", sizeof("(a, b) => a - b") - 1, "-", 0);
+  }
 
-      list_sort(list, pred, ctx);
+  JS_FreeValue(ctx, pred);
+  return ret;
+}
 
-      JS_FreeValue(ctx, pred);
-      ret = JS_DupValue(ctx, this_val);
-      break;
+/**
+ * sort()           sorts values numerically, like sort((a, b) => a - b)
+ * sort(compareFn)  calls compareFn(a, b) for every comparison
+ * sort(type)       sorts values natively, type is 'auto', 'number' or 'string'
+ * sort({ key, type, descending })
+ *                  key is a property name or a function (value, index, list)
+ *                  evaluated once per node, type defaults to 'number'
+ */
+static JSValue
+js_list_sort(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  List* list;
+  JSValue key = JS_UNDEFINED;
+  SortType type = SORT_NUMBER;
+  int dir = 1, ret;
+
+  if(!(list = js_list_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(argc > 0 && JS_IsFunction(ctx, argv[0])) {
+    list_sort(list, argv[0], ctx);
+    return JS_DupValue(ctx, this_val);
+  }
+
+  if(argc > 0 && (JS_IsString(argv[0]) || JS_IsObject(argv[0]))) {
+    const char* name;
+
+    if(JS_IsString(argv[0])) {
+      name = JS_ToCString(ctx, argv[0]);
+    } else {
+      if(JS_IsException((key = JS_GetPropertyStr(ctx, argv[0], "key"))))
+        return JS_EXCEPTION;
+
+      dir = js_get_propertystr_bool(ctx, argv[0], "descending") ? -1 : 1;
+      name = js_get_propertystr_cstring(ctx, argv[0], "type");
+    }
+
+    if(name) {
+      type = sort_type(name);
+      JS_FreeCString(ctx, name);
+
+      if((int)type == -1) {
+        JS_FreeValue(ctx, key);
+        return JS_ThrowRangeError(ctx, "sort type must be one of 'auto', 'number' or 'string'");
+      }
+    }
+
+    if(!JS_IsUndefined(key) && !JS_IsFunction(ctx, key) && !JS_IsString(key) && !JS_IsSymbol(key)) {
+      JS_FreeValue(ctx, key);
+      return JS_ThrowTypeError(ctx, "key must be a function or a property name");
     }
+  } else if(argc > 0 && !JS_IsUndefined(argv[0])) {
+    return JS_ThrowTypeError(ctx, "argument 1 must be a function, a sort type or an object");
   }
 
-  JS_FreeValue(ctx, pred);
-  return ret;
+  ret = list_sort_keys(list, this_val, key, type, dir, ctx);
+  JS_FreeValue(ctx, key);
+
+  return ret == -1 ? JS_EXCEPTION : JS_DupValue(ctx, this_val);
 }
 
 enum {
   LIST_LENGTH,
   LIST_ADDRESS,
+  LIST_INDEXED,
 };
 
 static JSValue
@@ -1340,11 +1763,35 @@ js_list_get(JSContext* ctx, JSValueConst this_val, int magic) {
       ret = JS_NewString(ctx, buf);
       break;
     }
+    case LIST_INDEXED: {
+      ret = JS_NewBool(ctx, !list->index.disabled);
+      break;
+    }
   }
 
   return ret;
 }
 
+static JSValue
+js_list_set(JSContext* ctx, JSValueConst this_val, JSValueConst value, int magic) {
+  List* list;
+
+  if(!(list = js_list_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case LIST_INDEXED: {
+      if(!(list->index.disabled = !JS_ToBool(ctx, value)))
+        break;
+
+      list_index_free(list, JS_GetRuntime(ctx));
+      break;
+    }
+  }
+
+  return JS_UNDEFINED;
+}
+
 static JSValue
 js_list_iterator(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
   List* list;
@@ -1424,7 +1871,7 @@ js_list_get_own_property(JSContext* ctx, JSPropertyDescriptor* pdesc, JSValueCon
   if(js_atom_is_index(ctx, &index, prop)) {
     Node* node;
 
-    if((node = list_at(list, index))) {
+    if((node = list_at(list, index, ctx))) {
       if(pdesc) {
         pdesc->flags = JS_PROP_ENUMERABLE;
         pdesc->value = JS_DupValue(ctx, node->value);
@@ -1476,7 +1923,7 @@ js_list_set_property(
 
       list_insert(list, value, NULL, ctx);
     } else {
-      Node* node = list_at(list, index);
+      Node* node = list_at(list, index, ctx);
 
       JS_FreeValue(ctx, node->value);
       node->value = JS_DupValue(ctx, value);
@@ -1543,13 +1990,14 @@ static const JSCFunctionListEntry js_list_methods[] = {
     JS_CFUNC_MAGIC_DEF("map", 1, js_list_functional, LIST_MAP),
     JS_CFUNC_MAGIC_DEF("reduce", 1, js_list_functional, LIST_REDUCE),
     JS_CFUNC_MAGIC_DEF("reduceRight", 1, js_list_functional, LIST_REDUCE_RIGHT),
-    JS_CFUNC_MAGIC_DEF("sort", 0, js_list_functional, LIST_SORT),
+    JS_CFUNC_DEF("sort", 0, js_list_sort),
     JS_CFUNC_MAGIC_DEF("values", 0, js_list_iterator, YIELD_VALUE),
     JS_CFUNC_MAGIC_DEF("keys", 0, js_list_iterator, YIELD_KEY),
     JS_CFUNC_MAGIC_DEF("entries", 0, js_list_iterator, YIELD_KEY_AND_VALUE),
     JS_ALIAS_DEF("[Symbol.iterator]", "values"),
     JS_CGETSET_MAGIC_FLAGS_DEF("length", js_list_get, 0, LIST_LENGTH, JS_PROP_ENUMERABLE),
     JS_CGETSET_MAGIC_DEF("address", js_list_get, 0, LIST_ADDRESS),
+    JS_CGETSET_MAGIC_DEF("indexed", js_list_get, js_list_set, LIST_INDEXED),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "List", JS_PROP_CONFIGURABLE),
 };
 
@@ -10,7 +10,7 @@
  */
 
 VISIBLE JSClassID js_location_class_id = 0;
-static JSValue location_proto, location_ctor;
+static thread_local JSValue location_proto, location_ctor;
 
 enum {
   LOCATION_PROP_LINE,
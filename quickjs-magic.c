@@ -10,7 +10,7 @@
  * @{
  */
 VISIBLE JSClassID js_magic_class_id = 0;
-static JSValue magic_proto, magic_ctor;
+static thread_local JSValue magic_proto, magic_ctor;
 
 enum {
   LIBMAGIC_ERROR = 0,
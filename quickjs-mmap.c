@@ -1,12 +1,20 @@
+#define _GNU_SOURCE 1
 #include "defines.h"
 #include <cutils.h>
 #include <quickjs.h>
 #include "utils.h"
+#include "quickjs-syscallerror.h"
+#include "stream-utils.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
 #ifdef _WIN32
 #include "mmap-win32.h"
+#include <io.h>
 #else
 #include <sys/mman.h>
 #include <errno.h>
+#include <unistd.h>
 #endif
 
 /**
@@ -153,8 +161,644 @@ js_mmap_tostring(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst a
   return JS_ThrowTypeError(ctx, "Argument is not an ArrayBuffer");
 }
 
+static const char* const mmap_advice_names[] = {
+    "normal",
+    "random",
+    "sequential",
+    "willneed",
+    "dontneed",
+    0,
+};
+
+#ifdef HAVE_MADVISE
+static const int mmap_advice_values[] = {
+    MADV_NORMAL,
+    MADV_RANDOM,
+    MADV_SEQUENTIAL,
+    MADV_WILLNEED,
+    MADV_DONTNEED,
+};
+#endif
+
+/* accepts one of the MADV_* constants or its name without prefix */
+static int
+js_mmap_advice(JSContext* ctx, JSValueConst value) {
+  int32_t advice = -1;
+
+  if(JS_IsString(value)) {
+    const char* str;
+
+    if(!(str = JS_ToCString(ctx, value)))
+      return -1;
+
+    for(int i = 0; mmap_advice_names[i]; i++)
+      if(!strcasecmp(str, mmap_advice_names[i])) {
+#ifdef HAVE_MADVISE
+        advice = mmap_advice_values[i];
+#else
+        advice = i;
+#endif
+        break;
+      }
+
+    JS_FreeCString(ctx, str);
+  } else if(JS_IsNumber(value)) {
+    JS_ToInt32(ctx, &advice, value);
+  }
+
+  if(advice < 0)
+    JS_ThrowRangeError(ctx, "invalid advice");
+
+  return advice;
+}
+
+static int
+mmap_advise(void* ptr, size_t len, int advice) {
+#ifdef HAVE_MADVISE
+  uintptr_t page = sysconf(_SC_PAGESIZE), start = (uintptr_t)ptr, end = start + len;
+
+  /*
+   * madvise() wants a page aligned start address.  MADV_DONTNEED discards
+   * whole pages, so it is limited to the pages inside the range, other
+   * advice may as well cover the partial pages at the edges.
+   */
+  if(advice == MADV_DONTNEED) {
+    start = (start + page - 1) & ~(page - 1);
+    end &= ~(page - 1);
+
+    if(end <= start)
+      return 0;
+  } else {
+    start &= ~(page - 1);
+  }
+
+  return madvise((void*)start, end - start, advice);
+#else
+  return 0;
+#endif
+}
+
+/**
+ * mapFile(path, { mode, populate, hugepages, advise })
+ *
+ * mode is 'r' (read-only file), 'r+' (read-write, shared) or 'c'
+ * (copy-on-write).  As an ArrayBuffer is always writable, 'r' maps the file
+ * copy-on-write too: stores only change this process' copy instead of
+ * faulting on a read-only page.  populate pre-faults the whole mapping, hugepages asks
+ * for transparent huge pages and advise is applied to the whole range.
+ */
+static JSValue
+js_mmap_mapfile(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  const char *path, *mode = 0;
+  int fd, prot = PROT_READ | PROT_WRITE, flags = MAP_PRIVATE, oflags = O_RDONLY, advice = -1;
+  BOOL populate = FALSE, hugepages = FALSE;
+  struct stat st;
+  void* ptr;
+  size_t length;
+
+  if(argc > 1 && JS_IsObject(argv[1])) {
+    JSValue adv;
+
+    mode = js_get_propertystr_cstring(ctx, argv[1], "mode");
+    populate = js_get_propertystr_bool(ctx, argv[1], "populate");
+    hugepages = js_get_propertystr_bool(ctx, argv[1], "hugepages");
+
+    if(!js_is_null_or_undefined((adv = JS_GetPropertyStr(ctx, argv[1], "advise"))))
+      if((advice = js_mmap_advice(ctx, adv)) < 0) {
+        JS_FreeValue(ctx, adv);
+
+        if(mode)
+          JS_FreeCString(ctx, mode);
+
+        return JS_EXCEPTION;
+      }
+
+    JS_FreeValue(ctx, adv);
+  }
+
+  if(mode) {
+    if(!strcmp(mode, "r+")) {
+      flags = MAP_SHARED;
+      oflags = O_RDWR;
+    } else if(strcmp(mode, "r") && strcmp(mode, "c")) {
+      JS_FreeCString(ctx, mode);
+      return JS_ThrowRangeError(ctx, "mode must be one of 'r', 'r+' or 'c'");
+    }
+
+    JS_FreeCString(ctx, mode);
+  }
+
+#ifdef MAP_POPULATE
+  if(populate)
+    flags |= MAP_POPULATE;
+#endif
+
+  if(!(path = JS_ToCString(ctx, argv[0])))
+    return JS_EXCEPTION;
+
+  fd = open(path, oflags);
+  JS_FreeCString(ctx, path);
+
+  if(fd == -1)
+    return js_syscallerror_throw(ctx, "open");
+
+  if(fstat(fd, &st) == -1) {
+    close(fd);
+    return js_syscallerror_throw(ctx, "fstat");
+  }
+
+  if((length = st.st_size) == 0) {
+    close(fd);
+    return JS_NewArrayBufferCopy(ctx, 0, 0);
+  }
+
+#if defined(HAVE_READAHEAD) && !defined(MAP_POPULATE)
+  if(populate)
+    readahead(fd, 0, length);
+#endif
+
+  ptr = mmap(0, length, prot, flags, fd, 0);
+  close(fd);
+
+  if(ptr == MAP_FAILED)
+    return js_syscallerror_throw(ctx, "mmap");
+
+#ifdef MADV_HUGEPAGE
+  if(hugepages)
+    madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+
+  if(advice >= 0)
+    mmap_advise(ptr, length, advice);
+
+#if defined(HAVE_MADVISE) && !defined(MAP_POPULATE)
+  if(populate)
+    madvise(ptr, length, MADV_WILLNEED);
+#endif
+
+  return JS_NewArrayBuffer(ctx, ptr, length, &js_mmap_free_func, (void*)length, !!(flags & MAP_SHARED));
+}
+
+#ifdef HAVE_MMAP
+static void mappedview_free(JSRuntime*, void*, void*);
+#endif
+
+/**
+ * advise(buffer, [offset, length], hint)
+ *
+ * range may be omitted (or null) to cover the whole buffer.
+ */
+static JSValue
+js_mmap_advise(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  uint8_t* data;
+  size_t len;
+  int64_t offset = 0, length;
+  int advice, hint = argc > 2 ? 2 : 1;
+  JSFreeArrayBufferDataFunc* free_func = js_arraybuffer_free_func(argv[0]);
+
+  /* advice on malloc()ed memory could discard the heap around it */
+  if(free_func != &js_mmap_free_func
+#ifdef HAVE_MMAP
+     && free_func != &mappedview_free
+#endif
+  )
+    return JS_ThrowTypeError(ctx, "argument 1 must be an ArrayBuffer returned by mmap() or mapFile()");
+
+  if(!(data = JS_GetArrayBuffer(ctx, &len, argv[0])))
+    return JS_EXCEPTION;
+
+  length = len;
+
+  if(hint == 2 && JS_IsArray(ctx, argv[1])) {
+    JSValue range[2] = {JS_GetPropertyUint32(ctx, argv[1], 0), JS_GetPropertyUint32(ctx, argv[1], 1)};
+
+    if(JS_IsNumber(range[0]))
+      JS_ToInt64Clamp(ctx, &offset, range[0], 0, len, len);
+
+    if(JS_IsNumber(range[1]))
+      JS_ToInt64Clamp(ctx, &length, range[1], 0, len - offset, 0);
+    else
+      length = len - offset;
+
+    JS_FreeValue(ctx, range[0]);
+    JS_FreeValue(ctx, range[1]);
+  }
+
+  if((advice = js_mmap_advice(ctx, argv[hint])) < 0)
+    return JS_EXCEPTION;
+
+  if(length == 0)
+    return JS_NewInt32(ctx, 0);
+
+  if(mmap_advise(data + offset, length, advice) == -1)
+    return js_syscallerror_throw(ctx, "madvise");
+
+  return JS_NewInt32(ctx, 0);
+}
+
+#ifdef HAVE_MMAP
+/**
+ * MappedFile: sliding window over a file, see MappedWindow in stream-utils.
+ *
+ * Views handed out by view()/read() point straight into the mapping, they
+ * are detached as soon as the window moves.
+ */
+typedef struct MappedView {
+  struct MappedView* next;
+  struct MappedFile* mf;
+  void* obj;
+} MappedView;
+
+typedef struct MappedFile {
+  int ref_count;
+  MappedWindow mw;
+  MappedView* views;
+} MappedFile;
+
+enum {
+  MAPPEDFILE_VIEW = 0,
+  MAPPEDFILE_READ,
+  MAPPEDFILE_WRITE,
+  MAPPEDFILE_SEEK,
+  MAPPEDFILE_REFRESH,
+  MAPPEDFILE_CLOSE,
+};
+
+enum {
+  MAPPEDFILE_POSITION = 0,
+  MAPPEDFILE_LENGTH,
+  MAPPEDFILE_START,
+  MAPPEDFILE_SIZE,
+  MAPPEDFILE_WINDOW,
+  MAPPEDFILE_WRITABLE,
+};
+
+VISIBLE JSClassID js_mappedfile_class_id = 0;
+static thread_local JSValue mappedfile_proto, mappedfile_ctor;
+
+static void
+mappedfile_unref(JSRuntime* rt, MappedFile* mf) {
+  if(--mf->ref_count == 0) {
+    mapwindow_free(&mf->mw);
+    js_free_rt(rt, mf);
+  }
+}
+
+static void
+mappedview_free(JSRuntime* rt, void* opaque, void* ptr) {
+  MappedView *mv = opaque, **pp;
+
+  /* called again by the finalizer after a detach */
+  if(ptr == NULL)
+    return;
+
+  if(mv->obj)
+    for(pp = &mv->mf->views; *pp; pp = &(*pp)->next)
+      if(*pp == mv) {
+        *pp = mv->next;
+        break;
+      }
+
+  mappedfile_unref(rt, mv->mf);
+  js_free_rt(rt, mv);
+}
+
+static void
+mappedfile_detach(JSContext* ctx, MappedFile* mf) {
+  MappedView* mv;
+
+  while((mv = mf->views)) {
+    JSValue obj = JS_MKPTR(JS_TAG_OBJECT, mv->obj);
+
+    mf->views = mv->next;
+    mv->obj = 0;
+    JS_DetachArrayBuffer(ctx, obj);
+  }
+}
+
+static uint8_t*
+mappedfile_at(JSContext* ctx, MappedFile* mf, uint64_t pos, size_t need, size_t* avail) {
+  uint8_t* base = mf->mw.base;
+  uint64_t start = mf->mw.start;
+  size_t size = mf->mw.size;
+  uint8_t* ptr = mapwindow_at(&mf->mw, pos, need, avail);
+
+  if(mf->mw.base != base || mf->mw.start != start || mf->mw.size != size)
+    mappedfile_detach(ctx, mf);
+
+  return ptr;
+}
+
+static JSValue
+mappedfile_view(JSContext* ctx, MappedFile* mf, uint8_t* ptr, size_t len) {
+  MappedView* mv;
+  JSValue obj;
+
+  if(!(mv = js_malloc(ctx, sizeof(MappedView))))
+    return JS_EXCEPTION;
+
+  obj = JS_NewArrayBuffer(ctx, ptr, len, &mappedview_free, mv, FALSE);
+
+  if(JS_IsException(obj)) {
+    js_free(ctx, mv);
+    return obj;
+  }
+
+  mv->mf = mf;
+  mv->obj = JS_VALUE_GET_PTR(obj);
+  mv->next = mf->views;
+  mf->views = mv;
+  mf->ref_count++;
+
+  return obj;
+}
+
+static MappedFile*
+js_mappedfile_data(JSContext* ctx, JSValueConst value) {
+  MappedFile* mf;
+
+  if(!(mf = JS_GetOpaque2(ctx, value, js_mappedfile_class_id)))
+    return 0;
+
+  if(mf->mw.fd == -1) {
+    JS_ThrowTypeError(ctx, "MappedFile is closed");
+    return 0;
+  }
+
+  return mf;
+}
+
+/**
+ * new MappedFile(path | fd, { window, writable })
+ */
+static JSValue
+js_mappedfile_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
+  JSValue proto, obj = JS_UNDEFINED;
+  MappedFile* mf;
+  int32_t fd = -1;
+  uint64_t window = 0;
+  BOOL writable = FALSE, close_on_end = FALSE;
+
+  if(argc > 1 && JS_IsObject(argv[1])) {
+    writable = js_get_propertystr_bool(ctx, argv[1], "writable");
+    window = js_get_propertystr_uint64(ctx, argv[1], "window");
+  }
+
+  if(JS_IsNumber(argv[0])) {
+    JS_ToInt32(ctx, &fd, argv[0]);
+  } else {
+    const char* path;
+
+    if(!(path = JS_ToCString(ctx, argv[0])))
+      return JS_EXCEPTION;
+
+    fd = writable ? open(path, O_RDWR | O_CREAT, 0644) : open(path, O_RDONLY);
+    JS_FreeCString(ctx, path);
+
+    if(fd == -1)
+      return js_syscallerror_throw(ctx, "open");
+
+    close_on_end = TRUE;
+  }
+
+  if(!(mf = js_mallocz(ctx, sizeof(MappedFile))))
+    goto fail;
+
+  mf->ref_count = 1;
+
+  if(mapwindow_init(&mf->mw, fd, window, writable, close_on_end) == -1) {
+    js_free(ctx, mf);
+    mf = 0;
+    obj = js_syscallerror_throw(ctx, "fstat");
+    goto fail;
+  }
+
+  /* using new_target to get the prototype is necessary when the class is extended. */
+  proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+  if(JS_IsException(proto))
+    goto fail;
+
+  if(!JS_IsObject(proto))
+    proto = JS_DupValue(ctx, mappedfile_proto);
+
+  obj = JS_NewObjectProtoClass(ctx, proto, js_mappedfile_class_id);
+  JS_FreeValue(ctx, proto);
+  if(JS_IsException(obj))
+    goto fail;
+
+  JS_SetOpaque(obj, mf);
+  return obj;
+
+fail:
+  if(mf)
+    mappedfile_unref(JS_GetRuntime(ctx), mf);
+  else if(close_on_end)
+    close(fd);
+
+  JS_FreeValue(ctx, obj);
+  return JS_EXCEPTION;
+}
+
+static JSValue
+js_mappedfile_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  MappedFile* mf;
+  JSValue ret = JS_UNDEFINED;
+
+  if(!(mf = js_mappedfile_data(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case MAPPEDFILE_VIEW:
+    case MAPPEDFILE_READ: {
+      uint64_t length = 0;
+      size_t avail;
+      uint8_t* ptr;
+      BOOL fixed = argc > 0 && !js_is_null_or_undefined(argv[0]);
+
+      if(fixed && JS_ToIndex(ctx, &length, argv[0]))
+        return JS_EXCEPTION;
+
+      if(!(ptr = mappedfile_at(ctx, mf, mf->mw.pos, length, &avail))) {
+        if(avail)
+          return js_syscallerror_throw(ctx, mf->mw.syscall);
+
+        return magic == MAPPEDFILE_READ ? JS_NULL : JS_NewArrayBufferCopy(ctx, 0, 0);
+      }
+
+      if(!fixed || length > avail)
+        length = avail;
+
+      ret = mappedfile_view(ctx, mf, ptr, length);
+
+      if(magic == MAPPEDFILE_READ && !JS_IsException(ret))
+        mf->mw.pos += length;
+
+      break;
+    }
+
+    case MAPPEDFILE_WRITE: {
+      InputBuffer input = js_input_chars(ctx, argv[0]);
+      Writer wr = writer_from_mapwindow(&mf->mw);
+      uint8_t* base = mf->mw.base;
+      uint64_t start = mf->mw.start;
+      ssize_t r;
+
+      if(!mf->mw.writable) {
+        input_buffer_free(&input, ctx);
+        return JS_ThrowTypeError(ctx, "MappedFile is not writable");
+      }
+
+      r = writer_write(&wr, input.data, input.size);
+      input_buffer_free(&input, ctx);
+
+      if(mf->mw.base != base || mf->mw.start != start)
+        mappedfile_detach(ctx, mf);
+
+      if(r < 0)
+        return js_syscallerror_throw(ctx, mf->mw.syscall);
+
+      ret = JS_NewInt64(ctx, r);
+      break;
+    }
+
+    case MAPPEDFILE_SEEK: {
+      int64_t offset = 0;
+      int32_t whence = SEEK_SET;
+
+      JS_ToInt64(ctx, &offset, argv[0]);
+
+      if(argc > 1)
+        JS_ToInt32(ctx, &whence, argv[1]);
+
+      offset += whence == SEEK_CUR ? (int64_t)mf->mw.pos : whence == SEEK_END ? (int64_t)mf->mw.end : 0;
+
+      if(offset < 0)
+        return JS_ThrowRangeError(ctx, "seek before start of file");
+
+      mf->mw.pos = offset;
+      ret = JS_NewInt64(ctx, offset);
+      break;
+    }
+
+    case MAPPEDFILE_REFRESH: {
+      if(mapwindow_refresh(&mf->mw) == -1)
+        return js_syscallerror_throw(ctx, "fstat");
+
+      if(!mf->mw.writable)
+        mf->mw.end = mf->mw.length;
+
+      ret = JS_NewInt64(ctx, mf->mw.end);
+      break;
+    }
+
+    case MAPPEDFILE_CLOSE: {
+      mappedfile_detach(ctx, mf);
+      mapwindow_free(&mf->mw);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static JSValue
+js_mappedfile_get(JSContext* ctx, JSValueConst this_val, int magic) {
+  MappedFile* mf;
+  JSValue ret = JS_UNDEFINED;
+
+  if(!(mf = JS_GetOpaque2(ctx, this_val, js_mappedfile_class_id)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case MAPPEDFILE_POSITION: {
+      ret = JS_NewInt64(ctx, mf->mw.pos);
+      break;
+    }
+
+    case MAPPEDFILE_LENGTH: {
+      ret = JS_NewInt64(ctx, mf->mw.writable ? mf->mw.end : mf->mw.length);
+      break;
+    }
+
+    case MAPPEDFILE_START: {
+      ret = JS_NewInt64(ctx, mf->mw.start);
+      break;
+    }
+
+    case MAPPEDFILE_SIZE: {
+      ret = JS_NewInt64(ctx, mf->mw.size);
+      break;
+    }
+
+    case MAPPEDFILE_WINDOW: {
+      ret = JS_NewInt64(ctx, mf->mw.window);
+      break;
+    }
+
+    case MAPPEDFILE_WRITABLE: {
+      ret = JS_NewBool(ctx, mf->mw.writable);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static JSValue
+js_mappedfile_set(JSContext* ctx, JSValueConst this_val, JSValueConst value, int magic) {
+  MappedFile* mf;
+  uint64_t pos;
+
+  if(!(mf = JS_GetOpaque2(ctx, this_val, js_mappedfile_class_id)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case MAPPEDFILE_POSITION: {
+      if(JS_ToIndex(ctx, &pos, value))
+        return JS_EXCEPTION;
+
+      mf->mw.pos = pos;
+      break;
+    }
+  }
+
+  return JS_UNDEFINED;
+}
+
+static void
+js_mappedfile_finalizer(JSRuntime* rt, JSValue val) {
+  MappedFile* mf;
+
+  if((mf = JS_GetOpaque(val, js_mappedfile_class_id)))
+    mappedfile_unref(rt, mf);
+}
+
+static JSClassDef js_mappedfile_class = {
+    .class_name = "MappedFile",
+    .finalizer = js_mappedfile_finalizer,
+};
+
+static const JSCFunctionListEntry js_mappedfile_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("view", 0, js_mappedfile_method, MAPPEDFILE_VIEW),
+    JS_CFUNC_MAGIC_DEF("read", 0, js_mappedfile_method, MAPPEDFILE_READ),
+    JS_CFUNC_MAGIC_DEF("write", 1, js_mappedfile_method, MAPPEDFILE_WRITE),
+    JS_CFUNC_MAGIC_DEF("seek", 1, js_mappedfile_method, MAPPEDFILE_SEEK),
+    JS_CFUNC_MAGIC_DEF("refresh", 0, js_mappedfile_method, MAPPEDFILE_REFRESH),
+    JS_CFUNC_MAGIC_DEF("close", 0, js_mappedfile_method, MAPPEDFILE_CLOSE),
+    JS_CGETSET_MAGIC_DEF("position", js_mappedfile_get, js_mappedfile_set, MAPPEDFILE_POSITION),
+    JS_CGETSET_MAGIC_DEF("length", js_mappedfile_get, 0, MAPPEDFILE_LENGTH),
+    JS_CGETSET_MAGIC_DEF("start", js_mappedfile_get, 0, MAPPEDFILE_START),
+    JS_CGETSET_MAGIC_DEF("size", js_mappedfile_get, 0, MAPPEDFILE_SIZE),
+    JS_CGETSET_MAGIC_DEF("window", js_mappedfile_get, 0, MAPPEDFILE_WINDOW),
+    JS_CGETSET_MAGIC_DEF("writable", js_mappedfile_get, 0, MAPPEDFILE_WRITABLE),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MappedFile", JS_PROP_CONFIGURABLE),
+};
+#endif
+
 static const JSCFunctionListEntry js_mmap_funcs[] = {
     JS_CFUNC_DEF("mmap", 2, js_mmap_map),
+    JS_CFUNC_DEF("mapFile", 1, js_mmap_mapfile),
+    JS_CFUNC_DEF("advise", 2, js_mmap_advise),
     JS_CFUNC_DEF("munmap", 1, js_mmap_unmap),
     JS_CFUNC_DEF("msync", 3, js_mmap_msync),
     JS_CFUNC_DEF("mprotect", 3, js_mmap_mprotect),
@@ -202,6 +846,24 @@ static const JSCFunctionListEntry js_mmap_funcs[] = {
 #ifdef MS_SYNC
     JS_CONSTANT(MS_SYNC),
 #endif
+#ifdef MADV_NORMAL
+    JS_CONSTANT(MADV_NORMAL),
+#endif
+#ifdef MADV_RANDOM
+    JS_CONSTANT(MADV_RANDOM),
+#endif
+#ifdef MADV_SEQUENTIAL
+    JS_CONSTANT(MADV_SEQUENTIAL),
+#endif
+#ifdef MADV_WILLNEED
+    JS_CONSTANT(MADV_WILLNEED),
+#endif
+#ifdef MADV_DONTNEED
+    JS_CONSTANT(MADV_DONTNEED),
+#endif
+#ifdef MADV_HUGEPAGE
+    JS_CONSTANT(MADV_HUGEPAGE),
+#endif
 #ifdef PROT_SAO
     JS_CONSTANT(PROT_SAO),
 #endif
@@ -212,7 +874,26 @@ static const JSCFunctionListEntry js_mmap_funcs[] = {
 
 static int
 js_mmap_init(JSContext* ctx, JSModuleDef* m) {
-  JS_SetModuleExportList(ctx, m, js_mmap_funcs, countof(js_mmap_funcs));
+#ifdef HAVE_MMAP
+  JS_NewClassID(&js_mappedfile_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_mappedfile_class_id, &js_mappedfile_class);
+
+  mappedfile_ctor = JS_NewCFunction2(ctx, js_mappedfile_constructor, "MappedFile", 1, JS_CFUNC_constructor, 0);
+  mappedfile_proto = JS_NewObject(ctx);
+
+  JS_SetPropertyFunctionList(ctx, mappedfile_proto, js_mappedfile_funcs, countof(js_mappedfile_funcs));
+  JS_SetClassProto(ctx, js_mappedfile_class_id, mappedfile_proto);
+
+  JS_SetConstructor(ctx, mappedfile_ctor, mappedfile_proto);
+#endif
+
+  if(m) {
+    JS_SetModuleExportList(ctx, m, js_mmap_funcs, countof(js_mmap_funcs));
+#ifdef HAVE_MMAP
+    JS_SetModuleExport(ctx, m, "MappedFile", mappedfile_ctor);
+#endif
+  }
+
   return 0;
 }
 
@@ -226,8 +907,12 @@ VISIBLE JSModuleDef*
 JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
   JSModuleDef* m;
 
-  if((m = JS_NewCModule(ctx, module_name, js_mmap_init)))
+  if((m = JS_NewCModule(ctx, module_name, js_mmap_init))) {
     JS_AddModuleExportList(ctx, m, js_mmap_funcs, countof(js_mmap_funcs));
+#ifdef HAVE_MMAP
+    JS_AddModuleExport(ctx, m, "MappedFile");
+#endif
+  }
 
   return m;
 }
@@ -9,8 +9,10 @@
 #include <sys/types.h>
 #include <limits.h>
 #include <string.h>
+#include <errno.h>
 
 #include "path.h"
+#include "glob-set.h"
 #include "utils.h"
 #ifdef _WIN32
 #include <windows.h>
@@ -660,6 +662,243 @@ fail:
   return ret;
 }
 
+typedef struct {
+  GlobSet* set;
+  GlobCursor cursor;
+} PathGlobSet;
+
+VISIBLE JSClassID js_path_globset_class_id = 0;
+static thread_local JSValue path_globset_proto, path_globset_ctor;
+
+static int
+path_globset_add(JSContext* ctx, PathGlobSet* gs, JSValueConst pattern, int flags) {
+  const char* str;
+  size_t len;
+  int ret;
+
+  if(js_is_array(ctx, pattern)) {
+    int64_t n = js_array_length(ctx, pattern);
+
+    for(int64_t i = 0; i < n; i++) {
+      JSValue item = JS_GetPropertyUint32(ctx, pattern, i);
+
+      ret = path_globset_add(ctx, gs, item, flags);
+      JS_FreeValue(ctx, item);
+
+      if(ret)
+        return ret;
+    }
+
+    return 0;
+  }
+
+  if(!(str = JS_ToCStringLen(ctx, &len, pattern)))
+    return -1;
+
+  if((ret = glob_set_add(gs->set, str, len, flags))) {
+    if(errno == E2BIG)
+      JS_ThrowRangeError(ctx, "pattern '%s' expands to too many alternatives", str);
+    else if(errno == EINVAL)
+      JS_ThrowTypeError(ctx, "invalid pattern '%s'", str);
+    else
+      JS_ThrowOutOfMemory(ctx);
+  }
+
+  JS_FreeCString(ctx, str);
+
+  /* the states kept by the cursor refer to the old trie */
+  glob_cursor_free(&gs->cursor);
+  return ret;
+}
+
+static int
+path_globset_test(JSContext* ctx, PathGlobSet* gs, JSValueConst path) {
+  const char* str;
+  size_t len;
+  int ret;
+
+  if(!(str = JS_ToCStringLen(ctx, &len, path)))
+    return -1;
+
+  if((ret = glob_cursor_match(gs->set, &gs->cursor, str, len)) == -1)
+    JS_ThrowOutOfMemory(ctx);
+
+  JS_FreeCString(ctx, str);
+  return ret;
+}
+
+/**
+ * new GlobSet([include], [exclude], [flags])
+ *
+ * Compiles include and exclude patterns (strings or arrays of them) into one
+ * matcher.  Patterns may contain {a,b} alternatives and '**'.  With the
+ * default flags (GlobSet.MATCHBASE), patterns without a '/' match the name
+ * of a path at any depth.
+ */
+static JSValue
+js_path_globset_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
+  JSValue proto, obj = JS_UNDEFINED;
+  PathGlobSet* gs;
+  int32_t flags = GLOB_SET_MATCHBASE;
+
+  if(argc > 2 && !JS_IsUndefined(argv[2]))
+    JS_ToInt32(ctx, &flags, argv[2]);
+
+  if(!(gs = js_mallocz(ctx, sizeof(PathGlobSet))))
+    return JS_EXCEPTION;
+
+  if(!(gs->set = glob_set_new(flags))) {
+    js_free(ctx, gs);
+    return JS_ThrowOutOfMemory(ctx);
+  }
+
+  glob_cursor_init(&gs->cursor);
+
+  /* using new_target to get the prototype is necessary when the class is extended. */
+  proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+  if(JS_IsException(proto))
+    goto fail;
+
+  obj = JS_NewObjectProtoClass(ctx, proto, js_path_globset_class_id);
+  JS_FreeValue(ctx, proto);
+
+  if(JS_IsException(obj))
+    goto fail;
+
+  JS_SetOpaque(obj, gs);
+
+  if(argc > 0 && !JS_IsUndefined(argv[0]) && path_globset_add(ctx, gs, argv[0], 0))
+    goto fail2;
+
+  if(argc > 1 && !JS_IsUndefined(argv[1]) && path_globset_add(ctx, gs, argv[1], GLOB_SET_EXCLUDE))
+    goto fail2;
+
+  return obj;
+
+fail:
+  glob_set_free(gs->set);
+  js_free(ctx, gs);
+fail2:
+  JS_FreeValue(ctx, obj);
+  return JS_EXCEPTION;
+}
+
+enum {
+  GLOBSET_ADD,
+  GLOBSET_MATCH,
+  GLOBSET_TEST,
+  GLOBSET_FILTER,
+};
+
+static JSValue
+js_path_globset_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  PathGlobSet* gs;
+  JSValue ret = JS_UNDEFINED;
+  int r;
+
+  if(!(gs = JS_GetOpaque2(ctx, this_val, js_path_globset_class_id)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case GLOBSET_ADD: {
+      if(path_globset_add(ctx, gs, argv[0], argc > 1 && JS_ToBool(ctx, argv[1]) ? GLOB_SET_EXCLUDE : 0))
+        return JS_EXCEPTION;
+
+      ret = JS_DupValue(ctx, this_val);
+      break;
+    }
+
+    case GLOBSET_MATCH: {
+      if((r = path_globset_test(ctx, gs, argv[0])) == -1)
+        return JS_EXCEPTION;
+
+      ret = JS_NewBool(ctx, r & GLOB_SET_MATCH);
+      break;
+    }
+
+    case GLOBSET_TEST: {
+      if((r = path_globset_test(ctx, gs, argv[0])) == -1)
+        return JS_EXCEPTION;
+
+      ret = JS_NewInt32(ctx, r);
+      break;
+    }
+
+    case GLOBSET_FILTER: {
+      int64_t n = js_array_length(ctx, argv[0]);
+      uint32_t j = 0;
+
+      if(n < 0)
+        return JS_ThrowTypeError(ctx, "argument 1 must be an array");
+
+      ret = JS_NewArray(ctx);
+
+      for(int64_t i = 0; i < n; i++) {
+        JSValue item = JS_GetPropertyUint32(ctx, argv[0], i);
+
+        if((r = path_globset_test(ctx, gs, item)) == -1) {
+          JS_FreeValue(ctx, item);
+          JS_FreeValue(ctx, ret);
+          return JS_EXCEPTION;
+        }
+
+        if(r & GLOB_SET_MATCH)
+          JS_SetPropertyUint32(ctx, ret, j++, item);
+        else
+          JS_FreeValue(ctx, item);
+      }
+
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static JSValue
+js_path_globset_get(JSContext* ctx, JSValueConst this_val, int magic) {
+  PathGlobSet* gs;
+
+  if(!(gs = JS_GetOpaque2(ctx, this_val, js_path_globset_class_id)))
+    return JS_EXCEPTION;
+
+  return JS_NewInt64(ctx, glob_set_count(gs->set, magic));
+}
+
+static void
+js_path_globset_finalizer(JSRuntime* rt, JSValue val) {
+  PathGlobSet* gs;
+
+  if((gs = JS_GetOpaque(val, js_path_globset_class_id))) {
+    glob_cursor_free(&gs->cursor);
+    glob_set_free(gs->set);
+    js_free_rt(rt, gs);
+  }
+}
+
+static JSClassDef js_path_globset_class = {
+    .class_name = "GlobSet",
+    .finalizer = js_path_globset_finalizer,
+};
+
+static const JSCFunctionListEntry js_path_globset_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("add", 1, js_path_globset_method, GLOBSET_ADD),
+    JS_CFUNC_MAGIC_DEF("match", 1, js_path_globset_method, GLOBSET_MATCH),
+    JS_CFUNC_MAGIC_DEF("test", 1, js_path_globset_method, GLOBSET_TEST),
+    JS_CFUNC_MAGIC_DEF("filter", 1, js_path_globset_method, GLOBSET_FILTER),
+    JS_CGETSET_MAGIC_DEF("includes", js_path_globset_get, 0, 0),
+    JS_CGETSET_MAGIC_DEF("excludes", js_path_globset_get, 0, GLOB_SET_EXCLUDE),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "GlobSet", JS_PROP_CONFIGURABLE),
+};
+
+static const JSCFunctionListEntry js_path_globset_static[] = {
+    JS_PROP_INT32_DEF("PERIOD", GLOB_SET_PERIOD, JS_PROP_CONFIGURABLE),
+    JS_PROP_INT32_DEF("MATCHBASE", GLOB_SET_MATCHBASE, JS_PROP_CONFIGURABLE),
+    JS_PROP_INT32_DEF("MATCH", GLOB_SET_MATCH, JS_PROP_CONFIGURABLE),
+    JS_PROP_INT32_DEF("EXCLUDED", GLOB_SET_EXCLUDED, JS_PROP_CONFIGURABLE),
+    JS_PROP_INT32_DEF("DESCEND", GLOB_SET_DESCEND, JS_PROP_CONFIGURABLE),
+};
+
 static const JSCFunctionListEntry js_path_funcs[] = {
     JS_CFUNC_MAGIC_DEF("basename", 1, js_path_method, PATH_BASENAME),
     JS_CFUNC_MAGIC_DEF("basepos", 1, js_path_method, PATH_BASEPOS),
@@ -714,8 +953,21 @@ static const JSCFunctionListEntry js_path_funcs[] = {
 
 static int
 js_path_init(JSContext* ctx, JSModuleDef* m) {
-  if(m)
+  JS_NewClassID(&js_path_globset_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_path_globset_class_id, &js_path_globset_class);
+
+  path_globset_ctor = JS_NewCFunction2(ctx, js_path_globset_constructor, "GlobSet", 0, JS_CFUNC_constructor, 0);
+  path_globset_proto = JS_NewObject(ctx);
+
+  JS_SetPropertyFunctionList(ctx, path_globset_proto, js_path_globset_funcs, countof(js_path_globset_funcs));
+  JS_SetPropertyFunctionList(ctx, path_globset_ctor, js_path_globset_static, countof(js_path_globset_static));
+  JS_SetClassProto(ctx, js_path_globset_class_id, path_globset_proto);
+  JS_SetConstructor(ctx, path_globset_ctor, path_globset_proto);
+
+  if(m) {
     JS_SetModuleExportList(ctx, m, js_path_funcs, countof(js_path_funcs));
+    JS_SetModuleExport(ctx, m, "GlobSet", path_globset_ctor);
+  }
 
   return 0;
 }
@@ -730,8 +982,10 @@ VISIBLE JSModuleDef*
 JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
   JSModuleDef* m;
 
-  if((m = JS_NewCModule(ctx, module_name, js_path_init)))
+  if((m = JS_NewCModule(ctx, module_name, js_path_init))) {
     JS_AddModuleExportList(ctx, m, js_path_funcs, countof(js_path_funcs));
+    JS_AddModuleExport(ctx, m, "GlobSet");
+  }
 
   return m;
 }
@@ -0,0 +1,852 @@
+#include "defines.h"
+#include "utils.h"
+#include "histogram.h"
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAVE_TIMERFD
+#include <sys/timerfd.h>
+#endif
+
+/**
+ * \defgroup quickjs-perf quickjs-perf: High resolution timing, marks and histograms
+ *
+ * Backing of lib/perf_hooks.js.  A Timeline keeps marks and measures in a
+ * C array, their names as atoms; entry objects are made for the caller of
+ * mark() and measure() and for queries, and are not kept.  Histograms count values into HDR-style buckets (see
+ * histogram.h), so recording a sample allocates nothing on the JS heap.
+ *
+ * monitorEventLoopDelay() arms a periodic timerfd and, from its read
+ * handler, records how long after each expiration the event loop got to it.
+ * The read handler keeps the event loop alive while the monitor is enabled.
+ * @{
+ */
+
+VISIBLE JSClassID js_timeline_class_id = 0, js_histogram_class_id = 0;
+static thread_local JSValue timeline_proto, timeline_ctor, histogram_proto, histogram_ctor;
+#ifdef HAVE_TIMERFD
+static thread_local JSValue interval_histogram_proto;
+#endif
+
+static struct timespec perf_origin;
+static double perf_time_origin;
+
+enum {
+  PERF_MARK = 0,
+  PERF_MEASURE,
+};
+
+static const char* const perf_entry_types[] = {"mark", "measure"};
+
+typedef struct {
+  int type;
+  JSAtom name;
+  double start, duration;
+  JSValue detail;
+} PerfEntry;
+
+typedef struct {
+  PerfEntry* entries;
+  size_t count, capacity;
+  JSValue protos[2];
+} PerfTimeline;
+
+typedef struct {
+  Histogram hist;
+  uint64_t last; /* recordDelta() */
+  int fd;        /* timerfd of monitorEventLoopDelay() */
+  uint64_t interval;
+  BOOL enabled;
+} PerfHistogram;
+
+static uint64_t
+perf_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double
+perf_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (ts.tv_sec - perf_origin.tv_sec) * 1e3 + (ts.tv_nsec - perf_origin.tv_nsec) / 1e6;
+}
+
+static JSValue
+js_perf_now(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  return JS_NewFloat64(ctx, perf_now());
+}
+
+static int
+perf_entry_type(JSContext* ctx, JSValueConst value) {
+  const char* str;
+  int type = -2;
+
+  if(JS_IsUndefined(value))
+    return -1;
+
+  if((str = JS_ToCString(ctx, value))) {
+    for(type = countof(perf_entry_types) - 1; type >= 0; type--)
+      if(!strcmp(str, perf_entry_types[type]))
+        break;
+
+    if(type == -1)
+      type = -2;
+
+    JS_FreeCString(ctx, str);
+  }
+
+  return type;
+}
+
+static JSValue
+perf_entry_object(JSContext* ctx, PerfTimeline* tl, const PerfEntry* e) {
+  JSValue obj = JS_NewObjectProto(ctx, tl->protos[e->type]);
+  const int flags = JS_PROP_ENUMERABLE | JS_PROP_CONFIGURABLE;
+
+  JS_DefinePropertyValueStr(ctx, obj, "name", JS_AtomToString(ctx, e->name), flags);
+  JS_DefinePropertyValueStr(ctx, obj, "entryType", JS_NewString(ctx, perf_entry_types[e->type]), flags);
+  JS_DefinePropertyValueStr(ctx, obj, "startTime", JS_NewFloat64(ctx, e->start), flags);
+  JS_DefinePropertyValueStr(ctx, obj, "duration", JS_NewFloat64(ctx, e->duration), flags);
+  JS_DefinePropertyValueStr(ctx, obj, "detail", JS_DupValue(ctx, e->detail), flags);
+  return obj;
+}
+
+static void
+perf_entry_free(JSRuntime* rt, PerfEntry* e) {
+  JS_FreeAtomRT(rt, e->name);
+  JS_FreeValueRT(rt, e->detail);
+}
+
+/**
+ * new Timeline([markProto, measureProto])
+ *
+ * Entry objects are created with these prototypes.
+ */
+static JSValue
+js_timeline_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
+  PerfTimeline* tl;
+  JSValue proto, obj = JS_UNDEFINED;
+
+  if(!(tl = js_mallocz(ctx, sizeof(PerfTimeline))))
+    return JS_EXCEPTION;
+
+  for(int i = 0; i < 2; i++)
+    tl->protos[i] = argc > i && JS_IsObject(argv[i]) ? JS_DupValue(ctx, argv[i]) : JS_NewObject(ctx);
+
+  proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+
+  if(JS_IsException(proto))
+    goto fail;
+
+  obj = JS_NewObjectProtoClass(ctx, proto, js_timeline_class_id);
+  JS_FreeValue(ctx, proto);
+
+  if(JS_IsException(obj))
+    goto fail;
+
+  JS_SetOpaque(obj, tl);
+  return obj;
+
+fail:
+  JS_FreeValue(ctx, tl->protos[0]);
+  JS_FreeValue(ctx, tl->protos[1]);
+  js_free(ctx, tl);
+  return JS_EXCEPTION;
+}
+
+enum {
+  TIMELINE_MARK = 0,
+  TIMELINE_MEASURE,
+  TIMELINE_TIME,
+  TIMELINE_ENTRIES,
+  TIMELINE_CLEAR,
+};
+
+static int
+timeline_entry_cmp(const void* a, const void* b) {
+  const PerfEntry *x = *(PerfEntry* const*)a, *y = *(PerfEntry* const*)b;
+
+  if(x->start != y->start)
+    return x->start < y->start ? -1 : 1;
+
+  /* keep the order they were added in */
+  return x < y ? -1 : x > y;
+}
+
+static JSValue
+js_timeline_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  PerfTimeline* tl;
+  JSValue ret = JS_UNDEFINED;
+
+  if(!(tl = JS_GetOpaque2(ctx, this_val, js_timeline_class_id)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    /* mark(name, startTime[, detail]), measure(name, start, end[, detail]) */
+    case TIMELINE_MARK:
+    case TIMELINE_MEASURE: {
+      PerfEntry* e;
+      double start, end;
+
+      if(JS_ToFloat64(ctx, &start, argv[1]))
+        return JS_EXCEPTION;
+
+      end = start;
+
+      if(magic == TIMELINE_MEASURE && JS_ToFloat64(ctx, &end, argv[2]))
+        return JS_EXCEPTION;
+
+      if(tl->count == tl->capacity) {
+        size_t capacity = tl->capacity ? tl->capacity * 2 : 64;
+        PerfEntry* entries;
+
+        if(!(entries = js_realloc(ctx, tl->entries, capacity * sizeof(PerfEntry))))
+          return JS_EXCEPTION;
+
+        tl->entries = entries;
+        tl->capacity = capacity;
+      }
+
+      e = &tl->entries[tl->count];
+
+      if((e->name = JS_ValueToAtom(ctx, argv[0])) == JS_ATOM_NULL)
+        return JS_EXCEPTION;
+
+      e->type = magic == TIMELINE_MARK ? PERF_MARK : PERF_MEASURE;
+      e->start = start;
+      e->duration = end - start;
+      e->detail = argc > 2 + e->type ? JS_DupValue(ctx, argv[2 + e->type]) : JS_NULL;
+      tl->count++;
+
+      ret = perf_entry_object(ctx, tl, e);
+      break;
+    }
+
+    /* time(markName | number): startTime of the last mark with that name */
+    case TIMELINE_TIME: {
+      JSAtom name;
+
+      if(JS_IsNumber(argv[0]))
+        return JS_DupValue(ctx, argv[0]);
+
+      if((name = JS_ValueToAtom(ctx, argv[0])) == JS_ATOM_NULL)
+        return JS_EXCEPTION;
+
+      ret = JS_UNDEFINED;
+
+      for(size_t i = tl->count; i > 0; i--)
+        if(tl->entries[i - 1].type == PERF_MARK && tl->entries[i - 1].name == name) {
+          ret = JS_NewFloat64(ctx, tl->entries[i - 1].start);
+          break;
+        }
+
+      if(JS_IsUndefined(ret)) {
+        const char* str = JS_AtomToCString(ctx, name);
+
+        ret = JS_ThrowSyntaxError(ctx, "The \"%s\" performance mark has not been set", str);
+        JS_FreeCString(ctx, str);
+      }
+
+      JS_FreeAtom(ctx, name);
+      break;
+    }
+
+    /* entries([type[, name]]): by startTime */
+    case TIMELINE_ENTRIES: {
+      int type = perf_entry_type(ctx, argc > 0 ? argv[0] : JS_UNDEFINED);
+      JSAtom name = argc > 1 && !JS_IsUndefined(argv[1]) ? JS_ValueToAtom(ctx, argv[1]) : JS_ATOM_NULL;
+      PerfEntry** list;
+      size_t n = 0;
+
+      if(!(list = js_malloc(ctx, sizeof(PerfEntry*) * (tl->count + 1)))) {
+        JS_FreeAtom(ctx, name);
+        return JS_EXCEPTION;
+      }
+
+      if(type != -2)
+        for(size_t i = 0; i < tl->count; i++)
+          if((type == -1 || tl->entries[i].type == type) && (name == JS_ATOM_NULL || tl->entries[i].name == name))
+            list[n++] = &tl->entries[i];
+
+      qsort(list, n, sizeof(PerfEntry*), timeline_entry_cmp);
+      ret = JS_NewArray(ctx);
+
+      for(size_t i = 0; i < n; i++)
+        JS_SetPropertyUint32(ctx, ret, i, perf_entry_object(ctx, tl, list[i]));
+
+      js_free(ctx, list);
+      JS_FreeAtom(ctx, name);
+      break;
+    }
+
+    /* clear(type[, name]) */
+    case TIMELINE_CLEAR: {
+      int type = perf_entry_type(ctx, argv[0]);
+      JSAtom name = argc > 1 && !JS_IsUndefined(argv[1]) ? JS_ValueToAtom(ctx, argv[1]) : JS_ATOM_NULL;
+      size_t j = 0;
+
+      for(size_t i = 0; i < tl->count; i++) {
+        PerfEntry* e = &tl->entries[i];
+
+        if((type == -1 || e->type == type) && (name == JS_ATOM_NULL || e->name == name))
+          perf_entry_free(JS_GetRuntime(ctx), e);
+        else
+          tl->entries[j++] = *e;
+      }
+
+      tl->count = j;
+      JS_FreeAtom(ctx, name);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static JSValue
+js_timeline_length(JSContext* ctx, JSValueConst this_val) {
+  PerfTimeline* tl;
+
+  if(!(tl = JS_GetOpaque2(ctx, this_val, js_timeline_class_id)))
+    return JS_EXCEPTION;
+
+  return JS_NewInt64(ctx, tl->count);
+}
+
+static void
+js_timeline_finalizer(JSRuntime* rt, JSValue val) {
+  PerfTimeline* tl;
+
+  if((tl = JS_GetOpaque(val, js_timeline_class_id))) {
+    for(size_t i = 0; i < tl->count; i++)
+      perf_entry_free(rt, &tl->entries[i]);
+
+    JS_FreeValueRT(rt, tl->protos[0]);
+    JS_FreeValueRT(rt, tl->protos[1]);
+    js_free_rt(rt, tl->entries);
+    js_free_rt(rt, tl);
+  }
+}
+
+static void
+js_timeline_mark(JSRuntime* rt, JSValueConst val, JS_MarkFunc* mark_func) {
+  PerfTimeline* tl;
+
+  if((tl = JS_GetOpaque(val, js_timeline_class_id))) {
+    for(size_t i = 0; i < tl->count; i++)
+      JS_MarkValue(rt, tl->entries[i].detail, mark_func);
+
+    JS_MarkValue(rt, tl->protos[0], mark_func);
+    JS_MarkValue(rt, tl->protos[1], mark_func);
+  }
+}
+
+static PerfHistogram*
+perf_histogram_new(JSContext* ctx, uint64_t lowest, uint64_t highest, int figures) {
+  PerfHistogram* ph;
+
+  if(!(ph = js_mallocz(ctx, sizeof(PerfHistogram))))
+    return 0;
+
+  if(histogram_init(&ph->hist, lowest, highest, figures)) {
+    js_free(ctx, ph);
+    JS_ThrowRangeError(ctx, "invalid histogram range %" PRIu64 " - %" PRIu64 " or figures %d", lowest, highest, figures);
+    return 0;
+  }
+
+  ph->fd = -1;
+  return ph;
+}
+
+static JSValue
+perf_histogram_wrap(JSContext* ctx, JSValueConst proto, PerfHistogram* ph) {
+  JSValue obj = JS_NewObjectProtoClass(ctx, proto, js_histogram_class_id);
+
+  if(JS_IsException(obj)) {
+    histogram_free(&ph->hist);
+    js_free(ctx, ph);
+    return obj;
+  }
+
+  JS_SetOpaque(obj, ph);
+  return obj;
+}
+
+static int
+perf_histogram_option(JSContext* ctx, JSValueConst options, const char* prop, double* value) {
+  JSValue v;
+  int ret = 0;
+
+  if(!JS_IsObject(options))
+    return 0;
+
+  v = JS_GetPropertyStr(ctx, options, prop);
+
+  if(!JS_IsUndefined(v)) {
+    if(JS_IsBigInt(ctx, v)) {
+      int64_t i;
+
+      ret = JS_ToBigInt64(ctx, &i, v);
+      *value = i;
+    } else {
+      ret = JS_ToFloat64(ctx, value, v);
+    }
+  }
+
+  JS_FreeValue(ctx, v);
+  return ret;
+}
+
+/**
+ * new Histogram({ lowest = 1, highest = Number.MAX_SAFE_INTEGER, figures = 3 })
+ */
+static JSValue
+js_histogram_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
+  PerfHistogram* ph;
+  double lowest = 1, highest = 9007199254740991.0, figures = 3;
+  JSValue proto, obj;
+
+  if(argc > 0 && (perf_histogram_option(ctx, argv[0], "lowest", &lowest) ||
+                  perf_histogram_option(ctx, argv[0], "highest", &highest) ||
+                  perf_histogram_option(ctx, argv[0], "figures", &figures)))
+    return JS_EXCEPTION;
+
+  /* 2^64 is the first double out of uint64_t range */
+  if(!(lowest >= 1 && highest < 18446744073709551616.0 && figures >= 1))
+    return JS_ThrowRangeError(ctx, "invalid histogram options");
+
+  if(!(ph = perf_histogram_new(ctx, lowest, highest, figures)))
+    return JS_EXCEPTION;
+
+  proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+
+  if(JS_IsException(proto)) {
+    histogram_free(&ph->hist);
+    js_free(ctx, ph);
+    return JS_EXCEPTION;
+  }
+
+  obj = perf_histogram_wrap(ctx, proto, ph);
+  JS_FreeValue(ctx, proto);
+  return obj;
+}
+
+enum {
+  HISTOGRAM_RECORD = 0,
+  HISTOGRAM_RECORD_DELTA,
+  HISTOGRAM_RESET,
+  HISTOGRAM_ADD,
+  HISTOGRAM_PERCENTILE,
+  HISTOGRAM_TO_JSON,
+};
+
+static void
+histogram_percentile_add(JSContext* ctx, JSValueConst ret, BOOL object, uint32_t i, double p, uint64_t value) {
+  if(object) {
+    char key[32];
+
+    snprintf(key, sizeof(key), "%.15g", p);
+    JS_SetPropertyStr(ctx, ret, key, JS_NewInt64(ctx, value));
+  } else {
+    JSValue pair = JS_NewArray(ctx);
+
+    JS_SetPropertyUint32(ctx, pair, 0, JS_NewFloat64(ctx, p));
+    JS_SetPropertyUint32(ctx, pair, 1, JS_NewInt64(ctx, value));
+    JS_SetPropertyUint32(ctx, ret, i, pair);
+  }
+}
+
+/* 0 is the minimum, then HdrHistogram style halving steps towards 100 until the maximum is reached */
+static JSValue
+histogram_percentiles(JSContext* ctx, const Histogram* h, BOOL object) {
+  JSValue ret = object ? JS_NewObject(ctx) : JS_NewArray(ctx);
+  uint32_t i = 0;
+
+  histogram_percentile_add(ctx, ret, object, i++, 0, h->total ? h->min : 0);
+
+  for(double p = 50;; p += (100 - p) / 2) {
+    uint64_t value = histogram_percentile(h, p);
+
+    if(value >= h->max || i >= 64) {
+      histogram_percentile_add(ctx, ret, object, i++, 100, h->max);
+      break;
+    }
+
+    histogram_percentile_add(ctx, ret, object, i++, p, value);
+  }
+
+  return ret;
+}
+
+static JSValue
+js_histogram_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  PerfHistogram* ph;
+  JSValue ret = JS_UNDEFINED;
+
+  if(!(ph = JS_GetOpaque2(ctx, this_val, js_histogram_class_id)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case HISTOGRAM_RECORD: {
+      double value;
+
+      if(JS_IsBigInt(ctx, argv[0])) {
+        int64_t i;
+
+        if(JS_ToBigInt64(ctx, &i, argv[0]))
+          return JS_EXCEPTION;
+
+        value = i;
+      } else if(JS_ToFloat64(ctx, &value, argv[0])) {
+        return JS_EXCEPTION;
+      }
+
+      if(!(value >= 1 && value < 18446744073709551616.0))
+        return JS_ThrowRangeError(ctx, "value must be >= 1 and < 2^64");
+
+      if(histogram_record(&ph->hist, value))
+        return JS_ThrowOutOfMemory(ctx);
+
+      break;
+    }
+
+    case HISTOGRAM_RECORD_DELTA: {
+      uint64_t now = perf_ns();
+
+      if(ph->last && histogram_record(&ph->hist, MAX_NUM(now - ph->last, 1)))
+        return JS_ThrowOutOfMemory(ctx);
+
+      ph->last = now;
+      break;
+    }
+
+    case HISTOGRAM_RESET: {
+      histogram_reset(&ph->hist);
+      ph->last = 0;
+      break;
+    }
+
+    case HISTOGRAM_ADD: {
+      PerfHistogram* other;
+
+      if(!(other = JS_GetOpaque2(ctx, argv[0], js_histogram_class_id)))
+        return JS_EXCEPTION;
+
+      if(histogram_add(&ph->hist, &other->hist))
+        return JS_ThrowOutOfMemory(ctx);
+
+      break;
+    }
+
+    case HISTOGRAM_PERCENTILE: {
+      double p;
+
+      if(JS_ToFloat64(ctx, &p, argv[0]))
+        return JS_EXCEPTION;
+
+      if(!(p > 0 && p <= 100))
+        return JS_ThrowRangeError(ctx, "percentile must be > 0 and <= 100");
+
+      ret = JS_NewInt64(ctx, p == 100 ? ph->hist.max : histogram_percentile(&ph->hist, p));
+      break;
+    }
+
+    case HISTOGRAM_TO_JSON: {
+      ret = JS_NewObject(ctx);
+      JS_SetPropertyStr(ctx, ret, "count", JS_NewInt64(ctx, ph->hist.total));
+      JS_SetPropertyStr(ctx, ret, "min", JS_NewInt64(ctx, ph->hist.min));
+      JS_SetPropertyStr(ctx, ret, "max", JS_NewInt64(ctx, ph->hist.max));
+      JS_SetPropertyStr(ctx, ret, "mean", JS_NewFloat64(ctx, histogram_mean(&ph->hist)));
+      JS_SetPropertyStr(ctx, ret, "exceeds", JS_NewInt64(ctx, ph->hist.exceeds));
+      JS_SetPropertyStr(ctx, ret, "stddev", JS_NewFloat64(ctx, histogram_stddev(&ph->hist)));
+      JS_SetPropertyStr(ctx, ret, "percentiles", histogram_percentiles(ctx, &ph->hist, TRUE));
+      break;
+    }
+  }
+
+  return ret;
+}
+
+enum {
+  HISTOGRAM_COUNT = 0,
+  HISTOGRAM_MIN,
+  HISTOGRAM_MAX,
+  HISTOGRAM_MEAN,
+  HISTOGRAM_STDDEV,
+  HISTOGRAM_EXCEEDS,
+  HISTOGRAM_PERCENTILES,
+};
+
+static JSValue
+js_histogram_get(JSContext* ctx, JSValueConst this_val, int magic) {
+  PerfHistogram* ph;
+  JSValue ret = JS_UNDEFINED;
+
+  if(!(ph = JS_GetOpaque2(ctx, this_val, js_histogram_class_id)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case HISTOGRAM_COUNT: ret = JS_NewInt64(ctx, ph->hist.total); break;
+    case HISTOGRAM_MIN: ret = JS_NewInt64(ctx, ph->hist.min); break;
+    case HISTOGRAM_MAX: ret = JS_NewInt64(ctx, ph->hist.max); break;
+    case HISTOGRAM_MEAN: ret = JS_NewFloat64(ctx, histogram_mean(&ph->hist)); break;
+    case HISTOGRAM_STDDEV: ret = JS_NewFloat64(ctx, histogram_stddev(&ph->hist)); break;
+    case HISTOGRAM_EXCEEDS: ret = JS_NewInt64(ctx, ph->hist.exceeds); break;
+
+    case HISTOGRAM_PERCENTILES: {
+      JSValue pairs = histogram_percentiles(ctx, &ph->hist, FALSE);
+
+      ret = js_global_new(ctx, "Map", 1, &pairs);
+      JS_FreeValue(ctx, pairs);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+#ifdef HAVE_TIMERFD
+static JSValue
+js_histogram_loop_ready(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  PerfHistogram* ph;
+  struct itimerspec its;
+  uint64_t expirations, remaining, lag;
+
+  if(!(ph = JS_GetOpaque(data[0], js_histogram_class_id)) || ph->fd == -1)
+    return JS_UNDEFINED;
+
+  if(read(ph->fd, &expirations, sizeof(expirations)) != sizeof(expirations) || expirations == 0)
+    return JS_UNDEFINED;
+
+  if(timerfd_gettime(ph->fd, &its))
+    return JS_UNDEFINED;
+
+  /* the last expiration was interval - remaining ago, the first one missed that many intervals earlier */
+  remaining = (uint64_t)its.it_value.tv_sec * 1000000000 + its.it_value.tv_nsec;
+  lag = (expirations - 1) * ph->interval + (ph->interval > remaining ? ph->interval - remaining : 0);
+
+  if(histogram_record(&ph->hist, MAX_NUM(lag, 1)))
+    return JS_ThrowOutOfMemory(ctx);
+
+  return JS_UNDEFINED;
+}
+
+static int
+histogram_loop_handler(JSContext* ctx, PerfHistogram* ph, JSValueConst obj) {
+  JSValue set_handler;
+
+  if(JS_IsException((set_handler = js_iohandler_fn(ctx, FALSE, 0))))
+    return -1;
+
+  js_iohandler_set(ctx,
+                   set_handler,
+                   ph->fd,
+                   JS_IsNull(obj) ? JS_NULL : JS_NewCFunctionData(ctx, js_histogram_loop_ready, 0, 0, 1, &obj));
+
+  JS_FreeValue(ctx, set_handler);
+  return 0;
+}
+
+enum {
+  HISTOGRAM_ENABLE = 0,
+  HISTOGRAM_DISABLE,
+};
+
+static JSValue
+js_histogram_interval(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  PerfHistogram* ph;
+  struct itimerspec its = {{0, 0}, {0, 0}};
+
+  if(!(ph = JS_GetOpaque2(ctx, this_val, js_histogram_class_id)))
+    return JS_EXCEPTION;
+
+  if(!ph->interval)
+    return JS_ThrowTypeError(ctx, "not an event loop delay histogram");
+
+  if(ph->enabled == (magic == HISTOGRAM_ENABLE))
+    return JS_FALSE;
+
+  if(magic == HISTOGRAM_ENABLE) {
+    if(ph->fd == -1 && (ph->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+      return JS_ThrowInternalError(ctx, "timerfd_create() failed: %s", strerror(errno));
+
+    its.it_value.tv_sec = its.it_interval.tv_sec = ph->interval / 1000000000;
+    its.it_value.tv_nsec = its.it_interval.tv_nsec = ph->interval % 1000000000;
+  }
+
+  if(timerfd_settime(ph->fd, 0, &its, 0))
+    return JS_ThrowInternalError(ctx, "timerfd_settime() failed: %s", strerror(errno));
+
+  if(histogram_loop_handler(ctx, ph, magic == HISTOGRAM_ENABLE ? this_val : JS_NULL))
+    return JS_EXCEPTION;
+
+  ph->enabled = magic == HISTOGRAM_ENABLE;
+  return JS_TRUE;
+}
+
+/**
+ * monitorEventLoopDelay([resolution = 10])
+ *
+ * Returns a disabled histogram that, once enabled, records every resolution
+ * milliseconds by how many nanoseconds the event loop was late.
+ */
+static JSValue
+js_perf_monitor(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  PerfHistogram* ph;
+  double resolution = 10;
+
+  if(argc > 0 && !JS_IsUndefined(argv[0]) && JS_ToFloat64(ctx, &resolution, argv[0]))
+    return JS_EXCEPTION;
+
+  if(!(resolution >= 1))
+    return JS_ThrowRangeError(ctx, "resolution must be >= 1");
+
+  /* like node.js, delays above one hour only count as exceeding */
+  if(!(ph = perf_histogram_new(ctx, 1, 3600000000000ull, 3)))
+    return JS_EXCEPTION;
+
+  ph->interval = resolution * 1e6;
+  return perf_histogram_wrap(ctx, interval_histogram_proto, ph);
+}
+#endif
+
+static void
+js_histogram_finalizer(JSRuntime* rt, JSValue val) {
+  PerfHistogram* ph;
+
+  if((ph = JS_GetOpaque(val, js_histogram_class_id))) {
+    if(ph->fd != -1)
+      close(ph->fd);
+
+    histogram_free(&ph->hist);
+    js_free_rt(rt, ph);
+  }
+}
+
+static JSClassDef js_timeline_class = {
+    .class_name = "Timeline",
+    .finalizer = js_timeline_finalizer,
+    .gc_mark = js_timeline_mark,
+};
+
+static const JSCFunctionListEntry js_timeline_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("mark", 2, js_timeline_method, TIMELINE_MARK),
+    JS_CFUNC_MAGIC_DEF("measure", 3, js_timeline_method, TIMELINE_MEASURE),
+    JS_CFUNC_MAGIC_DEF("time", 1, js_timeline_method, TIMELINE_TIME),
+    JS_CFUNC_MAGIC_DEF("entries", 0, js_timeline_method, TIMELINE_ENTRIES),
+    JS_CFUNC_MAGIC_DEF("clear", 1, js_timeline_method, TIMELINE_CLEAR),
+    JS_CGETSET_DEF("length", js_timeline_length, 0),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "Timeline", JS_PROP_CONFIGURABLE),
+};
+
+static JSClassDef js_histogram_class = {
+    .class_name = "Histogram",
+    .finalizer = js_histogram_finalizer,
+};
+
+static const JSCFunctionListEntry js_histogram_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("record", 1, js_histogram_method, HISTOGRAM_RECORD),
+    JS_CFUNC_MAGIC_DEF("recordDelta", 0, js_histogram_method, HISTOGRAM_RECORD_DELTA),
+    JS_CFUNC_MAGIC_DEF("reset", 0, js_histogram_method, HISTOGRAM_RESET),
+    JS_CFUNC_MAGIC_DEF("add", 1, js_histogram_method, HISTOGRAM_ADD),
+    JS_CFUNC_MAGIC_DEF("percentile", 1, js_histogram_method, HISTOGRAM_PERCENTILE),
+    JS_CFUNC_MAGIC_DEF("toJSON", 0, js_histogram_method, HISTOGRAM_TO_JSON),
+    JS_CGETSET_MAGIC_DEF("count", js_histogram_get, 0, HISTOGRAM_COUNT),
+    JS_CGETSET_MAGIC_DEF("min", js_histogram_get, 0, HISTOGRAM_MIN),
+    JS_CGETSET_MAGIC_DEF("max", js_histogram_get, 0, HISTOGRAM_MAX),
+    JS_CGETSET_MAGIC_DEF("mean", js_histogram_get, 0, HISTOGRAM_MEAN),
+    JS_CGETSET_MAGIC_DEF("stddev", js_histogram_get, 0, HISTOGRAM_STDDEV),
+    JS_CGETSET_MAGIC_DEF("exceeds", js_histogram_get, 0, HISTOGRAM_EXCEEDS),
+    JS_CGETSET_MAGIC_DEF("percentiles", js_histogram_get, 0, HISTOGRAM_PERCENTILES),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "Histogram", JS_PROP_CONFIGURABLE),
+};
+
+#ifdef HAVE_TIMERFD
+static const JSCFunctionListEntry js_interval_histogram_funcs[] = {
+    JS_CFUNC_MAGIC_DEF("enable", 0, js_histogram_interval, HISTOGRAM_ENABLE),
+    JS_CFUNC_MAGIC_DEF("disable", 0, js_histogram_interval, HISTOGRAM_DISABLE),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "IntervalHistogram", JS_PROP_CONFIGURABLE),
+};
+#endif
+
+static const JSCFunctionListEntry js_perf_funcs[] = {
+    JS_CFUNC_DEF("now", 0, js_perf_now),
+#ifdef HAVE_TIMERFD
+    JS_CFUNC_DEF("monitorEventLoopDelay", 0, js_perf_monitor),
+#endif
+};
+
+int
+js_perf_init(JSContext* ctx, JSModuleDef* m) {
+  if(!perf_origin.tv_sec) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &perf_origin);
+    clock_gettime(CLOCK_REALTIME, &ts);
+    perf_time_origin = ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+  }
+
+  JS_NewClassID(&js_timeline_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_timeline_class_id, &js_timeline_class);
+
+  timeline_ctor = JS_NewCFunction2(ctx, js_timeline_constructor, "Timeline", 2, JS_CFUNC_constructor, 0);
+  timeline_proto = JS_NewObject(ctx);
+  JS_SetPropertyFunctionList(ctx, timeline_proto, js_timeline_funcs, countof(js_timeline_funcs));
+  JS_SetClassProto(ctx, js_timeline_class_id, timeline_proto);
+  JS_SetConstructor(ctx, timeline_ctor, timeline_proto);
+
+  JS_NewClassID(&js_histogram_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_histogram_class_id, &js_histogram_class);
+
+  histogram_ctor = JS_NewCFunction2(ctx, js_histogram_constructor, "Histogram", 1, JS_CFUNC_constructor, 0);
+  histogram_proto = JS_NewObject(ctx);
+  JS_SetPropertyFunctionList(ctx, histogram_proto, js_histogram_funcs, countof(js_histogram_funcs));
+  JS_SetClassProto(ctx, js_histogram_class_id, histogram_proto);
+  JS_SetConstructor(ctx, histogram_ctor, histogram_proto);
+
+#ifdef HAVE_TIMERFD
+  interval_histogram_proto = JS_NewObjectProto(ctx, histogram_proto);
+  JS_SetPropertyFunctionList(ctx, interval_histogram_proto, js_interval_histogram_funcs, countof(js_interval_histogram_funcs));
+#endif
+
+  if(m) {
+    JS_SetModuleExportList(ctx, m, js_perf_funcs, countof(js_perf_funcs));
+    JS_SetModuleExport(ctx, m, "timeOrigin", JS_NewFloat64(ctx, perf_time_origin));
+    JS_SetModuleExport(ctx, m, "Timeline", timeline_ctor);
+    JS_SetModuleExport(ctx, m, "Histogram", histogram_ctor);
+  }
+
+  return 0;
+}
+
+#ifdef JS_SHARED_LIBRARY
+#define JS_INIT_MODULE js_init_module
+#else
+#define JS_INIT_MODULE js_init_module_perf
+#endif
+
+VISIBLE JSModuleDef*
+JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
+  JSModuleDef* m;
+
+  if((m = JS_NewCModule(ctx, module_name, js_perf_init))) {
+    JS_AddModuleExportList(ctx, m, js_perf_funcs, countof(js_perf_funcs));
+    JS_AddModuleExport(ctx, m, "timeOrigin");
+    JS_AddModuleExport(ctx, m, "Timeline");
+    JS_AddModuleExport(ctx, m, "Histogram");
+  }
+
+  return m;
+}
+
+/**
+ * @}
+ */
@@ -13,7 +13,7 @@
  */
 
 VISIBLE JSClassID js_pgsqlerror_class_id = 0, js_pgconn_class_id = 0, js_pgresult_class_id = 0;
-static JSValue pgsqlerror_proto, pgsqlerror_ctor,
+static thread_local JSValue pgsqlerror_proto, pgsqlerror_ctor,
                 pgsql_proto, pgsql_ctor,
                 pgresult_proto, pgresult_ctor;
 
@@ -16,7 +16,7 @@ VISIBLE
 __declspec(dllexport)
 #endif
     JSClassID js_pointer_class_id = 0;
-static JSValue pointer_proto, pointer_ctor;
+static thread_local JSValue pointer_proto, pointer_ctor;
 
 enum {
   STATIC_FROM = 0,
@@ -9,7 +9,7 @@
  * @{
  */
 VISIBLE JSClassID js_predicate_class_id = 0;
-static JSValue predicate_proto, predicate_ctor;
+static thread_local JSValue predicate_proto, predicate_ctor;
 
 enum PredicateId
 predicate_id(JSValueConst value) {
@@ -12,7 +12,7 @@ static JSValue js_repeater_push(JSContext*, JSValueConst, int, JSValueConst[]);
 static JSValue js_repeater_stop(JSContext*, JSValueConst, int, JSValueConst[]);
 
 VISIBLE JSClassID js_repeater_class_id = 0;
-static JSValue repeater_proto, repeater_ctor;
+static thread_local JSValue repeater_proto, repeater_ctor;
 
 enum repeater_functions {
   STATIC_RACE = 0,
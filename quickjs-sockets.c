@@ -20,6 +20,10 @@ typedef int SOCKET;
 #include <arpa/inet.h>
 #include <poll.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
 #endif
 
 #include <fcntl.h>
@@ -48,14 +52,16 @@ static int js_sockets_init(JSContext*, JSModuleDef*);
 static int js_socket_type(JSContext*, SockType*, int, JSValueConst[]);
 static JSValue js_socket_method(JSContext*, JSValueConst, int, JSValueConst[], int);
 static int js_socket_fd(JSValueConst);
+static int js_fd_value(JSContext*, JSValueConst);
 static BOOL js_socket_check_open(JSContext*, Socket);
 static JSValue js_socket_create(JSContext*, JSValueConst, int, JSValueConst[], BOOL);
 static JSValue js_socket_new_proto(JSContext*, JSValueConst, int, BOOL, BOOL);
 static int js_socket_address_family(JSValueConst);
 static int js_sockaddr_init(JSContext*, int, JSValueConst[], SockAddr*);
 
-JSClassID js_sockaddr_class_id = 0, js_socket_class_id = 0, js_asyncsocket_class_id = 0;
-static JSValue sockaddr_proto, sockaddr_ctor, socket_proto, asyncsocket_proto, socket_ctor, asyncsocket_ctor;
+JSClassID js_sockaddr_class_id = 0, js_socket_class_id = 0, js_asyncsocket_class_id = 0, js_msgbatch_class_id = 0;
+static thread_local JSValue sockaddr_proto, sockaddr_ctor, socket_proto, asyncsocket_proto, socket_ctor, asyncsocket_ctor,
+    msgbatch_proto, msgbatch_ctor;
 
 static const char* socketcall_names[] = {
     "socket",      "getsockname", "getpeername",
@@ -66,6 +72,7 @@ static const char* socketcall_names[] = {
 #endif
     "bind",        "accept",      "accept4",     "connect",    "listen",  "recv",    "recvfrom", "send",     "sendto",
     "shutdown",    "close",       "getsockopt",  "setsockopt", "recvmsg", "sendmsg", "recvmmsg", "sendmmsg",
+    "sendfile",    "splice",
 };
 
 static const char*
@@ -709,6 +716,333 @@ mmsgs_write(JSContext* ctx, JSValueConst arg, MultiMessageHeader mm) {
   return TRUE;
 }
 
+/**
+ * MessageBatch: a preallocated ring of fixed-size packet slots for
+ * recvmmsg()/sendmmsg(). Payloads, lengths and peer addresses live in
+ * ArrayBuffers created once with the batch, and the same views are handed
+ * out on every access, so no JS objects are created per packet.  A call
+ * starting at slot 'start' continues at slot 0 after the last one.
+ */
+typedef struct {
+  uint32_t count, slot_size;
+  uint8_t* data;
+  uint32_t* lengths;
+  SockAddr* addrs;
+  JSValue buffer, lengths_array, addresses; /* own data, lengths and addrs */
+  struct mmsghdr* msgvec;
+  struct iovec* iov;
+} MessageBatch;
+
+enum {
+  MSGBATCH_COUNT,
+  MSGBATCH_SLOTSIZE,
+  MSGBATCH_BUFFER,
+  MSGBATCH_LENGTHS,
+  MSGBATCH_ADDRESSES,
+};
+
+static MessageBatch*
+js_msgbatch_data(JSValueConst value) {
+  return JS_GetOpaque(value, js_msgbatch_class_id);
+}
+
+static MessageBatch*
+js_msgbatch_data2(JSContext* ctx, JSValueConst value) {
+  return JS_GetOpaque2(ctx, value, js_msgbatch_class_id);
+}
+
+static void
+msgbatch_free(JSRuntime* rt, MessageBatch* mb) {
+  JS_FreeValueRT(rt, mb->buffer);
+  JS_FreeValueRT(rt, mb->lengths_array);
+  JS_FreeValueRT(rt, mb->addresses);
+  js_free_rt(rt, mb->msgvec);
+  js_free_rt(rt, mb->iov);
+  js_free_rt(rt, mb);
+}
+
+/* a zeroed ArrayBuffer of \param size bytes, its memory is returned in \param ptr */
+static JSValue
+msgbatch_arraybuffer(JSContext* ctx, size_t size, void** ptr) {
+  JSValue buf;
+
+  if(!(*ptr = js_mallocz(ctx, size)))
+    return JS_EXCEPTION;
+
+  if(JS_IsException((buf = JS_NewArrayBuffer(ctx, *ptr, size, js_arraybuffer_freeptr, 0, FALSE)))) {
+    js_free(ctx, *ptr);
+    *ptr = 0;
+  }
+
+  return buf;
+}
+
+/**
+ * Prepares the message headers for slots [start, start + n) before a
+ * recvmmsg() (full slots, address buffers) or sendmmsg() (lengths[] bytes,
+ * addresses with family 0 are sent unaddressed).
+ */
+static void
+msgbatch_prepare(MessageBatch* mb, uint32_t start, uint32_t n, BOOL send) {
+  for(uint32_t i = start; i < start + n; i++) {
+    struct msghdr* m = &mb->msgvec[i].msg_hdr;
+
+    mb->iov[i].iov_base = mb->data + (size_t)i * mb->slot_size;
+    mb->iov[i].iov_len = send ? MIN_NUM(mb->lengths[i], mb->slot_size) : mb->slot_size;
+
+    m->msg_iov = &mb->iov[i];
+    m->msg_iovlen = 1;
+    m->msg_control = 0;
+    m->msg_controllen = 0;
+    m->msg_flags = 0;
+
+    if(send) {
+      m->msg_name = mb->addrs[i].family ? &mb->addrs[i] : 0;
+      m->msg_namelen = mb->addrs[i].family ? sockaddr_len(&mb->addrs[i]) : 0;
+    } else {
+      memset(&mb->addrs[i], 0, sizeof(SockAddr));
+      m->msg_name = &mb->addrs[i];
+      m->msg_namelen = sizeof(SockAddr);
+    }
+
+    mb->msgvec[i].msg_len = 0;
+  }
+}
+
+/**
+ * recvmmsg()/sendmmsg() on \param n slots from \param start on, wrapping
+ * around after the last slot.  After the wrap, recvmmsg() only takes the
+ * messages that are already queued.
+ *
+ * @return  the number of messages, -1 if none could be transferred
+ */
+static int
+msgbatch_call(MessageBatch* mb, int fd, uint32_t start, uint32_t n, int flags, struct timespec* timeout, BOOL send) {
+  uint32_t first = MIN_NUM(n, mb->count - start);
+  int r, r2;
+
+  msgbatch_prepare(mb, start, first, send);
+
+  if((r = send ? sendmmsg(fd, &mb->msgvec[start], first, flags)
+               : recvmmsg(fd, &mb->msgvec[start], first, flags, timeout)) == (int)first &&
+     n > first) {
+    msgbatch_prepare(mb, 0, n - first, send);
+
+    if((r2 = send ? sendmmsg(fd, mb->msgvec, n - first, flags)
+                  : recvmmsg(fd, mb->msgvec, n - first, flags | MSG_DONTWAIT, 0)) > 0)
+      r += r2;
+  }
+
+  if(!send)
+    for(int i = 0; i < r; i++) {
+      uint32_t j = (start + i) % mb->count;
+
+      mb->lengths[j] = mb->msgvec[j].msg_len;
+    }
+
+  return r;
+}
+
+static JSValue
+js_msgbatch_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
+  JSValue proto, obj = JS_UNDEFINED;
+  MessageBatch* mb;
+  uint32_t count = 0, slot_size = 0;
+
+  if(js_sockaddr_class_id == 0 && js_socket_class_id == 0 && js_asyncsocket_class_id == 0)
+    js_sockets_init(ctx, 0);
+
+  if(JS_ToUint32(ctx, &count, argv[0]) || JS_ToUint32(ctx, &slot_size, argv[1]))
+    return JS_EXCEPTION;
+
+  if(count == 0 || slot_size == 0)
+    return JS_ThrowRangeError(ctx, "MessageBatch count and slot size must be greater than 0");
+
+  if(!(mb = js_mallocz(ctx, sizeof(MessageBatch))))
+    return JS_EXCEPTION;
+
+  mb->count = count;
+  mb->slot_size = slot_size;
+  mb->buffer = mb->lengths_array = mb->addresses = JS_UNDEFINED;
+
+  if(JS_IsException((mb->buffer = msgbatch_arraybuffer(ctx, (size_t)count * slot_size, (void**)&mb->data))) ||
+     JS_IsException((mb->addresses = msgbatch_arraybuffer(ctx, sizeof(SockAddr) * count, (void**)&mb->addrs))) ||
+     !(mb->msgvec = js_mallocz(ctx, sizeof(struct mmsghdr) * count)) ||
+     !(mb->iov = js_mallocz(ctx, sizeof(struct iovec) * count)))
+    goto fail;
+
+  {
+    JSValue buf = msgbatch_arraybuffer(ctx, sizeof(uint32_t) * count, (void**)&mb->lengths);
+
+    if(JS_IsException(buf))
+      goto fail;
+
+    mb->lengths_array = js_typedarray_new(ctx, 32, FALSE, FALSE, buf);
+    JS_FreeValue(ctx, buf);
+
+    if(JS_IsException(mb->lengths_array))
+      goto fail;
+  }
+
+  proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+  if(JS_IsException(proto))
+    goto fail;
+
+  obj = JS_NewObjectProtoClass(ctx, proto, js_msgbatch_class_id);
+  JS_FreeValue(ctx, proto);
+
+  if(JS_IsException(obj))
+    goto fail;
+
+  JS_SetOpaque(obj, mb);
+  return obj;
+
+fail:
+  msgbatch_free(JS_GetRuntime(ctx), mb);
+  return JS_EXCEPTION;
+}
+
+static JSValue
+js_msgbatch_get(JSContext* ctx, JSValueConst this_val, int magic) {
+  MessageBatch* mb;
+  JSValue ret = JS_UNDEFINED;
+
+  if(!(mb = js_msgbatch_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  switch(magic) {
+    case MSGBATCH_COUNT: {
+      ret = JS_NewUint32(ctx, mb->count);
+      break;
+    }
+
+    case MSGBATCH_SLOTSIZE: {
+      ret = JS_NewUint32(ctx, mb->slot_size);
+      break;
+    }
+
+    case MSGBATCH_BUFFER: {
+      ret = JS_DupValue(ctx, mb->buffer);
+      break;
+    }
+
+    case MSGBATCH_LENGTHS: {
+      ret = JS_DupValue(ctx, mb->lengths_array);
+      break;
+    }
+
+    case MSGBATCH_ADDRESSES: {
+      ret = JS_DupValue(ctx, mb->addresses);
+      break;
+    }
+  }
+
+  return ret;
+}
+
+enum {
+  MSGBATCH_SLOT,
+  MSGBATCH_ADDRESS,
+  MSGBATCH_SETADDRESS,
+};
+
+static JSValue
+js_msgbatch_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  MessageBatch* mb;
+  JSValue ret = JS_UNDEFINED;
+  uint32_t i;
+
+  if(!(mb = js_msgbatch_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(JS_ToUint32(ctx, &i, argv[0]))
+    return JS_EXCEPTION;
+
+  if(i >= mb->count)
+    return JS_ThrowRangeError(ctx, "slot index %u out of range (count = %u)", i, mb->count);
+
+  switch(magic) {
+    case MSGBATCH_SLOT: {
+      JSValue args[3] = {
+          mb->buffer,
+          JS_NewInt64(ctx, (int64_t)i * mb->slot_size),
+          JS_NewUint32(ctx, argc > 1 && JS_ToBool(ctx, argv[1]) ? mb->slot_size : MIN_NUM(mb->lengths[i], mb->slot_size)),
+      };
+      JSValue ctor = js_global_get_str(ctx, "Uint8Array");
+
+      ret = JS_CallConstructor(ctx, ctor, countof(args), args);
+      JS_FreeValue(ctx, ctor);
+      break;
+    }
+
+    case MSGBATCH_ADDRESS: {
+      SockAddr* a;
+
+      if(mb->addrs[i].family == 0)
+        break;
+
+      if(!(a = js_mallocz(ctx, sizeof(SockAddr))))
+        return JS_EXCEPTION;
+
+      *a = mb->addrs[i];
+      ret = js_sockaddr_wrap(ctx, a);
+      break;
+    }
+
+    case MSGBATCH_SETADDRESS: {
+      SockAddr* a;
+
+      if(js_is_nullish(ctx, argv[1]))
+        memset(&mb->addrs[i], 0, sizeof(SockAddr));
+      else if((a = js_sockaddr_data2(ctx, argv[1])))
+        mb->addrs[i] = *a;
+      else
+        return JS_EXCEPTION;
+
+      break;
+    }
+  }
+
+  return ret;
+}
+
+static void
+js_msgbatch_finalizer(JSRuntime* rt, JSValue val) {
+  MessageBatch* mb;
+
+  if((mb = js_msgbatch_data(val)))
+    msgbatch_free(rt, mb);
+}
+
+static void
+js_msgbatch_mark(JSRuntime* rt, JSValueConst val, JS_MarkFunc* mark_func) {
+  MessageBatch* mb;
+
+  if((mb = js_msgbatch_data(val))) {
+    JS_MarkValue(rt, mb->buffer, mark_func);
+    JS_MarkValue(rt, mb->lengths_array, mark_func);
+    JS_MarkValue(rt, mb->addresses, mark_func);
+  }
+}
+
+static const JSCFunctionListEntry js_msgbatch_proto_funcs[] = {
+    JS_CGETSET_MAGIC_FLAGS_DEF("count", js_msgbatch_get, 0, MSGBATCH_COUNT, JS_PROP_ENUMERABLE),
+    JS_CGETSET_MAGIC_FLAGS_DEF("slotSize", js_msgbatch_get, 0, MSGBATCH_SLOTSIZE, JS_PROP_ENUMERABLE),
+    JS_CGETSET_MAGIC_DEF("buffer", js_msgbatch_get, 0, MSGBATCH_BUFFER),
+    JS_CGETSET_MAGIC_DEF("lengths", js_msgbatch_get, 0, MSGBATCH_LENGTHS),
+    JS_CGETSET_MAGIC_DEF("addresses", js_msgbatch_get, 0, MSGBATCH_ADDRESSES),
+    JS_CFUNC_MAGIC_DEF("slot", 1, js_msgbatch_method, MSGBATCH_SLOT),
+    JS_CFUNC_MAGIC_DEF("address", 1, js_msgbatch_method, MSGBATCH_ADDRESS),
+    JS_CFUNC_MAGIC_DEF("setAddress", 2, js_msgbatch_method, MSGBATCH_SETADDRESS),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "MessageBatch", JS_PROP_CONFIGURABLE),
+};
+
+static JSClassDef js_msgbatch_class = {
+    .class_name = "MessageBatch",
+    .finalizer = js_msgbatch_finalizer,
+    .gc_mark = js_msgbatch_mark,
+};
+
 static BOOL
 timeval_read(JSContext* ctx, JSValueConst arg, struct timeval* tv) {
   if(JS_IsNumber(arg)) {
@@ -1108,6 +1442,37 @@ js_select(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[])
   return JS_NewInt64(ctx, ret);
 }
 
+#ifdef HAVE_SPLICE
+static JSValue
+js_splice(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  int32_t fd_in, fd_out;
+  int64_t length = 65536;
+  uint32_t flags = SPLICE_F_MOVE;
+  ssize_t ret;
+
+  if(argc < 2 || js_is_nullish(ctx, argv[0]) || js_is_nullish(ctx, argv[1]))
+    return JS_ThrowTypeError(ctx, "splice() requires an input and an output file descriptor");
+
+  fd_in = js_fd_value(ctx, argv[0]);
+  fd_out = js_fd_value(ctx, argv[1]);
+
+  if(argc > 2 && !js_is_nullish(ctx, argv[2]))
+    JS_ToInt64(ctx, &length, argv[2]);
+
+  if(argc > 3)
+    JS_ToUint32(ctx, &flags, argv[3]);
+
+  if((ret = splice(fd_in, NULL, fd_out, NULL, length, flags)) == -1) {
+    if(errno == EAGAIN && (flags & SPLICE_F_NONBLOCK))
+      return JS_NewInt32(ctx, -1);
+
+    return JS_Throw(ctx, js_syscallerror_new(ctx, "splice", errno));
+  }
+
+  return JS_NewInt64(ctx, ret);
+}
+#endif
+
 #ifndef _WIN32
 static JSValue
 js_poll(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
@@ -1229,6 +1594,72 @@ fd_address_family(int fd) {
   return a.family;
 }
 
+#ifndef _WIN32
+/**
+ * Transfers up to \p count bytes from file descriptor \p in_fd to the socket.
+ *
+ * Uses sendfile() where available, so the data never passes through
+ * userspace. Otherwise falls back to a pread()/send() loop.
+ *
+ * @param  offset  file offset to start reading from, or -1 for the current file position
+ */
+static ssize_t
+fd_sendfile(int out_fd, int in_fd, int64_t offset, size_t count) {
+#ifdef HAVE_SENDFILE
+  off_t off = offset;
+
+  return sendfile(out_fd, in_fd, offset >= 0 ? &off : NULL, count);
+#else
+  char buf[65536];
+  ssize_t r = 0, n = 0;
+
+  while(count > 0) {
+    size_t len = MIN_NUM(count, sizeof(buf));
+
+    if((r = offset >= 0 ? pread(in_fd, buf, len, offset + n) : read(in_fd, buf, len)) <= 0)
+      break;
+
+    if((r = send(out_fd, buf, r, 0)) <= 0)
+      break;
+
+    n += r;
+    count -= r;
+  }
+
+  return n > 0 ? n : r;
+#endif
+}
+
+/**
+ * Returns the number of bytes between \p offset (or the current position)
+ * and the end of the file referred to by \p fd.
+ */
+static int64_t
+fd_remaining(int fd, int64_t offset) {
+  struct stat st;
+
+  if(fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+    return -1;
+
+  if(offset < 0)
+    offset = lseek(fd, 0, SEEK_CUR);
+
+  return offset < st.st_size ? st.st_size - offset : 0;
+}
+#endif
+
+static int
+js_fd_value(JSContext* ctx, JSValueConst value) {
+  int32_t fd = -1;
+
+  if(JS_IsObject(value))
+    fd = js_socket_fd(value);
+  else
+    JS_ToInt32(ctx, &fd, value);
+
+  return fd;
+}
+
 static BOOL
 socket_is_nonblocking(Socket s) {
 #ifdef _WIN32
@@ -1267,7 +1698,7 @@ socket_method(int magic) {
       "connect",
       "listen",
       0,
-      0,
+      "acceptMany",
       0,
       "recv",
       "send",
@@ -1281,6 +1712,12 @@ socket_method(int magic) {
       "close",
   };
 
+  /* these share the low bits of METHOD_SEND */
+  if((magic & 0xff) == 0x29 /* METHOD_SENDFILE */)
+    return "sendFile";
+  if((magic & 0xff) == 0x39 /* METHOD_SPLICE */)
+    return "splice";
+
   return methods[magic & 0x0f];
 }
 
@@ -1310,6 +1747,7 @@ enum {
   METHOD_ACCEPT = 0x02,
   METHOD_CONNECT = 0x03,
   METHOD_LISTEN = 0x04,
+  METHOD_ACCEPTMANY = 0x06 /* 0b00110 */,
   METHOD_RECV = 0x08 /* 0b01000 */,
   METHOD_SEND = 0x09 /* 0b01001 */,
   METHOD_RECVFROM = 0x0a /* 0b01010 */,
@@ -1322,6 +1760,8 @@ enum {
   METHOD_SETSOCKOPT,
   METHOD_SHUTDOWN,
   METHOD_CLOSE,
+  METHOD_SENDFILE = 0x29 /* 0b101001 */,
+  METHOD_SPLICE = 0x39 /* 0b111001 */,
 };
 
 enum {
@@ -1344,6 +1784,18 @@ enum {
   ASYNC_WAITONLY = 1 << 17,
 };
 
+/**
+ * Number of method arguments an async call keeps in its data[] until the
+ * socket becomes ready.
+ */
+static int
+js_asyncsocket_argn(int magic) {
+  if((magic & 0x0f) == METHOD_ACCEPTMANY)
+    return 2;
+
+  return (magic & 0xe) == 0xa ? 5 : (magic & 0x8) ? 4 : 1;
+}
+
 /**
  *   data[0]   Socket
  *   data[1]   resolve function
@@ -1360,7 +1812,7 @@ js_asyncsocket_resolve(
   AsyncSocket* asock = js_asyncsocket_data(data[0]);
   JSValueConst value = data[0];
   BOOL is_exception = FALSE;
-  int argn = (magic & 0xe) == 0xa ? 5 : (magic & 0x8) ? 4 : 1;
+  int argn = js_asyncsocket_argn(magic);
 
   assert(JS_VALUE_GET_TAG(data[1]) == JS_TAG_OBJECT);
   assert(JS_VALUE_GET_OBJ(data[1]));
@@ -1444,7 +1896,7 @@ js_asyncsocket_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueCo
   data_len = 4;
 
   if(magic >= 2) {
-    int argn = (magic & 0xe) == 0xa ? 5 : (magic & 0x8) ? 4 : 1;
+    int argn = js_asyncsocket_argn(magic);
 
     for(int i = 0; i < argn; i++)
       data[data_len++] = i < argc ? argv[i] : JS_UNDEFINED;
@@ -1596,6 +2048,7 @@ js_socket_error(JSContext* ctx, Socket sock) {
   if((err = socket_error(sock)))
     if(!(sock.nonblock &&
          ((sock.sysno == SYSCALL_RECV && err == EAGAIN) || (sock.sysno == SYSCALL_SEND && err == EWOULDBLOCK) ||
+          ((sock.sysno == SYSCALL_SENDFILE || sock.sysno == SYSCALL_SPLICE) && err == EAGAIN) ||
           (sock.sysno == SYSCALL_CONNECT && err == EINPROGRESS))))
       ret = JS_Throw(ctx, js_syscallerror_new(ctx, socket_syscall(sock), err));
 
@@ -1723,7 +2176,9 @@ js_socket_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst a
       case METHOD_SEND:
       case METHOD_SENDTO:
       case METHOD_RECVMSG:
-      case METHOD_SENDMSG: {
+      case METHOD_SENDMSG:
+      case METHOD_SENDFILE:
+      case METHOD_SPLICE: {
         return JS_ThrowInternalError(ctx, "socket %s() wait assert", socket_method(magic));
         assert(0);
         break;
@@ -1777,6 +2232,45 @@ js_socket_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst a
       break;
     }
 
+    case METHOD_ACCEPTMANY: {
+      uint32_t i = 0, max = UINT32_MAX;
+      int32_t flags = s->nonblock ? SOCK_NONBLOCK : 0;
+      BOOL async = socket_is_nonblocking(*s);
+      int fd = -1;
+
+      if(argc > 0 && JS_IsNumber(argv[0]))
+        JS_ToUint32(ctx, &max, argv[0]);
+
+      if(argc > 1 && JS_IsNumber(argv[1]))
+        JS_ToInt32(ctx, &flags, argv[1]);
+
+      ret = JS_NewArray(ctx);
+
+      /* acceptMany(0) accepts nothing */
+      if(max == 0)
+        break;
+
+      /* drain the backlog; a blocking listener only yields one connection */
+      while(i < max) {
+        socketcall_return(s, SYSCALL_ACCEPT4, (fd = accept4(socket_handle(*s), 0, 0, flags)));
+
+        if(fd < 0)
+          break;
+
+        JS_SetPropertyUint32(ctx, ret, i++, socket_adopt(ctx, fd, async));
+
+        if(!s->nonblock)
+          break;
+      }
+
+      if(i == 0 && fd < 0 && !(s->nonblock && (s->error == EAGAIN || s->error == EWOULDBLOCK))) {
+        JS_FreeValue(ctx, ret);
+        ret = JS_Throw(ctx, js_syscallerror_new(ctx, socket_syscall(*s), socket_error(*s)));
+      }
+
+      break;
+    }
+
     case METHOD_CONNECT: {
       JS_SOCKETCALL(SYSCALL_CONNECT, s, connect(socket_handle(*s), &a->s, sockaddr_len(a)));
 
@@ -1866,6 +2360,72 @@ js_socket_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst a
       break;
     }
 
+#ifndef _WIN32
+    case METHOD_SENDFILE: {
+      if(JS_IsNumber(argv[0])) {
+        int32_t fd = -1;
+        int64_t offset = -1, length = -1;
+
+        JS_ToInt32(ctx, &fd, argv[0]);
+
+        if(argc > 1 && !js_is_nullish(ctx, argv[1]))
+          JS_ToInt64(ctx, &offset, argv[1]);
+
+        if(argc > 2 && !js_is_nullish(ctx, argv[2]))
+          JS_ToInt64(ctx, &length, argv[2]);
+
+        if(length < 0 && (length = fd_remaining(fd, offset)) < 0)
+          return JS_ThrowRangeError(ctx, "argument 3 (length) required for non-regular file #%d", fd);
+
+        JS_SOCKETCALL(SYSCALL_SENDFILE, s, fd_sendfile(socket_handle(*s), fd, offset, length));
+      } else {
+        /* ArrayBuffer sources, typically a region returned by mmap(), are sent straight from the mapping */
+        InputBuffer buf = js_input_buffer(ctx, argv[0]);
+        OffsetLength off = OFFSETLENGTH_INIT();
+
+        if(!buf.data) {
+          input_buffer_free(&buf, ctx);
+          return JS_ThrowTypeError(ctx, "argument 1 must be a file descriptor or an ArrayBuffer");
+        }
+
+        js_offset_length(ctx, buf.size, argc - 1, argv + 1, 0, &off);
+
+        JS_SOCKETCALL(SYSCALL_SENDFILE,
+                      s,
+                      send(socket_handle(*s), offsetlength_data(off, buf.data), offsetlength_size(off, buf.size), 0));
+
+        input_buffer_free(&buf, ctx);
+      }
+
+      break;
+    }
+#endif
+
+#ifdef HAVE_SPLICE
+    case METHOD_SPLICE: {
+      int32_t fd;
+      uint32_t flags = SPLICE_F_MOVE;
+      int64_t length = 65536;
+
+      if(argc < 1 || js_is_nullish(ctx, argv[0]))
+        return JS_ThrowTypeError(ctx, "argument 1 must be a file descriptor");
+
+      fd = js_fd_value(ctx, argv[0]);
+
+      if(argc > 1 && !js_is_nullish(ctx, argv[1]))
+        JS_ToInt64(ctx, &length, argv[1]);
+
+      if(argc > 2)
+        JS_ToUint32(ctx, &flags, argv[2]);
+
+      if(s->nonblock)
+        flags |= SPLICE_F_NONBLOCK;
+
+      JS_SOCKETCALL(SYSCALL_SPLICE, s, splice(fd, NULL, socket_handle(*s), NULL, length, flags));
+      break;
+    }
+#endif
+
     case METHOD_GETSOCKOPT: {
       int32_t level, optname;
       uint32_t optlen = sizeof(int);
@@ -2003,6 +2563,40 @@ js_socket_method(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst a
       int32_t flags = 0;
       MultiMessageHeader mmh = {0, 0};
       struct timespec ts = {}, *tptr = 0;
+      MessageBatch* mb;
+
+      if((mb = js_msgbatch_data(argv[0]))) {
+        uint32_t start = 0, n = mb->count;
+
+        /*
+         * recvmmsg(batch, flags, timeout, start) fills up to all slots,
+         * sendmmsg(batch, flags, count, start) sends count slots, both from
+         * slot start on and wrapping around.
+         */
+        if(argc > 1)
+          JS_ToInt32(ctx, &flags, argv[1]);
+
+        if(argc > 3 && JS_IsNumber(argv[3]))
+          JS_ToUint32(ctx, &start, argv[3]);
+
+        start %= mb->count;
+
+        if(magic == METHOD_SENDMMSG) {
+          uint32_t count;
+
+          if(argc > 2 && JS_IsNumber(argv[2]) && !JS_ToUint32(ctx, &count, argv[2]))
+            n = MIN_NUM(n, count);
+        } else if(argc > 2 && timespec_read(ctx, argv[2], &ts)) {
+          tptr = &ts;
+        }
+
+        if(magic == METHOD_SENDMMSG)
+          JS_SOCKETCALL(SYSCALL_SENDMMSG, s, (r = msgbatch_call(mb, socket_handle(*s), start, n, flags, 0, TRUE)));
+        else
+          JS_SOCKETCALL(SYSCALL_RECVMMSG, s, (r = msgbatch_call(mb, socket_handle(*s), start, n, flags, tptr, FALSE)));
+
+        break;
+      }
 
       if(!mmsgs_read(ctx, argv[0], &mmh)) {
         ret = JS_ThrowInternalError(ctx, "Error parsing mmsghdr structure");
@@ -2232,6 +2826,148 @@ js_socket_valueof(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst
   return JS_NewInt32(ctx, socket_handle(s));
 }
 
+static JSValue
+js_asyncsocket_connections_next(
+    JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  AsyncSocket* s;
+  JSValue ret, promise, then;
+
+  if(!(s = js_asyncsocket_data(data[0])) || !socket_open(*(Socket*)s)) {
+    JSValue result = js_iterator_result(ctx, JS_UNDEFINED, TRUE);
+
+    ret = js_promise_resolve(ctx, result);
+    JS_FreeValue(ctx, result);
+    return ret;
+  }
+
+  promise = js_asyncsocket_method(ctx, data[0], 2, &data[1], METHOD_ACCEPTMANY);
+
+  if(JS_IsException(promise))
+    return promise;
+
+  then = js_iterator_then(ctx, FALSE);
+  ret = js_promise_then(ctx, promise, then);
+  JS_FreeValue(ctx, then);
+  JS_FreeValue(ctx, promise);
+
+  return ret;
+}
+
+static JSValue
+js_asyncsocket_connections_iterator(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  return JS_DupValue(ctx, this_val);
+}
+
+static const JSCFunctionListEntry js_asyncsocket_connections_funcs[] = {
+    JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, js_asyncsocket_connections_iterator),
+};
+
+/**
+ * Returns an async iterator which yields arrays of accepted sockets, one
+ * array per readiness event on the listening socket.
+ */
+static JSValue
+js_asyncsocket_connections(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  JSValue ret, data[] = {this_val, argc > 0 ? argv[0] : JS_UNDEFINED, argc > 1 ? argv[1] : JS_UNDEFINED};
+
+  if(!js_asyncsocket_data2(ctx, this_val))
+    return JS_EXCEPTION;
+
+  ret = JS_NewObject(ctx);
+  JS_SetPropertyStr(
+      ctx, ret, "next", JS_NewCFunctionData(ctx, js_asyncsocket_connections_next, 0, 0, countof(data), data));
+  JS_SetPropertyFunctionList(ctx, ret, js_asyncsocket_connections_funcs, countof(js_asyncsocket_connections_funcs));
+
+  return ret;
+}
+
+#ifdef SO_REUSEPORT
+static int
+reuseport_listener(const SockAddr* a, int backlog, const char** syscall) {
+  int fd, err, one = 1;
+
+  *syscall = "socket";
+
+  if((fd = socket(a->family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) == -1)
+    return -1;
+
+  *syscall = "setsockopt";
+
+  if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1 ||
+     setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1)
+    goto fail;
+
+  *syscall = "bind";
+
+  if(bind(fd, &a->s, sockaddr_len(a)) == -1)
+    goto fail;
+
+  *syscall = "listen";
+
+  if(listen(fd, backlog) == -1)
+    goto fail;
+
+  return fd;
+
+fail:
+  err = errno;
+  close(fd);
+  errno = err;
+  return -1;
+}
+
+/**
+ * reuseport(addr, count, backlog)
+ *
+ * Opens `count` non-blocking listeners on the same address with
+ * SO_REUSEPORT set, so the kernel spreads incoming connections over them.
+ * Returns an array of file descriptors, to be handed to workers and
+ * wrapped with Socket.adopt().
+ */
+static JSValue
+js_socket_reuseport(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  SockAddr* a;
+  uint32_t i, count = 1;
+  int32_t backlog = SOMAXCONN;
+  int* fds;
+  JSValue ret;
+
+  if(!(a = js_sockaddr_data2(ctx, argv[0])))
+    return JS_EXCEPTION;
+
+  if(argc > 1 && JS_ToUint32(ctx, &count, argv[1]))
+    return JS_EXCEPTION;
+
+  if(argc > 2 && JS_IsNumber(argv[2]))
+    JS_ToInt32(ctx, &backlog, argv[2]);
+
+  if(!(fds = js_malloc(ctx, sizeof(int) * MAX_NUM(count, 1))))
+    return JS_EXCEPTION;
+
+  for(i = 0; i < count; i++) {
+    const char* syscall;
+
+    if((fds[i] = reuseport_listener(a, backlog, &syscall)) == -1) {
+      int err = errno;
+
+      while(i > 0)
+        close(fds[--i]);
+
+      js_free(ctx, fds);
+      return JS_Throw(ctx, js_syscallerror_new(ctx, syscall, err));
+    }
+  }
+
+  ret = JS_NewArray(ctx);
+
+  for(i = 0; i < count; i++)
+    JS_SetPropertyUint32(ctx, ret, i, JS_NewInt32(ctx, fds[i]));
+
+  js_free(ctx, fds);
+  return ret;
+}
+#endif
+
 static JSValue
 js_socket_adopt(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
   int32_t fd = -1;
@@ -2281,6 +3017,12 @@ static const JSCFunctionListEntry js_sockets_funcs[] = {
     JS_CFUNC_DEF("select", 1, js_select),
 #ifndef _WIN32
     JS_CFUNC_DEF("poll", 1, js_poll),
+#endif
+#ifdef HAVE_SPLICE
+    JS_CFUNC_DEF("splice", 3, js_splice),
+#endif
+#ifdef SO_REUSEPORT
+    JS_CFUNC_DEF("reuseport", 2, js_socket_reuseport),
 #endif
     /*JS_CFUNC_MAGIC_DEF("getsockopt", 4, js_sockopt, METHOD_GETSOCKOPT),
     JS_CFUNC_MAGIC_DEF("setsockopt", 4, js_sockopt, METHOD_SETSOCKOPT),*/
@@ -2305,6 +3047,7 @@ static const JSCFunctionListEntry js_socket_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("connect", 1, js_socket_method, METHOD_CONNECT),
     JS_CFUNC_MAGIC_DEF("listen", 0, js_socket_method, METHOD_LISTEN),
     JS_CFUNC_MAGIC_DEF("accept", 0, js_socket_method, METHOD_ACCEPT),
+    JS_CFUNC_MAGIC_DEF("acceptMany", 2, js_socket_method, METHOD_ACCEPTMANY),
     JS_CFUNC_MAGIC_DEF("send", 1, js_socket_method, METHOD_SEND),
     JS_CFUNC_MAGIC_DEF("sendto", 2, js_socket_method, METHOD_SENDTO),
     JS_CFUNC_MAGIC_DEF("recv", 1, js_socket_method, METHOD_RECV),
@@ -2317,6 +3060,12 @@ static const JSCFunctionListEntry js_socket_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("sendmsg", 1, js_socket_method, METHOD_SENDMSG),
     JS_CFUNC_MAGIC_DEF("recvmmsg", 1, js_socket_method, METHOD_RECVMMSG),
     JS_CFUNC_MAGIC_DEF("sendmmsg", 1, js_socket_method, METHOD_SENDMMSG),
+#ifndef _WIN32
+    JS_CFUNC_MAGIC_DEF("sendFile", 1, js_socket_method, METHOD_SENDFILE),
+#endif
+#ifdef HAVE_SPLICE
+    JS_CFUNC_MAGIC_DEF("splice", 1, js_socket_method, METHOD_SPLICE),
+#endif
     JS_CFUNC_DEF("valueOf", 0, js_socket_valueof),
     JS_ALIAS_DEF("[Symbol.toPrimitive]", "valueOf"),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "Socket", JS_PROP_CONFIGURABLE),
@@ -2341,6 +3090,8 @@ static const JSCFunctionListEntry js_asyncsocket_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("connect", 1, js_socket_method, METHOD_CONNECT),
     JS_CFUNC_MAGIC_DEF("listen", 0, js_socket_method, METHOD_LISTEN),
     JS_CFUNC_MAGIC_DEF("accept", 0, js_asyncsocket_method, METHOD_ACCEPT),
+    JS_CFUNC_MAGIC_DEF("acceptMany", 2, js_asyncsocket_method, METHOD_ACCEPTMANY),
+    JS_CFUNC_DEF("connections", 2, js_asyncsocket_connections),
     JS_CFUNC_MAGIC_DEF("send", 1, js_asyncsocket_method, METHOD_SEND),
     JS_CFUNC_MAGIC_DEF("sendto", 2, js_asyncsocket_method, METHOD_SENDTO),
     JS_CFUNC_MAGIC_DEF("recv", 1, js_asyncsocket_method, METHOD_RECV),
@@ -2353,6 +3104,12 @@ static const JSCFunctionListEntry js_asyncsocket_proto_funcs[] = {
     JS_CFUNC_MAGIC_DEF("sendmsg", 1, js_asyncsocket_method, METHOD_SENDMSG),
     JS_CFUNC_MAGIC_DEF("recvmmsg", 1, js_asyncsocket_method, METHOD_RECVMMSG),
     JS_CFUNC_MAGIC_DEF("sendmmsg", 1, js_asyncsocket_method, METHOD_SENDMMSG),
+#ifndef _WIN32
+    JS_CFUNC_MAGIC_DEF("sendFile", 1, js_asyncsocket_method, METHOD_SENDFILE),
+#endif
+#ifdef HAVE_SPLICE
+    JS_CFUNC_MAGIC_DEF("splice", 1, js_asyncsocket_method, METHOD_SPLICE),
+#endif
     JS_CFUNC_DEF("valueOf", 0, js_socket_valueof),
     JS_ALIAS_DEF("[Symbol.toPrimitive]", "valueOf"),
     JS_PROP_STRING_DEF("[Symbol.toStringTag]", "AsyncSocket", JS_PROP_CONFIGURABLE),
@@ -3074,10 +3831,26 @@ static const JSCFunctionListEntry js_sockets_defines[] = {
     JS_CONSTANT(MSG_CTRUNC),
     JS_CONSTANT(MSG_OOB),
     JS_CONSTANT(MSG_ERRQUEUE),
+#ifdef MSG_DONTWAIT
+    JS_CONSTANT(MSG_DONTWAIT),
+#endif
+#ifdef MSG_WAITFORONE
+    JS_CONSTANT(MSG_WAITFORONE),
+#endif
 
     JS_CONSTANT(SHUT_RD),
     JS_CONSTANT(SHUT_WR),
     JS_CONSTANT(SHUT_RDWR),
+
+#ifdef SPLICE_F_MOVE
+    JS_CONSTANT_NONENUMERABLE(SPLICE_F_MOVE),
+#endif
+#ifdef SPLICE_F_NONBLOCK
+    JS_CONSTANT_NONENUMERABLE(SPLICE_F_NONBLOCK),
+#endif
+#ifdef SPLICE_F_MORE
+    JS_CONSTANT_NONENUMERABLE(SPLICE_F_MORE),
+#endif
 };
 
 static int
@@ -3123,10 +3896,22 @@ js_sockets_init(JSContext* ctx, JSModuleDef* m) {
   JS_SetClassProto(ctx, js_asyncsocket_class_id, asyncsocket_proto);
   JS_SetConstructor(ctx, asyncsocket_ctor, asyncsocket_proto);
 
+  JS_NewClassID(&js_msgbatch_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_msgbatch_class_id, &js_msgbatch_class);
+
+  msgbatch_ctor = JS_NewCFunction2(ctx, js_msgbatch_constructor, "MessageBatch", 2, JS_CFUNC_constructor, 0);
+  msgbatch_proto = JS_NewObject(ctx);
+
+  JS_SetPropertyFunctionList(ctx, msgbatch_proto, js_msgbatch_proto_funcs, countof(js_msgbatch_proto_funcs));
+
+  JS_SetClassProto(ctx, js_msgbatch_class_id, msgbatch_proto);
+  JS_SetConstructor(ctx, msgbatch_ctor, msgbatch_proto);
+
   if(m) {
     JS_SetModuleExport(ctx, m, "SockAddr", sockaddr_ctor);
     JS_SetModuleExport(ctx, m, "Socket", socket_ctor);
     JS_SetModuleExport(ctx, m, "AsyncSocket", asyncsocket_ctor);
+    JS_SetModuleExport(ctx, m, "MessageBatch", msgbatch_ctor);
 
     const char* module_name = module_namecstr(ctx, m);
 
@@ -3157,6 +3942,7 @@ JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
     JS_AddModuleExport(ctx, m, "SockAddr");
     JS_AddModuleExport(ctx, m, "Socket");
     JS_AddModuleExport(ctx, m, "AsyncSocket");
+    JS_AddModuleExport(ctx, m, "MessageBatch");
 
     size_t n = str_rchr(module_name, '/');
 
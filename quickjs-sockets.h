@@ -66,7 +66,7 @@ typedef union {
 #define SOCKET_PROPS() \
   unsigned fd : 16; \
   unsigned error : 8; \
-  unsigned sysno : 4; \
+  unsigned sysno : 5; \
   BOOL nonblock : 1, async : 1, owner : 1; \
   signed ret : 32
 
@@ -133,6 +133,8 @@ enum SocketCalls {
   SYSCALL_SENDMSG,
   SYSCALL_RECVMMSG,
   SYSCALL_SENDMMSG,
+  SYSCALL_SENDFILE,
+  SYSCALL_SPLICE,
 };
 
 #define socket_fd(sock) ((int16_t)(uint16_t)(sock).fd)
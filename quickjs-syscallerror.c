@@ -15,7 +15,7 @@
  * @{
  */
 VISIBLE JSClassID js_syscallerror_class_id = 0;
-static JSValue syscallerror_proto, syscallerror_ctor;
+static thread_local JSValue syscallerror_proto, syscallerror_ctor;
 
 int js_syscallerror_init(JSContext*, JSModuleDef*);
 static const char* syscallerror_symbol(int number);
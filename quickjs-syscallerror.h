@@ -27,6 +27,8 @@ typedef struct {
     } \
   } while(0)
 
+extern VISIBLE JSClassID js_syscallerror_class_id;
+
 VISIBLE SyscallError* syscallerror_new(JSContext*, const char* syscall, int number);
 VISIBLE void syscallerror_free(SyscallError*, JSRuntime*);
 
@@ -3,6 +3,7 @@
 #include "utils.h"
 #include "buffer-utils.h"
 #include "debug.h"
+#include "utf-utils.h"
 #include <sys/types.h>
 #include <libutf.h>
 #include "tutf8e/include/tutf8e.h"
@@ -13,7 +14,7 @@
  */
 
 VISIBLE JSClassID js_decoder_class_id = 0, js_encoder_class_id = 0;
-static JSValue textdecoder_proto, textdecoder_ctor, textencoder_proto, textencoder_ctor;
+static thread_local JSValue textdecoder_proto, textdecoder_ctor, textencoder_proto, textencoder_ctor;
 
 const TUTF8encoder* tutf8e_coders[] = {
     /* 0, 0, 0, 0, 0, 0, 0, 0, */
@@ -45,124 +46,142 @@ enum {
   DECODER_BUFFERED,
 };
 
-static size_t
-textdecoder_try(const void* in, size_t len) {
-  const uint8_t *x, *y, *end;
-  size_t r = 0;
-  int ch;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define TEXTCODE_HOST_BIG 1
+#else
+#define TEXTCODE_HOST_BIG 0
+#endif
 
-  for(x = in, end = x + len; x < end; r += x - y) {
-    y = x;
+static const uint8_t textcode_replacement[] = {0xef, 0xbf, 0xbd};
 
-    if((ch = unicode_from_utf8(x, end - x, &x)) == -1)
-      break;
-  }
+/* bytes to replace with a single U+FFFD, QuickJS encodes lone surrogates as 3 bytes */
+static size_t
+textcode_invalid_length(const uint8_t* p, size_t n) {
+  uint32_t cp;
+  int r;
 
-  return r;
+  if(n >= 3 && p[0] == 0xed && (p[1] & 0xe0) == 0xa0 && (p[2] & 0xc0) == 0x80)
+    return 3;
+
+  return (r = utf8_decode(p, n, &cp)) == 0 ? n : (size_t)-r;
 }
 
 size_t
 textdecoder_length(TextDecoder* td) {
   size_t len, r;
+  bool truncated;
 
-  r = textdecoder_try(ringbuffer_BEGIN(&td->buffer), ringbuffer_CONTINUOUS(&td->buffer));
+  r = utf8_validate(ringbuffer_BEGIN(&td->buffer), ringbuffer_CONTINUOUS(&td->buffer), &truncated);
   len = r;
 
-  if(len == ringbuffer_CONTINUOUS(&td->buffer))
+  if(len == ringbuffer_CONTINUOUS(&td->buffer) || truncated)
     if(td->buffer.head < td->buffer.tail) {
-      r = textdecoder_try(td->buffer.data, td->buffer.head);
+      /* a sequence may straddle the wrap, bail out then */
+      if(truncated)
+        return len;
+
+      r = utf8_validate(td->buffer.data, td->buffer.head, 0);
       len += r;
     }
 
   return len;
 }
 
+/* with 'flush' an incomplete sequence at the end decodes to U+FFFD instead of staying buffered */
 JSValue
-textdecoder_decode(TextDecoder* dec, JSContext* ctx) {
+textdecoder_decode(TextDecoder* dec, JSContext* ctx, BOOL flush) {
   JSValue ret = JS_UNDEFINED;
   size_t i = 0, blen;
-  uint_least32_t cp;
-  char tmp[UTF8_CHAR_LEN_MAX];
-  int len = 0;
+  const uint8_t* ptr;
+  bool swap_bytes = (dec->endian == BIG) != TEXTCODE_HOST_BIG;
   DynBuf dbuf;
 
   js_dbuf_init(ctx, &dbuf);
 
-  if((blen = ringbuffer_LENGTH(&dec->buffer)))
+  if((blen = ringbuffer_LENGTH(&dec->buffer))) {
+    /* the kernels want contiguous input */
+    if(!ringbuffer_IS_CONTINUOUS(&dec->buffer))
+      ringbuffer_normalize(&dec->buffer);
+
+    ptr = ringbuffer_BEGIN(&dec->buffer);
+
     switch(dec->type_code & 0x3) {
       case UTF8: {
-        size_t dlen, rlen = ringbuffer_LENGTH(&dec->buffer);
+        bool truncated;
+        size_t n;
 
-        if((dlen = textdecoder_length(dec)) < rlen) {
-          ringbuffer_normalize(&dec->buffer);
-          dlen = textdecoder_length(dec);
-        }
+        while(i < blen) {
+          n = utf8_validate(ptr + i, blen - i, &truncated);
 
-        dlen = MIN_NUM(dlen, ringbuffer_TAILROOM(&dec->buffer));
+          /* all valid: no intermediate copy */
+          if(i == 0 && (n == blen || (truncated && !flush))) {
+            ret = JS_NewStringLen(ctx, (const char*)ptr, n);
+            i = n;
+            break;
+          }
+
+          if(dbuf_put(&dbuf, ptr + i, n))
+            goto fail;
+
+          if((i += n) == blen || truncated)
+            break;
+
+          i += textcode_invalid_length(ptr + i, blen - i);
+          dbuf_put(&dbuf, textcode_replacement, sizeof(textcode_replacement));
+        }
 
-        ret = JS_NewStringLen(ctx, (const char*)ringbuffer_peek(&dec->buffer, 0), dlen);
-        ringbuffer_skip(&dec->buffer, dlen);
         break;
       }
 
       case UTF16: {
-        uint_least16_t* ptr = ringbuffer_BEGIN(&dec->buffer);
-        size_t n = blen & ~(0x1);
+        const uint16_t* u16 = (const uint16_t*)ptr;
+        size_t n = blen / 2, k = 0, c;
+        uint8_t* out;
 
-        for(i = 0; i < n; ptr = ringbuffer_NEXT(&dec->buffer, ptr), i += 2) {
-          uint_least16_t u16[2] = {uint16_get_endian(ptr, dec->endian), 0};
-          size_t ns = 2;
+        while(k < n) {
+          if(!(out = dbuf_reserve(&dbuf, (n - k) * 3)))
+            goto fail;
 
-          if(utf16_multiword(u16)) {
-            if(i + 2 >= n)
-              break;
+          dbuf.size += utf16_to_utf8(u16 + k, n - k, out, swap_bytes, &c);
 
-            u16[1] = uint16_get_endian(ptr + 1, dec->endian == BIG);
-            ns += 2;
-          }
-
-          if(!libutf_c16_to_c32(u16, &cp)) {
-            ret = JS_ThrowInternalError(ctx,
-                                        "%s: TextDecoder: not a valid utf-16 code at (%lu: 0x%04x, 0x%04x): %lu",
-                                        __func__,
-                                        (unsigned long)i,
-                                        (unsigned int)ptr[0],
-                                        (unsigned int)ptr[1],
-                                        (unsigned long)cp);
+          if((k += c) == n)
             break;
-          }
 
-          len = unicode_to_utf8((void*)tmp, cp);
+          /* high surrogate as last unit: wait for more input */
+          if(k + 1 == n) {
+            uint16_t u = swap_bytes ? (u16[k] >> 8) | (u16[k] << 8) : u16[k];
 
-          if(dbuf_put(&dbuf, (const void*)tmp, len))
-            return JS_EXCEPTION;
+            if(u >= 0xd800 && u < 0xdc00)
+              break;
+          }
+
+          dbuf_put(&dbuf, textcode_replacement, sizeof(textcode_replacement));
+          k++;
         }
 
+        i = k * 2;
         break;
       }
 
       case UTF32: {
-        const uint_least32_t* ptr = ringbuffer_BEGIN(&dec->buffer);
-        size_t n = blen & ~(0x3);
-
-        for(i = 0; i < n; ptr = ringbuffer_NEXT(&dec->buffer, ptr), i += 4) {
-          cp = uint32_get_endian(ptr, dec->endian);
-
-          if(!libutf_c32_to_c8(cp, &len, tmp)) {
-            ret = JS_ThrowInternalError(ctx,
-                                        "%s: TextDecoder: not a valid utf-32 code at (%lu: 0x%04x, 0x%04x): %lu",
-                                        __func__,
-                                        (unsigned long)i,
-                                        (unsigned int)ptr[0],
-                                        (unsigned int)ptr[1],
-                                        (unsigned long)cp);
+        const uint32_t* u32 = (const uint32_t*)ptr;
+        size_t n = blen / 4, k = 0, c;
+        uint8_t* out;
+
+        while(k < n) {
+          if(!(out = dbuf_reserve(&dbuf, (n - k) * 4)))
+            goto fail;
+
+          dbuf.size += utf32_to_utf8(u32 + k, n - k, out, swap_bytes, &c);
+
+          if((k += c) == n)
             break;
-          }
 
-          if(dbuf_put(&dbuf, (const void*)tmp, len))
-            return JS_EXCEPTION;
+          dbuf_put(&dbuf, textcode_replacement, sizeof(textcode_replacement));
+          k++;
         }
 
+        i = k * 4;
         break;
       }
 
@@ -170,17 +189,30 @@ textdecoder_decode(TextDecoder* dec, JSContext* ctx) {
         TUTF8encoder encoder;
 
         if((encoder = *tutf8e_coders[dec->type_code - 8])) {
+          /* ASCII runs are the same in every code page, only the rest goes through the table */
+          while(i < blen) {
+            size_t a = utf_ascii_prefix(ptr + i, blen - i), j, n = 0;
+            uint8_t* dst;
+
+            if(a && dbuf_put(&dbuf, ptr + i, a))
+              goto fail;
 
-          const char* ptr = ringbuffer_BEGIN(&dec->buffer);
-          size_t n = 0;
+            if((i += a) == blen)
+              break;
+
+            for(j = i; j < blen && ptr[j] >= 0x80; j++) {}
+
+            if(TUTF8E_OK != tutf8e_encoder_buffer_length(encoder, (const char*)ptr + i, 0, j - i, &n))
+              break;
 
-          if(TUTF8E_OK == tutf8e_encoder_buffer_length(encoder, ptr, 0, blen, &n)) {
-            uint8_t* dst = dbuf_reserve(&dbuf, n);
+            if(!(dst = dbuf_reserve(&dbuf, n)))
+              goto fail;
 
-            if(TUTF8E_OK == tutf8e_encoder_buffer_encode(encoder, ptr, blen, 0, (char*)dst, &n)) {
-              dbuf.size += n;
-              i = blen;
-            }
+            if(TUTF8E_OK != tutf8e_encoder_buffer_encode(encoder, (const char*)ptr + i, j - i, 0, (char*)dst, &n))
+              break;
+
+            dbuf.size += n;
+            i = j;
           }
 
         } else {
@@ -193,15 +225,25 @@ textdecoder_decode(TextDecoder* dec, JSContext* ctx) {
         break;
       }
     }
+  }
+
+  if(flush && i < blen && !JS_IsException(ret)) {
+    dbuf_put(&dbuf, textcode_replacement, sizeof(textcode_replacement));
+    i = blen;
+  }
 
   ringbuffer_skip(&dec->buffer, i);
 
-  if(JS_IsUndefined(ret) && dbuf.size > 0)
-    ret = JS_NewStringLen(ctx, (const char*)dbuf.buf, dbuf.size);
+  if(JS_IsUndefined(ret))
+    ret = dbuf.size > 0 ? JS_NewStringLen(ctx, (const char*)dbuf.buf, dbuf.size) : JS_NewStringLen(ctx, "", 0);
 
   dbuf_free(&dbuf);
 
   return ret;
+
+fail:
+  dbuf_free(&dbuf);
+  return JS_ThrowOutOfMemory(ctx);
 }
 
 static JSValue
@@ -301,7 +343,7 @@ js_decoder_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
 
   switch(magic) {
     case DECODER_END: {
-      ret = ringbuffer_LENGTH(&dec->buffer) ? textdecoder_decode(dec, ctx) : JS_NULL;
+      ret = ringbuffer_LENGTH(&dec->buffer) ? textdecoder_decode(dec, ctx, TRUE) : JS_NULL;
 
       if(magic == DECODER_END)
         ringbuffer_reset(&dec->buffer);
@@ -325,7 +367,7 @@ js_decoder_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
                                        magic == DECODER_DECODE ? "decode" : "end");
       }
 
-      ret = ringbuffer_LENGTH(&dec->buffer) ? textdecoder_decode(dec, ctx) : JS_NULL;
+      ret = ringbuffer_LENGTH(&dec->buffer) ? textdecoder_decode(dec, ctx, magic == DECODER_END) : JS_NULL;
 
       if(magic == DECODER_END)
         ringbuffer_reset(&dec->buffer);
@@ -381,6 +423,7 @@ static const JSCFunctionListEntry js_decoder_funcs[] = {
 enum {
   ENCODER_ENCODE,
   ENCODER_END,
+  ENCODER_ENCODE_INTO,
 };
 enum {
   ENCODER_ENCODING,
@@ -415,9 +458,9 @@ textencoder_read(TextEncoder* te, JSContext* ctx) {
 JSValue
 textencoder_encode(TextEncoder* enc, InputBuffer in, JSContext* ctx) {
   JSValue ret = JS_UNDEFINED;
-  uint32_t cp;
-  uint8_t u8[UTF8_CHAR_LEN_MAX];
-  const uint8_t *ptr, *end, *next;
+  const uint8_t* ptr = block_begin(&in.block);
+  size_t n = (const uint8_t*)block_end(&in.block) - ptr, k = 0, o = 0, c;
+  bool swap_bytes = (enc->endian == BIG) != TEXTCODE_HOST_BIG;
 
   switch(enc->type_code & 0x3) {
     case UTF8: {
@@ -433,52 +476,43 @@ textencoder_encode(TextEncoder* enc, InputBuffer in, JSContext* ctx) {
     }
 
     case UTF16: {
-      ptr = block_begin(&in.block);
-      end = block_end(&in.block);
+      uint16_t* out;
 
-      for(size_t i = 0; ptr < end; ptr = next, i++) {
-        uint_least16_t u16[2];
-        int len;
-
-        cp = unicode_from_utf8(ptr, end - ptr, &next);
+      /* at most one unit per input byte */
+      if(!(out = (uint16_t*)ringbuffer_reserve(&enc->buffer, n * 2 + 2)))
+        return JS_ThrowInternalError(ctx, "%s: TextEncoder: ringbuffer write failed", __func__);
 
-        if(!libutf_c32_to_c16(cp, &len, u16))
-          return JS_ThrowInternalError(ctx,
-                                       "%s: TextEncoder: not a valid code point at (%lu) [%lu]: %lu",
-                                       __func__,
-                                       (unsigned long)i,
-                                       (unsigned long)(end - ptr),
-                                       (unsigned long)cp);
+      while(k < n) {
+        o += utf8_to_utf16(ptr + k, n - k, out + o, swap_bytes, &c);
 
-        for(int j = 0; j < len; j++)
-          uint16_put_endian(u8 + j * 2, u16[j], enc->endian);
+        if((k += c) == n)
+          break;
 
-        if(ringbuffer_append(&enc->buffer, u8, len * sizeof(uint16_t)) < 0)
-          return JS_ThrowInternalError(ctx, "TextEncoder: ringbuffer write failed");
+        k += textcode_invalid_length(ptr + k, n - k);
+        out[o++] = swap_bytes ? 0xfdff : UTF_REPLACEMENT_CHAR;
       }
 
+      enc->buffer.head += o * 2;
       break;
     }
 
     case UTF32: {
-      ptr = block_begin(&in.block);
-      end = block_end(&in.block);
+      uint32_t* out;
 
-      for(size_t i = 0; ptr < end; ptr = next, i++) {
+      if(!(out = (uint32_t*)ringbuffer_reserve(&enc->buffer, n * 4 + 4)))
+        return JS_ThrowInternalError(ctx, "%s: TextEncoder: ringbuffer write failed", __func__);
 
-        if((cp = unicode_from_utf8(ptr, end - ptr, &next)) == 0xffffffff)
-          return JS_ThrowInternalError(ctx,
-                                       "%s: TextEncoder: not a valid code point at (%lu): %lu",
-                                       __func__,
-                                       (unsigned long)(ptr - in.block.base),
-                                       (long unsigned int)cp);
+      while(k < n) {
+        o += utf8_to_utf32(ptr + k, n - k, out + o, swap_bytes, &c);
 
-        uint32_put_endian(u8, cp, enc->endian);
+        if((k += c) == n)
+          break;
 
-        if(ringbuffer_append(&enc->buffer, u8, sizeof(cp)) < 0)
-          return JS_ThrowInternalError(ctx, "%s: TextEncoder: ringbuffer write failed", __func__);
+        k += textcode_invalid_length(ptr + k, n - k);
+        out[o++] = swap_bytes ? 0xfdff0000 : UTF_REPLACEMENT_CHAR;
       }
 
+      enc->buffer.head += o * 4;
       break;
     }
 
@@ -491,6 +525,176 @@ textencoder_encode(TextEncoder* enc, InputBuffer in, JSContext* ctx) {
   return ret;
 }
 
+/**
+ * @brief      Encodes UTF-8 input straight into out without splitting
+ *             characters, stops when out is full
+ *
+ * @param      consumed  receives the number of input bytes encoded
+ *
+ * @return     number of bytes written
+ */
+size_t
+textencoder_encode_buffer(TextEncoder* enc, const uint8_t* in, size_t n, uint8_t* out, size_t cap, size_t* consumed) {
+  bool swap_bytes = (enc->endian == BIG) != TEXTCODE_HOST_BIG;
+  size_t k = 0, o = 0, c, unit;
+
+  switch(enc->type_code & 0x3) {
+    case UTF8: {
+      if((k = n) > cap)
+        for(k = cap; k > 0 && (in[k] & 0xc0) == 0x80;)
+          k--;
+
+      memcpy(out, in, k);
+      o = k;
+      break;
+    }
+
+    case UTF16:
+    case UTF32: {
+      unit = (enc->type_code & 0x3) == UTF16 ? 2 : 4;
+
+      while(k < n) {
+        size_t room = cap / unit - o, chunk = MIN_NUM(n - k, room);
+        uint32_t cp;
+        int r;
+
+        if(chunk == 0)
+          break;
+
+        /* n input bytes never yield more than n units */
+        if(unit == 2)
+          o += utf8_to_utf16(in + k, chunk, (uint16_t*)out + o, swap_bytes, &c);
+        else
+          o += utf8_to_utf32(in + k, chunk, (uint32_t*)out + o, swap_bytes, &c);
+
+        if((k += c) == n || c == chunk)
+          continue;
+
+        /* a character cut by the chunk boundary */
+        if((r = utf8_decode(in + k, n - k, &cp)) > 0) {
+          if(cap / unit - o < (unit == 2 && cp >= 0x10000 ? 2 : 1))
+            break;
+
+          if(unit == 2)
+            o += utf8_to_utf16(in + k, r, (uint16_t*)out + o, swap_bytes, &c);
+          else
+            o += utf8_to_utf32(in + k, r, (uint32_t*)out + o, swap_bytes, &c);
+
+          k += r;
+          continue;
+        }
+
+        if(o >= cap / unit)
+          break;
+
+        k += textcode_invalid_length(in + k, n - k);
+
+        if(unit == 2)
+          ((uint16_t*)out)[o++] = swap_bytes ? 0xfdff : UTF_REPLACEMENT_CHAR;
+        else
+          ((uint32_t*)out)[o++] = swap_bytes ? 0xfdff0000 : UTF_REPLACEMENT_CHAR;
+      }
+
+      o *= unit;
+      break;
+    }
+  }
+
+  if(consumed)
+    *consumed = k;
+
+  return o;
+}
+
+/* encodes into a new ArrayBuffer, no intermediate ring buffer copy */
+static JSValue
+textencoder_encode_new(TextEncoder* enc, const uint8_t* in, size_t n, JSContext* ctx) {
+  size_t cap = n * ((enc->type_code & 0x3) == UTF32 ? 4 : (enc->type_code & 0x3) == UTF16 ? 2 : 1), len;
+  uint8_t *buf, *tmp;
+
+  if(!(buf = js_malloc(ctx, MAX_NUM(cap, 1))))
+    return JS_EXCEPTION;
+
+  len = textencoder_encode_buffer(enc, in, n, buf, cap, 0);
+
+  if(len < cap && (tmp = js_realloc(ctx, buf, MAX_NUM(len, 1))))
+    buf = tmp;
+
+  return JS_NewArrayBuffer(ctx, buf, len, js_arraybuffer_freeptr, 0, FALSE);
+}
+
+static int
+textencoder_bits(TextEncoder* enc) {
+  switch(enc->type_code & 0x3) {
+    case UTF16: return 16;
+    case UTF32: return 32;
+  }
+
+  return 8;
+}
+
+/**
+ * Streaming encode: an ArrayBufferSink copies synchronously, so it gets a
+ * transient view of the encoder's scratch buffer which is detached right
+ * after write().  Stream writers keep the chunk, they get a buffer of their
+ * own.  A WritableStream is written through a temporarily acquired writer.
+ */
+static JSValue
+textencoder_encode_sink(TextEncoder* enc, const uint8_t* in, size_t n, JSValueConst sink, JSContext* ctx) {
+  JSValue buf, chunk, ret, writer = JS_UNDEFINED;
+  const char* tag = js_get_tostringtag_cstr(ctx, sink);
+  BOOL transient = tag && !strcmp(tag, "ArrayBufferSink");
+
+  if(tag)
+    JS_FreeCString(ctx, tag);
+
+  if(!js_has_propertystr(ctx, sink, "write")) {
+    if(!js_has_propertystr(ctx, sink, "getWriter"))
+      return JS_ThrowTypeError(ctx, "argument 2 has neither write() nor getWriter()");
+
+    if(JS_IsException((writer = js_invoke(ctx, sink, "getWriter", 0, 0))))
+      return JS_EXCEPTION;
+
+    sink = writer;
+  }
+
+  if(transient) {
+    size_t cap = n * (textencoder_bits(enc) / 8), len;
+    uint8_t* out;
+
+    if(!(out = ringbuffer_reserve(&enc->buffer, cap + 1)))
+      return JS_ThrowOutOfMemory(ctx);
+
+    len = textencoder_encode_buffer(enc, in, n, out, cap, 0);
+    buf = JS_NewArrayBuffer(ctx, out, len, 0, 0, FALSE);
+  } else {
+    buf = textencoder_encode_new(enc, in, n, ctx);
+  }
+
+  if(JS_IsException(buf)) {
+    JS_FreeValue(ctx, writer);
+    return buf;
+  }
+
+  chunk = js_typedarray_new(ctx, 8, FALSE, FALSE, buf);
+  ret = js_invoke(ctx, sink, "write", 1, &chunk);
+  JS_FreeValue(ctx, chunk);
+
+  if(transient)
+    JS_DetachArrayBuffer(ctx, buf);
+
+  JS_FreeValue(ctx, buf);
+
+  if(!JS_IsUndefined(writer)) {
+    JSValue r = js_invoke(ctx, writer, "releaseLock", 0, 0);
+
+    JS_FreeValue(ctx, r);
+    JS_FreeValue(ctx, writer);
+  }
+
+  return ret;
+}
+
 static JSValue
 js_encoder_get(JSContext* ctx, JSValueConst this_val, int magic) {
   TextEncoder* enc;
@@ -598,18 +802,58 @@ js_encoder_functions(JSContext* ctx, JSValueConst this_val, int argc, JSValueCon
 
     case ENCODER_ENCODE: {
       InputBuffer in = js_input_chars(ctx, argv[0]);
+      JSValue buf;
+
+      /* the ring buffer only matters when something is pending from before */
+      if(ringbuffer_LENGTH(&enc->buffer)) {
+        ret = textencoder_encode(enc, in, ctx);
+        input_buffer_free(&in, ctx);
 
-      ret = textencoder_encode(enc, in, ctx);
+        if(JS_IsException(ret))
+          break;
 
-      if(JS_IsException(ret))
+        ret = textencoder_read(enc, ctx);
         break;
+      }
 
-      size_t len = ringbuffer_avail(&enc->buffer);
-      ret = len == 0 ? JS_NULL : textencoder_read(enc, ctx);
+      buf = textencoder_encode_new(enc, input_buffer_data(&in), input_buffer_length(&in), ctx);
+      input_buffer_free(&in, ctx);
 
-      if(magic == ENCODER_END)
-        ringbuffer_reset(&enc->buffer);
+      if(JS_IsException(buf))
+        return buf;
+
+      ret = js_typedarray_new(ctx, textencoder_bits(enc), FALSE, FALSE, buf);
+      JS_FreeValue(ctx, buf);
+      break;
+    }
+
+    case ENCODER_ENCODE_INTO: {
+      InputBuffer in = js_input_chars(ctx, argv[0]);
+      const uint8_t* data = input_buffer_data(&in);
+      size_t len = input_buffer_length(&in), n, written;
+
+      if(argc > 1 && (js_is_typedarray(ctx, argv[1]) || js_is_arraybuffer(ctx, argv[1]))) {
+        InputBuffer out = js_output_args(ctx, argc - 1, argv + 1);
+
+        if(JS_IsException(out.value)) {
+          input_buffer_free(&in, ctx);
+          return JS_EXCEPTION;
+        }
+
+        written = textencoder_encode_buffer(enc, data, len, input_buffer_data(&out), input_buffer_length(&out), &n);
+
+        ret = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, ret, "read", JS_NewInt64(ctx, utf8_utf16_units(data, n)));
+        JS_SetPropertyStr(ctx, ret, "written", JS_NewInt64(ctx, written));
+
+        input_buffer_free(&out, ctx);
+      } else if(argc > 1 && JS_IsObject(argv[1])) {
+        ret = textencoder_encode_sink(enc, data, len, argv[1], ctx);
+      } else {
+        ret = JS_ThrowTypeError(ctx, "argument 2 must be a Uint8Array, ArrayBuffer, ArrayBufferSink or WritableStream");
+      }
 
+      input_buffer_free(&in, ctx);
       break;
     }
   }
@@ -651,6 +895,7 @@ static JSClassDef js_encoder_class = {
 
 static const JSCFunctionListEntry js_encoder_funcs[] = {
     JS_CFUNC_MAGIC_DEF("encode", 1, js_encoder_functions, ENCODER_ENCODE),
+    JS_CFUNC_MAGIC_DEF("encodeInto", 2, js_encoder_functions, ENCODER_ENCODE_INTO),
     JS_CFUNC_MAGIC_DEF("end", 1, js_encoder_functions, ENCODER_END),
     JS_CGETSET_ENUMERABLE_DEF("encoding", js_encoder_get, 0, ENCODER_ENCODING),
     JS_CGETSET_MAGIC_DEF("endian", js_encoder_get, 0, ENCODER_ENDIANNESS),
@@ -73,6 +73,7 @@ JSValue textdecoder_read(TextDecoder*, JSContext* ctx);
 int js_code_init(JSContext*, JSModuleDef* m);
 size_t textencoder_length(TextEncoder*);
 JSValue textencoder_read(TextEncoder*, JSContext* ctx);
+size_t textencoder_encode_buffer(TextEncoder*, const uint8_t*, size_t, uint8_t*, size_t, size_t* consumed);
 int js_encoder_init(JSContext*, JSModuleDef* m);
 
 static inline TextDecoder*
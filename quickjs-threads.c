@@ -0,0 +1,1141 @@
+#include "defines.h"
+#include "utils.h"
+#include <quickjs-libc.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * \defgroup quickjs-threads quickjs-threads: Worker threads with their own runtime
+ *
+ * Every Worker is a pthread running a runtime and context of its own, with
+ * the script given to the constructor as its main module and the usual
+ * event loop after it.  The two sides talk through a message queue in each
+ * direction; a byte written to a pipe wakes the receiving event loop, whose
+ * read handler takes all queued messages.
+ *
+ * Messages are serialized with JS_WriteObject2(), SharedArrayBuffers by
+ * reference, so both threads see the same memory and can Atomics.wait() /
+ * Atomics.notify() on it (waiting is allowed in workers only).  ArrayBuffers
+ * in the transfer list are detached in the sender after the message was
+ * written.
+ *
+ * A worker always watches its channel, but only keeps running for it while
+ * parent.onmessage is set; otherwise a timer checks every
+ * THREADS_IDLE_CHECK ms whether anything else is left.  The timers and I/O
+ * handlers of the worker are counted by wrapping the setters of its 'os'
+ * module.  terminate() makes running JS throw and drops all handlers and
+ * timers of the worker, so its event loop ends.  A worker blocked in
+ * Atomics.wait() only notices that once the wait returns.
+ *
+ * The native modules keep their class prototypes and constructors in
+ * thread_local variables, so every thread importing one gets its own.  Class
+ * IDs are process-wide and allocated on first import.
+ * @{
+ */
+
+VISIBLE JSClassID js_worker_class_id = 0;
+
+enum {
+  THREADS_MESSAGE = 0,
+  THREADS_ERROR,
+  THREADS_EXIT,
+};
+
+#define THREADS_IDLE_CHECK 100
+
+typedef struct threads_message ThreadsMessage;
+
+/* malloc()ed, messages outlive the runtime that wrote them */
+struct threads_message {
+  ThreadsMessage* next;
+  int type, code;
+  uint8_t* data;
+  size_t size;
+  uint8_t** sab_tab;
+  size_t sab_len;
+};
+
+typedef struct {
+  pthread_mutex_t lock;
+  ThreadsMessage *head, **tail;
+  int fds[2];
+} ThreadsChannel;
+
+typedef struct {
+  int ref_count;
+  int id;
+  int terminate;
+  BOOL started, exited;
+  pthread_t thread;
+  ThreadsChannel in, out; /* to the worker, from the worker */
+  char *filename, *source;
+  ThreadsMessage* data; /* workerData */
+} ThreadsWorker;
+
+static int threads_next_id = 1;
+
+enum {
+  THREADS_SET_READ = 0,
+  THREADS_SET_WRITE,
+  THREADS_SET_TIMEOUT,
+  THREADS_SET_INTERVAL,
+  THREADS_CLEAR_TIMEOUT,
+  THREADS_CLEAR_INTERVAL,
+  THREADS_SETTERS,
+};
+
+static const char* const threads_setter_names[THREADS_SETTERS] = {
+    "setReadHandler",
+    "setWriteHandler",
+    "setTimeout",
+    "setInterval",
+    "clearTimeout",
+    "clearInterval",
+};
+
+typedef struct threads_source ThreadsSource;
+
+/* a timer or I/O handler set through the worker's 'os' module */
+struct threads_source {
+  ThreadsSource* next;
+  int type; /* THREADS_SET_* */
+  int fd;   /* the serial number of a timer */
+  JSValue timer;
+};
+
+/* in a worker thread: its own ThreadsWorker, parent.onmessage, the idle timer and what keeps its loop busy */
+static thread_local ThreadsWorker* threads_self;
+static thread_local JSValue threads_onmessage, threads_idle;
+static thread_local JSValue threads_setters[THREADS_SETTERS]; /* the unwrapped ones */
+static thread_local ThreadsSource* threads_sources;
+static thread_local int threads_serial;
+
+static int
+threads_channel_init(ThreadsChannel* ch) {
+  if(pipe(ch->fds) == -1)
+    return -1;
+
+  /* a full pipe means the reader has not woken up yet, nothing is lost */
+  fcntl(ch->fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(ch->fds[1], F_SETFL, O_NONBLOCK);
+  fcntl(ch->fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(ch->fds[1], F_SETFD, FD_CLOEXEC);
+
+  pthread_mutex_init(&ch->lock, 0);
+  ch->head = 0;
+  ch->tail = &ch->head;
+  return 0;
+}
+
+static void
+threads_message_free(ThreadsMessage* msg) {
+  for(size_t i = 0; i < msg->sab_len; i++)
+    js_sab_free(0, msg->sab_tab[i]);
+
+  free(msg->sab_tab);
+  free(msg->data);
+  free(msg);
+}
+
+static void
+threads_channel_free(ThreadsChannel* ch) {
+  ThreadsMessage *msg, *next;
+
+  for(msg = ch->head; msg; msg = next) {
+    next = msg->next;
+    threads_message_free(msg);
+  }
+
+  close(ch->fds[0]);
+  close(ch->fds[1]);
+  pthread_mutex_destroy(&ch->lock);
+}
+
+static void
+threads_channel_wake(ThreadsChannel* ch) {
+  while(write(ch->fds[1], "", 1) == -1 && errno == EINTR) {}
+}
+
+static void
+threads_channel_post(ThreadsChannel* ch, ThreadsMessage* msg) {
+  msg->next = 0;
+
+  pthread_mutex_lock(&ch->lock);
+  *ch->tail = msg;
+  ch->tail = &msg->next;
+  pthread_mutex_unlock(&ch->lock);
+
+  threads_channel_wake(ch);
+}
+
+static ThreadsMessage*
+threads_channel_take(ThreadsChannel* ch) {
+  ThreadsMessage* msg;
+
+  pthread_mutex_lock(&ch->lock);
+
+  if((msg = ch->head) && !(ch->head = msg->next))
+    ch->tail = &ch->head;
+
+  pthread_mutex_unlock(&ch->lock);
+  return msg;
+}
+
+/* empties the pipe, the queue is what counts */
+static void
+threads_channel_drain(ThreadsChannel* ch) {
+  char buf[256];
+  ssize_t r;
+
+  while((r = read(ch->fds[0], buf, sizeof(buf))) > 0 || (r == -1 && errno == EINTR)) {}
+}
+
+/* wake the reader again for what is left in the queue */
+static void
+threads_channel_rearm(ThreadsChannel* ch) {
+  if(ch->head)
+    threads_channel_wake(ch);
+}
+
+static ThreadsMessage*
+threads_message_new(int type, int code) {
+  ThreadsMessage* msg;
+
+  if((msg = calloc(1, sizeof(ThreadsMessage)))) {
+    msg->type = type;
+    msg->code = code;
+  }
+
+  return msg;
+}
+
+/**
+ * @brief Serialize \param value into a message, then detach the ArrayBuffers of \param transfer
+ *
+ * @return  the message, NULL on exception
+ */
+static ThreadsMessage*
+threads_message_write(JSContext* ctx, int type, JSValueConst value, JSValueConst transfer) {
+  ThreadsMessage* msg;
+  uint8_t *data, **sab_tab;
+  size_t size, sab_len;
+  int64_t ntransfer = 0;
+
+  if(!JS_IsUndefined(transfer)) {
+    if(!JS_IsArray(ctx, transfer)) {
+      JS_ThrowTypeError(ctx, "transfer list must be an array");
+      return 0;
+    }
+
+    ntransfer = js_array_length(ctx, transfer);
+
+    for(int64_t i = 0; i < ntransfer; i++) {
+      JSValue buf = JS_GetPropertyUint32(ctx, transfer, i);
+      BOOL ok = js_is_arraybuffer(ctx, buf);
+
+      JS_FreeValue(ctx, buf);
+
+      if(!ok) {
+        JS_ThrowTypeError(ctx, "only ArrayBuffers can be transferred");
+        return 0;
+      }
+    }
+  }
+
+  if(!(data = JS_WriteObject2(ctx, &size, value, JS_WRITE_OBJ_SAB | JS_WRITE_OBJ_REFERENCE, &sab_tab, &sab_len)))
+    return 0;
+
+  if(!(msg = threads_message_new(type, 0)) || !(msg->data = malloc(size)) ||
+     (sab_len && !(msg->sab_tab = malloc(sizeof(uint8_t*) * sab_len)))) {
+    if(msg) {
+      free(msg->data);
+      free(msg);
+    }
+
+    js_free(ctx, data);
+    js_free(ctx, sab_tab);
+    JS_ThrowOutOfMemory(ctx);
+    return 0;
+  }
+
+  memcpy(msg->data, data, size);
+  msg->size = size;
+  js_free(ctx, data);
+
+  /* the message holds a reference until it is read */
+  for(size_t i = 0; i < sab_len; i++) {
+    js_sab_dup(0, sab_tab[i]);
+    msg->sab_tab[i] = sab_tab[i];
+  }
+
+  msg->sab_len = sab_len;
+  js_free(ctx, sab_tab);
+
+  for(int64_t i = 0; i < ntransfer; i++) {
+    JSValue buf = JS_GetPropertyUint32(ctx, transfer, i);
+
+    JS_DetachArrayBuffer(ctx, buf);
+    JS_FreeValue(ctx, buf);
+  }
+
+  return msg;
+}
+
+static JSValue
+threads_message_read(JSContext* ctx, ThreadsMessage* msg) {
+  return JS_ReadObject(ctx, msg->data, msg->size, JS_READ_OBJ_SAB | JS_READ_OBJ_REFERENCE);
+}
+
+/* Error objects can't be serialized, their name, message and stack are sent instead */
+static ThreadsMessage*
+threads_message_error(JSContext* ctx, JSValueConst error) {
+  ThreadsMessage* msg;
+  JSValue obj;
+
+  if(!JS_IsError(ctx, error))
+    return threads_message_write(ctx, THREADS_ERROR, error, JS_UNDEFINED);
+
+  obj = JS_NewObject(ctx);
+  JS_SetPropertyStr(ctx, obj, "name", JS_GetPropertyStr(ctx, error, "name"));
+  JS_SetPropertyStr(ctx, obj, "message", JS_GetPropertyStr(ctx, error, "message"));
+  JS_SetPropertyStr(ctx, obj, "stack", JS_GetPropertyStr(ctx, error, "stack"));
+
+  if((msg = threads_message_write(ctx, THREADS_ERROR, obj, JS_UNDEFINED)))
+    msg->code = 1;
+
+  JS_FreeValue(ctx, obj);
+  return msg;
+}
+
+static JSValue
+threads_error_read(JSContext* ctx, ThreadsMessage* msg) {
+  JSValue obj = threads_message_read(ctx, msg), error;
+
+  if(!msg->code || JS_IsException(obj))
+    return obj;
+
+  error = JS_NewError(ctx);
+  JS_SetPropertyStr(ctx, error, "name", JS_GetPropertyStr(ctx, obj, "name"));
+  JS_SetPropertyStr(ctx, error, "message", JS_GetPropertyStr(ctx, obj, "message"));
+  JS_SetPropertyStr(ctx, error, "stack", JS_GetPropertyStr(ctx, obj, "stack"));
+  JS_FreeValue(ctx, obj);
+  return error;
+}
+
+static void
+threads_worker_free(ThreadsWorker* w) {
+  if(atomic_add_int(&w->ref_count, -1))
+    return;
+
+  threads_channel_free(&w->in);
+  threads_channel_free(&w->out);
+
+  if(w->data)
+    threads_message_free(w->data);
+
+  free(w->filename);
+  free(w->source);
+  free(w);
+}
+
+static int
+threads_interrupt_handler(JSRuntime* rt, void* opaque) {
+  ThreadsWorker* w = opaque;
+
+  return __atomic_load_n(&w->terminate, __ATOMIC_RELAXED);
+}
+
+static JSContext*
+threads_context_new(JSRuntime* rt) {
+  JSContext* ctx;
+
+  JS_SetModuleLoaderFunc(rt, 0, js_module_loader, 0);
+
+  if((ctx = JS_NewContext(rt))) {
+    js_init_module_std(ctx, "std");
+    js_init_module_os(ctx, "os");
+  }
+
+  return ctx;
+}
+
+static JSValue js_parent_receive(JSContext*, JSValueConst, int, JSValueConst[]);
+static JSValue js_parent_idle(JSContext*, JSValueConst, int, JSValueConst[]);
+
+static BOOL
+threads_is_terminated(void) {
+  return __atomic_load_n(&threads_self->terminate, __ATOMIC_RELAXED);
+}
+
+/* (un)watch the channel from the parent, it is not counted as a source */
+static BOOL
+threads_watch(JSContext* ctx, BOOL watch) {
+  return js_iohandler_set(ctx,
+                          threads_setters[THREADS_SET_READ],
+                          threads_self->in.fds[0],
+                          watch ? JS_NewCFunction(ctx, js_parent_receive, "onmessage", 0) : JS_NULL);
+}
+
+/* timer IDs are numbers or, with older quickjs-libc, objects */
+static BOOL
+threads_timer_equal(JSValueConst a, JSValueConst b) {
+  if(JS_VALUE_GET_TAG(a) != JS_VALUE_GET_TAG(b))
+    return FALSE;
+
+  return JS_IsObject(a) ? JS_VALUE_GET_PTR(a) == JS_VALUE_GET_PTR(b) : JS_VALUE_GET_INT(a) == JS_VALUE_GET_INT(b);
+}
+
+static void
+threads_source_add(JSContext* ctx, int type, int fd, JSValueConst timer) {
+  ThreadsSource* src;
+
+  if((src = js_malloc(ctx, sizeof(ThreadsSource)))) {
+    src->type = type;
+    src->fd = fd;
+    src->timer = JS_DupValue(ctx, timer);
+    src->next = threads_sources;
+    threads_sources = src;
+  }
+}
+
+/* removes the I/O handler \param fd or the timer with the serial number \param fd or the ID \param timer */
+static void
+threads_source_remove(JSContext* ctx, int type, int fd, JSValueConst timer) {
+  ThreadsSource **ptr, *src;
+
+  for(ptr = &threads_sources; (src = *ptr); ptr = &src->next) {
+    if(JS_IsUndefined(timer) ? src->type == type && src->fd == fd : threads_timer_equal(src->timer, timer)) {
+      *ptr = src->next;
+      JS_FreeValue(ctx, src->timer);
+      js_free(ctx, src);
+      break;
+    }
+  }
+}
+
+static void
+threads_sources_free(JSContext* ctx) {
+  while(threads_sources)
+    threads_source_remove(ctx, threads_sources->type, threads_sources->fd, JS_UNDEFINED);
+}
+
+/* TRUE while the event loop has handlers or timers besides the channel */
+static BOOL
+threads_loop_busy(void) {
+  return !!threads_sources;
+}
+
+static void
+threads_idle_arm(JSContext* ctx, int32_t delay) {
+  JSValue args[2] = {JS_NewCFunction(ctx, js_parent_idle, "idle", 0), JS_NewInt32(ctx, delay)};
+
+  JS_FreeValue(ctx, threads_idle);
+
+  if(JS_IsException((threads_idle = JS_Call(ctx, threads_setters[THREADS_SET_TIMEOUT], JS_UNDEFINED, countof(args), args)))) {
+    js_std_dump_error(ctx);
+    threads_idle = JS_UNDEFINED;
+  }
+
+  JS_FreeValue(ctx, args[0]);
+}
+
+static void
+threads_idle_stop(JSContext* ctx) {
+  if(!JS_IsUndefined(threads_idle)) {
+    JS_FreeValue(ctx, JS_Call(ctx, threads_setters[THREADS_CLEAR_TIMEOUT], JS_UNDEFINED, 1, &threads_idle));
+    JS_FreeValue(ctx, threads_idle);
+    threads_idle = JS_UNDEFINED;
+  }
+}
+
+/* a timeout of the worker fired, it no longer keeps the loop running */
+static JSValue
+threads_timer_fire(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  threads_source_remove(ctx, THREADS_SET_TIMEOUT, magic, JS_UNDEFINED);
+
+  return JS_Call(ctx, data[0], this_val, argc, argv);
+}
+
+/* replaces the handler and timer setters of the worker's 'os' module, to count what they set */
+static JSValue
+threads_os_setter(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic) {
+  JSValueConst* args = alloca(sizeof(JSValueConst) * argc);
+  JSValue func = JS_UNDEFINED, ret;
+  int32_t fd = -1;
+
+  memcpy(args, argv, sizeof(JSValueConst) * argc);
+
+  switch(magic) {
+    case THREADS_SET_READ:
+    case THREADS_SET_WRITE: {
+      if(argc < 1 || JS_ToInt32(ctx, &fd, argv[0]))
+        break;
+
+      threads_source_remove(ctx, magic, fd, JS_UNDEFINED);
+      break;
+    }
+
+    case THREADS_SET_TIMEOUT:
+    case THREADS_SET_INTERVAL: {
+      if(argc < 1 || !JS_IsFunction(ctx, argv[0]))
+        break;
+
+      fd = ++threads_serial;
+
+      if(magic == THREADS_SET_TIMEOUT)
+        args[0] = func = JS_NewCFunctionData(ctx, threads_timer_fire, 0, fd, 1, &argv[0]);
+
+      break;
+    }
+  }
+
+  ret = JS_Call(ctx, threads_setters[magic], this_val, argc, args);
+  JS_FreeValue(ctx, func);
+
+  if(JS_IsException(ret))
+    return ret;
+
+  switch(magic) {
+    case THREADS_SET_READ:
+    case THREADS_SET_WRITE: {
+      if(argc > 1 && JS_IsFunction(ctx, argv[1]))
+        threads_source_add(ctx, magic, fd, JS_UNDEFINED);
+
+      break;
+    }
+
+    case THREADS_SET_TIMEOUT:
+    case THREADS_SET_INTERVAL: {
+      if(fd != -1)
+        threads_source_add(ctx, magic, fd, ret);
+
+      break;
+    }
+
+    case THREADS_CLEAR_TIMEOUT:
+    case THREADS_CLEAR_INTERVAL: {
+      if(argc > 0)
+        threads_source_remove(ctx, magic, -1, argv[0]);
+
+      break;
+    }
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Keeps the setters of the worker's 'os' module and exports counting ones instead
+ *
+ * Must run before the worker's script imports from 'os'.
+ */
+static BOOL
+threads_os_wrap(JSContext* ctx) {
+  JSModuleDef* m;
+  JSValue ns;
+
+  if(!(m = js_module_find(ctx, "os")))
+    return FALSE;
+
+  ns = JS_GetModuleNamespace(ctx, m);
+
+  for(int i = 0; i < THREADS_SETTERS; i++) {
+    threads_setters[i] = JS_GetPropertyStr(ctx, ns, threads_setter_names[i]);
+
+    if(JS_IsFunction(ctx, threads_setters[i]))
+      JS_SetModuleExport(ctx, m, threads_setter_names[i], JS_NewCFunctionMagic(ctx, threads_os_setter, threads_setter_names[i], 2, JS_CFUNC_generic_magic, i));
+  }
+
+  JS_FreeValue(ctx, ns);
+
+  return JS_IsFunction(ctx, threads_setters[THREADS_SET_READ]) && JS_IsFunction(ctx, threads_setters[THREADS_SET_TIMEOUT]) &&
+         JS_IsFunction(ctx, threads_setters[THREADS_CLEAR_TIMEOUT]);
+}
+
+/* terminate(): drops every handler and timer of the worker, so that js_std_loop() returns */
+static void
+threads_loop_clear(JSContext* ctx) {
+  JSRuntime* rt = JS_GetRuntime(ctx);
+
+  js_std_free_handlers(rt);
+  js_std_init_handlers(rt);
+
+  /* js_std_init_handlers() may set its own SharedArrayBuffer functions */
+  js_sab_init(rt);
+
+  JS_FreeValue(ctx, threads_idle);
+  threads_idle = JS_UNDEFINED;
+  JS_FreeValue(ctx, threads_onmessage);
+  threads_onmessage = JS_UNDEFINED;
+  threads_sources_free(ctx);
+}
+
+static void*
+threads_worker_thread(void* arg) {
+  ThreadsWorker* w = arg;
+  JSRuntime* rt;
+  JSContext* ctx = 0;
+  JSValue ret;
+  ThreadsMessage* msg;
+  int code = 1;
+
+  threads_self = w;
+  threads_onmessage = threads_idle = JS_UNDEFINED;
+
+  for(int i = 0; i < THREADS_SETTERS; i++)
+    threads_setters[i] = JS_UNDEFINED;
+
+  if(!(rt = JS_NewRuntime()))
+    goto exit;
+
+  JS_SetCanBlock(rt, TRUE);
+  js_std_init_handlers(rt);
+  js_sab_init(rt);
+  JS_SetInterruptHandler(rt, threads_interrupt_handler, w);
+
+  if(!(ctx = (js_thread_context_new ? js_thread_context_new : threads_context_new)(rt)))
+    goto exit;
+
+  js_std_add_helpers(ctx, 0, 0);
+
+  if(js_eval_str(ctx,
+                 "import * as std from 'std';\nimport * as os from 'os';\n"
+                 "globalThis.std = std;\nglobalThis.os = os;\n",
+                 "<worker>",
+                 JS_EVAL_TYPE_MODULE)) {
+    js_std_dump_error(ctx);
+    goto exit;
+  }
+
+  if(!threads_os_wrap(ctx)) {
+    JS_ThrowInternalError(ctx, "'os' module without handler setters");
+    js_std_dump_error(ctx);
+    goto exit;
+  }
+
+  /* watched even without parent.onmessage, so that terminate() always gets through */
+  if(!threads_watch(ctx, TRUE)) {
+    js_std_dump_error(ctx);
+    goto exit;
+  }
+
+  if(w->source) {
+    ret = JS_Eval(ctx, w->source, strlen(w->source), "<worker>", JS_EVAL_TYPE_MODULE);
+  } else {
+    uint8_t* buf;
+    size_t len;
+
+    if((buf = js_load_file(ctx, &len, w->filename))) {
+      ret = JS_Eval(ctx, (const char*)buf, len, w->filename, JS_EVAL_TYPE_MODULE);
+      js_free(ctx, buf);
+    } else {
+      ret = JS_ThrowReferenceError(ctx, "could not load '%s'", w->filename);
+    }
+  }
+
+  if(JS_IsException(ret)) {
+    JSValue error = JS_GetException(ctx);
+
+    /* the error thrown by terminate() is not reported */
+    if(!threads_is_terminated()) {
+      if((msg = threads_message_error(ctx, error)))
+        threads_channel_post(&w->out, msg);
+      else
+        js_std_dump_error(ctx);
+    }
+
+    JS_FreeValue(ctx, error);
+  } else {
+    JS_FreeValue(ctx, ret);
+
+    if(!JS_IsFunction(ctx, threads_onmessage))
+      threads_idle_arm(ctx, 0);
+
+    js_std_loop(ctx);
+    code = threads_is_terminated() ? 1 : 0;
+  }
+
+exit:
+  if(ctx) {
+    JS_FreeValue(ctx, threads_onmessage);
+    JS_FreeValue(ctx, threads_idle);
+    threads_onmessage = threads_idle = JS_UNDEFINED;
+    threads_sources_free(ctx);
+
+    for(int i = 0; i < THREADS_SETTERS; i++) {
+      JS_FreeValue(ctx, threads_setters[i]);
+      threads_setters[i] = JS_UNDEFINED;
+    }
+
+    js_std_free_handlers(rt);
+
+    if(js_thread_context_free && js_thread_context_new)
+      js_thread_context_free(ctx);
+
+    JS_FreeContext(ctx);
+  }
+
+  if(rt)
+    JS_FreeRuntime(rt);
+
+  if((msg = threads_message_new(THREADS_EXIT, code)))
+    threads_channel_post(&w->out, msg);
+
+  threads_self = 0;
+  threads_worker_free(w);
+  return 0;
+}
+
+static ThreadsWorker*
+js_worker_data2(JSContext* ctx, JSValueConst value) {
+  return JS_GetOpaque2(ctx, value, js_worker_class_id);
+}
+
+static void
+js_worker_callback(JSContext* ctx, JSValueConst obj, const char* name, JSValueConst arg) {
+  JSValue func = JS_GetPropertyStr(ctx, obj, name);
+
+  if(JS_IsFunction(ctx, func))
+    js_call_handler(ctx, func, obj, 1, &arg);
+
+  JS_FreeValue(ctx, func);
+}
+
+/* read handler on the main side: messages, errors and the exit of the worker */
+static JSValue
+js_worker_receive(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  ThreadsWorker* w;
+  ThreadsMessage* msg;
+
+  if(!(w = js_worker_data2(ctx, data[0])))
+    return JS_EXCEPTION;
+
+  threads_channel_drain(&w->out);
+
+  while((msg = threads_channel_take(&w->out))) {
+    JSValue value = JS_UNDEFINED;
+
+    switch(msg->type) {
+      case THREADS_MESSAGE: {
+        JSValue event;
+
+        if(JS_IsException(value = threads_message_read(ctx, msg)))
+          break;
+
+        event = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, event, "data", value);
+        js_worker_callback(ctx, data[0], "onmessage", event);
+        value = event;
+        break;
+      }
+
+      case THREADS_ERROR: {
+        if(JS_IsException(value = threads_error_read(ctx, msg)))
+          break;
+
+        js_worker_callback(ctx, data[0], "onerror", value);
+        break;
+      }
+
+      case THREADS_EXIT: {
+        JSValue set_handler = js_iohandler_fn(ctx, FALSE, 0);
+
+        pthread_join(w->thread, 0);
+        w->exited = TRUE;
+
+        js_iohandler_set(ctx, set_handler, w->out.fds[0], JS_NULL);
+        JS_FreeValue(ctx, set_handler);
+
+        value = JS_NewInt32(ctx, msg->code);
+        js_worker_callback(ctx, data[0], "onexit", value);
+        break;
+      }
+    }
+
+    threads_message_free(msg);
+
+    if(JS_IsException(value)) {
+      threads_channel_rearm(&w->out);
+      return JS_EXCEPTION;
+    }
+
+    JS_FreeValue(ctx, value);
+  }
+
+  return JS_UNDEFINED;
+}
+
+/**
+ * @brief new Worker(filename[, { eval, workerData, transfer }])
+ *
+ * With eval: true, filename is the source of the worker's module.
+ */
+static JSValue
+js_worker_constructor(JSContext* ctx, JSValueConst new_target, int argc, JSValueConst argv[]) {
+  ThreadsWorker* w;
+  JSValue proto, obj = JS_UNDEFINED, set_handler;
+  const char* str;
+  BOOL eval = FALSE;
+
+  if(!(str = JS_ToCString(ctx, argv[0])))
+    return JS_EXCEPTION;
+
+  if(!(w = calloc(1, sizeof(ThreadsWorker)))) {
+    JS_FreeCString(ctx, str);
+    return JS_ThrowOutOfMemory(ctx);
+  }
+
+  w->ref_count = 1;
+  w->in.fds[0] = w->in.fds[1] = w->out.fds[0] = w->out.fds[1] = -1;
+
+  if(argc > 1 && JS_IsObject(argv[1])) {
+    JSValue data = JS_GetPropertyStr(ctx, argv[1], "workerData"), transfer = JS_GetPropertyStr(ctx, argv[1], "transfer");
+
+    BOOL ok = TRUE;
+
+    eval = js_get_propertystr_bool(ctx, argv[1], "eval");
+
+    if(!JS_IsUndefined(data))
+      ok = !!(w->data = threads_message_write(ctx, THREADS_MESSAGE, data, transfer));
+
+    JS_FreeValue(ctx, data);
+    JS_FreeValue(ctx, transfer);
+
+    if(!ok)
+      goto fail;
+  }
+
+  if(eval)
+    w->source = strdup(str);
+  else
+    w->filename = strdup(str);
+
+  if(threads_channel_init(&w->in) == -1 || threads_channel_init(&w->out) == -1) {
+    JS_ThrowInternalError(ctx, "pipe() failed: %s", strerror(errno));
+    goto fail;
+  }
+
+  /* using the prototype from new_target allows for subclassing */
+  proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+  obj = JS_NewObjectProtoClass(ctx, proto, js_worker_class_id);
+  JS_FreeValue(ctx, proto);
+
+  if(JS_IsException(obj))
+    goto fail;
+
+  JS_SetOpaque(obj, w);
+  w->id = atomic_add_int(&threads_next_id, 1) - 1;
+
+  /* one reference for the thread, one for the object */
+  w->ref_count = 2;
+
+  if((errno = pthread_create(&w->thread, 0, threads_worker_thread, w))) {
+    w->ref_count = 1;
+    JS_ThrowInternalError(ctx, "pthread_create() failed: %s", strerror(errno));
+    goto fail;
+  }
+
+  w->started = TRUE;
+
+  /* the handler holds on to the Worker object until the thread has exited */
+  set_handler = js_iohandler_fn(ctx, FALSE, 0);
+
+  if(!js_iohandler_set(ctx, set_handler, w->out.fds[0], JS_NewCFunctionData(ctx, js_worker_receive, 0, 0, 1, &obj))) {
+    __atomic_store_n(&w->terminate, 1, __ATOMIC_RELAXED);
+    JS_FreeValue(ctx, set_handler);
+    goto fail;
+  }
+
+  JS_FreeValue(ctx, set_handler);
+  JS_FreeCString(ctx, str);
+  return obj;
+
+fail:
+  JS_FreeCString(ctx, str);
+
+  if(JS_IsUndefined(obj))
+    threads_worker_free(w);
+  else
+    JS_FreeValue(ctx, obj);
+
+  return JS_EXCEPTION;
+}
+
+static JSValue
+js_worker_post(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ThreadsWorker* w;
+  ThreadsMessage* msg;
+
+  if(!(w = js_worker_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(!(msg = threads_message_write(ctx, THREADS_MESSAGE, argv[0], argc > 1 ? argv[1] : JS_UNDEFINED)))
+    return JS_EXCEPTION;
+
+  if(w->exited)
+    threads_message_free(msg);
+  else
+    threads_channel_post(&w->in, msg);
+
+  return JS_UNDEFINED;
+}
+
+/* interrupts JS running in the worker and ends its event loop */
+static JSValue
+js_worker_terminate(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ThreadsWorker* w;
+
+  if(!(w = js_worker_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  if(!w->exited && !__atomic_exchange_n(&w->terminate, 1, __ATOMIC_RELAXED))
+    threads_channel_wake(&w->in);
+
+  return JS_UNDEFINED;
+}
+
+static JSValue
+js_worker_get(JSContext* ctx, JSValueConst this_val, int magic) {
+  ThreadsWorker* w;
+
+  if(!(w = js_worker_data2(ctx, this_val)))
+    return JS_EXCEPTION;
+
+  return magic ? JS_NewBool(ctx, !w->exited) : JS_NewInt32(ctx, w->id);
+}
+
+static void
+js_worker_finalizer(JSRuntime* rt, JSValue val) {
+  ThreadsWorker* w;
+
+  if((w = JS_GetOpaque(val, js_worker_class_id))) {
+    /* the runtime is going away with the worker still running: end it, nobody joins it */
+    if(w->started && !w->exited) {
+      if(!__atomic_exchange_n(&w->terminate, 1, __ATOMIC_RELAXED))
+        threads_channel_wake(&w->in);
+
+      pthread_detach(w->thread);
+    }
+
+    threads_worker_free(w);
+  }
+}
+
+static JSClassDef js_worker_class = {
+    .class_name = "Worker",
+    .finalizer = js_worker_finalizer,
+};
+
+static const JSCFunctionListEntry js_worker_funcs[] = {
+    JS_CFUNC_DEF("postMessage", 1, js_worker_post),
+    JS_CFUNC_DEF("terminate", 0, js_worker_terminate),
+    JS_CGETSET_MAGIC_DEF("threadId", js_worker_get, 0, 0),
+    JS_CGETSET_MAGIC_DEF("running", js_worker_get, 0, 1),
+    JS_PROP_STRING_DEF("[Symbol.toStringTag]", "Worker", JS_PROP_CONFIGURABLE),
+};
+
+/* read handler on the channel in the worker, messages wait in the queue until parent.onmessage is set */
+static JSValue
+js_parent_receive(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ThreadsWorker* w = threads_self;
+  ThreadsMessage* msg;
+
+  threads_channel_drain(&w->in);
+
+  if(threads_is_terminated()) {
+    threads_loop_clear(ctx);
+    return JS_UNDEFINED;
+  }
+
+  while(JS_IsFunction(ctx, threads_onmessage) && (msg = threads_channel_take(&w->in))) {
+    JSValue value, event;
+
+    value = threads_message_read(ctx, msg);
+    threads_message_free(msg);
+
+    if(JS_IsException(value)) {
+      threads_channel_rearm(&w->in);
+      return JS_EXCEPTION;
+    }
+
+    event = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, event, "data", value);
+
+    if(JS_IsFunction(ctx, threads_onmessage)) {
+      JSValue func = JS_DupValue(ctx, threads_onmessage), ret = JS_Call(ctx, func, JS_UNDEFINED, 1, &event);
+
+      JS_FreeValue(ctx, func);
+
+      if(JS_IsException(ret)) {
+        JS_FreeValue(ctx, event);
+
+        /* interrupted by terminate() */
+        if(threads_is_terminated()) {
+          JS_FreeValue(ctx, JS_GetException(ctx));
+          threads_loop_clear(ctx);
+          return JS_UNDEFINED;
+        }
+
+        threads_channel_rearm(&w->in);
+        return JS_EXCEPTION;
+      }
+
+      JS_FreeValue(ctx, ret);
+    }
+
+    JS_FreeValue(ctx, event);
+  }
+
+  return JS_UNDEFINED;
+}
+
+/* idle timer in a worker without parent.onmessage: stops watching the channel once nothing else is left */
+static JSValue
+js_parent_idle(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  JS_FreeValue(ctx, threads_idle);
+  threads_idle = JS_UNDEFINED;
+
+  if(JS_IsFunction(ctx, threads_onmessage))
+    return JS_UNDEFINED;
+
+  if(!threads_loop_busy()) {
+    if(!threads_watch(ctx, FALSE))
+      return JS_EXCEPTION;
+
+    return JS_UNDEFINED;
+  }
+
+  threads_idle_arm(ctx, THREADS_IDLE_CHECK);
+  return JS_UNDEFINED;
+}
+
+static JSValue
+js_parent_post(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  ThreadsMessage* msg;
+
+  if(!(msg = threads_message_write(ctx, THREADS_MESSAGE, argv[0], argc > 1 ? argv[1] : JS_UNDEFINED)))
+    return JS_EXCEPTION;
+
+  threads_channel_post(&threads_self->out, msg);
+  return JS_UNDEFINED;
+}
+
+static JSValue
+js_parent_get_onmessage(JSContext* ctx, JSValueConst this_val) {
+  return JS_DupValue(ctx, threads_onmessage);
+}
+
+/* the worker's event loop keeps running as long as a function is set */
+static JSValue
+js_parent_set_onmessage(JSContext* ctx, JSValueConst this_val, JSValueConst value) {
+  BOOL listening = JS_IsFunction(ctx, threads_onmessage), listen = JS_IsFunction(ctx, value);
+
+  JS_FreeValue(ctx, threads_onmessage);
+  threads_onmessage = JS_DupValue(ctx, value);
+
+  if(listen != listening) {
+    if(listen) {
+      threads_idle_stop(ctx);
+
+      if(!threads_watch(ctx, TRUE))
+        return JS_EXCEPTION;
+
+      /* deliver what arrived in the meantime */
+      threads_channel_rearm(&threads_self->in);
+    } else {
+      threads_idle_arm(ctx, 0);
+    }
+  }
+
+  return JS_UNDEFINED;
+}
+
+static const JSCFunctionListEntry js_parent_funcs[] = {
+    JS_CFUNC_DEF("postMessage", 1, js_parent_post),
+    JS_CGETSET_DEF("onmessage", js_parent_get_onmessage, js_parent_set_onmessage),
+};
+
+static JSValue
+js_threads_parallelism(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return JS_NewInt32(ctx, n > 0 ? n : 1);
+}
+
+static const JSCFunctionListEntry js_threads_funcs[] = {
+    JS_CFUNC_DEF("availableParallelism", 0, js_threads_parallelism),
+};
+
+static int
+js_threads_init(JSContext* ctx, JSModuleDef* m) {
+  JSValue worker_ctor, worker_proto, parent = JS_NULL, data = JS_UNDEFINED;
+
+  js_sab_init(JS_GetRuntime(ctx));
+
+  JS_NewClassID(&js_worker_class_id);
+  JS_NewClass(JS_GetRuntime(ctx), js_worker_class_id, &js_worker_class);
+
+  worker_ctor = JS_NewCFunction2(ctx, js_worker_constructor, "Worker", 1, JS_CFUNC_constructor, 0);
+  worker_proto = JS_NewObject(ctx);
+  JS_SetPropertyFunctionList(ctx, worker_proto, js_worker_funcs, countof(js_worker_funcs));
+  JS_SetClassProto(ctx, js_worker_class_id, worker_proto);
+  JS_SetConstructor(ctx, worker_ctor, worker_proto);
+
+  if(threads_self) {
+    parent = JS_NewObject(ctx);
+    JS_SetPropertyFunctionList(ctx, parent, js_parent_funcs, countof(js_parent_funcs));
+
+    if(threads_self->data) {
+      data = threads_message_read(ctx, threads_self->data);
+      threads_message_free(threads_self->data);
+      threads_self->data = 0;
+
+      if(JS_IsException(data)) {
+        JS_FreeValue(ctx, parent);
+        JS_FreeValue(ctx, worker_ctor);
+        return -1;
+      }
+    }
+  }
+
+  if(m) {
+    JS_SetModuleExportList(ctx, m, js_threads_funcs, countof(js_threads_funcs));
+    JS_SetModuleExport(ctx, m, "Worker", worker_ctor);
+    JS_SetModuleExport(ctx, m, "parent", parent);
+    JS_SetModuleExport(ctx, m, "workerData", data);
+    JS_SetModuleExport(ctx, m, "isMainThread", JS_NewBool(ctx, !threads_self));
+    JS_SetModuleExport(ctx, m, "threadId", JS_NewInt32(ctx, threads_self ? threads_self->id : 0));
+  }
+
+  return 0;
+}
+
+#if defined(JS_SHARED_LIBRARY) && defined(JS_THREADS_MODULE)
+#define JS_INIT_MODULE js_init_module
+#else
+#define JS_INIT_MODULE js_init_module_threads
+#endif
+
+VISIBLE JSModuleDef*
+JS_INIT_MODULE(JSContext* ctx, const char* module_name) {
+  JSModuleDef* m;
+
+  if((m = JS_NewCModule(ctx, module_name, js_threads_init))) {
+    JS_AddModuleExportList(ctx, m, js_threads_funcs, countof(js_threads_funcs));
+    JS_AddModuleExport(ctx, m, "Worker");
+    JS_AddModuleExport(ctx, m, "parent");
+    JS_AddModuleExport(ctx, m, "workerData");
+    JS_AddModuleExport(ctx, m, "isMainThread");
+    JS_AddModuleExport(ctx, m, "threadId");
+  }
+
+  return m;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,312 @@
+#include "alloc-trace.h"
+#include "defines.h"
+#include <cutils.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/**
+ * \addtogroup alloc-trace
+ * @{
+ */
+
+/* pages per mapped window, each window holds event_size * pages_per_window * page_size bytes */
+#define ALLOC_TRACE_WINDOW_PAGES 16
+#define ALLOC_TRACE_STACK_MAX 4096
+
+typedef struct {
+  uint64_t hash;
+  uint32_t id;
+  uint32_t len;
+  char* text; /* compared on a hash match, two stacks may share a hash */
+} AllocTraceStack;
+
+struct alloc_trace {
+  int fd, flags;
+  uint8_t* window;
+  size_t window_size, pos;
+  uint64_t offset; /* of the window in the file */
+  uint64_t start, interval;
+  int64_t countdown;
+  AllocTraceStackFunc* stack_fn;
+  void* opaque;
+  AllocTraceStack* stacks;
+  size_t nstacks, cstacks;
+  BOOL sampling;
+  char buf[ALLOC_TRACE_STACK_MAX];
+};
+
+static uint64_t
+alloc_trace_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifndef _WIN32
+static int
+alloc_trace_map(AllocTrace* t) {
+  void* p;
+
+  if(ftruncate(t->fd, t->offset + t->window_size) == -1)
+    return -1;
+
+  if((p = mmap(0, t->window_size, PROT_READ | PROT_WRITE, MAP_SHARED, t->fd, t->offset)) == MAP_FAILED)
+    return -1;
+
+  t->window = p;
+  t->pos = 0;
+  return 0;
+}
+
+/**
+ * @brief Next event slot, moving the window on when it is full
+ *
+ * @return  pointer to sizeof(AllocTraceEvent) bytes, NULL if the trace could not be extended
+ */
+static void*
+alloc_trace_slot(AllocTrace* t) {
+  void* slot;
+
+  if(!t->window)
+    return 0;
+
+  if(t->pos == t->window_size) {
+    munmap(t->window, t->window_size);
+    t->window = 0;
+    t->offset += t->window_size;
+
+    if(alloc_trace_map(t))
+      return 0;
+  }
+
+  slot = t->window + t->pos;
+  t->pos += sizeof(AllocTraceEvent);
+  return slot;
+}
+#else
+static void*
+alloc_trace_slot(AllocTrace* t) {
+  return 0;
+}
+#endif
+
+static void
+alloc_trace_event(AllocTrace* t, int type, uint32_t stack, void* ptr, uint64_t size, uint64_t arg) {
+  AllocTraceEvent* e;
+
+  if((e = alloc_trace_slot(t))) {
+    e->type = type;
+    e->stack = stack;
+    e->time = alloc_trace_now() - t->start;
+    e->ptr = (uintptr_t)ptr;
+    e->size = size;
+    e->arg = arg;
+  }
+}
+
+static uint32_t
+alloc_trace_stack(AllocTrace* t, const char* s, size_t len) {
+  uint64_t h = 14695981039346656037ull;
+  size_t i;
+
+  for(i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 1099511628211ull;
+  }
+
+  if(t->nstacks * 4 >= t->cstacks * 3) {
+    size_t capacity = t->cstacks ? t->cstacks * 2 : 1024;
+    AllocTraceStack* stacks;
+
+    if(!(stacks = calloc(capacity, sizeof(AllocTraceStack))))
+      return 0;
+
+    for(i = 0; i < t->cstacks; i++)
+      if(t->stacks[i].id) {
+        size_t j = t->stacks[i].hash & (capacity - 1);
+
+        while(stacks[j].id)
+          j = (j + 1) & (capacity - 1);
+
+        stacks[j] = t->stacks[i];
+      }
+
+    free(t->stacks);
+    t->stacks = stacks;
+    t->cstacks = capacity;
+  }
+
+  for(i = h & (t->cstacks - 1); t->stacks[i].id; i = (i + 1) & (t->cstacks - 1))
+    if(t->stacks[i].hash == h && t->stacks[i].len == len && !memcmp(t->stacks[i].text, s, len))
+      return t->stacks[i].id;
+
+  if(!(t->stacks[i].text = malloc(len + 1)))
+    return 0;
+
+  memcpy(t->stacks[i].text, s, len);
+  t->stacks[i].hash = h;
+  t->stacks[i].len = len;
+  t->stacks[i].id = ++t->nstacks;
+
+  alloc_trace_event(t, ALLOC_TRACE_STACK, t->stacks[i].id, 0, len, 0);
+
+  for(size_t pos = 0; pos < len; pos += sizeof(AllocTraceEvent)) {
+    uint8_t* slot;
+
+    if(!(slot = alloc_trace_slot(t)))
+      break;
+
+    memset(slot, 0, sizeof(AllocTraceEvent));
+    memcpy(slot, &s[pos], MIN_NUM(len - pos, sizeof(AllocTraceEvent)));
+  }
+
+  return t->stacks[i].id;
+}
+
+static void
+alloc_trace_sample(AllocTrace* t, void* ptr, size_t size) {
+  uint64_t n;
+  size_t len;
+
+  if(!t->interval || (t->countdown -= size) > 0)
+    return;
+
+  n = 1 + (uint64_t)(-t->countdown) / t->interval;
+  t->countdown += n * t->interval;
+
+  /* the stack function may allocate itself */
+  if(t->sampling)
+    return;
+
+  t->sampling = TRUE;
+  len = t->stack_fn ? t->stack_fn(t->opaque, t->buf, sizeof(t->buf)) : 0;
+  alloc_trace_event(t, ALLOC_TRACE_SAMPLE, alloc_trace_stack(t, t->buf, len), ptr, size, n * t->interval);
+  t->sampling = FALSE;
+}
+
+/**
+ * @brief Create \param file and start tracing into it
+ *
+ * @param flags            ALLOC_TRACE_EVENTS to record every allocation,
+ *                         ALLOC_TRACE_FREES to record only frees and reallocs
+ * @param sample_interval  take a sample every that many bytes, 0 for none
+ *
+ * @return  the trace, NULL with errno set on failure
+ */
+AllocTrace*
+alloc_trace_open(const char* file, int flags, uint64_t sample_interval, AllocTraceStackFunc* stack_fn, void* opaque) {
+#ifndef _WIN32
+  AllocTraceHeader* h;
+  AllocTrace* t;
+  size_t header_size = sizeof(AllocTraceHeader);
+  struct timespec ts;
+  int error;
+
+  if(!(t = calloc(1, sizeof(AllocTrace))))
+    return 0;
+
+  t->flags = flags;
+  t->interval = t->countdown = sample_interval;
+  t->stack_fn = stack_fn;
+  t->opaque = opaque;
+  t->window_size = sizeof(AllocTraceEvent) * sysconf(_SC_PAGESIZE) * ALLOC_TRACE_WINDOW_PAGES;
+
+  if((t->fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1)
+    goto fail;
+
+  if(alloc_trace_map(t))
+    goto fail;
+
+  /* the header takes whole event slots */
+  header_size = (header_size + sizeof(AllocTraceEvent) - 1) / sizeof(AllocTraceEvent) * sizeof(AllocTraceEvent);
+
+  h = (AllocTraceHeader*)t->window;
+  memcpy(h->magic, ALLOC_TRACE_MAGIC, sizeof(h->magic));
+  h->version = ALLOC_TRACE_VERSION;
+  h->event_size = sizeof(AllocTraceEvent);
+  h->header_size = header_size;
+  h->flags = flags;
+  h->sample_interval = sample_interval;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  h->start = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+  t->pos = header_size;
+  t->start = alloc_trace_now();
+  return t;
+
+fail:
+  error = errno;
+
+  if(t->fd != -1)
+    close(t->fd);
+
+  free(t);
+  errno = error;
+#else
+  errno = ENOSYS;
+#endif
+  return 0;
+}
+
+void
+alloc_trace_malloc(AllocTrace* t, void* ptr, size_t size) {
+  if(t->flags & ALLOC_TRACE_EVENTS)
+    alloc_trace_event(t, ALLOC_TRACE_MALLOC, 0, ptr, size, 0);
+
+  alloc_trace_sample(t, ptr, size);
+}
+
+void
+alloc_trace_free(AllocTrace* t, void* ptr, size_t usable) {
+  if(t->flags & (ALLOC_TRACE_EVENTS | ALLOC_TRACE_FREES))
+    alloc_trace_event(t, ALLOC_TRACE_FREE, 0, ptr, usable, 0);
+}
+
+void
+alloc_trace_realloc(AllocTrace* t, void* old, void* ptr, size_t size) {
+  if(t->flags & (ALLOC_TRACE_EVENTS | ALLOC_TRACE_FREES))
+    alloc_trace_event(t, ALLOC_TRACE_REALLOC, 0, ptr, size, (uintptr_t)old);
+
+  if(ptr)
+    alloc_trace_sample(t, ptr, size);
+}
+
+/**
+ * @brief Stop tracing, truncate the file to the events written and close it
+ */
+int
+alloc_trace_close(AllocTrace* t) {
+  int ret = 0;
+
+#ifndef _WIN32
+  if(t->window)
+    munmap(t->window, t->window_size);
+
+  if(ftruncate(t->fd, t->offset + (t->window ? t->pos : 0)) == -1)
+    ret = -1;
+
+  if(close(t->fd) == -1)
+    ret = -1;
+#endif
+
+  for(size_t i = 0; i < t->cstacks; i++)
+    if(t->stacks[i].id)
+      free(t->stacks[i].text);
+
+  free(t->stacks);
+  free(t);
+  return ret;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,627 @@
+#include "dir-walk.h"
+#include "defines.h"
+#include "glob-set.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/**
+ * \addtogroup dir-walk
+ * @{
+ */
+
+#define DIR_WALK_THREADS 4
+#define DIR_WALK_THREADS_MAX 64
+#define DIR_WALK_BATCH 1024
+/* batches waiting to be consumed before the workers pause */
+#define DIR_WALK_MAX_BATCHES 64
+
+typedef struct dir_walk_item {
+  struct dir_walk_item* next;
+  int depth;
+  GlobState state;
+  char path[];
+} DirWalkItem;
+
+struct dir_walk {
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_t lock;
+  pthread_cond_t work, space;
+#endif
+  DirWalkItem* queue;
+  DirWalkBatch *head, *tail;
+  size_t nbatches;
+  uint32_t busy, running, refs;
+  BOOL threaded, finished;
+  _Atomic(int) cancel;
+  int error, fds[2];
+  size_t rel;
+  GlobSet* globs;
+  int types, max_depth;
+  size_t batch_size;
+};
+
+#ifdef HAVE_PTHREAD_H
+#define dir_walk_lock(w) pthread_mutex_lock(&(w)->lock)
+#define dir_walk_unlock(w) pthread_mutex_unlock(&(w)->lock)
+#else
+#define dir_walk_lock(w)
+#define dir_walk_unlock(w)
+#endif
+
+static GlobSet*
+dir_walk_globs(const DirWalkOptions* opts) {
+  GlobSet* set;
+
+  if(!(set = glob_set_new(GLOB_SET_MATCHBASE)))
+    return 0;
+
+  for(size_t i = 0; i < opts->ninclude; i++)
+    if(glob_set_add(set, opts->include[i], strlen(opts->include[i]), 0))
+      goto fail;
+
+  for(size_t i = 0; i < opts->nexclude; i++)
+    if(glob_set_add(set, opts->exclude[i], strlen(opts->exclude[i]), GLOB_SET_EXCLUDE))
+      goto fail;
+
+  return set;
+
+fail:
+  glob_set_free(set);
+  return 0;
+}
+
+static DirWalkItem*
+dir_walk_item(const char* path, size_t len, int depth) {
+  DirWalkItem* item;
+
+  if((item = malloc(sizeof(DirWalkItem) + len + 1))) {
+    item->next = 0;
+    item->depth = depth;
+    glob_state_init(&item->state);
+    memcpy(item->path, path, len);
+    item->path[len] = '\0';
+  }
+
+  return item;
+}
+
+static void
+dir_walk_item_free(DirWalkItem* item) {
+  glob_state_free(&item->state);
+  free(item);
+}
+
+static int
+dir_walk_append(DirWalkBatch** bp, int type, const char* path, size_t len) {
+  DirWalkBatch* b;
+
+  if(!(b = *bp) && !(b = *bp = calloc(1, sizeof(DirWalkBatch))))
+    return -1;
+
+  if(b->len + len + 2 > b->capacity) {
+    size_t capacity = MAX_NUM(b->capacity * 2, b->len + len + 2);
+    char* data;
+
+    if(!(data = realloc(b->data, MAX_NUM(capacity, 65536))))
+      return -1;
+
+    b->data = data;
+    b->capacity = MAX_NUM(capacity, 65536);
+  }
+
+  b->data[b->len++] = type;
+  memcpy(&b->data[b->len], path, len + 1);
+  b->len += len + 1;
+  b->count++;
+  return 0;
+}
+
+static void
+dir_walk_wakeup(DirWalk* w) {
+  if(w->fds[1] != -1)
+    while(write(w->fds[1], "", 1) == -1 && errno == EINTR) {}
+}
+
+/**
+ * @brief Hand \param b over to the consumer, waiting while too many batches are pending
+ *
+ * Called with the lock held.
+ */
+static void
+dir_walk_push(DirWalk* w, DirWalkBatch* b) {
+#ifdef HAVE_PTHREAD_H
+  while(w->threaded && w->nbatches >= DIR_WALK_MAX_BATCHES && !w->cancel)
+    pthread_cond_wait(&w->space, &w->lock);
+#endif
+
+  if(w->cancel) {
+    dir_walk_batch_free(b);
+    return;
+  }
+
+  if(w->tail)
+    w->tail->next = b;
+  else
+    w->head = b;
+
+  w->tail = b;
+
+  if(w->nbatches++ == 0)
+    dir_walk_wakeup(w);
+}
+
+static int
+dir_walk_lstat(const char* path) {
+  struct stat st;
+
+#ifdef _WIN32
+  if(stat(path, &st) == -1)
+#else
+  if(lstat(path, &st) == -1)
+#endif
+    return 0;
+
+  if(S_ISREG(st.st_mode))
+    return TYPE_REG;
+  if(S_ISDIR(st.st_mode))
+    return TYPE_DIR;
+#ifdef S_ISLNK
+  if(S_ISLNK(st.st_mode))
+    return TYPE_LNK;
+#endif
+#ifdef S_ISBLK
+  if(S_ISBLK(st.st_mode))
+    return TYPE_BLK;
+#endif
+  if(S_ISCHR(st.st_mode))
+    return TYPE_CHR;
+#ifdef S_ISFIFO
+  if(S_ISFIFO(st.st_mode))
+    return TYPE_FIFO;
+#endif
+#ifdef S_ISSOCK
+  if(S_ISSOCK(st.st_mode))
+    return TYPE_SOCK;
+#endif
+
+  return 0;
+}
+
+/**
+ * @brief Read the directory \param item, queueing its subdirectories and adding matching entries to \param batch
+ *
+ * Each queued directory carries the pattern state of its path, so every entry is matched with a single step and
+ * directories below which nothing can match are not queued at all.
+ */
+static void
+dir_walk_dir(DirWalk* w, Directory* d, DirWalkItem* item, DirWalkBatch** batch) {
+  size_t dlen = strlen(item->path), size = dlen + 258, nlen, len;
+  int depth = item->depth + 1, type, result = GLOB_SET_MATCH | GLOB_SET_DESCEND;
+  char *buf, *name;
+  GlobState state;
+  DirEntry* e;
+
+  if(w->max_depth >= 0 && depth > w->max_depth)
+    return;
+
+  if(getdents_open(d, item->path)) {
+    if(item->depth == 0) {
+      dir_walk_lock(w);
+      w->error = errno;
+      dir_walk_unlock(w);
+    }
+
+    return;
+  }
+
+  if(!(buf = malloc(size)))
+    goto end;
+
+  glob_state_init(&state);
+
+  memcpy(buf, item->path, dlen);
+
+  if(dlen == 0 || buf[dlen - 1] != '/')
+    buf[dlen++] = '/';
+
+  while(!w->cancel && (e = getdents_read(d))) {
+#if !(defined(_WIN32) && !defined(__MSYS__))
+    name = (char*)getdents_cname(e);
+#else
+    if(!(name = getdents_name(e)))
+      continue;
+#endif
+
+    if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      goto next;
+
+    nlen = strlen(name);
+    len = dlen + nlen;
+
+    if(len + 1 > size) {
+      char* tmp;
+
+      if(!(tmp = realloc(buf, len + 1)))
+        goto next;
+
+      buf = tmp;
+      size = len + 1;
+    }
+
+    memcpy(&buf[dlen], name, nlen + 1);
+
+    if(!(type = getdents_type(e)))
+      type = dir_walk_lstat(buf);
+
+    if(w->globs && ((result = glob_set_step(w->globs, &item->state, name, nlen, &state)) == -1 ||
+                    (result & GLOB_SET_EXCLUDED)))
+      goto next;
+
+    if((type & w->types) && (result & GLOB_SET_MATCH) && dir_walk_append(batch, type, buf, len) == 0 &&
+       (*batch)->count >= w->batch_size) {
+      dir_walk_lock(w);
+      dir_walk_push(w, *batch);
+      dir_walk_unlock(w);
+      *batch = 0;
+    }
+
+    if(type == TYPE_DIR && (result & GLOB_SET_DESCEND) && (w->max_depth < 0 || depth < w->max_depth)) {
+      DirWalkItem* sub;
+
+      if((sub = dir_walk_item(buf, len, depth))) {
+        if(w->globs)
+          glob_state_move(&sub->state, &state);
+
+        dir_walk_lock(w);
+        sub->next = w->queue;
+        w->queue = sub;
+#ifdef HAVE_PTHREAD_H
+        if(w->threaded)
+          pthread_cond_signal(&w->work);
+#endif
+        dir_walk_unlock(w);
+      }
+    }
+
+  next:
+#if defined(_WIN32) && !defined(__MSYS__)
+    free(name);
+#endif
+    continue;
+  }
+
+  glob_state_free(&state);
+  free(buf);
+
+end:
+  getdents_close(d);
+}
+
+static void
+dir_walk_destroy(DirWalk* w) {
+  DirWalkItem* item;
+  DirWalkBatch* b;
+
+  while((item = w->queue)) {
+    w->queue = item->next;
+    dir_walk_item_free(item);
+  }
+
+  while((b = w->head)) {
+    w->head = b->next;
+    dir_walk_batch_free(b);
+  }
+
+  if(w->globs)
+    glob_set_free(w->globs);
+
+  if(w->fds[0] != -1)
+    close(w->fds[0]);
+  if(w->fds[1] != -1)
+    close(w->fds[1]);
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_destroy(&w->lock);
+  pthread_cond_destroy(&w->work);
+  pthread_cond_destroy(&w->space);
+#endif
+
+  free(w);
+}
+
+static void
+dir_walk_release(DirWalk* w) {
+  BOOL last;
+
+  dir_walk_lock(w);
+  last = --w->refs == 0;
+  dir_walk_unlock(w);
+
+  if(last)
+    dir_walk_destroy(w);
+}
+
+#ifdef HAVE_PTHREAD_H
+static void*
+dir_walk_thread(void* arg) {
+  DirWalk* w = arg;
+  DirWalkBatch* batch = 0;
+  DirWalkItem* item;
+  Directory* d;
+
+  if((d = malloc(getdents_size())))
+    getdents_clear(d);
+
+  dir_walk_lock(w);
+
+  while(d) {
+    while(!w->queue && w->busy && !w->cancel) {
+      /* hand over what we have before going idle */
+      if(batch) {
+        dir_walk_push(w, batch);
+        batch = 0;
+        continue;
+      }
+
+      pthread_cond_wait(&w->work, &w->lock);
+    }
+
+    if(w->cancel || !(item = w->queue))
+      break;
+
+    w->queue = item->next;
+    w->busy++;
+    dir_walk_unlock(w);
+
+    dir_walk_dir(w, d, item, &batch);
+    dir_walk_item_free(item);
+
+    dir_walk_lock(w);
+
+    if(--w->busy == 0 && !w->queue)
+      pthread_cond_broadcast(&w->work);
+  }
+
+  if(batch)
+    dir_walk_push(w, batch);
+
+  if(--w->running == 0) {
+    w->finished = TRUE;
+    dir_walk_wakeup(w);
+  }
+
+  dir_walk_unlock(w);
+
+  if(d)
+    free(d);
+
+  dir_walk_release(w);
+  return 0;
+}
+#endif
+
+/**
+ * @brief Walk on the calling thread until a batch is ready, when no threads could be started
+ */
+static void
+dir_walk_inline(DirWalk* w) {
+  DirWalkBatch* batch = 0;
+  DirWalkItem* item;
+  Directory* d;
+
+  if(!(d = malloc(getdents_size()))) {
+    w->error = ENOMEM;
+    w->finished = TRUE;
+    return;
+  }
+
+  getdents_clear(d);
+
+  while(!w->head && !w->cancel && (item = w->queue)) {
+    w->queue = item->next;
+    dir_walk_dir(w, d, item, &batch);
+    dir_walk_item_free(item);
+  }
+
+  free(d);
+
+  if(batch)
+    dir_walk_push(w, batch);
+
+  if(!w->queue || w->cancel)
+    w->finished = TRUE;
+}
+
+void
+dir_walk_options(DirWalkOptions* opts) {
+  memset(opts, 0, sizeof(DirWalkOptions));
+  opts->types = TYPE_MASK;
+  opts->max_depth = -1;
+  opts->threads = DIR_WALK_THREADS;
+  opts->batch_size = DIR_WALK_BATCH;
+}
+
+DirWalk*
+dir_walk_new(const char* root, const DirWalkOptions* opts) {
+  size_t len = strlen(root);
+  DirWalk* w;
+
+  if(!(w = calloc(1, sizeof(DirWalk))))
+    return 0;
+
+  w->fds[0] = w->fds[1] = -1;
+  w->refs = 1;
+  w->types = opts->types;
+  w->max_depth = opts->max_depth;
+  w->batch_size = opts->batch_size ? opts->batch_size : DIR_WALK_BATCH;
+
+#ifdef HAVE_PTHREAD_H
+  pthread_mutex_init(&w->lock, 0);
+  pthread_cond_init(&w->work, 0);
+  pthread_cond_init(&w->space, 0);
+#endif
+
+  if((opts->ninclude || opts->nexclude) && !(w->globs = dir_walk_globs(opts)))
+    goto fail;
+
+  while(len > 1 && root[len - 1] == '/')
+    len--;
+
+  /* offset of the path relative to the root in the paths below it */
+  w->rel = len + (len == 0 || root[len - 1] != '/');
+
+  if(!(w->queue = dir_walk_item(len ? root : ".", len ? len : 1, 0)))
+    goto fail;
+
+  if(w->globs && glob_set_start(w->globs, &w->queue->state) == -1)
+    goto fail;
+
+  if(!len)
+    w->rel = 2;
+
+#ifdef HAVE_PTHREAD_H
+  if(opts->threads > 0 && pipe(w->fds) == 0) {
+    int n = MIN_NUM(opts->threads, DIR_WALK_THREADS_MAX);
+
+    fcntl(w->fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(w->fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(w->fds[1], F_SETFD, FD_CLOEXEC);
+
+    dir_walk_lock(w);
+
+    for(int i = 0; i < n; i++) {
+      pthread_attr_t attr;
+      pthread_t thread;
+
+      pthread_attr_init(&attr);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+      if(pthread_create(&thread, &attr, dir_walk_thread, w) == 0) {
+        w->running++;
+        w->refs++;
+      }
+
+      pthread_attr_destroy(&attr);
+    }
+
+    w->threaded = w->running > 0;
+    dir_walk_unlock(w);
+  }
+#endif
+
+  return w;
+
+fail:
+  dir_walk_destroy(w);
+  return 0;
+}
+
+/**
+ * @brief File descriptor which becomes readable when dir_walk_next() has something, -1 if it never blocks
+ */
+int
+dir_walk_fd(DirWalk* w) {
+  return w->threaded ? w->fds[0] : -1;
+}
+
+/**
+ * @brief Take the next batch of entries
+ *
+ * @return  a batch to be freed with dir_walk_batch_free(), or NULL when there is none yet
+ *          (*done is then TRUE if the walk has finished)
+ */
+DirWalkBatch*
+dir_walk_next(DirWalk* w, BOOL* done) {
+  DirWalkBatch* b;
+
+  if(!w->threaded && !w->finished)
+    dir_walk_inline(w);
+
+  dir_walk_lock(w);
+
+  if((b = w->head)) {
+    if(!(w->head = b->next))
+      w->tail = 0;
+
+    b->next = 0;
+    w->nbatches--;
+
+#ifdef HAVE_PTHREAD_H
+    pthread_cond_signal(&w->space);
+#endif
+  }
+
+  *done = !b && w->finished;
+  dir_walk_unlock(w);
+
+  return b;
+}
+
+/**
+ * @brief errno of opening the root directory, 0 if it could be read
+ */
+int
+dir_walk_error(DirWalk* w) {
+  int ret;
+
+  dir_walk_lock(w);
+  ret = w->error;
+  dir_walk_unlock(w);
+
+  return ret;
+}
+
+/**
+ * @brief Stop the walk, dir_walk_next() reports it as done once the threads have stopped
+ */
+void
+dir_walk_cancel(DirWalk* w) {
+  DirWalkBatch* b;
+
+  dir_walk_lock(w);
+  w->cancel = TRUE;
+
+  while((b = w->head)) {
+    w->head = b->next;
+    dir_walk_batch_free(b);
+  }
+
+  w->tail = 0;
+  w->nbatches = 0;
+
+#ifdef HAVE_PTHREAD_H
+  pthread_cond_broadcast(&w->work);
+  pthread_cond_broadcast(&w->space);
+#endif
+
+  if(!w->threaded)
+    w->finished = TRUE;
+
+  dir_walk_unlock(w);
+}
+
+void
+dir_walk_free(DirWalk* w) {
+  dir_walk_cancel(w);
+  dir_walk_release(w);
+}
+
+void
+dir_walk_batch_free(DirWalkBatch* b) {
+  if(b->data)
+    free(b->data);
+
+  free(b);
+}
+
+/**
+ * @}
+ */
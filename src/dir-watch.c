@@ -0,0 +1,575 @@
+#include "dir-watch.h"
+#include "defines.h"
+#include "glob-set.h"
+
+#ifdef HAVE_INOTIFY
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+
+/**
+ * \addtogroup dir-watch
+ * @{
+ */
+
+#define DIR_WATCH_MASK \
+  (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF)
+/* needed to follow the tree whatever the caller asked for */
+#define DIR_WATCH_TREE (IN_CREATE | IN_MOVED_FROM | IN_MOVED_TO)
+#define DIR_WATCH_DELAY 50
+#define DIR_WATCH_MAX_DELAY 1000
+
+/* watch descriptor -> directory */
+typedef struct dir_watch_node {
+  struct dir_watch_node* next;
+  int wd;
+  char* path;
+} DirWatchNode;
+
+/* path -> events in the current change set */
+typedef struct dir_watch_entry {
+  struct dir_watch_entry *next, *link;
+  uint32_t hash, mask;
+  char path[];
+} DirWatchEntry;
+
+struct dir_watch {
+  int fd, timerfd;
+  uint32_t mask, report, delay, max_delay;
+  char* root;
+  size_t rel;
+  GlobSet* exclude;
+  DirWatchNode** nodes;
+  size_t nnodes, cnodes;
+  DirWatchEntry **entries, *first, **last;
+  size_t nentries, centries;
+  int64_t since;
+  BOOL overflow;
+};
+
+static uint32_t
+dir_watch_hash(const char* s, size_t len) {
+  uint32_t h = 2166136261u;
+
+  for(size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+static int64_t
+dir_watch_now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static BOOL
+dir_watch_excluded(DirWatch* w, const char* path) {
+  const char* rel = path + w->rel;
+
+  return !!(glob_set_match(w->exclude, rel, strlen(rel)) & GLOB_SET_EXCLUDED);
+}
+
+static DirWatchNode*
+dir_watch_node(DirWatch* w, int wd) {
+  DirWatchNode* node;
+
+  if(w->cnodes)
+    for(node = w->nodes[(uint32_t)wd & (w->cnodes - 1)]; node; node = node->next)
+      if(node->wd == wd)
+        return node;
+
+  return 0;
+}
+
+static void
+dir_watch_node_set(DirWatch* w, int wd, const char* path) {
+  DirWatchNode* node;
+  char* s;
+
+  if(!(s = strdup(path)))
+    return;
+
+  if((node = dir_watch_node(w, wd))) {
+    free(node->path);
+    node->path = s;
+    return;
+  }
+
+  if(w->nnodes >= w->cnodes) {
+    size_t capacity = w->cnodes ? w->cnodes * 2 : 64;
+    DirWatchNode** nodes;
+
+    if(!(nodes = calloc(capacity, sizeof(DirWatchNode*)))) {
+      free(s);
+      return;
+    }
+
+    for(size_t i = 0; i < w->cnodes; i++)
+      while((node = w->nodes[i])) {
+        w->nodes[i] = node->next;
+        node->next = nodes[(uint32_t)node->wd & (capacity - 1)];
+        nodes[(uint32_t)node->wd & (capacity - 1)] = node;
+      }
+
+    free(w->nodes);
+    w->nodes = nodes;
+    w->cnodes = capacity;
+  }
+
+  if(!(node = malloc(sizeof(DirWatchNode)))) {
+    free(s);
+    return;
+  }
+
+  node->wd = wd;
+  node->path = s;
+  node->next = w->nodes[(uint32_t)wd & (w->cnodes - 1)];
+  w->nodes[(uint32_t)wd & (w->cnodes - 1)] = node;
+  w->nnodes++;
+}
+
+static void
+dir_watch_node_remove(DirWatch* w, int wd) {
+  DirWatchNode **ptr, *node;
+
+  if(w->cnodes)
+    for(ptr = &w->nodes[(uint32_t)wd & (w->cnodes - 1)]; (node = *ptr); ptr = &node->next)
+      if(node->wd == wd) {
+        *ptr = node->next;
+        free(node->path);
+        free(node);
+        w->nnodes--;
+        return;
+      }
+}
+
+/**
+ * @brief Stop watching \param path and everything below it
+ */
+static void
+dir_watch_remove_tree(DirWatch* w, const char* path) {
+  size_t len = strlen(path);
+  DirWatchNode **ptr, *node;
+
+  for(size_t i = 0; i < w->cnodes; i++)
+    for(ptr = &w->nodes[i]; (node = *ptr);) {
+      if(!strncmp(node->path, path, len) && (node->path[len] == '\0' || node->path[len] == '/')) {
+        inotify_rm_watch(w->fd, node->wd);
+
+        *ptr = node->next;
+        free(node->path);
+        free(node);
+        w->nnodes--;
+        continue;
+      }
+
+      ptr = &node->next;
+    }
+}
+
+static void
+dir_watch_record(DirWatch* w, const char* path, uint32_t mask) {
+  size_t len = strlen(path);
+  uint32_t hash = dir_watch_hash(path, len);
+  DirWatchEntry* e;
+
+  if(w->centries)
+    for(e = w->entries[hash & (w->centries - 1)]; e; e = e->next)
+      if(e->hash == hash && !strcmp(e->path, path)) {
+        e->mask |= mask;
+        return;
+      }
+
+  if(w->nentries >= w->centries) {
+    size_t capacity = w->centries ? w->centries * 2 : 256;
+    DirWatchEntry** entries;
+
+    if(!(entries = calloc(capacity, sizeof(DirWatchEntry*))))
+      return;
+
+    for(e = w->first; e; e = e->link) {
+      e->next = entries[e->hash & (capacity - 1)];
+      entries[e->hash & (capacity - 1)] = e;
+    }
+
+    free(w->entries);
+    w->entries = entries;
+    w->centries = capacity;
+  }
+
+  if(!(e = malloc(sizeof(DirWatchEntry) + len + 1)))
+    return;
+
+  e->hash = hash;
+  e->mask = mask;
+  memcpy(e->path, path, len + 1);
+
+  e->next = w->entries[hash & (w->centries - 1)];
+  w->entries[hash & (w->centries - 1)] = e;
+
+  e->link = 0;
+  *w->last = e;
+  w->last = &e->link;
+  w->nentries++;
+}
+
+static char*
+dir_watch_join(const char* dir, const char* name) {
+  size_t dlen = strlen(dir), nlen = strlen(name);
+  char* path;
+
+  if((path = malloc(dlen + 1 + nlen + 1))) {
+    memcpy(path, dir, dlen);
+    path[dlen] = '/';
+    memcpy(&path[dlen + 1], name, nlen + 1);
+  }
+
+  return path;
+}
+
+/**
+ * @brief Watch \param path and the directories below it
+ *
+ * With \param report, their entries are recorded as created: they may have
+ * appeared before the watch was in place.
+ *
+ * @return  0 on success, -1 if \param path could not be watched
+ */
+static int
+dir_watch_add_tree(DirWatch* w, const char* path, BOOL report) {
+  struct dirent* ent;
+  struct stat st;
+  DIR* d;
+  int wd;
+
+  if((wd = inotify_add_watch(w->fd, path, w->mask | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)) == -1)
+    return -1;
+
+  dir_watch_node_set(w, wd, path);
+
+  if(!(d = opendir(path)))
+    return 0;
+
+  while((ent = readdir(d))) {
+    char* child;
+    BOOL isdir;
+
+    if(!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+      continue;
+
+    if(!(child = dir_watch_join(path, ent->d_name)))
+      continue;
+
+    if(w->exclude && dir_watch_excluded(w, child)) {
+      free(child);
+      continue;
+    }
+
+    isdir = ent->d_type == DT_DIR || (ent->d_type == DT_UNKNOWN && !lstat(child, &st) && S_ISDIR(st.st_mode));
+
+    if(report && (w->report & IN_CREATE))
+      dir_watch_record(w, child, IN_CREATE | (isdir ? IN_ISDIR : 0));
+
+    if(isdir)
+      dir_watch_add_tree(w, child, report);
+
+    free(child);
+  }
+
+  closedir(d);
+  return 0;
+}
+
+/**
+ * @brief Start the change set timer, or move it when more events arrive
+ */
+static void
+dir_watch_arm(DirWatch* w) {
+  struct itimerspec its;
+  int64_t now = dir_watch_now(), due;
+
+  if(!w->since)
+    w->since = now;
+
+  due = MIN_NUM(now + w->delay, w->since + w->max_delay);
+
+  memset(&its, 0, sizeof(its));
+
+  if(due > now) {
+    its.it_value.tv_sec = (due - now) / 1000;
+    its.it_value.tv_nsec = ((due - now) % 1000) * 1000000;
+  } else {
+    its.it_value.tv_nsec = 1;
+  }
+
+  timerfd_settime(w->timerfd, 0, &its, 0);
+}
+
+void
+dir_watch_options(DirWatchOptions* opts) {
+  memset(opts, 0, sizeof(DirWatchOptions));
+  opts->mask = DIR_WATCH_MASK;
+  opts->delay = DIR_WATCH_DELAY;
+  opts->max_delay = DIR_WATCH_MAX_DELAY;
+}
+
+DirWatch*
+dir_watch_new(const char* root, const DirWatchOptions* opts) {
+  size_t len = strlen(root);
+  DirWatch* w;
+  int error;
+
+  if(!(w = calloc(1, sizeof(DirWatch))))
+    return 0;
+
+  w->fd = w->timerfd = -1;
+  w->last = &w->first;
+  w->report = opts->mask ? opts->mask : DIR_WATCH_MASK;
+  w->mask = w->report | DIR_WATCH_TREE;
+  w->delay = opts->delay;
+  w->max_delay = MAX_NUM(opts->max_delay, opts->delay);
+
+  while(len > 1 && root[len - 1] == '/')
+    len--;
+
+  if(!(w->root = strndup(root, len)))
+    goto fail;
+
+  /* offset of the path relative to the root in the paths below it */
+  w->rel = len + (len == 0 || root[len - 1] != '/');
+
+  if(opts->nexclude) {
+    if(!(w->exclude = glob_set_new(GLOB_SET_MATCHBASE)))
+      goto fail;
+
+    for(size_t i = 0; i < opts->nexclude; i++)
+      if(glob_set_add(w->exclude, opts->exclude[i], strlen(opts->exclude[i]), GLOB_SET_EXCLUDE))
+        goto fail;
+  }
+
+  if((w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+    goto fail;
+
+  if((w->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) == -1)
+    goto fail;
+
+  if(dir_watch_add_tree(w, w->root, FALSE) == -1)
+    goto fail;
+
+  return w;
+
+fail:
+  error = errno;
+  dir_watch_free(w);
+  errno = error;
+  return 0;
+}
+
+/**
+ * @brief The inotify descriptor, call dir_watch_read() when it is readable
+ */
+int
+dir_watch_fd(DirWatch* w) {
+  return w->fd;
+}
+
+/**
+ * @brief The timer descriptor, call dir_watch_take() when it is readable
+ */
+int
+dir_watch_timerfd(DirWatch* w) {
+  return w->timerfd;
+}
+
+/**
+ * @brief Read the pending events into the change set, updating the watches
+ *
+ * @return  number of events read, -1 on error
+ */
+int
+dir_watch_read(DirWatch* w) {
+  char buf[65536] __attribute__((aligned(__alignof__(struct inotify_event))));
+  char* moved = 0;
+  uint32_t cookie = 0;
+  int count = 0;
+  ssize_t n;
+
+  while((n = read(w->fd, buf, sizeof(buf))) > 0) {
+    struct inotify_event* ev;
+
+    for(char* p = buf; p < buf + n; p += sizeof(struct inotify_event) + ev->len) {
+      DirWatchNode* node;
+      char* path;
+
+      ev = (struct inotify_event*)p;
+      count++;
+
+      /*
+       * A rename within the tree is an IN_MOVED_FROM directly followed by an
+       * IN_MOVED_TO with the same cookie.  Otherwise the directory was moved
+       * out of the tree.
+       */
+      if(moved) {
+        if(!((ev->mask & IN_MOVED_TO) && ev->cookie == cookie))
+          dir_watch_remove_tree(w, moved);
+
+        free(moved);
+        moved = 0;
+      }
+
+      if(ev->mask & IN_Q_OVERFLOW) {
+        w->overflow = TRUE;
+        dir_watch_add_tree(w, w->root, FALSE);
+        continue;
+      }
+
+      if(!(node = dir_watch_node(w, ev->wd)))
+        continue;
+
+      if(ev->mask & IN_IGNORED) {
+        dir_watch_node_remove(w, ev->wd);
+        continue;
+      }
+
+      if(!(path = ev->len ? dir_watch_join(node->path, ev->name) : strdup(node->path)))
+        continue;
+
+      if(ev->len && w->exclude && dir_watch_excluded(w, path)) {
+        free(path);
+        continue;
+      }
+
+      /* events only watched for the tree are not reported */
+      if(ev->mask & w->report & IN_ALL_EVENTS)
+        dir_watch_record(w, path, ev->mask & (w->report | ~IN_ALL_EVENTS));
+
+      if((ev->mask & IN_ISDIR) && ev->len) {
+        if(ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+          dir_watch_add_tree(w, path, TRUE);
+        } else if(ev->mask & IN_MOVED_FROM) {
+          cookie = ev->cookie;
+          moved = path;
+          continue;
+        }
+      }
+
+      free(path);
+    }
+  }
+
+  if(moved) {
+    dir_watch_remove_tree(w, moved);
+    free(moved);
+  }
+
+  /* an overflow is reported even when no event could be recorded */
+  if(w->first || w->overflow)
+    dir_watch_arm(w);
+
+  return n == -1 && errno != EAGAIN && errno != EINTR ? -1 : count;
+}
+
+/**
+ * @brief Take the current change set
+ *
+ * @return  an array of \param count changes, in the order they were first seen,
+ *          to be freed with dir_watch_changes_free(); NULL if there were none
+ */
+DirWatchChange*
+dir_watch_take(DirWatch* w, size_t* count, BOOL* overflow) {
+  DirWatchChange* changes = 0;
+  DirWatchEntry *e, *next;
+  uint64_t expirations;
+  size_t i = 0;
+
+  while(read(w->timerfd, &expirations, sizeof(expirations)) > 0) {}
+
+  if(w->nentries && (changes = malloc(w->nentries * sizeof(DirWatchChange))))
+    for(e = w->first; e; e = e->link)
+      if((changes[i].path = strdup(e->path)))
+        changes[i++].mask = e->mask;
+
+  for(e = w->first; e; e = next) {
+    next = e->link;
+    free(e);
+  }
+
+  if(w->centries)
+    memset(w->entries, 0, w->centries * sizeof(DirWatchEntry*));
+
+  w->first = 0;
+  w->last = &w->first;
+  w->nentries = 0;
+  w->since = 0;
+
+  *count = i;
+  *overflow = w->overflow;
+  w->overflow = FALSE;
+
+  return changes;
+}
+
+/**
+ * @brief Number of directories being watched
+ */
+size_t
+dir_watch_count(DirWatch* w) {
+  return w->nnodes;
+}
+
+void
+dir_watch_changes_free(DirWatchChange* changes, size_t count) {
+  for(size_t i = 0; i < count; i++)
+    free(changes[i].path);
+
+  free(changes);
+}
+
+void
+dir_watch_free(DirWatch* w) {
+  DirWatchNode* node;
+  DirWatchEntry *e, *next;
+
+  for(size_t i = 0; i < w->cnodes; i++)
+    while((node = w->nodes[i])) {
+      w->nodes[i] = node->next;
+      free(node->path);
+      free(node);
+    }
+
+  for(e = w->first; e; e = next) {
+    next = e->link;
+    free(e);
+  }
+
+  if(w->exclude)
+    glob_set_free(w->exclude);
+
+  free(w->nodes);
+  free(w->entries);
+  free(w->root);
+
+  if(w->fd != -1)
+    close(w->fd);
+  if(w->timerfd != -1)
+    close(w->timerfd);
+
+  free(w);
+}
+
+/**
+ * @}
+ */
+#endif /* defined(HAVE_INOTIFY) */
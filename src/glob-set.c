@@ -0,0 +1,927 @@
+#include "glob-set.h"
+#include "defines.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * \addtogroup glob-set
+ * @{
+ */
+
+/* upper limit of patterns a single brace expansion may produce */
+#define GLOB_SET_MAX_EXPANSIONS 65536
+
+/* GlobNode accept/below bits */
+#define GLOB_INCLUDE 1
+#define GLOB_EXCLUDE 2
+
+/* wildcard nodes whose component does not end in a literal character */
+#define GLOB_KEY_ANY 256
+
+enum { OP_CHAR, OP_ANY, OP_STAR, OP_CLASS };
+
+typedef struct {
+  uint8_t type, ch;
+  uint16_t cls;
+} GlobOp;
+
+typedef struct {
+  GlobOp* ops;
+  size_t nops;
+  uint8_t (*classes)[32];
+  size_t nclasses;
+  size_t min;     /* characters consumed by everything except '*' */
+  size_t nsuffix; /* literal characters after the last '*' */
+  BOOL star;
+  char* source;
+  size_t source_len;
+} GlobSegment;
+
+struct glob_node {
+  GlobNode* parent;
+  /* the edge leading here: a literal component, a compiled one or '**' */
+  char* literal;
+  size_t len;
+  uint32_t hash;
+  GlobSegment* segment;
+  uint16_t key;
+  BOOL globstar;
+  /* patterns ending here, patterns ending somewhere below */
+  int accept, below;
+  GlobNode** table;
+  size_t nliteral, table_size;
+  GlobNode** wild; /* sorted by key */
+  size_t nwild, wild_size;
+  GlobNode* star;
+};
+
+struct glob_set {
+  GlobNode root;
+  int flags;
+  size_t ninclude, nexclude;
+};
+
+static uint32_t
+glob_hash(const char* s, size_t len) {
+  uint32_t h = 2166136261u;
+
+  for(size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)s[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+static void
+glob_segment_free(GlobSegment* seg) {
+  free(seg->ops);
+  free(seg->classes);
+  free(seg->source);
+  free(seg);
+}
+
+/**
+ * @brief Parse a bracket expression starting at \param p[i]
+ *
+ * @return  index of the closing ']', 0 if there is none and the '[' is literal
+ */
+static size_t
+glob_class_end(const char* p, size_t len, size_t i) {
+  size_t j = i + 1;
+
+  if(j < len && (p[j] == '!' || p[j] == '^'))
+    j++;
+
+  if(j < len && p[j] == ']')
+    j++;
+
+  for(; j < len; j++) {
+    if(p[j] == '\\')
+      j++;
+    else if(p[j] == ']')
+      return j;
+  }
+
+  return 0;
+}
+
+static void
+glob_class_parse(uint8_t cls[32], const char* p, size_t i, size_t end) {
+  BOOL neg = FALSE;
+
+  memset(cls, 0, 32);
+
+  if(++i < end && (p[i] == '!' || p[i] == '^')) {
+    neg = TRUE;
+    i++;
+  }
+
+  for(; i < end; i++) {
+    uint8_t lo = p[i], hi;
+
+    if(lo == '\\' && i + 1 < end)
+      lo = p[++i];
+
+    hi = lo;
+
+    if(i + 2 < end && p[i + 1] == '-') {
+      hi = p[i + 2];
+      i += 2;
+
+      if(hi == '\\' && i + 1 < end)
+        hi = p[++i];
+    }
+
+    for(unsigned int c = lo; c <= hi; c++)
+      cls[c >> 3] |= 1 << (c & 7);
+  }
+
+  if(neg)
+    for(size_t k = 0; k < 32; k++)
+      cls[k] = ~cls[k];
+}
+
+/**
+ * @brief Compile a path component
+ *
+ * @return  the compiled component, NULL with *literal set when it contains no wildcards
+ *          (the unescaped text is then in buf), NULL with errno set on failure
+ */
+static GlobSegment*
+glob_segment_compile(const char* p, size_t len, char* buf, size_t* buflen, BOOL* literal) {
+  GlobSegment* seg;
+  size_t n = 0, ncls = 0;
+
+  *literal = FALSE;
+
+  if(!(seg = calloc(1, sizeof(GlobSegment))) || !(seg->ops = calloc(len, sizeof(GlobOp))))
+    goto fail;
+
+  for(size_t i = 0; i < len; i++) {
+    GlobOp* op = &seg->ops[n];
+    size_t end;
+
+    switch(p[i]) {
+      case '*': {
+        if(n == 0 || seg->ops[n - 1].type != OP_STAR) {
+          op->type = OP_STAR;
+          n++;
+        }
+
+        seg->star = TRUE;
+        continue;
+      }
+
+      case '?': {
+        op->type = OP_ANY;
+        break;
+      }
+
+      case '[': {
+        if((end = glob_class_end(p, len, i))) {
+          uint8_t(*classes)[32];
+
+          if(!(classes = realloc(seg->classes, (ncls + 1) * 32)))
+            goto fail;
+
+          seg->classes = classes;
+          glob_class_parse(seg->classes[ncls], p, i, end);
+          op->type = OP_CLASS;
+          op->cls = ncls++;
+          i = end;
+          break;
+        }
+
+        op->type = OP_CHAR;
+        op->ch = '[';
+        break;
+      }
+
+      case '\\': {
+        if(i + 1 < len)
+          i++;
+      }
+        /* fall through */
+      default: {
+        op->type = OP_CHAR;
+        op->ch = p[i];
+        break;
+      }
+    }
+
+    seg->min++;
+    n++;
+  }
+
+  seg->nops = n;
+  seg->nclasses = ncls;
+
+  if(!seg->star && !ncls) {
+    BOOL any = FALSE;
+
+    for(size_t i = 0; i < n; i++)
+      if(seg->ops[i].type != OP_CHAR)
+        any = TRUE;
+
+    if(!any) {
+      for(size_t i = 0; i < n; i++)
+        buf[i] = seg->ops[i].ch;
+
+      *buflen = n;
+      *literal = TRUE;
+      glob_segment_free(seg);
+      return 0;
+    }
+  }
+
+  while(seg->nsuffix < n && seg->ops[n - 1 - seg->nsuffix].type == OP_CHAR)
+    seg->nsuffix++;
+
+  if(!(seg->source = malloc(len + 1)))
+    goto fail;
+
+  memcpy(seg->source, p, len);
+  seg->source[len] = '\0';
+  seg->source_len = len;
+  return seg;
+
+fail:
+  if(seg)
+    glob_segment_free(seg);
+
+  errno = ENOMEM;
+  return 0;
+}
+
+static inline BOOL
+glob_op_match(const GlobSegment* seg, const GlobOp* op, uint8_t c) {
+  switch(op->type) {
+    case OP_CHAR: return op->ch == c;
+    case OP_CLASS: return (seg->classes[op->cls][c >> 3] >> (c & 7)) & 1;
+    default: return TRUE;
+  }
+}
+
+static BOOL
+glob_segment_match(const GlobSegment* seg, const char* s, size_t len, BOOL period) {
+  size_t i = 0, j = 0, star_i = SIZE_MAX, star_j = 0;
+
+  if(len < seg->min || (!seg->star && len != seg->min))
+    return FALSE;
+
+  for(size_t k = 0; k < seg->nsuffix; k++)
+    if(seg->ops[seg->nops - 1 - k].ch != (uint8_t)s[len - 1 - k])
+      return FALSE;
+
+  if(period && s[0] == '.' && !(seg->ops[0].type == OP_CHAR && seg->ops[0].ch == '.'))
+    return FALSE;
+
+  while(j < len) {
+    if(i < seg->nops && seg->ops[i].type == OP_STAR) {
+      star_i = i++;
+      star_j = j;
+    } else if(i < seg->nops && glob_op_match(seg, &seg->ops[i], s[j])) {
+      i++;
+      j++;
+    } else if(star_i != SIZE_MAX) {
+      i = star_i + 1;
+      j = ++star_j;
+    } else {
+      return FALSE;
+    }
+  }
+
+  while(i < seg->nops && seg->ops[i].type == OP_STAR)
+    i++;
+
+  return i == seg->nops;
+}
+
+static GlobNode*
+glob_node_new(GlobNode* parent) {
+  GlobNode* node;
+
+  if((node = calloc(1, sizeof(GlobNode))))
+    node->parent = parent;
+  else
+    errno = ENOMEM;
+
+  return node;
+}
+
+static void
+glob_node_clear(GlobNode* node) {
+  for(size_t i = 0; i < node->table_size; i++)
+    if(node->table[i]) {
+      glob_node_clear(node->table[i]);
+      free(node->table[i]);
+    }
+
+  for(size_t i = 0; i < node->nwild; i++) {
+    glob_node_clear(node->wild[i]);
+    free(node->wild[i]);
+  }
+
+  if(node->star) {
+    glob_node_clear(node->star);
+    free(node->star);
+  }
+
+  free(node->table);
+  free(node->wild);
+  free(node->literal);
+
+  if(node->segment)
+    glob_segment_free(node->segment);
+}
+
+static GlobNode*
+glob_node_lookup(const GlobNode* node, const char* s, size_t len, uint32_t hash) {
+  GlobNode* child;
+
+  if(node->nliteral)
+    for(size_t i = hash & (node->table_size - 1); (child = node->table[i]); i = (i + 1) & (node->table_size - 1))
+      if(child->hash == hash && child->len == len && !memcmp(child->literal, s, len))
+        return child;
+
+  return 0;
+}
+
+static GlobNode*
+glob_node_literal(GlobNode* node, const char* s, size_t len) {
+  uint32_t hash = glob_hash(s, len);
+  GlobNode* child;
+
+  if((child = glob_node_lookup(node, s, len, hash)))
+    return child;
+
+  if((node->nliteral + 1) * 4 > node->table_size * 3) {
+    size_t size = node->table_size ? node->table_size * 2 : 8;
+    GlobNode** table;
+
+    if(!(table = calloc(size, sizeof(GlobNode*)))) {
+      errno = ENOMEM;
+      return 0;
+    }
+
+    for(size_t i = 0; i < node->table_size; i++)
+      if((child = node->table[i])) {
+        size_t j = child->hash & (size - 1);
+
+        while(table[j])
+          j = (j + 1) & (size - 1);
+
+        table[j] = child;
+      }
+
+    free(node->table);
+    node->table = table;
+    node->table_size = size;
+  }
+
+  if(!(child = glob_node_new(node)))
+    return 0;
+
+  if(!(child->literal = malloc(len + 1))) {
+    free(child);
+    errno = ENOMEM;
+    return 0;
+  }
+
+  memcpy(child->literal, s, len);
+  child->literal[len] = '\0';
+  child->len = len;
+  child->hash = hash;
+
+  size_t i = hash & (node->table_size - 1);
+
+  while(node->table[i])
+    i = (i + 1) & (node->table_size - 1);
+
+  node->table[i] = child;
+  node->nliteral++;
+  return child;
+}
+
+/* first wildcard child with a key >= key */
+static size_t
+glob_node_wild_find(const GlobNode* node, uint16_t key) {
+  size_t lo = 0, hi = node->nwild;
+
+  while(lo < hi) {
+    size_t mid = (lo + hi) / 2;
+
+    if(node->wild[mid]->key < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+static GlobNode*
+glob_node_wildcard(GlobNode* node, GlobSegment* seg) {
+  uint16_t key = seg->nsuffix ? seg->ops[seg->nops - 1].ch : GLOB_KEY_ANY;
+  size_t i = glob_node_wild_find(node, key);
+  GlobNode* child;
+
+  for(size_t j = i; j < node->nwild && node->wild[j]->key == key; j++) {
+    GlobSegment* other = node->wild[j]->segment;
+
+    if(other->source_len == seg->source_len && !memcmp(other->source, seg->source, seg->source_len)) {
+      glob_segment_free(seg);
+      return node->wild[j];
+    }
+  }
+
+  if(node->nwild == node->wild_size) {
+    size_t size = node->wild_size ? node->wild_size * 2 : 4;
+    GlobNode** wild;
+
+    if(!(wild = realloc(node->wild, size * sizeof(GlobNode*)))) {
+      glob_segment_free(seg);
+      errno = ENOMEM;
+      return 0;
+    }
+
+    node->wild = wild;
+    node->wild_size = size;
+  }
+
+  if(!(child = glob_node_new(node))) {
+    glob_segment_free(seg);
+    return 0;
+  }
+
+  child->segment = seg;
+  child->key = key;
+
+  memmove(&node->wild[i + 1], &node->wild[i], (node->nwild - i) * sizeof(GlobNode*));
+  node->wild[i] = child;
+  node->nwild++;
+  return child;
+}
+
+static GlobNode*
+glob_node_star(GlobNode* node) {
+  if(node->globstar)
+    return node;
+
+  if(!node->star && (node->star = glob_node_new(node)))
+    node->star->globstar = TRUE;
+
+  return node->star;
+}
+
+static int
+glob_set_insert(GlobSet* set, const char* p, size_t len, int flags) {
+  GlobNode* node = &set->root;
+  int bit = (flags & GLOB_SET_EXCLUDE) ? GLOB_EXCLUDE : GLOB_INCLUDE;
+  char* buf;
+
+  while(len > 1 && p[len - 1] == '/')
+    len--;
+
+  if((set->flags & GLOB_SET_MATCHBASE) && !memchr(p, '/', len) && !(node = glob_node_star(node)))
+    return -1;
+
+  if(!(buf = malloc(len + 1))) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for(size_t i = 0, start; i < len;) {
+    GlobSegment* seg;
+    size_t n;
+    BOOL literal;
+
+    while(i < len && p[i] == '/')
+      i++;
+
+    for(start = i; i < len && p[i] != '/'; i++)
+      if(p[i] == '\\' && i + 1 < len && p[i + 1] != '/')
+        i++;
+
+    n = i - start;
+
+    if(n == 0 || (n == 1 && p[start] == '.'))
+      continue;
+
+    if(n == 2 && p[start] == '*' && p[start + 1] == '*')
+      node = glob_node_star(node);
+    else if((seg = glob_segment_compile(&p[start], n, buf, &n, &literal)))
+      node = glob_node_wildcard(node, seg);
+    else
+      node = literal ? glob_node_literal(node, buf, n) : 0;
+
+    if(!node) {
+      free(buf);
+      return -1;
+    }
+  }
+
+  free(buf);
+
+  if(node == &set->root) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  node->accept |= bit;
+
+  if(node->globstar)
+    node->below |= bit;
+
+  while((node = node->parent))
+    node->below |= bit;
+
+  return 0;
+}
+
+static int
+glob_set_expand(GlobSet* set, const char* p, size_t len, int flags, size_t* count) {
+  for(size_t i = 0; i < len; i++) {
+    size_t j, depth = 0, ncomma = 0;
+
+    if(p[i] == '\\') {
+      i++;
+      continue;
+    }
+
+    if(p[i] != '{')
+      continue;
+
+    for(j = i; j < len; j++) {
+      if(p[j] == '\\')
+        j++;
+      else if(p[j] == '{')
+        depth++;
+      else if(p[j] == '}' && --depth == 0)
+        break;
+      else if(p[j] == ',' && depth == 1)
+        ncomma++;
+    }
+
+    /* unbalanced or without alternatives: a literal brace */
+    if(j >= len || !ncomma)
+      continue;
+
+    depth = 0;
+
+    for(size_t k = i + 1, start = k; k <= j; k++) {
+      if(k < j && p[k] == '\\') {
+        k++;
+        continue;
+      }
+
+      if(k == j || (p[k] == ',' && depth == 0)) {
+        size_t n = i + (k - start) + (len - j - 1);
+        char* buf;
+        int ret;
+
+        if(!(buf = malloc(n + 1))) {
+          errno = ENOMEM;
+          return -1;
+        }
+
+        memcpy(buf, p, i);
+        memcpy(&buf[i], &p[start], k - start);
+        memcpy(&buf[i + k - start], &p[j + 1], len - j - 1);
+
+        ret = glob_set_expand(set, buf, n, flags, count);
+        free(buf);
+
+        if(ret)
+          return ret;
+
+        start = k + 1;
+      } else if(p[k] == '{') {
+        depth++;
+      } else if(p[k] == '}') {
+        depth--;
+      }
+    }
+
+    return 0;
+  }
+
+  if(++*count > GLOB_SET_MAX_EXPANSIONS) {
+    errno = E2BIG;
+    return -1;
+  }
+
+  return glob_set_insert(set, p, len, flags);
+}
+
+GlobSet*
+glob_set_new(int flags) {
+  GlobSet* set;
+
+  if((set = calloc(1, sizeof(GlobSet))))
+    set->flags = flags;
+
+  return set;
+}
+
+/**
+ * @brief Add a pattern, expanding {a,b} alternatives
+ *
+ * @return  0 on success, -1 with errno set (EINVAL for an empty pattern)
+ */
+int
+glob_set_add(GlobSet* set, const char* pattern, size_t len, int flags) {
+  size_t count = 0;
+
+  if(glob_set_expand(set, pattern, len, flags, &count))
+    return -1;
+
+  if(flags & GLOB_SET_EXCLUDE)
+    set->nexclude++;
+  else
+    set->ninclude++;
+
+  return 0;
+}
+
+/**
+ * @brief Number of include (or with GLOB_SET_EXCLUDE, exclude) patterns added
+ */
+size_t
+glob_set_count(const GlobSet* set, int flags) {
+  return (flags & GLOB_SET_EXCLUDE) ? set->nexclude : set->ninclude;
+}
+
+void
+glob_set_free(GlobSet* set) {
+  glob_node_clear(&set->root);
+  free(set);
+}
+
+typedef struct {
+  int accept, below;
+} GlobStep;
+
+static int
+glob_state_add(GlobState* st, const GlobNode* node, GlobStep* step) {
+  step->accept |= node->accept;
+  step->below |= node->below;
+
+  if(node->globstar || node->nliteral || node->nwild) {
+    size_t i;
+
+    for(i = 0; i < st->count; i++)
+      if(st->nodes[i] == node)
+        break;
+
+    if(i == st->count) {
+      if(st->count == st->size) {
+        size_t size = st->size ? st->size * 2 : 8;
+        const GlobNode** nodes;
+
+        if(!(nodes = realloc(st->nodes, size * sizeof(GlobNode*)))) {
+          errno = ENOMEM;
+          return -1;
+        }
+
+        st->nodes = nodes;
+        st->size = size;
+      }
+
+      st->nodes[st->count++] = node;
+    }
+  }
+
+  return node->star ? glob_state_add(st, node->star, step) : 0;
+}
+
+static int
+glob_state_result(const GlobSet* set, GlobState* st, const GlobStep* step) {
+  st->result = 0;
+
+  if(step->accept & GLOB_EXCLUDE) {
+    st->count = 0;
+    return st->result = GLOB_SET_EXCLUDED;
+  }
+
+  if(!set->ninclude || (step->accept & GLOB_INCLUDE))
+    st->result |= GLOB_SET_MATCH;
+
+  if(!set->ninclude || (step->below & GLOB_INCLUDE))
+    st->result |= GLOB_SET_DESCEND;
+
+  return st->result;
+}
+
+/**
+ * @brief Initialize \param st with the state of the root directory
+ *
+ * @return  GLOB_SET_DESCEND, -1 when out of memory
+ */
+int
+glob_set_start(const GlobSet* set, GlobState* st) {
+  GlobStep step = {0, 0};
+
+  st->count = 0;
+
+  if(glob_state_add(st, &set->root, &step))
+    return -1;
+
+  return st->result = GLOB_SET_DESCEND;
+}
+
+/**
+ * @brief Step from the state \param in of a directory to the state of its entry \param name
+ *
+ * \param out is reused, it must not be \param in.
+ *
+ * @return  GLOB_SET_* flags for the entry, -1 when out of memory
+ */
+int
+glob_set_step(const GlobSet* set, const GlobState* in, const char* name, size_t len, GlobState* out) {
+  BOOL period = (set->flags & GLOB_SET_PERIOD) && len && name[0] == '.';
+  uint16_t last = len ? (uint8_t)name[len - 1] : GLOB_KEY_ANY;
+  GlobStep step = {0, 0};
+  uint32_t hash = 0;
+
+  out->count = 0;
+
+  if(in->result & GLOB_SET_EXCLUDED)
+    return out->result = GLOB_SET_EXCLUDED;
+
+  for(size_t i = 0; i < in->count; i++) {
+    const GlobNode *node = in->nodes[i], *child;
+
+    if(node->globstar && !period && glob_state_add(out, node, &step))
+      return -1;
+
+    if(node->nliteral) {
+      if(!hash)
+        hash = glob_hash(name, len);
+
+      if((child = glob_node_lookup(node, name, len, hash)) && glob_state_add(out, child, &step))
+        return -1;
+    }
+
+    if(node->nwild) {
+      for(size_t j = glob_node_wild_find(node, last); j < node->nwild && node->wild[j]->key == last; j++)
+        if(glob_segment_match(node->wild[j]->segment, name, len, period) && glob_state_add(out, node->wild[j], &step))
+          return -1;
+
+      if(last != GLOB_KEY_ANY)
+        for(size_t j = glob_node_wild_find(node, GLOB_KEY_ANY); j < node->nwild; j++)
+          if(glob_segment_match(node->wild[j]->segment, name, len, period) && glob_state_add(out, node->wild[j], &step))
+            return -1;
+    }
+  }
+
+  return glob_state_result(set, out, &step);
+}
+
+/**
+ * @brief Match a single path, see glob_cursor_match() for lists of paths
+ */
+int
+glob_set_match(const GlobSet* set, const char* path, size_t len) {
+  GlobCursor c;
+  int ret;
+
+  glob_cursor_init(&c);
+  ret = glob_cursor_match(set, &c, path, len);
+  glob_cursor_free(&c);
+
+  return ret;
+}
+
+void
+glob_state_move(GlobState* to, GlobState* from) {
+  free(to->nodes);
+  *to = *from;
+  glob_state_init(from);
+}
+
+void
+glob_state_free(GlobState* st) {
+  free(st->nodes);
+  glob_state_init(st);
+}
+
+void
+glob_cursor_init(GlobCursor* c) {
+  memset(c, 0, sizeof(GlobCursor));
+}
+
+/**
+ * @brief Match \param path, reusing the states of the directories it shares with the previous one
+ *
+ * '.' components and repeated slashes are skipped.  The cursor must be
+ * re-initialized when patterns are added to the set.
+ *
+ * @return  GLOB_SET_* flags, -1 when out of memory
+ */
+int
+glob_cursor_match(const GlobSet* set, GlobCursor* c, const char* path, size_t len) {
+  size_t common = 0, keep = 0, pos;
+
+  if(!c->capacity) {
+    if(!(c->states = calloc(8, sizeof(GlobState))) || !(c->ends = calloc(8, sizeof(size_t)))) {
+      glob_cursor_free(c);
+      errno = ENOMEM;
+      return -1;
+    }
+
+    c->capacity = 8;
+
+    if(glob_set_start(set, &c->states[0]) == -1) {
+      glob_cursor_free(c);
+      return -1;
+    }
+  }
+
+  for(size_t n = MIN_NUM(len, c->len); common < n && path[common] == c->path[common];)
+    common++;
+
+  while(keep < c->depth &&
+        (c->ends[keep] < common || (c->ends[keep] == common && (common == len || path[common] == '/'))))
+    keep++;
+
+  c->depth = keep;
+  pos = keep ? c->ends[keep - 1] : 0;
+
+  while(pos < len) {
+    size_t start;
+    int r;
+
+    while(pos < len && path[pos] == '/')
+      pos++;
+
+    for(start = pos; pos < len && path[pos] != '/';)
+      pos++;
+
+    if(pos == start || (pos - start == 1 && path[start] == '.'))
+      continue;
+
+    if(c->depth + 1 >= c->capacity) {
+      size_t capacity = c->capacity * 2;
+      GlobState* states;
+      size_t* ends;
+
+      if(!(states = realloc(c->states, capacity * sizeof(GlobState))))
+        goto fail;
+
+      c->states = states;
+      memset(&c->states[c->capacity], 0, (capacity - c->capacity) * sizeof(GlobState));
+
+      if(!(ends = realloc(c->ends, capacity * sizeof(size_t))))
+        goto fail;
+
+      c->ends = ends;
+      c->capacity = capacity;
+    }
+
+    if((r = glob_set_step(set, &c->states[c->depth], &path[start], pos - start, &c->states[c->depth + 1])) == -1)
+      goto fail;
+
+    c->ends[c->depth++] = pos;
+  }
+
+  if(len + 1 > c->size) {
+    char* s;
+
+    if(!(s = realloc(c->path, len + 1)))
+      goto fail;
+
+    c->path = s;
+    c->size = len + 1;
+  }
+
+  memcpy(c->path, path, len);
+  c->len = len;
+
+  return c->states[c->depth].result;
+
+fail:
+  /* forget the previous path, the states kept are still valid */
+  c->len = 0;
+  c->depth = 0;
+  errno = ENOMEM;
+  return -1;
+}
+
+void
+glob_cursor_free(GlobCursor* c) {
+  for(size_t i = 0; i < c->capacity; i++)
+    free(c->states[i].nodes);
+
+  free(c->states);
+  free(c->ends);
+  free(c->path);
+  glob_cursor_init(c);
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,228 @@
+#include "histogram.h"
+#include "defines.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * \addtogroup histogram
+ * @{
+ */
+
+static inline int
+histogram_msb(uint64_t v) {
+  return 63 - __builtin_clzll(v);
+}
+
+static inline size_t
+histogram_index(const Histogram* h, uint64_t value) {
+  uint64_t v = value >> h->unit_shift;
+  int shift;
+
+  if(v < ((uint64_t)1 << h->sub_bits))
+    return v;
+
+  shift = histogram_msb(v) - (h->sub_bits - 1);
+  return ((size_t)shift << (h->sub_bits - 1)) + (v >> shift);
+}
+
+/* lowest value counted in bucket i, and the bucket's width */
+static inline uint64_t
+histogram_value(const Histogram* h, size_t i, uint64_t* width) {
+  size_t half = (size_t)1 << (h->sub_bits - 1);
+  int shift;
+
+  if(i < half * 2) {
+    *width = (uint64_t)1 << h->unit_shift;
+    return (uint64_t)i << h->unit_shift;
+  }
+
+  shift = i / half - 1;
+  *width = (uint64_t)1 << (shift + h->unit_shift);
+  return (uint64_t)(i - ((size_t)shift << (h->sub_bits - 1))) << (shift + h->unit_shift);
+}
+
+/**
+ * @brief Initialize a histogram for values from \param lowest to \param highest
+ *
+ * @param figures  significant decimal figures kept, 1 to 5
+ *
+ * @return  0 on success, -1 with errno = EINVAL on bad arguments
+ */
+int
+histogram_init(Histogram* h, uint64_t lowest, uint64_t highest, int figures) {
+  uint64_t single = 2;
+
+  if(lowest < 1 || highest < 2 * lowest || figures < 1 || figures > 5) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(h, 0, sizeof(Histogram));
+
+  for(int i = 0; i < figures; i++)
+    single *= 10;
+
+  /* smallest power of two sub-buckets that resolves 2 * 10^figures single units */
+  h->sub_bits = histogram_msb(single - 1) + 1;
+  h->unit_shift = histogram_msb(lowest);
+  h->lowest = lowest;
+  h->highest = highest;
+  h->min = INT64_MAX;
+  return 0;
+}
+
+static int
+histogram_count(Histogram* h, uint64_t value, uint64_t n) {
+  size_t i = histogram_index(h, value);
+
+  if(i >= h->ncounts) {
+    size_t limit = histogram_index(h, h->highest) + 1;
+    size_t size = MIN_NUM(MAX_NUM(MAX_NUM(i + 1, h->ncounts * 2), 256), limit);
+    uint64_t* counts;
+
+    if(!(counts = realloc(h->counts, size * sizeof(uint64_t))))
+      return -1;
+
+    memset(&counts[h->ncounts], 0, (size - h->ncounts) * sizeof(uint64_t));
+    h->counts = counts;
+    h->ncounts = size;
+  }
+
+  h->counts[i] += n;
+
+  if(i >= h->nused)
+    h->nused = i + 1;
+
+  h->total += n;
+  return 0;
+}
+
+/**
+ * @brief Count \param value, values above the highest trackable are only counted as exceeding
+ *
+ * @return  0 on success, -1 when the buckets could not be grown
+ */
+int
+histogram_record(Histogram* h, uint64_t value) {
+  if(value > h->highest) {
+    h->exceeds++;
+    return 0;
+  }
+
+  if(histogram_count(h, value, 1))
+    return -1;
+
+  if(value < h->min)
+    h->min = value;
+
+  if(value > h->max)
+    h->max = value;
+
+  h->sum += value;
+  return 0;
+}
+
+/**
+ * @brief Add the counts of \param other, which may have a different resolution
+ */
+int
+histogram_add(Histogram* h, const Histogram* other) {
+  uint64_t width;
+
+  for(size_t i = 0; i < other->nused; i++) {
+    if(!other->counts[i])
+      continue;
+
+    uint64_t value = histogram_value(other, i, &width);
+
+    if(value > h->highest)
+      h->exceeds += other->counts[i];
+    else if(histogram_count(h, value, other->counts[i]))
+      return -1;
+  }
+
+  if(other->total) {
+    h->min = MIN_NUM(h->min, other->min);
+    h->max = MAX_NUM(h->max, MIN_NUM(other->max, h->highest));
+  }
+
+  h->exceeds += other->exceeds;
+  h->sum += other->sum;
+  return 0;
+}
+
+void
+histogram_reset(Histogram* h) {
+  if(h->counts)
+    memset(h->counts, 0, h->nused * sizeof(uint64_t));
+
+  h->nused = 0;
+  h->total = h->exceeds = 0;
+  h->min = INT64_MAX;
+  h->max = 0;
+  h->sum = 0;
+}
+
+/**
+ * @brief Value below or at which \param percentile percent of the recorded values are
+ *
+ * @return  the highest value of the bucket reached, 0 if nothing was recorded
+ */
+uint64_t
+histogram_percentile(const Histogram* h, double percentile) {
+  uint64_t target, seen = 0, width;
+
+  if(!h->total)
+    return 0;
+
+  percentile = MIN_NUM(MAX_NUM(percentile, 0.0), 100.0);
+
+  if((target = ceil(percentile / 100.0 * h->total)) == 0)
+    target = 1;
+
+  for(size_t i = 0; i < h->nused; i++)
+    if((seen += h->counts[i]) >= target) {
+      uint64_t value = histogram_value(h, i, &width) + width - 1;
+
+      return MAX_NUM(MIN_NUM(value, h->max), h->min);
+    }
+
+  return h->max;
+}
+
+double
+histogram_mean(const Histogram* h) {
+  return h->total ? h->sum / h->total : NAN;
+}
+
+/* computed from bucket midpoints, like HdrHistogram does */
+double
+histogram_stddev(const Histogram* h) {
+  double mean = histogram_mean(h), sum = 0;
+  uint64_t width;
+
+  if(!h->total)
+    return NAN;
+
+  for(size_t i = 0; i < h->nused; i++)
+    if(h->counts[i]) {
+      double dev = histogram_value(h, i, &width) + (width >> 1) - mean;
+
+      sum += dev * dev * h->counts[i];
+    }
+
+  return sqrt(sum / h->total);
+}
+
+void
+histogram_free(Histogram* h) {
+  free(h->counts);
+  h->counts = 0;
+  h->ncounts = h->nused = 0;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,836 @@
+#include "module-cache.h"
+#include "path.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/**
+ * \addtogroup module-cache
+ * @{
+ */
+
+#define MODULE_CACHE_MAGIC "QJSMBC1"
+#define MODULE_CACHE_SUFFIX ".jsc"
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/* An entry is this header, the key (absolute path, NUL, module name) and the bytecode */
+typedef struct {
+  char magic[8];
+  uint64_t version;
+  int64_t mtime_sec, mtime_nsec;
+  uint64_t size, hash;
+  uint32_t key_len, bytecode_len;
+} ModuleCacheHeader;
+
+static uint64_t
+module_cache_hash(const void* data, size_t len, uint64_t h) {
+  const uint8_t* p = data;
+
+  for(size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+
+  return h;
+}
+
+/* bytecode depends on the engine version and on the JSValue layout */
+static uint64_t
+module_cache_version(const char* version) {
+  return module_cache_hash(version, strlen(version), FNV_OFFSET) ^ (sizeof(void*) << 8 | sizeof(JSValue));
+}
+
+static void
+module_cache_mtime(const struct stat* st, int64_t* sec, int64_t* nsec) {
+  *sec = st->st_mtime;
+#if defined(__APPLE__)
+  *nsec = st->st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+  *nsec = 0;
+#else
+  *nsec = st->st_mtim.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Read a whole file into a NUL terminated malloc()'ed buffer
+ */
+static uint8_t*
+module_cache_read(const char* path, size_t* lenp) {
+  struct stat st;
+  uint8_t* buf = 0;
+  int fd;
+
+  if((fd = open(path, O_RDONLY | O_BINARY)) == -1)
+    return 0;
+
+  if(!fstat(fd, &st) && (buf = malloc(st.st_size + 1))) {
+    size_t n = 0;
+    ssize_t r;
+
+    while(n < (size_t)st.st_size && (r = read(fd, buf + n, st.st_size - n)) > 0)
+      n += r;
+
+    if(n == (size_t)st.st_size) {
+      buf[n] = '\0';
+      *lenp = n;
+    } else {
+      free(buf);
+      buf = 0;
+    }
+  }
+
+  close(fd);
+  return buf;
+}
+
+static int
+module_cache_mkdir(const char* dir) {
+  char* p;
+  int ret;
+
+  if(!(p = strdup(dir)))
+    return -1;
+
+  for(char* s = p + 1; *s; s++)
+    if(*s == '/') {
+      *s = '\0';
+      mkdir(p, 0755);
+      *s = '/';
+    }
+
+  ret = mkdir(p, 0755);
+  free(p);
+
+  return ret == 0 || errno == EEXIST ? 0 : -1;
+}
+
+static char*
+module_cache_entry(ModuleCache* mc, const char* key, size_t key_len) {
+  size_t len = strlen(mc->dir) + 1 + 16 + sizeof(MODULE_CACHE_SUFFIX);
+  char* file;
+
+  if((file = malloc(len)))
+    snprintf(file,
+             len,
+             "%s/%016llx" MODULE_CACHE_SUFFIX,
+             mc->dir,
+             (unsigned long long)module_cache_hash(key, key_len, FNV_OFFSET));
+
+  return file;
+}
+
+/**
+ * @brief Create a unique temporary file next to \param file, to be renamed over it
+ *
+ * The name is made by mkstemp(), so threads and processes writing the same
+ * entry never share a temporary file.
+ *
+ * @return  the file descriptor (its name in *\param tmpp) or -1 with errno set
+ */
+static int
+module_cache_tmpfile(const char* file, char** tmpp) {
+  size_t len = strlen(file) + 8;
+  char* tmp;
+  int fd, err;
+
+  if(!(tmp = malloc(len)))
+    return -1;
+
+  snprintf(tmp, len, "%s.XXXXXX", file);
+
+#ifdef _WIN32
+  fd = _mktemp(tmp) ? open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_BINARY, 0644) : -1;
+#else
+  if((fd = mkstemp(tmp)) != -1)
+    fchmod(fd, 0644);
+#endif
+
+  if(fd == -1) {
+    err = errno;
+    free(tmp);
+    errno = err;
+    return -1;
+  }
+
+  *tmpp = tmp;
+  return fd;
+}
+
+static int
+module_cache_write(
+    ModuleCache* mc, JSContext* ctx, const char* file, ModuleCacheHeader* hdr, const char* key, JSValueConst module) {
+  uint8_t* bytecode;
+  size_t bytecode_len;
+  char* tmp = 0;
+  int fd, ret = -1;
+
+  if(!(bytecode = JS_WriteObject(ctx, &bytecode_len, module, JS_WRITE_OBJ_BYTECODE))) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return -1;
+  }
+
+  if((fd = module_cache_tmpfile(file, &tmp)) == -1 && errno == ENOENT && !module_cache_mkdir(mc->dir))
+    fd = module_cache_tmpfile(file, &tmp);
+
+  if(fd != -1) {
+    hdr->bytecode_len = bytecode_len;
+
+    if(write(fd, hdr, sizeof(*hdr)) == sizeof(*hdr) && write(fd, key, hdr->key_len) == (ssize_t)hdr->key_len &&
+       write(fd, bytecode, bytecode_len) == (ssize_t)bytecode_len)
+      ret = 0;
+
+    close(fd);
+
+#ifdef _WIN32
+    if(!ret)
+      unlink(file);
+#endif
+
+    if(ret || rename(tmp, file)) {
+      unlink(tmp);
+      ret = -1;
+    }
+
+    free(tmp);
+  }
+
+  js_free(ctx, bytecode);
+
+  if(!ret)
+    mc->writes++;
+
+  return ret;
+}
+
+/**
+ * @brief Parse a cache mode name
+ *
+ * @return  a ModuleCacheMode or -1 if the name is unknown
+ */
+int
+module_cache_mode(const char* name) {
+  if(!strcmp(name, "off") || !strcmp(name, "no") || !strcmp(name, "0"))
+    return MODULE_CACHE_OFF;
+
+  if(!strcmp(name, "mtime") || !strcmp(name, "on") || !strcmp(name, "1"))
+    return MODULE_CACHE_MTIME;
+
+  if(!strcmp(name, "hash"))
+    return MODULE_CACHE_HASH;
+
+  return -1;
+}
+
+/**
+ * @brief Default cache directory: $XDG_CACHE_HOME/qjsm or $HOME/.cache/qjsm
+ */
+char*
+module_cache_default_dir(void) {
+  const char *base, *sub = "/qjsm";
+  char* dir;
+  size_t len;
+
+  if(!(base = getenv("XDG_CACHE_HOME")) || !*base) {
+    if(!(base = getenv("HOME")) || !*base)
+      return 0;
+
+    sub = "/.cache/qjsm";
+  }
+
+  len = strlen(base) + strlen(sub) + 1;
+
+  if((dir = malloc(len)))
+    snprintf(dir, len, "%s%s", base, sub);
+
+  return dir;
+}
+
+int
+module_cache_init(ModuleCache* mc, const char* dir, ModuleCacheMode mode, const char* version) {
+  memset(mc, 0, sizeof(ModuleCache));
+
+  if(!dir)
+    return 0;
+
+  if(!(mc->dir = strdup(dir)))
+    return -1;
+
+  mc->version = module_cache_version(version);
+  mc->mode = mode;
+  return 0;
+}
+
+void
+module_cache_free(ModuleCache* mc) {
+  if(mc->dir)
+    free(mc->dir);
+
+  memset(mc, 0, sizeof(ModuleCache));
+}
+
+/**
+ * @brief Remove all entries from the cache directory
+ *
+ * @return  number of entries removed, -1 if the directory could not be read
+ */
+int
+module_cache_clear(ModuleCache* mc) {
+  const size_t suffix_len = sizeof(MODULE_CACHE_SUFFIX) - 1;
+  struct dirent* ent;
+  DIR* d;
+  int ret = 0;
+
+  if(!mc->dir || !(d = opendir(mc->dir)))
+    return -1;
+
+  while((ent = readdir(d))) {
+    size_t len = strlen(ent->d_name), n = strlen(mc->dir) + len + 2;
+    char* file;
+
+    if(len <= suffix_len || strcmp(ent->d_name + len - suffix_len, MODULE_CACHE_SUFFIX))
+      continue;
+
+    if((file = malloc(n))) {
+      snprintf(file, n, "%s/%s", mc->dir, ent->d_name);
+
+      if(!unlink(file))
+        ++ret;
+
+      free(file);
+    }
+  }
+
+  closedir(d);
+  return ret;
+}
+
+/**
+ * @brief Compile the ES module \param filename, using the cache if possible
+ *
+ * @return  the compiled (not yet evaluated) module, or JS_EXCEPTION
+ */
+JSValue
+module_cache_compile(JSContext* ctx, ModuleCache* mc, const char* filename) {
+  ModuleCacheHeader hdr;
+  struct stat st;
+  uint8_t *source = 0, *entry = 0;
+  size_t source_len = 0, entry_len = 0, key_len = 0;
+  char *abs = 0, *key = 0, *file = 0;
+  int64_t sec = 0, nsec = 0;
+  JSValue ret;
+
+  if(mc->mode == MODULE_CACHE_OFF || stat(filename, &st) || !(abs = path_absolute1(filename)))
+    goto compile;
+
+  /* the module name is part of the bytecode, so it is part of the key as well */
+  key_len = strlen(abs) + 1 + strlen(filename);
+
+  if(!(key = malloc(key_len + 1)))
+    goto compile;
+
+  strcpy(key, abs);
+  strcpy(key + strlen(abs) + 1, filename);
+
+  if(!(file = module_cache_entry(mc, key, key_len)))
+    goto compile;
+
+  module_cache_mtime(&st, &sec, &nsec);
+
+  if((entry = module_cache_read(file, &entry_len)) && entry_len >= sizeof(hdr)) {
+    memcpy(&hdr, entry, sizeof(hdr));
+
+    if(memcmp(hdr.magic, MODULE_CACHE_MAGIC, sizeof(hdr.magic)) || hdr.version != mc->version ||
+       hdr.key_len != key_len || entry_len != sizeof(hdr) + (size_t)hdr.key_len + hdr.bytecode_len ||
+       memcmp(entry + sizeof(hdr), key, key_len))
+      goto compile;
+
+    if(mc->mode != MODULE_CACHE_MTIME || hdr.mtime_sec != sec || hdr.mtime_nsec != nsec ||
+       hdr.size != (uint64_t)st.st_size) {
+      if(!(source = module_cache_read(filename, &source_len)))
+        goto compile;
+
+      if(module_cache_hash(source, source_len, FNV_OFFSET) != hdr.hash)
+        goto compile;
+
+      /* only touched: refresh the stamp so the next lookup skips hashing */
+      if(hdr.mtime_sec != sec || hdr.mtime_nsec != nsec || hdr.size != source_len) {
+        int fd;
+
+        hdr.mtime_sec = sec;
+        hdr.mtime_nsec = nsec;
+        hdr.size = source_len;
+
+        if((fd = open(file, O_WRONLY | O_BINARY)) != -1) {
+          if(write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+            unlink(file);
+
+          close(fd);
+        }
+      }
+    }
+
+    ret = JS_ReadObject(ctx, entry + sizeof(hdr) + hdr.key_len, hdr.bytecode_len, JS_READ_OBJ_BYTECODE);
+
+    if(!JS_IsException(ret)) {
+      mc->hits++;
+      goto end;
+    }
+
+    JS_FreeValue(ctx, JS_GetException(ctx));
+  }
+
+compile:
+  if(!source && !(source = module_cache_read(filename, &source_len))) {
+    ret = JS_ThrowReferenceError(ctx, "could not load module filename '%s'", filename);
+    goto end;
+  }
+
+  ret = JS_Eval(ctx, (const char*)source, source_len, filename, JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_COMPILE_ONLY);
+
+  if(file && !JS_IsException(ret)) {
+    mc->misses++;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MODULE_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version = mc->version;
+    hdr.mtime_sec = sec;
+    hdr.mtime_nsec = nsec;
+    hdr.size = source_len;
+    hdr.hash = module_cache_hash(source, source_len, FNV_OFFSET);
+    hdr.key_len = key_len;
+
+    module_cache_write(mc, ctx, file, &hdr, key, ret);
+  }
+
+end:
+  if(source)
+    free(source);
+  if(entry)
+    free(entry);
+  if(file)
+    free(file);
+  if(key)
+    free(key);
+  if(abs)
+    free(abs);
+
+  return ret;
+}
+
+#define MODULE_IMAGE_MAGIC "QJSMIMG"
+
+/*
+ * Image layout: this header, the working directory, then for every module a
+ * ModuleImageRecord, its name (NUL terminated) and bytecode, then for every
+ * resolution three NUL terminated strings preceded by their lengths.
+ */
+typedef struct {
+  char magic[8];
+  uint64_t version;
+  uint32_t nmodules, nresolutions, cwd_len, reserved;
+} ModuleImageHeader;
+
+typedef struct {
+  int64_t mtime_sec, mtime_nsec;
+  uint64_t size;
+  uint32_t name_len, bytecode_len;
+} ModuleImageRecord;
+
+static void
+module_image_entry_free(ModuleImageEntry* e) {
+  if(e->owned) {
+    free(e->name);
+    free(e->bytecode);
+  }
+}
+
+static void
+module_image_reset(ModuleImage* img) {
+  for(size_t i = 0; i < img->nmodules; i++)
+    module_image_entry_free(&img->modules[i]);
+
+  for(size_t i = 0; i < img->nresolutions * 3; i++)
+    free(img->resolutions[i]);
+
+  if(img->modules)
+    free(img->modules);
+  if(img->resolutions)
+    free(img->resolutions);
+  if(img->data)
+    free(img->data);
+  if(img->cwd)
+    free(img->cwd);
+
+  img->data = 0;
+  img->cwd = 0;
+  img->modules = 0;
+  img->nmodules = img->cmodules = 0;
+  img->resolutions = 0;
+  img->nresolutions = img->cresolutions = 0;
+}
+
+static ModuleImageEntry*
+module_image_slot(ModuleImage* img, const char* name) {
+  ModuleImageEntry* e;
+
+  if((e = module_image_find(img, name))) {
+    module_image_entry_free(e);
+    return e;
+  }
+
+  if(img->nmodules == img->cmodules) {
+    size_t n = img->cmodules ? img->cmodules * 2 : 32;
+
+    if(!(e = realloc(img->modules, n * sizeof(ModuleImageEntry))))
+      return 0;
+
+    img->modules = e;
+    img->cmodules = n;
+  }
+
+  return &img->modules[img->nmodules++];
+}
+
+/**
+ * @brief Read \param len bytes at \param *pos of \param data, checking against \param end
+ */
+static const uint8_t*
+module_image_take(const uint8_t** pos, const uint8_t* end, size_t len) {
+  const uint8_t* p = *pos;
+
+  if((size_t)(end - p) < len)
+    return 0;
+
+  *pos = p + len;
+  return p;
+}
+
+static int
+module_image_write(int fd, const void* data, size_t len) {
+  return write(fd, data, len) == (ssize_t)len ? 0 : -1;
+}
+
+void
+module_image_init(ModuleImage* img, const char* version) {
+  memset(img, 0, sizeof(ModuleImage));
+
+  img->version = module_cache_version(version);
+}
+
+void
+module_image_free(ModuleImage* img) {
+  module_image_reset(img);
+}
+
+/**
+ * @brief Load the image \param file, replacing the current contents
+ *
+ * @return  0 on success, -1 if the file is missing, truncated, written by another engine version or saved in
+ *          another directory
+ */
+int
+module_image_load(ModuleImage* img, const char* file) {
+  ModuleImageHeader hdr;
+  char cwd[4096];
+  const uint8_t *pos, *end, *p;
+  uint8_t* data;
+  size_t len, i;
+
+  module_image_reset(img);
+
+  if(!(data = module_cache_read(file, &len)))
+    return -1;
+
+  img->data = data;
+  pos = data;
+  end = data + len;
+
+  if(!(p = module_image_take(&pos, end, sizeof(hdr))))
+    goto fail;
+
+  memcpy(&hdr, p, sizeof(hdr));
+
+  if(memcmp(hdr.magic, MODULE_IMAGE_MAGIC, sizeof(hdr.magic)) || hdr.version != img->version)
+    goto fail;
+
+  if(!(p = module_image_take(&pos, end, hdr.cwd_len)) || !(img->cwd = malloc(hdr.cwd_len + 1)))
+    goto fail;
+
+  memcpy(img->cwd, p, hdr.cwd_len);
+  img->cwd[hdr.cwd_len] = '\0';
+
+  /* module names and resolutions may be relative */
+  if(!getcwd(cwd, sizeof(cwd)) || strcmp(cwd, img->cwd))
+    goto fail;
+
+  if(hdr.nmodules && !(img->modules = calloc(hdr.nmodules, sizeof(ModuleImageEntry))))
+    goto fail;
+
+  img->cmodules = hdr.nmodules;
+
+  for(i = 0; i < hdr.nmodules; i++) {
+    ModuleImageEntry* e = &img->modules[i];
+    ModuleImageRecord rec;
+
+    if(!(p = module_image_take(&pos, end, sizeof(rec))))
+      goto fail;
+
+    memcpy(&rec, p, sizeof(rec));
+
+    /* names and bytecode are used in place */
+    if(!(e->name = (char*)module_image_take(&pos, end, (size_t)rec.name_len + 1)) || e->name[rec.name_len] != '\0' ||
+       !(e->bytecode = (uint8_t*)module_image_take(&pos, end, rec.bytecode_len)))
+      goto fail;
+
+    e->bytecode_len = rec.bytecode_len;
+    e->mtime_sec = rec.mtime_sec;
+    e->mtime_nsec = rec.mtime_nsec;
+    e->size = rec.size;
+    e->owned = FALSE;
+    img->nmodules++;
+  }
+
+  if(hdr.nresolutions && !(img->resolutions = calloc(hdr.nresolutions * 3, sizeof(char*))))
+    goto fail;
+
+  img->cresolutions = hdr.nresolutions;
+
+  for(i = 0; i < hdr.nresolutions; i++) {
+    for(int j = 0; j < 3; j++) {
+      uint32_t n;
+
+      if(!(p = module_image_take(&pos, end, sizeof(n))))
+        goto fail;
+
+      memcpy(&n, p, sizeof(n));
+
+      if(!(p = module_image_take(&pos, end, n)) || !(img->resolutions[i * 3 + j] = malloc(n + 1)))
+        goto fail;
+
+      memcpy(img->resolutions[i * 3 + j], p, n);
+      img->resolutions[i * 3 + j][n] = '\0';
+    }
+
+    img->nresolutions++;
+  }
+
+  return 0;
+
+fail:
+  /* count the partially read resolution so its strings are freed as well */
+  if(img->resolutions && img->nresolutions < img->cresolutions)
+    img->nresolutions++;
+
+  module_image_reset(img);
+  return -1;
+}
+
+/**
+ * @brief Write the image to \param file, stamped with the current working directory
+ */
+int
+module_image_save(ModuleImage* img, const char* file) {
+  ModuleImageHeader hdr;
+  char cwd[4096], *tmp;
+  int fd, ret = 0;
+
+  if(!getcwd(cwd, sizeof(cwd)) || (fd = module_cache_tmpfile(file, &tmp)) == -1)
+    return -1;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, MODULE_IMAGE_MAGIC, sizeof(hdr.magic));
+  hdr.version = img->version;
+  hdr.nmodules = img->nmodules;
+  hdr.nresolutions = img->nresolutions;
+  hdr.cwd_len = strlen(cwd);
+
+  ret |= module_image_write(fd, &hdr, sizeof(hdr));
+  ret |= module_image_write(fd, cwd, hdr.cwd_len);
+
+  for(size_t i = 0; i < img->nmodules && !ret; i++) {
+    ModuleImageEntry* e = &img->modules[i];
+    ModuleImageRecord rec = {e->mtime_sec, e->mtime_nsec, e->size, strlen(e->name), e->bytecode_len};
+
+    ret |= module_image_write(fd, &rec, sizeof(rec));
+    ret |= module_image_write(fd, e->name, (size_t)rec.name_len + 1);
+    ret |= module_image_write(fd, e->bytecode, e->bytecode_len);
+  }
+
+  for(size_t i = 0; i < img->nresolutions * 3 && !ret; i++) {
+    uint32_t n = strlen(img->resolutions[i]);
+
+    ret |= module_image_write(fd, &n, sizeof(n));
+    ret |= module_image_write(fd, img->resolutions[i], n);
+  }
+
+  close(fd);
+
+#ifdef _WIN32
+  if(!ret)
+    unlink(file);
+#endif
+
+  if(ret || rename(tmp, file)) {
+    unlink(tmp);
+    ret = -1;
+  }
+
+  free(tmp);
+  return ret;
+}
+
+ModuleImageEntry*
+module_image_find(ModuleImage* img, const char* name) {
+  for(size_t i = 0; i < img->nmodules; i++)
+    if(!strcmp(img->modules[i].name, name))
+      return &img->modules[i];
+
+  return 0;
+}
+
+/**
+ * @brief Read the compiled module \param name from the image
+ *
+ * Entries of files on disk are only used if the file's mtime and size are
+ * unchanged.  Entries without a stamp (sources not backed by a file) are
+ * always used.
+ *
+ * @return  the compiled (not yet evaluated) module, JS_UNDEFINED if there is no usable entry
+ */
+JSValue
+module_image_read(JSContext* ctx, ModuleImage* img, const char* name) {
+  ModuleImageEntry* e;
+  JSValue ret;
+
+  if(!(e = module_image_find(img, name)))
+    return JS_UNDEFINED;
+
+  if(e->mtime_sec || e->mtime_nsec || e->size) {
+    struct stat st;
+    int64_t sec, nsec;
+
+    if(stat(name, &st))
+      return JS_UNDEFINED;
+
+    module_cache_mtime(&st, &sec, &nsec);
+
+    if(sec != e->mtime_sec || nsec != e->mtime_nsec || (uint64_t)st.st_size != e->size)
+      return JS_UNDEFINED;
+  }
+
+  ret = JS_ReadObject(ctx, e->bytecode, e->bytecode_len, JS_READ_OBJ_BYTECODE);
+
+  if(JS_IsException(ret)) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return JS_UNDEFINED;
+  }
+
+  return ret;
+}
+
+/**
+ * @brief Add the compiled \param module under \param name, stamped with the mtime and size of the file \param name
+ */
+int
+module_image_add(JSContext* ctx, ModuleImage* img, const char* name, JSValueConst module) {
+  ModuleImageEntry* e;
+  struct stat st;
+  uint8_t *bytecode, *copy;
+  size_t bytecode_len;
+  char* key;
+
+  if(!(bytecode = JS_WriteObject(ctx, &bytecode_len, module, JS_WRITE_OBJ_BYTECODE))) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return -1;
+  }
+
+  copy = malloc(bytecode_len);
+  key = strdup(name);
+
+  if(!copy || !key || !(e = module_image_slot(img, name))) {
+    free(copy);
+    free(key);
+    js_free(ctx, bytecode);
+    return -1;
+  }
+
+  memcpy(copy, bytecode, bytecode_len);
+  js_free(ctx, bytecode);
+
+  memset(e, 0, sizeof(ModuleImageEntry));
+  e->name = key;
+  e->bytecode = copy;
+  e->bytecode_len = bytecode_len;
+  e->owned = TRUE;
+
+  if(!stat(name, &st)) {
+    module_cache_mtime(&st, &e->mtime_sec, &e->mtime_nsec);
+    e->size = st.st_size;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Record that \param specifier imported from \param base resolved to \param result
+ */
+int
+module_image_resolution(ModuleImage* img, const char* base, const char* specifier, const char* result) {
+  const char* strs[3] = {base, specifier, result};
+
+  for(size_t i = 0; i < img->nresolutions; i++)
+    if(!strcmp(img->resolutions[i * 3], base) && !strcmp(img->resolutions[i * 3 + 1], specifier)) {
+      char* s;
+
+      if(!strcmp(img->resolutions[i * 3 + 2], result))
+        return 0;
+
+      if(!(s = strdup(result)))
+        return -1;
+
+      free(img->resolutions[i * 3 + 2]);
+      img->resolutions[i * 3 + 2] = s;
+      return 0;
+    }
+
+  if(img->nresolutions == img->cresolutions) {
+    size_t n = img->cresolutions ? img->cresolutions * 2 : 64;
+    char** r;
+
+    if(!(r = realloc(img->resolutions, n * 3 * sizeof(char*))))
+      return -1;
+
+    img->resolutions = r;
+    img->cresolutions = n;
+  }
+
+  for(int j = 0; j < 3; j++)
+    if(!(img->resolutions[img->nresolutions * 3 + j] = strdup(strs[j]))) {
+      while(--j >= 0)
+        free(img->resolutions[img->nresolutions * 3 + j]);
+
+      return -1;
+    }
+
+  img->nresolutions++;
+  return 0;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,364 @@
+#include "path-cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef HAVE_INOTIFY
+#include <fcntl.h>
+#include <sys/inotify.h>
+#endif
+
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+
+/**
+ * \addtogroup path-cache
+ * @{
+ */
+
+/* namespaces used internally, callers use printable characters */
+#define NS_STAT '\1'
+#define NS_WATCH '\2'
+
+struct path_cache_entry {
+  PathCacheEntry* next;
+  uint32_t hash;
+  int type;
+  char* value;
+  size_t key_len;
+  char key[];
+};
+
+#ifdef CLOCK_MONOTONIC_COARSE
+#define PATH_CACHE_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define PATH_CACHE_CLOCK CLOCK_MONOTONIC
+#endif
+
+/* milliseconds, read without a system call where the vDSO provides the clock */
+static int64_t
+path_cache_now(void) {
+  struct timespec ts;
+
+  clock_gettime(PATH_CACHE_CLOCK, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t
+path_cache_hash(const char* key, size_t len) {
+  uint32_t h = 2166136261u;
+
+  for(size_t i = 0; i < len; i++) {
+    h ^= (uint8_t)key[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+/**
+ * @brief Build the key  ns a \0 b  in \param buf or a malloc()'ed buffer
+ */
+static char*
+path_cache_key(char* buf, size_t size, char ns, const char* a, const char* b, size_t* lenp) {
+  size_t alen = strlen(a), blen = b ? strlen(b) : 0, len = 1 + alen + 1 + blen;
+  char* key = len <= size ? buf : malloc(len);
+
+  if(key) {
+    key[0] = ns;
+    memcpy(key + 1, a, alen + 1);
+
+    if(blen)
+      memcpy(key + 2 + alen, b, blen);
+
+    *lenp = len;
+  }
+
+  return key;
+}
+
+static PathCacheEntry*
+path_cache_find(PathCache* pc, const char* key, size_t len, uint32_t hash) {
+  PathCacheEntry* e;
+
+  if(pc->capacity)
+    for(e = pc->table[hash & (pc->capacity - 1)]; e; e = e->next)
+      if(e->hash == hash && e->key_len == len && !memcmp(e->key, key, len))
+        return e;
+
+  return 0;
+}
+
+static PathCacheEntry*
+path_cache_insert(PathCache* pc, const char* key, size_t len, uint32_t hash) {
+  PathCacheEntry* e;
+
+  if(pc->count >= pc->capacity) {
+    size_t capacity = pc->capacity ? pc->capacity * 2 : 64;
+    PathCacheEntry** table;
+
+    if(!(table = calloc(capacity, sizeof(PathCacheEntry*))))
+      return 0;
+
+    for(size_t i = 0; i < pc->capacity; i++)
+      while((e = pc->table[i])) {
+        pc->table[i] = e->next;
+        e->next = table[e->hash & (capacity - 1)];
+        table[e->hash & (capacity - 1)] = e;
+      }
+
+    free(pc->table);
+    pc->table = table;
+    pc->capacity = capacity;
+  }
+
+  if((e = malloc(sizeof(PathCacheEntry) + len))) {
+    e->hash = hash;
+    e->type = PATH_TYPE_NONE;
+    e->value = 0;
+    e->key_len = len;
+    memcpy(e->key, key, len);
+
+    e->next = pc->table[hash & (pc->capacity - 1)];
+    pc->table[hash & (pc->capacity - 1)] = e;
+    pc->count++;
+  }
+
+  return e;
+}
+
+#ifdef HAVE_INOTIFY
+/**
+ * @brief Watch the directory containing \param path, or its nearest existing parent
+ */
+static void
+path_cache_watch(PathCache* pc, const char* path) {
+  char dir[PATH_MAX], key[PATH_MAX + 2];
+  size_t len, keylen;
+  char* s;
+
+  if((len = strlen(path)) >= sizeof(dir))
+    return;
+
+  memcpy(dir, path, len + 1);
+
+  for(;;) {
+    if(!(s = strrchr(dir, '/')))
+      strcpy(dir, ".");
+    else if(s == dir)
+      s[1] = '\0';
+    else
+      *s = '\0';
+
+    path_cache_key(key, sizeof(key), NS_WATCH, dir, 0, &keylen);
+
+    if(path_cache_find(pc, key, keylen, path_cache_hash(key, keylen)))
+      return;
+
+    if(inotify_add_watch(pc->watch_fd,
+                         dir,
+                         IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_DELETE_SELF) != -1) {
+      path_cache_insert(pc, key, keylen, path_cache_hash(key, keylen));
+      return;
+    }
+
+    if(!s || s == dir)
+      return;
+  }
+}
+#endif
+
+void
+path_cache_init(PathCache* pc, BOOL watch) {
+  char buf[PATH_MAX];
+
+  memset(pc, 0, sizeof(PathCache));
+
+  pc->cwd = getcwd(buf, sizeof(buf)) ? strdup(buf) : 0;
+  pc->watch_fd = -1;
+  pc->checked = pc->flushed = path_cache_now();
+
+#ifdef HAVE_INOTIFY
+  if(watch)
+    pc->watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+void
+path_cache_clear(PathCache* pc) {
+  PathCacheEntry* e;
+
+  for(size_t i = 0; i < pc->capacity; i++)
+    while((e = pc->table[i])) {
+      pc->table[i] = e->next;
+
+      if(e->value)
+        free(e->value);
+
+      free(e);
+    }
+
+  pc->count = 0;
+  pc->flushed = path_cache_now();
+}
+
+void
+path_cache_free(PathCache* pc) {
+  path_cache_clear(pc);
+
+  if(pc->table)
+    free(pc->table);
+
+  if(pc->cwd)
+    free(pc->cwd);
+
+  if(pc->watch_fd != -1)
+    close(pc->watch_fd);
+
+  memset(pc, 0, sizeof(PathCache));
+  pc->watch_fd = -1;
+}
+
+/**
+ * @brief Flush the cache if the working directory changed, a watched directory was modified or,
+ * without watching, its entries are older than PATH_CACHE_TTL
+ *
+ * getcwd() is only called once per PATH_CACHE_TTL, a chdir() is noticed within that time.
+ *
+ * @return  TRUE if the cache was flushed
+ */
+BOOL
+path_cache_validate(PathCache* pc) {
+  char buf[PATH_MAX];
+  BOOL stale = FALSE;
+  int64_t now = path_cache_now();
+
+#ifdef HAVE_INOTIFY
+  if(pc->watch_fd != -1) {
+    char events[4096];
+
+    while(read(pc->watch_fd, events, sizeof(events)) > 0)
+      stale = TRUE;
+  }
+#endif
+
+  if(pc->watch_fd == -1 && now - pc->flushed >= PATH_CACHE_TTL)
+    stale = TRUE;
+
+  if(now - pc->checked >= PATH_CACHE_TTL) {
+    pc->checked = now;
+
+    if(getcwd(buf, sizeof(buf)) && (!pc->cwd || strcmp(buf, pc->cwd))) {
+      stale = TRUE;
+
+      if(pc->cwd)
+        free(pc->cwd);
+
+      pc->cwd = strdup(buf);
+    }
+  }
+
+  if(stale)
+    path_cache_clear(pc);
+
+  return stale;
+}
+
+/**
+ * @brief Cached stat() of \param path
+ *
+ * @return  PATH_TYPE_FILE, PATH_TYPE_DIR, PATH_TYPE_OTHER or PATH_TYPE_NONE if it doesn't exist
+ */
+int
+path_cache_type(PathCache* pc, const char* path) {
+  char buf[PATH_MAX + 2], *key;
+  PathCacheEntry* e;
+  struct stat st;
+  uint32_t hash;
+  size_t len;
+  int type;
+
+  if(!(key = path_cache_key(buf, sizeof(buf), NS_STAT, path, 0, &len)))
+    return PATH_TYPE_NONE;
+
+  hash = path_cache_hash(key, len);
+
+  if((e = path_cache_find(pc, key, len, hash))) {
+    pc->hits++;
+    type = e->type;
+  } else {
+    pc->misses++;
+
+    if(!stat(path, &st))
+      type = S_ISREG(st.st_mode) ? PATH_TYPE_FILE : S_ISDIR(st.st_mode) ? PATH_TYPE_DIR : PATH_TYPE_OTHER;
+    else
+      type = lstat(path, &st) ? PATH_TYPE_NONE : PATH_TYPE_OTHER;
+
+    if((e = path_cache_insert(pc, key, len, hash)))
+      e->type = type;
+
+#ifdef HAVE_INOTIFY
+    if(pc->watch_fd != -1)
+      path_cache_watch(pc, path);
+#endif
+  }
+
+  if(key != buf)
+    free(key);
+
+  return type;
+}
+
+/**
+ * @brief Look up a memoized result for (\param a, \param b) in namespace \param ns
+ *
+ * @return  TRUE if there is an entry, *result is then the stored string or NULL
+ */
+BOOL
+path_cache_get(PathCache* pc, char ns, const char* a, const char* b, const char** result) {
+  char buf[PATH_MAX + 2], *key;
+  PathCacheEntry* e;
+  size_t len;
+
+  if(!(key = path_cache_key(buf, sizeof(buf), ns, a, b, &len)))
+    return FALSE;
+
+  if((e = path_cache_find(pc, key, len, path_cache_hash(key, len))))
+    *result = e->value;
+
+  if(key != buf)
+    free(key);
+
+  e ? pc->hits++ : pc->misses++;
+  return e != NULL;
+}
+
+void
+path_cache_put(PathCache* pc, char ns, const char* a, const char* b, const char* result) {
+  char buf[PATH_MAX + 2], *key;
+  PathCacheEntry* e;
+  uint32_t hash;
+  size_t len;
+
+  if(!(key = path_cache_key(buf, sizeof(buf), ns, a, b, &len)))
+    return;
+
+  hash = path_cache_hash(key, len);
+
+  if((e = path_cache_find(pc, key, len, hash)) || (e = path_cache_insert(pc, key, len, hash))) {
+    if(e->value)
+      free(e->value);
+
+    e->value = result ? strdup(result) : 0;
+  }
+
+  if(key != buf)
+    free(key);
+}
+
+/**
+ * @}
+ */
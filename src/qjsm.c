@@ -48,6 +48,10 @@
 #include <quickjs-libc.h>
 #include "buffer-utils.h"
 #include "base64.h"
+#include "module-cache.h"
+#include "path-cache.h"
+#include "alloc-trace.h"
+#include "size-alloc.h"
 #include "debug.h"
 
 #include "quickjs-internal.h"
@@ -68,6 +72,14 @@ static thread_local int debug_module_loader = 0;
 static thread_local Vector module_debug = VECTOR_INIT();
 static thread_local Vector module_list = VECTOR_INIT();
 static thread_local ModuleLoaderContext* module_loaders = NULL;
+static ModuleCache module_cache;
+static BOOL resolve_cache = TRUE, watch_modules = FALSE;
+static thread_local PathCache path_cache;
+static thread_local BOOL path_cache_ready = FALSE;
+/* startup image, only used by the main thread */
+static ModuleImage startup_image;
+static thread_local ModuleImage* module_image = 0;
+static BOOL image_save = FALSE;
 
 #ifndef QUICKJS_MODULE_PATH
 #ifdef QUICKJS_PREFIX
@@ -78,7 +90,7 @@ static thread_local ModuleLoaderContext* module_loaders = NULL;
 static const char jsm_default_module_path[] = QUICKJS_MODULE_PATH;
 
 // static JSModuleLoaderFunc* module_loader = 0;
-static JSValue package_json;
+static thread_local JSValue package_json;
 static char* exename;
 static size_t exelen;
 static JSRuntime* jsm_rt;
@@ -90,6 +102,47 @@ static const char* const module_extensions[] = {
     //    "/package.json",
 };
 
+static PathCache*
+jsm_path_cache(void) {
+  if(!resolve_cache)
+    return 0;
+
+  if(!path_cache_ready) {
+    path_cache_init(&path_cache, watch_modules);
+    path_cache_ready = TRUE;
+  }
+
+  return &path_cache;
+}
+
+/**
+ * @brief Drop memoized lookups (and package.json) after a chdir(), a file change with --watch-modules
+ * or, without it, once the entries are older than PATH_CACHE_TTL
+ */
+static void
+jsm_path_cache_validate(JSContext* ctx) {
+  PathCache* pc;
+
+  if((pc = jsm_path_cache()) && path_cache_validate(pc)) {
+    JS_FreeValue(ctx, package_json);
+    package_json = JS_UNDEFINED;
+  }
+}
+
+static BOOL
+jsm_isfile(const char* path) {
+  PathCache* pc;
+
+  return (pc = jsm_path_cache()) ? path_cache_isfile(pc, path) : path_isfile1(path);
+}
+
+static BOOL
+jsm_exists(const char* path) {
+  PathCache* pc;
+
+  return (pc = jsm_path_cache()) ? path_cache_exists(pc, path) : path_exists1(path);
+}
+
 static inline BOOL
 is_searchable(const char* path) {
   return !path_isexplicit(path);
@@ -102,7 +155,7 @@ has_dot_or_slash(const char* s) {
 
 static char*
 is_module(JSContext* ctx, const char* module_name) {
-  BOOL yes = path_isfile1(module_name);
+  BOOL yes = jsm_isfile(module_name);
 
   if(debug_module_loader > 2)
     printf("%-20s (module_name=\"%s\")=%s\n", __FUNCTION__, module_name, ((yes) ? "TRUE" : "FALSE"));
@@ -507,6 +560,9 @@ jsm_load_json(JSContext* ctx, const char* file) {
 static JSValue
 jsm_load_package(JSContext* ctx, const char* file) {
   if(JS_IsUndefined(package_json) || JS_VALUE_GET_TAG(package_json) == 0) {
+    if(!jsm_isfile(file ? file : "package.json"))
+      return package_json = JS_NULL;
+
     package_json = jsm_load_json(ctx, file ? file : "package.json");
 
     if(JS_IsException(package_json)) {
@@ -538,7 +594,7 @@ jsm_search_list(JSContext* ctx, const char* module_name, const char* list) {
     t[i] = '/';
     strcpy(&t[i + 1], module_name);
 
-    if(path_isfile1(t))
+    if(jsm_isfile(t))
       return t;
 
     if(s[i])
@@ -603,7 +659,17 @@ jsm_search_module(JSContext* ctx, const char* module_name) {
   BOOL search = is_searchable(module_name);
   BOOL suffix = module_has_suffix(module_name);
   ModuleLoader* fn = search ? &jsm_search_path : &is_module;
-  char* s = suffix ? fn(ctx, module_name) : jsm_search_suffix(ctx, module_name, fn);
+  PathCache* pc = jsm_path_cache();
+  const char* cached;
+  char* s;
+
+  if(pc && path_cache_get(pc, 's', module_name, getenv("QUICKJS_MODULE_PATH"), &cached))
+    return cached ? js_strdup(ctx, cached) : 0;
+
+  s = suffix ? fn(ctx, module_name) : jsm_search_suffix(ctx, module_name, fn);
+
+  if(pc)
+    path_cache_put(pc, 's', module_name, getenv("QUICKJS_MODULE_PATH"), s);
 
   if(debug_module_loader >= 2)
     printf("%-20s (module_name=\"%s\") search=%s suffix=%s fn=%s result=%s\n",
@@ -632,6 +698,11 @@ char*
 jsm_module_package(JSContext* ctx, const char* module) {
   JSValue package;
   char *rel, *file = 0;
+  PathCache* pc = jsm_path_cache();
+  const char* cached;
+
+  if(pc && path_cache_get(pc, 'p', module, 0, &cached))
+    return cached ? js_strdup(ctx, cached) : 0;
 
   rel = path_isabsolute1(module) ? path_relative1(module) : strdup(module);
 
@@ -658,6 +729,10 @@ jsm_module_package(JSContext* ctx, const char* module) {
   }
 
   free(rel);
+
+  if(pc)
+    path_cache_put(pc, 'p', module, 0, file);
+
   return file;
 }
 
@@ -818,7 +893,7 @@ jsm_module_locate(JSContext* ctx, const char* module_name, void* opaque) {
       printf("%-20s [1](module_name=\"%s\", opaque=%p) s=%s\n", __FUNCTION__, module_name, opaque, s);
 
     if(has_dot_or_slash(s))
-      if(path_isfile1(s))
+      if(jsm_isfile(s))
         break;
 
     if(is_searchable(s)) {
@@ -892,12 +967,51 @@ jsm_call_normalizers(JSContext* ctx, ModuleLoaderContext* loader, JSValueConst b
   return argv[1];
 }
 
+/**
+ * @brief Compile a module file, through the bytecode cache unless it is a shared object
+ */
+static JSModuleDef*
+jsm_module_compile(JSContext* ctx, const char* path, void* opaque) {
+  JSModuleDef* m;
+  JSValue func = JS_UNDEFINED;
+  uint32_t hits = module_cache.hits;
+  const char* from = "image";
+
+  if(str_ends(path, CONFIG_SHEXT) || (module_cache.mode == MODULE_CACHE_OFF && !module_image))
+    return js_module_loader(ctx, path, opaque);
+
+  if(module_image)
+    func = module_image_read(ctx, module_image, path);
+
+  if(JS_IsUndefined(func)) {
+    func = module_cache_compile(ctx, &module_cache, path);
+    from = module_cache.hits != hits ? "hit" : "miss";
+
+    if(image_save && module_image && !JS_IsException(func))
+      module_image_add(ctx, module_image, path, func);
+  }
+
+  if(debug_module_loader >= 2)
+    printf("%-20s \"%s\" (cache %s)\n", __FUNCTION__, path, from);
+
+  if(JS_IsException(func))
+    return 0;
+
+  js_module_set_import_meta(ctx, func, TRUE, FALSE);
+
+  m = JS_VALUE_GET_PTR(func);
+  JS_FreeValue(ctx, func);
+  return m;
+}
+
 JSModuleDef*
 jsm_module_loader(JSContext* ctx, const char* module_name, void* opaque) {
   char *s = 0, *name = js_strdup(ctx, module_name);
   JSModuleDef* m = 0;
   ModuleLoaderContext** lptr = opaque;
 
+  jsm_path_cache_validate(ctx);
+
 again:
   if(str_start(name, "file://"))
     name += 7;
@@ -1014,7 +1128,7 @@ restart:
         BuiltinModule* rec;
 
         if((rec = jsm_builtin_find(s))) {
-          free(s);
+          js_free(ctx, s);
           js_free(ctx, name);
           return jsm_builtin_init(ctx, rec);
         }
@@ -1061,7 +1175,7 @@ restart:
     if(str_ends(s, ".json"))
       m = jsm_module_json(ctx, s);
     else
-      m = js_module_loader(ctx, s, opaque);
+      m = jsm_module_compile(ctx, s, opaque);
 
     jsm_stack_pop(ctx);
 
@@ -1091,9 +1205,17 @@ end:
 
 char*
 jsm_module_normalize(JSContext* ctx, const char* path, const char* name, void* opaque) {
-  char* file = 0;
+  char *file = 0, *base = 0;
   BuiltinModule* bltin = 0;
   ModuleLoaderContext** lptr = opaque;
+  PathCache* pc = 0;
+  const char* cached;
+
+  jsm_path_cache_validate(ctx);
+
+  /* results only depend on the directory of the importing module, unless JS normalizers are registered */
+  if((!lptr || !*lptr) && (pc = jsm_path_cache()))
+    base = path[0] == '<' ? str_ndup("<", 1) : str_ndup(path, path_dirlen1(path));
 
   if(!has_dot_or_slash(name) && (bltin = jsm_builtin_find(name))) {
     if(bltin->def) {
@@ -1102,6 +1224,9 @@ jsm_module_normalize(JSContext* ctx, const char* path, const char* name, void* o
       file = js_strdup(ctx, str);
       JS_FreeCString(ctx, str);
     }
+  } else if(base && path_cache_get(pc, 'n', base, name, &cached)) {
+    file = js_strdup(ctx, cached);
+    goto done;
   } else {
     if(path[0] != '<' && (path_isdotslash(name) || path_isdotdot(name)) && has_dot_or_slash(name)) {
       DynBuf dir;
@@ -1132,8 +1257,15 @@ jsm_module_normalize(JSContext* ctx, const char* path, const char* name, void* o
       dbuf_0(&db);
 
       file = (char*)db.buf;
-    } else if(has_dot_or_slash(name) && path_exists1(name) && path_isrelative(name)) {
-      file = path_absolute1(name);
+    } else if(has_dot_or_slash(name) && jsm_exists(name) && path_isrelative(name)) {
+      DynBuf db;
+
+      js_dbuf_init(ctx, &db);
+
+      path_absolute3(name, strlen(name), &db);
+      dbuf_0(&db);
+
+      file = (char*)db.buf;
       path_normalize1(file);
     }
   }
@@ -1170,6 +1302,17 @@ jsm_module_normalize(JSContext* ctx, const char* path, const char* name, void* o
   if(file == 0)
     file = js_strdup(ctx, name);
 
+  if(base && !bltin) {
+    path_cache_put(pc, 'n', base, name, file);
+
+    if(image_save && module_image)
+      module_image_resolution(module_image, base, name, file);
+  }
+
+done:
+  if(base)
+    free(base);
+
   if(debug_module_loader >= 1)
     printf("%-20s %s: \"%s\" => \"%s\"\n", __FUNCTION__, path, name, file);
 
@@ -1222,6 +1365,38 @@ jsm_context_new(JSRuntime* rt) {
   return ctx;
 }
 
+/* 'threads' workers resolve modules like the main thread, module_loaders is the worker's own */
+static JSContext*
+jsm_thread_context_new(JSRuntime* rt) {
+  JS_SetModuleLoaderFunc(rt, jsm_module_normalize, jsm_module_loader, &module_loaders);
+
+  return jsm_context_new(rt);
+}
+
+/* the worker's context is going away: free its loaders, package.json, path cache and its inotify fd */
+static void
+jsm_thread_context_free(JSContext* ctx) {
+  ModuleLoaderContext *lc, *next;
+
+  for(lc = module_loaders; lc; lc = next) {
+    next = lc->next;
+    JS_FreeValue(ctx, lc->func);
+    js_free(ctx, lc);
+  }
+
+  module_loaders = 0;
+
+  JS_FreeValue(ctx, package_json);
+  package_json = JS_UNDEFINED;
+
+  if(path_cache_ready) {
+    path_cache_free(&path_cache);
+    path_cache_ready = FALSE;
+  }
+
+  vector_freestrings(&module_list);
+}
+
 JSValue
 jsm_modules_array(JSContext* ctx, JSValueConst this_val, int magic) {
   JSModuleDef *m, **list;
@@ -1415,6 +1590,171 @@ static const JSMallocFunctions trace_mf = {
 #endif
 };
 
+/* binary allocation tracing (--alloc-trace, --alloc-sample) */
+static size_t
+jsm_alloc_trace_stack(void* opaque, char* buf, size_t size) {
+  return jsm_rt ? js_stack_frames(jsm_rt, buf, size, 64) : 0;
+}
+
+static void*
+jsm_alloc_trace_malloc(JSMallocState* s, size_t size) {
+  void* ptr;
+
+  assert(size != 0);
+
+  if(unlikely(s->malloc_size + size > s->malloc_limit))
+    return 0;
+
+  if((ptr = malloc(size))) {
+    s->malloc_count++;
+    s->malloc_size += jsm_trace_malloc_usable_size(ptr) + MALLOC_OVERHEAD;
+    alloc_trace_malloc(s->opaque, ptr, size);
+  }
+
+  return ptr;
+}
+
+static void
+jsm_alloc_trace_free(JSMallocState* s, void* ptr) {
+  size_t size;
+
+  if(!ptr)
+    return;
+
+  size = jsm_trace_malloc_usable_size(ptr);
+  alloc_trace_free(s->opaque, ptr, size);
+  s->malloc_count--;
+  s->malloc_size -= size + MALLOC_OVERHEAD;
+  free(ptr);
+}
+
+static void*
+jsm_alloc_trace_realloc(JSMallocState* s, void* ptr, size_t size) {
+  size_t old_size;
+  void* ret;
+
+  if(!ptr)
+    return size ? jsm_alloc_trace_malloc(s, size) : 0;
+
+  if(size == 0) {
+    jsm_alloc_trace_free(s, ptr);
+    return 0;
+  }
+
+  old_size = jsm_trace_malloc_usable_size(ptr);
+
+  if(s->malloc_size + size - old_size > s->malloc_limit)
+    return 0;
+
+  if((ret = realloc(ptr, size))) {
+    s->malloc_size += jsm_trace_malloc_usable_size(ret) - old_size;
+    alloc_trace_realloc(s->opaque, ptr, ret, size);
+  }
+
+  return ret;
+}
+
+/* the usable size function is taken from trace_mf */
+static JSMallocFunctions alloc_trace_mf = {
+    jsm_alloc_trace_malloc,
+    jsm_alloc_trace_free,
+    jsm_alloc_trace_realloc,
+};
+
+/* built-in size-class allocator (--slab-alloc), larger blocks still come from malloc() */
+static size_t
+jsm_slab_usable_size(const void* ptr) {
+  size_t size;
+
+  if((size = size_alloc_usable_size(ptr)))
+    return size;
+
+  return jsm_trace_malloc_usable_size((void*)ptr);
+}
+
+static void*
+jsm_slab_malloc(JSMallocState* s, size_t size) {
+  size_t class_size = size_alloc_class_size(size);
+  void* ptr;
+
+  assert(size != 0);
+
+  if(unlikely(s->malloc_size + (class_size ? class_size : size + MALLOC_OVERHEAD) > s->malloc_limit))
+    return 0;
+
+  if(class_size && (ptr = size_alloc_malloc(s->opaque, size)))
+    s->malloc_size += class_size;
+  else if((ptr = malloc(size)))
+    s->malloc_size += jsm_trace_malloc_usable_size(ptr) + MALLOC_OVERHEAD;
+  else
+    return 0;
+
+  s->malloc_count++;
+  return ptr;
+}
+
+static void
+jsm_slab_free(JSMallocState* s, void* ptr) {
+  size_t size;
+
+  if(!ptr)
+    return;
+
+  s->malloc_count--;
+
+  if((size = size_alloc_usable_size(ptr))) {
+    s->malloc_size -= size;
+    size_alloc_free(s->opaque, ptr);
+  } else {
+    s->malloc_size -= jsm_trace_malloc_usable_size(ptr) + MALLOC_OVERHEAD;
+    free(ptr);
+  }
+}
+
+static void*
+jsm_slab_realloc(JSMallocState* s, void* ptr, size_t size) {
+  size_t old_size;
+  void* ret;
+
+  if(!ptr)
+    return size ? jsm_slab_malloc(s, size) : 0;
+
+  if(size == 0) {
+    jsm_slab_free(s, ptr);
+    return 0;
+  }
+
+  /* a slab block stays where it is as long as the size class does not change */
+  if((old_size = size_alloc_usable_size(ptr))) {
+    if(size_alloc_class_size(size) == old_size)
+      return ptr;
+
+    if(!(ret = jsm_slab_malloc(s, size)))
+      return 0;
+
+    memcpy(ret, ptr, MIN_NUM(size, old_size));
+    jsm_slab_free(s, ptr);
+    return ret;
+  }
+
+  old_size = jsm_trace_malloc_usable_size(ptr);
+
+  if(s->malloc_size + size - old_size > s->malloc_limit)
+    return 0;
+
+  if((ret = realloc(ptr, size)))
+    s->malloc_size += jsm_trace_malloc_usable_size(ret) - old_size;
+
+  return ret;
+}
+
+static const JSMallocFunctions slab_mf = {
+    jsm_slab_malloc,
+    jsm_slab_free,
+    jsm_slab_realloc,
+    jsm_slab_usable_size,
+};
+
 void
 jsm_help(void) {
   printf("QuickJS version " CONFIG_VERSION "\n"
@@ -1434,10 +1774,23 @@ jsm_help(void) {
 #endif
 #endif
          "-T  --trace        trace memory allocation\n"
+         "    --alloc-trace FILE     record allocations into FILE (binary, see lib/alloc-trace.js)\n"
+         "    --alloc-sample n       only sample one allocation every 'n' bytes, with its JS stack\n"
+         "    --slab-alloc           serve small allocations from size-class slabs\n"
+         "    --stats                count handler dispatches, jobs and GC runs, see getRuntimeStats()\n"
+         "    --stats-fd n           write the stats to fd 'n' as one JSON object per line\n"
+         "    --stats-interval ms    how often the stats are written (default 1000)\n"
          "-d  --dump         dump the memory usage stats\n"
          "    --memory-limit n       limit the memory usage to 'n' bytes\n"
          "    --stack-size n         limit the stack size to 'n' bytes\n"
          "    --unhandled-rejection  dump unhandled promise rejections\n"
+         "    --cache MODE           module bytecode cache: off, mtime (default) or hash\n"
+         "    --cache-dir DIR        module bytecode cache directory\n"
+         "    --clear-cache          remove all cached module bytecode\n"
+         "    --no-resolve-cache     don't memoize module resolution and stat() results\n"
+         "    --watch-modules        flush memoized module resolution on file changes\n"
+         "    --image FILE           load compiled modules and resolutions from a startup image\n"
+         "    --save-image           write everything this run loaded to the startup image\n"
          "-q  --quit         just instantiate the interpreter and quit\n"
 #ifdef SIGUSR1
          "\n"
@@ -1793,6 +2146,374 @@ jsm_module_func(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst ar
   return val;
 }
 
+/* --stats: dispatch times of os handlers, job queue, GC runs and memory */
+typedef struct {
+  char type; /* 'r'ead, 'w'rite or 't'imer */
+  int fd;
+  JSAtom name; /* of the timer function */
+  uint64_t count, time, max;
+} StatsHandler;
+
+static struct {
+  BOOL enabled;
+  int fd;
+  uint64_t start, interval, next_dump;
+  StatsHandler* handlers;
+  size_t nhandlers;
+  uint64_t jobs, job_time, drains, max_depth, max_drain;
+  uint64_t gc_runs, gc_freed;
+  size_t gc_threshold, gc_peak;
+  JSMemoryUsage dump_memory, call_memory; /* the deltas are against these */
+} jsm_stats = {.fd = -1, .interval = 1000};
+
+#define JSM_MEMORY_FIELD(name, field) {name, offsetof(JSMemoryUsage, field)}
+
+static const struct {
+  const char* name;
+  size_t offset;
+} jsm_stats_memory_fields[] = {
+    JSM_MEMORY_FIELD("mallocSize", malloc_size),
+    JSM_MEMORY_FIELD("mallocCount", malloc_count),
+    JSM_MEMORY_FIELD("memoryUsedSize", memory_used_size),
+    JSM_MEMORY_FIELD("memoryUsedCount", memory_used_count),
+    JSM_MEMORY_FIELD("atomCount", atom_count),
+    JSM_MEMORY_FIELD("strCount", str_count),
+    JSM_MEMORY_FIELD("objCount", obj_count),
+    JSM_MEMORY_FIELD("propCount", prop_count),
+    JSM_MEMORY_FIELD("shapeCount", shape_count),
+    JSM_MEMORY_FIELD("jsFuncCount", js_func_count),
+    JSM_MEMORY_FIELD("cFuncCount", c_func_count),
+    JSM_MEMORY_FIELD("arrayCount", array_count),
+    JSM_MEMORY_FIELD("binaryObjectCount", binary_object_count),
+};
+
+static uint64_t
+jsm_stats_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Count the automatic GCs QuickJS ran since the last call
+ *
+ * After each one QuickJS moves the threshold to 1.5 times what is left, so a
+ * moved threshold means a collection, and the peak seen before it minus what
+ * is left is (at least) what it freed. Called from the interrupt handler and
+ * after each handler; it never collects itself, the GC runs as it would
+ * without --stats.
+ */
+static void
+jsm_stats_gc(JSRuntime* rt) {
+  size_t size = js_malloc_size(rt), threshold = js_gc_threshold(rt), peak, after;
+
+  if(threshold == jsm_stats.gc_threshold) {
+    jsm_stats.gc_peak = MAX_NUM(jsm_stats.gc_peak, size);
+    return;
+  }
+
+  /* it ran because the size went past the old threshold */
+  peak = MAX_NUM(jsm_stats.gc_peak, jsm_stats.gc_threshold);
+  after = threshold - threshold / 3;
+
+  jsm_stats.gc_runs++;
+  jsm_stats.gc_freed += peak > after ? peak - after : 0;
+  jsm_stats.gc_threshold = threshold;
+  jsm_stats.gc_peak = size;
+}
+
+/* run the jobs a handler queued right away, to see how many and how long */
+static void
+jsm_stats_jobs(JSContext* ctx) {
+  JSRuntime* rt = JS_GetRuntime(ctx);
+  JSContext* ctx1;
+  size_t depth;
+  uint64_t n = 0, t;
+  int ret;
+
+  if(!(depth = js_pending_jobs(rt)))
+    return;
+
+  t = jsm_stats_ns();
+
+  while((ret = JS_ExecutePendingJob(rt, &ctx1)) > 0)
+    n++;
+
+  jsm_stats.job_time += jsm_stats_ns() - t;
+
+  if(ret < 0)
+    js_std_dump_error(ctx1);
+
+  jsm_stats.jobs += n;
+  jsm_stats.drains++;
+  jsm_stats.max_depth = MAX_NUM(jsm_stats.max_depth, depth);
+  jsm_stats.max_drain = MAX_NUM(jsm_stats.max_drain, n);
+}
+
+static void
+jsm_stats_set(JSContext* ctx, JSValueConst obj, const char* name, uint64_t ns) {
+  JS_SetPropertyStr(ctx, obj, name, JS_NewFloat64(ctx, ns / 1e6));
+}
+
+/**
+ * @brief Everything counted so far, memory as it is now and its change since \param last
+ */
+static JSValue
+jsm_stats_object(JSContext* ctx, JSMemoryUsage* last) {
+  JSValue ret = JS_NewObject(ctx), mem, delta;
+  JSMemoryUsage usage;
+
+  jsm_stats_set(ctx, ret, "uptime", jsm_stats_ns() - jsm_stats.start);
+
+  if(jsm_stats.enabled) {
+    JSValue handlers = JS_NewArray(ctx), jobs = JS_NewObject(ctx), gc = JS_NewObject(ctx);
+
+    for(size_t i = 0; i < jsm_stats.nhandlers; i++) {
+      StatsHandler* h = &jsm_stats.handlers[i];
+      JSValue obj = JS_NewObject(ctx);
+
+      JS_SetPropertyStr(ctx, obj, "type", JS_NewString(ctx, h->type == 'r' ? "read" : h->type == 'w' ? "write" : "timer"));
+
+      if(h->type == 't')
+        JS_SetPropertyStr(ctx, obj, "name", JS_AtomToString(ctx, h->name));
+      else
+        JS_SetPropertyStr(ctx, obj, "fd", JS_NewInt32(ctx, h->fd));
+
+      JS_SetPropertyStr(ctx, obj, "count", JS_NewInt64(ctx, h->count));
+      jsm_stats_set(ctx, obj, "time", h->time);
+      jsm_stats_set(ctx, obj, "max", h->max);
+      JS_SetPropertyUint32(ctx, handlers, i, obj);
+    }
+
+    JS_SetPropertyStr(ctx, ret, "handlers", handlers);
+
+    JS_SetPropertyStr(ctx, jobs, "count", JS_NewInt64(ctx, jsm_stats.jobs));
+    jsm_stats_set(ctx, jobs, "time", jsm_stats.job_time);
+    JS_SetPropertyStr(ctx, jobs, "drains", JS_NewInt64(ctx, jsm_stats.drains));
+    JS_SetPropertyStr(ctx, jobs, "maxDepth", JS_NewInt64(ctx, jsm_stats.max_depth));
+    JS_SetPropertyStr(ctx, jobs, "maxDrain", JS_NewInt64(ctx, jsm_stats.max_drain));
+    JS_SetPropertyStr(ctx, jobs, "pending", JS_NewInt64(ctx, js_pending_jobs(JS_GetRuntime(ctx))));
+    JS_SetPropertyStr(ctx, ret, "jobs", jobs);
+
+    JS_SetPropertyStr(ctx, gc, "runs", JS_NewInt64(ctx, jsm_stats.gc_runs));
+    JS_SetPropertyStr(ctx, gc, "freed", JS_NewInt64(ctx, jsm_stats.gc_freed));
+    JS_SetPropertyStr(ctx, gc, "threshold", JS_NewInt64(ctx, jsm_stats.gc_threshold));
+    JS_SetPropertyStr(ctx, ret, "gc", gc);
+  }
+
+  JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &usage);
+
+  mem = JS_NewObject(ctx);
+  delta = JS_NewObject(ctx);
+
+  for(size_t i = 0; i < countof(jsm_stats_memory_fields); i++) {
+    size_t offset = jsm_stats_memory_fields[i].offset;
+    int64_t value = *(int64_t*)((uint8_t*)&usage + offset), prev = *(int64_t*)((uint8_t*)last + offset);
+
+    JS_SetPropertyStr(ctx, mem, jsm_stats_memory_fields[i].name, JS_NewInt64(ctx, value));
+    JS_SetPropertyStr(ctx, delta, jsm_stats_memory_fields[i].name, JS_NewInt64(ctx, value - prev));
+  }
+
+  *last = usage;
+
+  JS_SetPropertyStr(ctx, mem, "delta", delta);
+  JS_SetPropertyStr(ctx, ret, "memory", mem);
+  return ret;
+}
+
+static void
+jsm_stats_reset(void) {
+  for(size_t i = 0; i < jsm_stats.nhandlers; i++)
+    jsm_stats.handlers[i].count = jsm_stats.handlers[i].time = jsm_stats.handlers[i].max = 0;
+
+  jsm_stats.jobs = jsm_stats.job_time = jsm_stats.drains = jsm_stats.max_depth = jsm_stats.max_drain = 0;
+  jsm_stats.gc_runs = jsm_stats.gc_freed = 0;
+}
+
+/* one JSON object per line to the --stats-fd */
+static void
+jsm_stats_dump(JSContext* ctx) {
+  JSValue obj = jsm_stats_object(ctx, &jsm_stats.dump_memory);
+  JSValue json = JS_JSONStringify(ctx, obj, JS_UNDEFINED, JS_UNDEFINED);
+  const char* str;
+  size_t len;
+
+  if(JS_IsException(json))
+    JS_FreeValue(ctx, JS_GetException(ctx));
+  else if((str = JS_ToCStringLen(ctx, &len, json))) {
+    dprintf(jsm_stats.fd, "%.*s\n", (int)len, str);
+    JS_FreeCString(ctx, str);
+  }
+
+  JS_FreeValue(ctx, json);
+  JS_FreeValue(ctx, obj);
+
+  jsm_stats.next_dump = jsm_stats_ns() + jsm_stats.interval * 1000000;
+}
+
+static JSValue
+jsm_stats_dispatch(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  StatsHandler* h;
+  uint64_t t = jsm_stats_ns();
+  JSValue ret = JS_Call(ctx, data[0], this_val, argc, argv);
+
+  t = jsm_stats_ns() - t;
+
+  /* the handler may have set new ones, which can move the array */
+  h = &jsm_stats.handlers[magic];
+  h->count++;
+  h->time += t;
+  h->max = MAX_NUM(h->max, t);
+
+  /* an exception stays pending for the event loop to report */
+  if(!JS_IsException(ret)) {
+    jsm_stats_jobs(ctx);
+    jsm_stats_gc(JS_GetRuntime(ctx));
+
+    if(jsm_stats.fd != -1 && jsm_stats_ns() >= jsm_stats.next_dump)
+      jsm_stats_dump(ctx);
+  }
+
+  return ret;
+}
+
+static int
+jsm_stats_slot(JSContext* ctx, char type, int fd, JSAtom name) {
+  StatsHandler* h;
+
+  for(size_t i = 0; i < jsm_stats.nhandlers; i++) {
+    h = &jsm_stats.handlers[i];
+
+    if(h->type == type && h->fd == fd && h->name == name) {
+      JS_FreeAtom(ctx, name);
+      return i;
+    }
+  }
+
+  if(!(h = js_realloc(ctx, jsm_stats.handlers, (jsm_stats.nhandlers + 1) * sizeof(StatsHandler)))) {
+    JS_FreeAtom(ctx, name);
+    return -1;
+  }
+
+  jsm_stats.handlers = h;
+  h = &jsm_stats.handlers[jsm_stats.nhandlers];
+  memset(h, 0, sizeof(StatsHandler));
+  h->type = type;
+  h->fd = fd;
+  h->name = name;
+
+  return jsm_stats.nhandlers++;
+}
+
+/* replaces os.setReadHandler(fd, func), os.setWriteHandler(fd, func) and os.setTimeout(func, delay) */
+static JSValue
+jsm_stats_set_handler(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[], int magic, JSValue data[]) {
+  JSValueConst* args = alloca(sizeof(JSValueConst) * argc);
+  JSValue func = JS_UNDEFINED, ret;
+  int index = magic == 't' ? 0 : 1, slot;
+
+  memcpy(args, argv, sizeof(JSValueConst) * argc);
+
+  if(index < argc && JS_IsFunction(ctx, argv[index])) {
+    JSAtom name = JS_ATOM_NULL;
+    int32_t fd = -1;
+
+    if(magic == 't') {
+      JSValue value = JS_GetPropertyStr(ctx, argv[index], "name");
+
+      name = JS_ValueToAtom(ctx, value);
+      JS_FreeValue(ctx, value);
+    } else if(JS_ToInt32(ctx, &fd, argv[0])) {
+      return JS_EXCEPTION;
+    }
+
+    if((slot = jsm_stats_slot(ctx, magic, fd, name)) == -1)
+      return JS_EXCEPTION;
+
+    args[index] = func = JS_NewCFunctionData(ctx, jsm_stats_dispatch, 0, slot, 1, &argv[index]);
+  }
+
+  ret = JS_Call(ctx, data[0], this_val, argc, args);
+  JS_FreeValue(ctx, func);
+  return ret;
+}
+
+/**
+ * @brief Start counting: wrap the handler setters of the 'os' module
+ *
+ * Must run before anything imports from 'os' and copies the setters.
+ *
+ * @return  -1 if the 'os' module could not be loaded
+ */
+static int
+jsm_stats_init(JSContext* ctx) {
+  static const struct {
+    const char* name;
+    char type;
+  } setters[] = {
+      {"setReadHandler", 'r'},
+      {"setWriteHandler", 'w'},
+      {"setTimeout", 't'},
+      {"setInterval", 't'},
+  };
+  JSModuleDef* m;
+  JSValue ns;
+
+  if(js_eval_str(ctx, "import 'os';\n", "<stats>", JS_EVAL_TYPE_MODULE) || !(m = jsm_module_find(ctx, "os", 0)))
+    return -1;
+
+  ns = JS_GetModuleNamespace(ctx, m);
+
+  for(size_t i = 0; i < countof(setters); i++) {
+    JSValue func = JS_GetPropertyStr(ctx, ns, setters[i].name);
+
+    if(JS_IsFunction(ctx, func))
+      JS_SetModuleExport(ctx, m, setters[i].name, JS_NewCFunctionData(ctx, jsm_stats_set_handler, 2, setters[i].type, 1, &func));
+
+    JS_FreeValue(ctx, func);
+  }
+
+  JS_FreeValue(ctx, ns);
+
+  jsm_stats.gc_threshold = js_gc_threshold(JS_GetRuntime(ctx));
+  jsm_stats.gc_peak = js_malloc_size(JS_GetRuntime(ctx));
+
+  JS_ComputeMemoryUsage(JS_GetRuntime(ctx), &jsm_stats.dump_memory);
+  jsm_stats.call_memory = jsm_stats.dump_memory;
+
+  jsm_stats.next_dump = jsm_stats_ns() + jsm_stats.interval * 1000000;
+  jsm_stats.enabled = TRUE;
+  return 0;
+}
+
+static void
+jsm_stats_free(JSContext* ctx) {
+  for(size_t i = 0; i < jsm_stats.nhandlers; i++)
+    JS_FreeAtom(ctx, jsm_stats.handlers[i].name);
+
+  js_free(ctx, jsm_stats.handlers);
+  jsm_stats.handlers = 0;
+  jsm_stats.nhandlers = 0;
+  jsm_stats.enabled = FALSE;
+}
+
+/**
+ * @brief getRuntimeStats([reset])
+ *
+ * 'handlers', 'jobs' and 'gc' are only there when qjsm runs with --stats,
+ * memory.delta is the change since the previous call.
+ */
+static JSValue
+jsm_get_runtime_stats(JSContext* ctx, JSValueConst this_val, int argc, JSValueConst argv[]) {
+  JSValue ret = jsm_stats_object(ctx, &jsm_stats.call_memory);
+
+  if(argc > 0 && JS_ToBool(ctx, argv[0]))
+    jsm_stats_reset();
+
+  return ret;
+}
+
 static const JSCFunctionListEntry jsm_global_funcs[] = {
     JS_CFUNC_MAGIC_DEF("evalFile", 1, jsm_eval_script, EVAL_FILE),
     JS_CFUNC_MAGIC_DEF("evalBuf", 1, jsm_eval_script, EVAL_BUF),
@@ -1824,6 +2545,7 @@ static const JSCFunctionListEntry jsm_global_funcs[] = {
     JS_CFUNC_MAGIC_DEF("getModuleFunction", 1, jsm_module_func, GET_MODULE_FUNCTION),
     JS_CFUNC_MAGIC_DEF("getModuleException", 1, jsm_module_func, GET_MODULE_EXCEPTION),
     JS_CFUNC_MAGIC_DEF("getModuleMetaObject", 1, jsm_module_func, GET_MODULE_META_OBJ),
+    JS_CFUNC_DEF("getRuntimeStats", 0, jsm_get_runtime_stats),
     JS_CFUNC_DEF("startInteractive", 0, jsm_start_interactive4),
 };
 
@@ -1880,15 +2602,90 @@ int
 jsm_interrupt_handler(JSRuntime* rt, void* opaque) {
   /*JSContext* ctx = opaque;*/
 
+  if(jsm_stats.enabled)
+    jsm_stats_gc(rt);
+
   return 0;
 }
 
+/**
+ * @brief Evaluate one of the built-in prelude modules, from the startup image if it holds it
+ *
+ * @return  -1 on exception (left pending), 0 otherwise
+ */
+static int
+jsm_eval_prelude(JSContext* ctx, const char* name, const char* source) {
+  JSValue func = JS_UNDEFINED, ret;
+
+  if(module_image)
+    func = module_image_read(ctx, module_image, name);
+
+  if(JS_IsUndefined(func)) {
+    func = JS_Eval(ctx, source, strlen(source), name, JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_COMPILE_ONLY);
+
+    if(image_save && module_image && !JS_IsException(func))
+      module_image_add(ctx, module_image, name, func);
+  }
+
+  if(JS_IsException(func))
+    return -1;
+
+  if(JS_ResolveModule(ctx, func) < 0) {
+    JS_FreeValue(ctx, func);
+    return -1;
+  }
+
+  js_module_set_import_meta(ctx, func, FALSE, FALSE);
+
+  ret = JS_EvalFunction(ctx, func);
+
+  if(JS_IsException(ret))
+    return -1;
+
+  JS_FreeValue(ctx, ret);
+  return 0;
+}
+
+/**
+ * @brief Load the startup image \param file, if it was saved in the current directory
+ *
+ * Its module resolutions are put into the path cache, as long as the
+ * files they resolved to are still there.
+ */
+static void
+jsm_image_load(const char* file) {
+  PathCache* pc;
+
+  module_image_init(&startup_image, CONFIG_VERSION);
+  module_image = &startup_image;
+
+  if(module_image_load(&startup_image, file) == -1)
+    return;
+
+  if((pc = jsm_path_cache()))
+    for(size_t i = 0; i < startup_image.nresolutions; i++) {
+      char** r = &startup_image.resolutions[i * 3];
+
+      if(!has_dot_or_slash(r[2]) || jsm_isfile(r[2]))
+        path_cache_put(pc, 'n', r[0], r[1], r[2]);
+    }
+
+  if(debug_module_loader >= 1)
+    printf("startup image: %zu modules, %zu resolutions\n", startup_image.nmodules, startup_image.nresolutions);
+}
+
 int
 main(int argc, char** argv) {
   struct trace_malloc_data trace_data = {0};
   int optind;
   char *expr = 0, dump_memory = 0, trace_memory = 0, empty_run = 0, module = 1, load_std = 1,
-       dump_unhandled_promise_rejection = 0;
+       dump_unhandled_promise_rejection = 0, clear_cache = 0;
+  const char *cache_dir = 0, *image_file = 0, *alloc_trace_file = 0;
+  int cache_mode = -1;
+  uint64_t alloc_sample = 0;
+  AllocTrace* alloc_trace = 0;
+  SizeAlloc* slab_alloc = 0;
+  BOOL slab_memory = FALSE, stats = FALSE;
   const char* include_list[32];
   size_t /*i,*/ memory_limit = 0, include_count = 0, stack_size = 0;
 #ifdef HAVE_QJSCALC
@@ -1896,6 +2693,7 @@ main(int argc, char** argv) {
 #endif
 
   package_json = JS_UNDEFINED;
+  jsm_stats.start = jsm_stats_ns();
   // replObj = JS_UNDEFINED;
 
   exename = strdup(argv[0] + path_basename1(argv[0]));
@@ -2004,6 +2802,57 @@ main(int argc, char** argv) {
         break;
       }
 
+      if(!strcmp(longopt, "alloc-trace")) {
+        if(optind >= argc) {
+          fprintf(stderr, "expecting trace file");
+          exit(1);
+        }
+
+        alloc_trace_file = argv[optind++];
+        break;
+      }
+
+      if(!strcmp(longopt, "alloc-sample")) {
+        if(optind >= argc) {
+          fprintf(stderr, "expecting sample interval");
+          exit(1);
+        }
+
+        alloc_sample = (uint64_t)strtod(argv[optind++], 0);
+        break;
+      }
+
+      if(!strcmp(longopt, "slab-alloc")) {
+        slab_memory = TRUE;
+        break;
+      }
+
+      if(!strcmp(longopt, "stats")) {
+        stats = TRUE;
+        break;
+      }
+
+      if(!strcmp(longopt, "stats-fd")) {
+        if(optind >= argc) {
+          fprintf(stderr, "expecting file descriptor");
+          exit(1);
+        }
+
+        jsm_stats.fd = atoi(argv[optind++]);
+        stats = TRUE;
+        break;
+      }
+
+      if(!strcmp(longopt, "stats-interval")) {
+        if(optind >= argc) {
+          fprintf(stderr, "expecting interval");
+          exit(1);
+        }
+
+        jsm_stats.interval = (uint64_t)strtod(argv[optind++], 0);
+        break;
+      }
+
       if(!strcmp(longopt, "std")) {
         load_std = 1;
         break;
@@ -2046,6 +2895,55 @@ main(int argc, char** argv) {
         break;
       }
 
+      if(!strcmp(longopt, "cache")) {
+        if(optind >= argc || (cache_mode = module_cache_mode(argv[optind++])) == -1) {
+          fprintf(stderr, "expecting cache mode (off, mtime or hash)");
+          exit(1);
+        }
+
+        break;
+      }
+
+      if(!strcmp(longopt, "cache-dir")) {
+        if(optind >= argc) {
+          fprintf(stderr, "expecting cache directory");
+          exit(1);
+        }
+
+        cache_dir = argv[optind++];
+        break;
+      }
+
+      if(!strcmp(longopt, "clear-cache")) {
+        clear_cache = 1;
+        break;
+      }
+
+      if(!strcmp(longopt, "no-resolve-cache")) {
+        resolve_cache = FALSE;
+        break;
+      }
+
+      if(!strcmp(longopt, "watch-modules")) {
+        watch_modules = TRUE;
+        break;
+      }
+
+      if(!strcmp(longopt, "image")) {
+        if(optind >= argc) {
+          fprintf(stderr, "expecting image file");
+          exit(1);
+        }
+
+        image_file = argv[optind++];
+        break;
+      }
+
+      if(!strcmp(longopt, "save-image")) {
+        image_save = TRUE;
+        break;
+      }
+
       if(!strcmp(longopt, "stack-size")) {
         if(optind >= argc) {
           fprintf(stderr, "expecting stack size");
@@ -2068,6 +2966,33 @@ main(int argc, char** argv) {
     optind++;
   }
 
+  {
+    const char* str;
+    char* dir = 0;
+
+    if(cache_mode == -1 && (!(str = getenv("QJSM_CACHE")) || (cache_mode = module_cache_mode(str)) == -1))
+      cache_mode = MODULE_CACHE_MTIME;
+
+    if(!cache_dir && !(cache_dir = getenv("QJSM_CACHE_DIR")))
+      cache_dir = dir = module_cache_default_dir();
+
+    module_cache_init(&module_cache, cache_dir, cache_mode, CONFIG_VERSION);
+
+    if(clear_cache)
+      module_cache_clear(&module_cache);
+
+    if(dir)
+      free(dir);
+
+    if(!image_file)
+      image_file = getenv("QJSM_IMAGE");
+
+    if(image_file)
+      jsm_image_load(image_file);
+    else
+      image_save = FALSE;
+  }
+
   jsm_init_modules(jsm_ctx);
 
 #ifdef HAVE_GET_MODULE_LOADER_FUNC
@@ -2097,9 +3022,26 @@ main(int argc, char** argv) {
     bignum_ext = 1;
 #endif
 
-  if(trace_memory) {
+  if(alloc_trace_file || alloc_sample) {
+    if(!alloc_trace_file)
+      alloc_trace_file = "qjsm.alloc-trace";
+
+    if(!(alloc_trace = alloc_trace_open(alloc_trace_file,
+                                        alloc_sample ? ALLOC_TRACE_FREES : ALLOC_TRACE_EVENTS,
+                                        alloc_sample,
+                                        jsm_alloc_trace_stack,
+                                        0))) {
+      fprintf(stderr, "%s: cannot create '%s': %s\n", exename, alloc_trace_file, strerror(errno));
+      exit(1);
+    }
+
+    alloc_trace_mf.js_malloc_usable_size = trace_mf.js_malloc_usable_size;
+    jsm_rt = JS_NewRuntime2(&alloc_trace_mf, alloc_trace);
+  } else if(trace_memory) {
     jsm_trace_malloc_init(&trace_data);
     jsm_rt = JS_NewRuntime2(&trace_mf, &trace_data);
+  } else if(slab_memory && (slab_alloc = size_alloc_new())) {
+    jsm_rt = JS_NewRuntime2(&slab_mf, slab_alloc);
   } else {
     jsm_rt = JS_NewRuntime();
   }
@@ -2116,6 +3058,8 @@ main(int argc, char** argv) {
     JS_SetMaxStackSize(jsm_rt, stack_size);
 
   js_std_set_worker_new_context_func(jsm_context_new);
+  js_thread_context_new = jsm_thread_context_new;
+  js_thread_context_free = jsm_thread_context_free;
 
   js_std_init_handlers(jsm_rt);
 
@@ -2155,6 +3099,11 @@ main(int argc, char** argv) {
 
     JS_SetPropertyFunctionList(jsm_ctx, JS_GetGlobalObject(jsm_ctx), jsm_global_funcs, countof(jsm_global_funcs));
 
+    if(stats && jsm_stats_init(jsm_ctx) == -1) {
+      jsm_dump_error(jsm_ctx);
+      goto fail;
+    }
+
     if(load_std) {
       const char* str = "import * as std from 'std';\nimport * as os from 'os';\nglobalThis.std = "
                         "std;\nglobalThis.os = os;\nglobalThis.setTimeout = "
@@ -2167,7 +3116,7 @@ main(int argc, char** argv) {
 
     if(db.size) {
       dbuf_0(&db);
-      js_eval_str(jsm_ctx, (const char*)db.buf, 0, JS_EVAL_TYPE_MODULE);
+      jsm_eval_prelude(jsm_ctx, load_std ? "<prelude:std>" : "<prelude>", (const char*)db.buf);
     }
 
     dbuf_free(&db);
@@ -2192,12 +3141,11 @@ main(int argc, char** argv) {
         goto fail;
     }
 
-    js_eval_str(jsm_ctx,
-                "import { Console } from 'console';\n"
-                "import { out } from 'std';\n"
-                "globalThis.console = new Console(out, { inspectOptions: { customInspect: true } });\n",
-                0,
-                JS_EVAL_TYPE_MODULE);
+    jsm_eval_prelude(jsm_ctx,
+                     "<console>",
+                     "import { Console } from 'console';\n"
+                     "import { out } from 'std';\n"
+                     "globalThis.console = new Console(out, { inspectOptions: { customInspect: true } });\n");
 
     if(!interactive) {
 #ifndef _WIN32
@@ -2229,6 +3177,9 @@ main(int argc, char** argv) {
       jsm_start_interactive(jsm_ctx, TRUE);
 
     js_std_loop(jsm_ctx);
+
+    if(jsm_stats.enabled && jsm_stats.fd != -1)
+      jsm_stats_dump(jsm_ctx);
   }
 
   JSValue exception = JS_GetException(jsm_ctx);
@@ -2241,14 +3192,50 @@ main(int argc, char** argv) {
 
     JS_ComputeMemoryUsage(jsm_rt, &stats);
     JS_DumpMemoryUsage(stdout, &stats, jsm_rt);
+
+    if(slab_alloc) {
+      SizeAllocStats st;
+
+      size_alloc_stats(slab_alloc, &st);
+      printf("slab allocator: %zu blocks, %zu bytes in %zu slabs, %zu arenas, %zu arena resets\n",
+             st.blocks,
+             st.block_bytes,
+             st.slabs,
+             st.arenas,
+             st.resets);
+    }
   }
 
   JS_FreeValue(jsm_ctx, sargs);
 
   js_std_free_handlers(jsm_rt);
+  jsm_stats_free(jsm_ctx);
   JS_FreeContext(jsm_ctx);
   JS_FreeRuntime(jsm_rt);
 
+  if(alloc_trace)
+    alloc_trace_close(alloc_trace);
+
+  if(slab_alloc)
+    size_alloc_destroy(slab_alloc);
+
+  if(module_image) {
+    if(image_save && module_image_save(module_image, image_file))
+      fprintf(stderr, "%s: could not write startup image '%s'\n", exename, image_file);
+
+    module_image_free(module_image);
+    module_image = 0;
+  }
+
+  module_cache_free(&module_cache);
+
+  if(path_cache_ready) {
+    if(debug_module_loader >= 1)
+      printf("path cache: %" PRIu32 " hits, %" PRIu32 " misses\n", path_cache.hits, path_cache.misses);
+
+    path_cache_free(&path_cache);
+  }
+
   if(empty_run && dump_memory) {
     clock_t t[5];
     double best[5];
@@ -2282,7 +3269,15 @@ main(int argc, char** argv) {
   return 0;
 fail:
   js_std_free_handlers(jsm_rt);
+  jsm_stats_free(jsm_ctx);
   JS_FreeContext(jsm_ctx);
   JS_FreeRuntime(jsm_rt);
+
+  if(alloc_trace)
+    alloc_trace_close(alloc_trace);
+
+  if(slab_alloc)
+    size_alloc_destroy(slab_alloc);
+
   return 1;
 }
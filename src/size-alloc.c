@@ -0,0 +1,311 @@
+#include "size-alloc.h"
+#include "defines.h"
+#include <cutils.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/**
+ * \addtogroup size-alloc
+ * @{
+ */
+
+#define SLAB_SHIFT 16
+#define SLAB_SIZE (1 << SLAB_SHIFT)
+#define SLAB_HEADER 64 /* blocks start here, keeps every class 16-byte aligned */
+#define ARENA_SHIFT 22
+#define ARENA_SIZE (1 << ARENA_SHIFT)
+#define ARENA_SLABS (ARENA_SIZE / SLAB_SIZE)
+
+#define SIZE_CLASSES countof(size_classes)
+
+static const uint16_t size_classes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024,
+};
+
+typedef struct size_arena SizeArena;
+typedef struct size_slab SizeSlab;
+
+struct size_slab {
+  SizeSlab *next, *prev; /* in the list of slabs with free blocks of its class */
+  SizeArena* arena;
+  void* free;
+  uint32_t size;
+  uint16_t cls;
+  uint16_t used, bump, capacity;
+};
+
+struct size_arena {
+  SizeArena* next;
+  uint8_t* base;
+  SizeSlab* free; /* empty slabs, linked through next */
+  uint32_t bump;  /* slabs carved */
+  uint32_t live;  /* slabs holding blocks */
+};
+
+struct size_alloc {
+  SizeSlab* classes[SIZE_CLASSES];
+  SizeArena *arenas, *current;
+  SizeAllocStats stats;
+};
+
+/* size class of (size + 15) / 16 */
+static uint8_t size_class_of[SIZE_ALLOC_MAX / 16 + 1];
+
+/* all arenas of all allocators come from this range, so a block is recognized by its address */
+static uint8_t* size_region;
+static size_t size_region_size, size_region_next;
+
+static BOOL
+size_alloc_init(void) {
+#ifndef _WIN32
+  size_t size = sizeof(void*) == 8 ? (size_t)1 << 36 : (size_t)1 << 28;
+  uint8_t* p = MAP_FAILED;
+  uint32_t cls = 0;
+
+  if(size_region)
+    return TRUE;
+
+  for(uint32_t i = 0; i < countof(size_class_of); i++) {
+    if(i * 16 > size_classes[cls])
+      cls++;
+
+    size_class_of[i] = cls;
+  }
+
+  /* address space only, arenas are made accessible when they are handed out */
+  for(; size >= 16 * ARENA_SIZE; size >>= 1)
+    if((p = mmap(0, size + ARENA_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) != MAP_FAILED)
+      break;
+
+  if(p == MAP_FAILED)
+    return FALSE;
+
+  size_region = (uint8_t*)(((uintptr_t)p + ARENA_SIZE - 1) & ~(uintptr_t)(ARENA_SIZE - 1));
+  size_region_size = size;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * @brief Create an allocator
+ *
+ * @return  the allocator, NULL if the address range could not be reserved
+ */
+SizeAlloc*
+size_alloc_new(void) {
+  if(!size_alloc_init())
+    return 0;
+
+  return calloc(1, sizeof(SizeAlloc));
+}
+
+static SizeArena*
+size_arena_new(SizeAlloc* a) {
+#ifndef _WIN32
+  size_t index = __atomic_fetch_add(&size_region_next, 1, __ATOMIC_RELAXED);
+  SizeArena* arena;
+
+  if(index >= size_region_size / ARENA_SIZE)
+    return 0;
+
+  if(!(arena = calloc(1, sizeof(SizeArena))))
+    return 0;
+
+  arena->base = size_region + index * ARENA_SIZE;
+
+  if(mprotect(arena->base, ARENA_SIZE, PROT_READ | PROT_WRITE)) {
+    free(arena);
+    return 0;
+  }
+
+  arena->next = a->arenas;
+  a->arenas = arena;
+  a->stats.arenas++;
+  return arena;
+#else
+  return 0;
+#endif
+}
+
+static SizeSlab*
+size_slab_new(SizeAlloc* a, uint32_t cls) {
+  SizeArena* arena = a->current;
+  SizeSlab* slab;
+
+  if(!arena || (!arena->free && arena->bump == ARENA_SLABS)) {
+    for(arena = a->arenas; arena; arena = arena->next)
+      if(arena->free || arena->bump < ARENA_SLABS)
+        break;
+
+    if(!arena && !(arena = size_arena_new(a)))
+      return 0;
+
+    a->current = arena;
+  }
+
+  if((slab = arena->free))
+    arena->free = slab->next;
+  else
+    slab = (SizeSlab*)(arena->base + (size_t)arena->bump++ * SLAB_SIZE);
+
+  arena->live++;
+  a->stats.slabs++;
+
+  slab->next = slab->prev = 0;
+  slab->arena = arena;
+  slab->free = 0;
+  slab->size = size_classes[cls];
+  slab->cls = cls;
+  slab->used = slab->bump = 0;
+  slab->capacity = (SLAB_SIZE - SLAB_HEADER) / slab->size;
+
+  a->classes[cls] = slab;
+  return slab;
+}
+
+static void
+size_slab_unlink(SizeAlloc* a, SizeSlab* slab) {
+  if(slab->prev)
+    slab->prev->next = slab->next;
+  else
+    a->classes[slab->cls] = slab->next;
+
+  if(slab->next)
+    slab->next->prev = slab->prev;
+
+  slab->next = slab->prev = 0;
+}
+
+static void
+size_slab_release(SizeAlloc* a, SizeSlab* slab) {
+  SizeArena* arena = slab->arena;
+
+  size_slab_unlink(a, slab);
+  slab->next = arena->free;
+  arena->free = slab;
+  a->stats.slabs--;
+
+  /* start over with an arena everything was freed from, unless it is the one slabs are taken from */
+  if(--arena->live == 0 && arena != a->current) {
+#ifndef _WIN32
+    madvise(arena->base, ARENA_SIZE, MADV_DONTNEED);
+#endif
+    arena->free = 0;
+    arena->bump = 0;
+    a->stats.resets++;
+  }
+}
+
+/**
+ * @brief Allocate \param size bytes from a slab
+ *
+ * @return  the block, NULL if size > SIZE_ALLOC_MAX or no slab could be made
+ */
+void*
+size_alloc_malloc(SizeAlloc* a, size_t size) {
+  uint32_t cls;
+  SizeSlab* slab;
+  void* ptr;
+
+  if(size > SIZE_ALLOC_MAX)
+    return 0;
+
+  cls = size_class_of[(size + 15) >> 4];
+
+  if(!(slab = a->classes[cls]) && !(slab = size_slab_new(a, cls)))
+    return 0;
+
+  if((ptr = slab->free))
+    slab->free = *(void**)ptr;
+  else
+    ptr = (uint8_t*)slab + SLAB_HEADER + (size_t)slab->bump++ * slab->size;
+
+  if(++slab->used == slab->capacity)
+    size_slab_unlink(a, slab);
+
+  a->stats.blocks++;
+  a->stats.block_bytes += slab->size;
+  return ptr;
+}
+
+/**
+ * @brief Return a block obtained from size_alloc_malloc()
+ */
+void
+size_alloc_free(SizeAlloc* a, void* ptr) {
+  SizeSlab* slab = (SizeSlab*)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+
+  *(void**)ptr = slab->free;
+  slab->free = ptr;
+
+  a->stats.blocks--;
+  a->stats.block_bytes -= slab->size;
+
+  /* was full, has room again */
+  if(slab->used-- == slab->capacity) {
+    if((slab->next = a->classes[slab->cls]))
+      slab->next->prev = slab;
+
+    a->classes[slab->cls] = slab;
+  }
+
+  /* keep the last slab of a class around, it would only be made again */
+  if(slab->used == 0 && (slab->next || slab->prev))
+    size_slab_release(a, slab);
+}
+
+/**
+ * @brief Size of the block at \param ptr
+ *
+ * @return  the size class of the block, 0 if ptr was not allocated from a slab
+ */
+size_t
+size_alloc_usable_size(const void* ptr) {
+  if((uintptr_t)ptr - (uintptr_t)size_region >= size_region_size)
+    return 0;
+
+  return ((const SizeSlab*)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1)))->size;
+}
+
+/**
+ * @brief Bytes size_alloc_malloc() would take for \param size
+ *
+ * @return  the size class, 0 if size > SIZE_ALLOC_MAX
+ */
+size_t
+size_alloc_class_size(size_t size) {
+  return size <= SIZE_ALLOC_MAX ? size_classes[size_class_of[(size + 15) >> 4]] : 0;
+}
+
+void
+size_alloc_stats(const SizeAlloc* a, SizeAllocStats* st) {
+  *st = a->stats;
+}
+
+/**
+ * @brief Give back all arenas of the allocator, whether blocks are still in use or not
+ */
+void
+size_alloc_destroy(SizeAlloc* a) {
+  SizeArena *arena, *next;
+
+  for(arena = a->arenas; arena; arena = next) {
+    next = arena->next;
+#ifndef _WIN32
+    /* the address range stays reserved, arenas are not handed out twice */
+    mmap(arena->base, ARENA_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+#endif
+    free(arena);
+  }
+
+  free(a);
+}
+
+/**
+ * @}
+ */
@@ -1,13 +1,19 @@
+#define _GNU_SOURCE 1
 #include "stream-utils.h"
 #include "buffer-utils.h"
 #include "defines.h"
 
 #include <assert.h>
+#include <errno.h>
 #ifdef _WIN32
 #include <io.h>
 #else
 #include <unistd.h>
 #endif
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #define RESULT(r, acc) \
   do { \
@@ -160,6 +166,43 @@ read_range(intptr_t p, void* buf, size_t len, struct StreamReader* rd) {
   return len;
 }
 
+#ifdef HAVE_MMAP
+static ssize_t
+read_mapwindow(intptr_t p, void* buf, size_t len, struct StreamReader* rd) {
+  MappedWindow* mw = (MappedWindow*)p;
+  uint8_t* ptr;
+  size_t avail;
+
+  if(!(ptr = mapwindow_at(mw, mw->pos, 0, &avail)))
+    return avail ? READER_ERROR : 0;
+
+  if(len > avail)
+    len = avail;
+
+  memcpy(buf, ptr, len);
+  mw->pos += len;
+  return len;
+}
+
+static ssize_t
+write_mapwindow(intptr_t p, const void* buf, size_t len, Writer* wr) {
+  MappedWindow* mw = (MappedWindow*)p;
+  uint8_t* ptr;
+  size_t avail;
+
+  if(!(ptr = mapwindow_at(mw, mw->pos, len, &avail)))
+    return -1;
+
+  memcpy(ptr, buf, len);
+  mw->pos += len;
+
+  if(mw->pos > mw->end)
+    mw->end = mw->pos;
+
+  return len;
+}
+#endif
+
 /**
  * \addtogroup stream-utils
  * @{
@@ -284,6 +327,180 @@ reader_free(Reader* rd) {
     rd->finalizer(rd->opaque, rd->opaque2);
 }
 
+#ifdef HAVE_MMAP
+/* largest offset mmap() and ftruncate() take, off_t may only have 32 bits */
+#define MAPWINDOW_OFF_MAX ((((uint64_t)1 << (sizeof(off_t) * 8 - 2)) - 1) * 2 + 1)
+
+static inline size_t
+mapwindow_round(MappedWindow* mw, size_t n) {
+  return (n + mw->page - 1) / mw->page * mw->page;
+}
+
+int
+mapwindow_init(MappedWindow* mw, int fd, size_t window, bool writable, bool close_on_end) {
+  struct stat st;
+
+  if(fstat(fd, &st) == -1)
+    return -1;
+
+  memset(mw, 0, sizeof(MappedWindow));
+  mw->fd = fd;
+  mw->writable = writable;
+  mw->close_on_end = close_on_end;
+  mw->page = sysconf(_SC_PAGESIZE);
+  mw->window = mapwindow_round(mw, window ? window : 1 << 24);
+  mw->end = mw->length = st.st_size;
+  return 0;
+}
+
+/* re-reads the file length so readers can follow a growing file */
+int
+mapwindow_refresh(MappedWindow* mw) {
+  struct stat st;
+
+  if(fstat(mw->fd, &st) == -1) {
+    mw->syscall = "fstat";
+    return -1;
+  }
+
+  if((uint64_t)st.st_size > mw->length)
+    mw->length = st.st_size;
+
+  return 0;
+}
+
+static int
+mapwindow_map(MappedWindow* mw, uint64_t start, size_t size) {
+  void* ptr = MAP_FAILED;
+  int prot = PROT_READ | (mw->writable ? PROT_WRITE : 0);
+
+  if(mw->base && start == mw->start && size == mw->size)
+    return 0;
+
+  /* would be truncated when passed as off_t */
+  if(size > MAPWINDOW_OFF_MAX || start > MAPWINDOW_OFF_MAX - size) {
+    mw->syscall = "mmap";
+    errno = EOVERFLOW;
+    return -1;
+  }
+
+#ifdef HAVE_MREMAP
+  if(mw->base && start == mw->start)
+    ptr = mremap(mw->base, mw->size, size, MREMAP_MAYMOVE);
+#endif
+
+  if(ptr == MAP_FAILED) {
+    if(mw->base)
+      munmap(mw->base, mw->size);
+
+    mw->base = 0;
+    mw->size = 0;
+
+    if((ptr = mmap(0, size, prot, MAP_SHARED, mw->fd, start)) == MAP_FAILED) {
+      mw->syscall = "mmap";
+      return -1;
+    }
+  }
+
+  mw->base = ptr;
+  mw->start = start;
+  mw->size = size;
+  return 0;
+}
+
+/**
+ * @brief      Makes sure pos is mapped and returns a pointer to it
+ *
+ * @param      mw     MappedWindow struct
+ * @param      pos    absolute file offset
+ * @param      need   bytes which must be contiguous at pos (writers only)
+ * @param      avail  receives the number of contiguous bytes at pos
+ *
+ * @return     pointer into the mapping, NULL on EOF (*avail == 0) or error
+ */
+uint8_t*
+mapwindow_at(MappedWindow* mw, uint64_t pos, size_t need, size_t* avail) {
+  uint64_t start = pos - pos % mw->page;
+  size_t size = MAX_NUM(mw->window, mapwindow_round(mw, pos - start + need));
+
+  *avail = 0;
+
+  if(mw->base && pos >= mw->start && pos + need <= mw->start + mw->size && pos < mw->start + mw->size) {
+    if(mw->writable || pos < mw->length) {
+      *avail = MIN_NUM(mw->start + mw->size, mw->writable ? UINT64_MAX : mw->length) - pos;
+      return mw->base + (pos - mw->start);
+    }
+  }
+
+  if(!mw->writable) {
+    if(pos >= mw->length)
+      if(mapwindow_refresh(mw) == -1 || pos >= mw->length)
+        return 0;
+
+    size = MIN_NUM(size, mapwindow_round(mw, mw->length - start));
+  } else if(start + size > mw->length) {
+    if(start + size > MAPWINDOW_OFF_MAX) {
+      mw->syscall = "ftruncate";
+      errno = EFBIG;
+      *avail = 1;
+      return 0;
+    }
+
+    if(ftruncate(mw->fd, start + size) == -1) {
+      mw->syscall = "ftruncate";
+      *avail = 1;
+      return 0;
+    }
+
+    mw->length = start + size;
+  }
+
+  if(mapwindow_map(mw, start, size) == -1) {
+    *avail = 1;
+    return 0;
+  }
+
+  *avail = MIN_NUM(start + size, mw->writable ? UINT64_MAX : mw->length) - pos;
+  return mw->base + (pos - start);
+}
+
+void
+mapwindow_free(MappedWindow* mw) {
+  if(mw->base)
+    munmap(mw->base, mw->size);
+
+  mw->base = 0;
+
+  if(mw->writable && mw->length > mw->end)
+    if(ftruncate(mw->fd, mw->end) == 0)
+      mw->length = mw->end;
+
+  if(mw->close_on_end && mw->fd >= 0)
+    close(mw->fd);
+
+  mw->fd = -1;
+}
+
+Reader
+reader_from_mapwindow(MappedWindow* mw) {
+  return (Reader){
+      &read_mapwindow,
+      mw,
+      NULL,
+      NULL,
+  };
+}
+
+Writer
+writer_from_mapwindow(MappedWindow* mw) {
+  return (Writer){
+      &write_mapwindow,
+      mw,
+      NULL,
+  };
+}
+#endif
+
 ssize_t
 transform_urldecode(Reader* rd, Writer* wr) {
   int c;
@@ -0,0 +1,466 @@
+#include "utf-utils.h"
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define UTF_NEON 1
+#endif
+
+#define SWAP16(x) ((uint16_t)(((x) >> 8) | ((x) << 8)))
+#define SWAP32(x) ((((x) >> 24) & 0xff) | (((x) >> 8) & 0xff00) | (((x) << 8) & 0xff0000) | ((x) << 24))
+
+static inline size_t
+utf8_encode(uint8_t* out, uint32_t cp) {
+  if(cp < 0x80) {
+    out[0] = cp;
+    return 1;
+  }
+
+  if(cp < 0x800) {
+    out[0] = 0xc0 | (cp >> 6);
+    out[1] = 0x80 | (cp & 0x3f);
+    return 2;
+  }
+
+  if(cp < 0x10000) {
+    out[0] = 0xe0 | (cp >> 12);
+    out[1] = 0x80 | ((cp >> 6) & 0x3f);
+    out[2] = 0x80 | (cp & 0x3f);
+    return 3;
+  }
+
+  out[0] = 0xf0 | (cp >> 18);
+  out[1] = 0x80 | ((cp >> 12) & 0x3f);
+  out[2] = 0x80 | ((cp >> 6) & 0x3f);
+  out[3] = 0x80 | (cp & 0x3f);
+  return 4;
+}
+
+/**
+ * \addtogroup utf-utils
+ * @{
+ */
+
+/**
+ * @brief      Length of the leading run of 7-bit characters
+ */
+size_t
+utf_ascii_prefix(const uint8_t* s, size_t n) {
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  for(; i + 32 <= n; i += 32) {
+    int mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(s + i)));
+
+    if(mask)
+      return i + __builtin_ctz(mask);
+  }
+#endif
+#if defined(__SSE2__)
+  for(; i + 16 <= n; i += 16) {
+    int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i)));
+
+    if(mask)
+      return i + __builtin_ctz(mask);
+  }
+#elif defined(UTF_NEON)
+  for(; i + 16 <= n; i += 16)
+    if(vmaxvq_u8(vld1q_u8(s + i)) >= 0x80)
+      break;
+#else
+  for(; i + 8 <= n; i += 8) {
+    uint64_t w;
+
+    memcpy(&w, s + i, sizeof(w));
+
+    if(w & 0x8080808080808080ull)
+      break;
+  }
+#endif
+
+  while(i < n && s[i] < 0x80)
+    i++;
+
+  return i;
+}
+
+/**
+ * @brief      Decodes and validates one UTF-8 sequence
+ *
+ * @return     sequence length, 0 if the input ends inside a (so far valid)
+ *             sequence, or the negated length of the invalid subpart (>= 1)
+ */
+int
+utf8_decode(const uint8_t* s, size_t n, uint32_t* cp) {
+  uint8_t c = s[0], lo = 0x80, hi = 0xbf;
+  int len, i;
+  uint32_t v;
+
+  if(c < 0x80) {
+    *cp = c;
+    return 1;
+  }
+
+  if(c >= 0xc2 && c <= 0xdf) {
+    len = 2;
+    v = c & 0x1f;
+  } else if(c >= 0xe0 && c <= 0xef) {
+    len = 3;
+    v = c & 0x0f;
+
+    if(c == 0xe0)
+      lo = 0xa0;
+    else if(c == 0xed)
+      hi = 0x9f;
+  } else if(c >= 0xf0 && c <= 0xf4) {
+    len = 4;
+    v = c & 0x07;
+
+    if(c == 0xf0)
+      lo = 0x90;
+    else if(c == 0xf4)
+      hi = 0x8f;
+  } else {
+    return -1;
+  }
+
+  for(i = 1; i < len; i++) {
+    if((size_t)i >= n)
+      return 0;
+
+    if(s[i] < lo || s[i] > hi)
+      return -i;
+
+    v = (v << 6) | (s[i] & 0x3f);
+    lo = 0x80;
+    hi = 0xbf;
+  }
+
+  *cp = v;
+  return len;
+}
+
+/**
+ * @brief      Length of the longest valid UTF-8 prefix
+ *
+ * @param      truncated  set when the input ends inside a valid sequence
+ */
+size_t
+utf8_validate(const uint8_t* s, size_t n, bool* truncated) {
+  size_t i = 0;
+  uint32_t cp;
+  int r;
+
+  if(truncated)
+    *truncated = false;
+
+  while(i < n) {
+    i += utf_ascii_prefix(s + i, n - i);
+
+    while(i < n && s[i] >= 0x80) {
+      if((r = utf8_decode(s + i, n - i, &cp)) <= 0) {
+        if(truncated)
+          *truncated = r == 0;
+
+        return i;
+      }
+
+      i += r;
+    }
+  }
+
+  return i;
+}
+
+/**
+ * @brief      Number of UTF-16 units the (well-formed) UTF-8 input encodes
+ */
+size_t
+utf8_utf16_units(const uint8_t* s, size_t n) {
+  size_t i = 0, r = 0;
+
+  while(i < n) {
+    size_t a = utf_ascii_prefix(s + i, n - i);
+
+    r += a;
+
+    for(i += a; i < n && s[i] >= 0x80; i++)
+      r += ((s[i] & 0xc0) != 0x80) + (s[i] >= 0xf0);
+  }
+
+  return r;
+}
+
+/**
+ * @brief      Converts UTF-8 to UTF-16, out must have room for n units
+ *
+ * @return     number of UTF-16 units written
+ */
+size_t
+utf8_to_utf16(const uint8_t* s, size_t n, uint16_t* out, bool swap_bytes, size_t* consumed) {
+  size_t i = 0, o = 0;
+  uint32_t cp;
+  int r;
+
+  while(i < n) {
+#if defined(__SSE2__)
+    for(; i + 16 <= n; i += 16, o += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(s + i)), z = _mm_setzero_si128();
+
+      if(_mm_movemask_epi8(v))
+        break;
+
+      if(swap_bytes) {
+        _mm_storeu_si128((__m128i*)(out + o), _mm_unpacklo_epi8(z, v));
+        _mm_storeu_si128((__m128i*)(out + o + 8), _mm_unpackhi_epi8(z, v));
+      } else {
+        _mm_storeu_si128((__m128i*)(out + o), _mm_unpacklo_epi8(v, z));
+        _mm_storeu_si128((__m128i*)(out + o + 8), _mm_unpackhi_epi8(v, z));
+      }
+    }
+#elif defined(UTF_NEON)
+    for(; i + 16 <= n; i += 16, o += 16) {
+      uint8x16_t v = vld1q_u8(s + i);
+
+      if(vmaxvq_u8(v) >= 0x80)
+        break;
+
+      if(swap_bytes) {
+        vst1q_u16(out + o, vshll_n_u8(vget_low_u8(v), 8));
+        vst1q_u16(out + o + 8, vshll_n_u8(vget_high_u8(v), 8));
+      } else {
+        vst1q_u16(out + o, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(out + o + 8, vmovl_u8(vget_high_u8(v)));
+      }
+    }
+#endif
+
+    for(; i < n && s[i] < 0x80; i++)
+      out[o++] = swap_bytes ? (uint16_t)(s[i] << 8) : s[i];
+
+    while(i < n && s[i] >= 0x80) {
+      if((r = utf8_decode(s + i, n - i, &cp)) <= 0)
+        goto end;
+
+      if(cp >= 0x10000) {
+        uint16_t hi = 0xd800 | ((cp - 0x10000) >> 10), lo = 0xdc00 | (cp & 0x3ff);
+
+        out[o++] = swap_bytes ? SWAP16(hi) : hi;
+        out[o++] = swap_bytes ? SWAP16(lo) : lo;
+      } else {
+        out[o++] = swap_bytes ? SWAP16(cp) : cp;
+      }
+
+      i += r;
+    }
+  }
+
+end:
+  if(consumed)
+    *consumed = i;
+
+  return o;
+}
+
+/**
+ * @brief      Converts UTF-8 to UTF-32, out must have room for n code points
+ *
+ * @return     number of code points written
+ */
+size_t
+utf8_to_utf32(const uint8_t* s, size_t n, uint32_t* out, bool swap_bytes, size_t* consumed) {
+  size_t i = 0, o = 0;
+  uint32_t cp;
+  int r;
+
+  while(i < n) {
+#if defined(__SSE2__)
+    if(!swap_bytes)
+      for(; i + 16 <= n; i += 16, o += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i)), z = _mm_setzero_si128();
+        __m128i lo = _mm_unpacklo_epi8(v, z), hi = _mm_unpackhi_epi8(v, z);
+
+        if(_mm_movemask_epi8(v))
+          break;
+
+        _mm_storeu_si128((__m128i*)(out + o), _mm_unpacklo_epi16(lo, z));
+        _mm_storeu_si128((__m128i*)(out + o + 4), _mm_unpackhi_epi16(lo, z));
+        _mm_storeu_si128((__m128i*)(out + o + 8), _mm_unpacklo_epi16(hi, z));
+        _mm_storeu_si128((__m128i*)(out + o + 12), _mm_unpackhi_epi16(hi, z));
+      }
+#elif defined(UTF_NEON)
+    if(!swap_bytes)
+      for(; i + 16 <= n; i += 16, o += 16) {
+        uint8x16_t v = vld1q_u8(s + i);
+        uint16x8_t lo, hi;
+
+        if(vmaxvq_u8(v) >= 0x80)
+          break;
+
+        lo = vmovl_u8(vget_low_u8(v));
+        hi = vmovl_u8(vget_high_u8(v));
+        vst1q_u32(out + o, vmovl_u16(vget_low_u16(lo)));
+        vst1q_u32(out + o + 4, vmovl_u16(vget_high_u16(lo)));
+        vst1q_u32(out + o + 8, vmovl_u16(vget_low_u16(hi)));
+        vst1q_u32(out + o + 12, vmovl_u16(vget_high_u16(hi)));
+      }
+#endif
+
+    for(; i < n && s[i] < 0x80; i++)
+      out[o++] = swap_bytes ? (uint32_t)s[i] << 24 : s[i];
+
+    while(i < n && s[i] >= 0x80) {
+      if((r = utf8_decode(s + i, n - i, &cp)) <= 0)
+        goto end;
+
+      out[o++] = swap_bytes ? SWAP32(cp) : cp;
+      i += r;
+    }
+  }
+
+end:
+  if(consumed)
+    *consumed = i;
+
+  return o;
+}
+
+/**
+ * @brief      Converts UTF-16 to UTF-8, out must have room for 3 * n bytes
+ *
+ * @return     number of bytes written
+ */
+size_t
+utf16_to_utf8(const uint16_t* s, size_t n, uint8_t* out, bool swap_bytes, size_t* consumed) {
+  size_t i = 0, o = 0;
+
+  while(i < n) {
+#if defined(__SSE2__)
+    for(; i + 8 <= n; i += 8, o += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+
+      if(swap_bytes)
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+
+      if(_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short)0xff80)), _mm_setzero_si128())) != 0xffff)
+        break;
+
+      _mm_storel_epi64((__m128i*)(out + o), _mm_packus_epi16(v, v));
+    }
+#elif defined(UTF_NEON)
+    for(; i + 8 <= n; i += 8, o += 8) {
+      uint16x8_t v = vld1q_u16(s + i);
+
+      if(swap_bytes)
+        v = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(v)));
+
+      if(vmaxvq_u16(v) >= 0x80)
+        break;
+
+      vst1_u8(out + o, vmovn_u16(v));
+    }
+#endif
+
+    for(; i < n; i++) {
+      uint32_t c = swap_bytes ? SWAP16(s[i]) : s[i];
+
+      if(c < 0x80) {
+        out[o++] = c;
+        continue;
+      }
+
+      if(c >= 0xd800 && c <= 0xdfff) {
+        uint32_t c2;
+
+        if(c >= 0xdc00 || i + 1 >= n)
+          goto end;
+
+        c2 = swap_bytes ? SWAP16(s[i + 1]) : s[i + 1];
+
+        if(c2 < 0xdc00 || c2 > 0xdfff)
+          goto end;
+
+        c = 0x10000 + ((c - 0xd800) << 10) + (c2 - 0xdc00);
+        i++;
+      }
+
+      o += utf8_encode(out + o, c);
+
+      /* back to the vector loop after a run of non-ASCII */
+      if(i + 1 < n && (swap_bytes ? SWAP16(s[i + 1]) : s[i + 1]) < 0x80) {
+        i++;
+        break;
+      }
+    }
+  }
+
+end:
+  if(consumed)
+    *consumed = i;
+
+  return o;
+}
+
+/**
+ * @brief      Converts UTF-32 to UTF-8, out must have room for 4 * n bytes
+ *
+ * @return     number of bytes written
+ */
+size_t
+utf32_to_utf8(const uint32_t* s, size_t n, uint8_t* out, bool swap_bytes, size_t* consumed) {
+  size_t i = 0, o = 0;
+
+  while(i < n) {
+#if defined(__SSE2__)
+    if(!swap_bytes)
+      for(; i + 8 <= n; i += 8, o += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s + i)), b = _mm_loadu_si128((const __m128i*)(s + i + 4));
+        __m128i m = _mm_set1_epi32(~0x7f), z = _mm_setzero_si128();
+
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(a, b), m), z)) != 0xffff)
+          break;
+
+        a = _mm_packs_epi32(a, b);
+        _mm_storel_epi64((__m128i*)(out + o), _mm_packus_epi16(a, a));
+      }
+#elif defined(UTF_NEON)
+    if(!swap_bytes)
+      for(; i + 8 <= n; i += 8, o += 8) {
+        uint32x4_t a = vld1q_u32(s + i), b = vld1q_u32(s + i + 4);
+
+        if(vmaxvq_u32(vorrq_u32(a, b)) >= 0x80)
+          break;
+
+        vst1_u8(out + o, vmovn_u16(vcombine_u16(vmovn_u32(a), vmovn_u32(b))));
+      }
+#endif
+
+    for(; i < n; i++) {
+      uint32_t c = swap_bytes ? SWAP32(s[i]) : s[i];
+
+      if(c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+        goto end;
+
+      o += utf8_encode(out + o, c);
+
+      if(c >= 0x80 && i + 1 < n && (swap_bytes ? SWAP32(s[i + 1]) : s[i + 1]) < 0x80) {
+        i++;
+        break;
+      }
+    }
+  }
+
+end:
+  if(consumed)
+    *consumed = i;
+
+  return o;
+}
+
+/**
+ * @}
+ */
@@ -28,7 +28,7 @@ int JS_ToInt64Clamp(JSContext*, int64_t*, JSValueConst, int64_t, int64_t, int64_
 JSModuleLoaderFunc* JS_GetModuleLoaderFunc(JSRuntime*);
 void* JS_GetModuleLoaderOpaque(JSRuntime*);
 
-static JSValue generator_prototype, asyncgenerator_prototype, typedarray_prototype;
+static thread_local JSValue generator_prototype, asyncgenerator_prototype, typedarray_prototype;
 // static JSModuleDef* io_module;
 
 /**
@@ -3364,6 +3364,12 @@ js_iohandler_set(JSContext* ctx, JSValueConst set_handler, int fd, JSValue handl
   return TRUE;
 }
 
+/* set by the host to make contexts of other threads like its own (module loader, built-in modules) */
+JSContext* (*js_thread_context_new)(JSRuntime*) = 0;
+
+/* set by the host to release what it keeps per thread for such a context, before the context is freed */
+void (*js_thread_context_free)(JSContext*) = 0;
+
 JSValue
 js_promise_new(JSContext* ctx, JSValue resolving_funcs[2]) {
   JSValue ret = JS_NewPromiseCapability(ctx, resolving_funcs);
@@ -0,0 +1,83 @@
+import { List } from 'list';
+import { performance } from 'perf_hooks';
+
+/*
+ * Compares Array, the plain linked List (indexed = false, every positional
+ * access walks from the nearer end) and the default List with its position
+ * index, for queue, random access and splice-at-iterator workloads.
+ */
+
+const N = +(process.argv[2] ?? 20000);
+
+const containers = {
+  Array: () => [],
+  'List (walk)': () => Object.assign(new List(), { indexed: false }),
+  'List (indexed)': () => new List(),
+};
+
+function fill(c, n) {
+  for(let i = 0; i < n; i++) c.push(i);
+  return c;
+}
+
+const workloads = {
+  queue(c) {
+    let sum = 0;
+
+    for(let i = 0; i < N; i++) {
+      c.push(i);
+      c.push(i + 1);
+      sum += c.shift();
+    }
+
+    while(c.length) sum += c.shift();
+    return sum;
+  },
+  random(c) {
+    let sum = 0,
+      seed = 1;
+
+    fill(c, N);
+
+    for(let i = 0; i < N; i++) {
+      seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+      sum += c.at(seed % N);
+    }
+
+    return sum;
+  },
+  sequential(c) {
+    let sum = 0;
+
+    fill(c, N);
+
+    for(let i = 0; i < N; i++) sum += c[i];
+    return sum;
+  },
+  splice(c) {
+    fill(c, N);
+
+    if(Array.isArray(c)) {
+      for(let i = 0; i < N; i += 2) c.splice(i + 1, 0, -i);
+    } else {
+      const it = c.begin();
+
+      for(let i = 0; i < N; i++) {
+        it.next();
+        if(i % 2 == 0) c.insertBefore(it, -i);
+      }
+    }
+
+    return c.length;
+  },
+};
+
+for(const [name, workload] of Object.entries(workloads)) {
+  for(const [type, create] of Object.entries(containers)) {
+    const c = create();
+    const t = performance.now();
+    const result = workload(c);
+
+    console.log(`${name.padEnd(12)} ${type.padEnd(16)} ${(performance.now() - t).toFixed(2).padStart(10)} ms  (${result})`);
+  }
+}
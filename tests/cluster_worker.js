@@ -0,0 +1,7 @@
+import { serve } from 'cluster';
+
+/* answers every connection with the id of the worker that accepted it */
+serve(async (conn, id) => {
+  await conn.send(`${id}`);
+  conn.close();
+});
@@ -0,0 +1,134 @@
+import * as aio from 'aio';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as std from 'std';
+import Console from 'console';
+import { Worker } from 'worker_threads';
+import { assert, assertStrictEquals } from './tinytest.js';
+
+const once = (emitter, event) => new Promise(resolve => emitter.once(event, resolve));
+const delay = ms => new Promise(resolve => os.setTimeout(resolve, ms));
+
+async function rejection(promise) {
+  try {
+    await promise;
+  } catch(e) {
+    return e;
+  }
+}
+
+/* pipes are not handed to the thread pool, they wait for the event loop */
+async function testPipe() {
+  const [rd, wr] = os.pipe();
+  const buf = new ArrayBuffer(16);
+
+  os.setTimeout(() => os.write(wr, new Uint8Array([...'pipe'].map(c => c.charCodeAt(0))).buffer, 0, 4), 50);
+
+  assertStrictEquals(4, await fs.read(rd, buf, 0, buf.byteLength));
+  assertStrictEquals('pipe', String.fromCharCode(...new Uint8Array(buf, 0, 4)));
+
+  os.close(rd);
+  os.close(wr);
+}
+
+/* a worker terminated with requests in flight drops them and still exits */
+async function testTerminate() {
+  const worker = new Worker(
+    `import * as aio from 'aio';
+     import { parentPort } from 'worker_threads';
+     (function next() {
+       for(let i = 0; i < 16; i++) aio.readdir('/');
+       aio.stat('/').then(next);
+     })();
+     parentPort.postMessage('busy');`,
+    { eval: true },
+  );
+
+  assertStrictEquals('busy', await once(worker, 'message'));
+  await delay(50);
+  assertStrictEquals(1, await worker.terminate());
+}
+
+async function main(...args) {
+  globalThis.console = new Console({ inspectOptions: { compact: 2 } });
+
+  const dir = args[0] ?? '/tmp';
+  const file = `${dir}/test_aio-${Date.now()}.txt`;
+  const data = new Uint8Array([...'hello aio\n'].map(c => c.charCodeAt(0)));
+
+  assert(aio.threads() >= 1, `threads ${aio.threads()}`);
+
+  const st = await aio.stat(dir);
+  assertStrictEquals(os.S_IFDIR, st.mode & os.S_IFMT);
+
+  let fd = await aio.open(file, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644);
+  assertStrictEquals(data.byteLength, await aio.write(fd, data.buffer, 0, data.byteLength));
+  await aio.fsync(fd);
+  await aio.close(fd);
+
+  fd = await aio.open(file, os.O_RDONLY);
+  const buf = new ArrayBuffer(64);
+  const n = await aio.read(fd, buf, 0, buf.byteLength, 6);
+  assertStrictEquals('aio\n', String.fromCharCode(...new Uint8Array(buf, 0, n)));
+  await aio.close(fd);
+
+  /* many requests in flight at once */
+  const stats = await Promise.all([...Array(32)].map(() => aio.stat(file)));
+  assertStrictEquals(32, stats.length);
+  assert(stats.every(s => s.size == data.byteLength), 'parallel stats');
+
+  const names = await aio.readdir(dir);
+  assert(names.includes(file.slice(dir.length + 1)), 'readdir() lists the file');
+
+  const copy = `${file}.copy`;
+  let calls = 0,
+    progress;
+  assertStrictEquals(
+    data.byteLength,
+    await aio.copyFile(file, copy, aio.COPYFILE_FICLONE, (copied, total) => (calls++, (progress = [copied, total]))),
+  );
+  assert(calls > 0, 'copyFile() reported progress');
+  assertStrictEquals(JSON.stringify([data.byteLength, data.byteLength]), JSON.stringify(progress));
+  assertStrictEquals(data.byteLength, (await aio.stat(copy)).size);
+
+  /* procfs reports a size of 0, the contents are still copied */
+  if(os.stat('/proc/self/status')[1] == 0) {
+    const procCopy = `${file}.status`;
+
+    assert((await aio.copyFile('/proc/self/status', procCopy)) > 0, 'copyFile() of a procfs file copied nothing');
+    assert((await aio.stat(procCopy)).size > 0, 'copy of a procfs file is empty');
+    await aio.unlink(procCopy);
+  }
+
+  let error;
+  try {
+    aio.copyFileSync(file, copy, aio.COPYFILE_EXCL);
+  } catch(e) {
+    error = e;
+  }
+
+  assert(error, 'copyFileSync() with COPYFILE_EXCL overwrote an existing file');
+  assertStrictEquals('open', error.syscall);
+  assertStrictEquals(17 /* EEXIST */, error.errno);
+
+  await aio.unlink(copy);
+  await aio.unlink(file);
+
+  error = await rejection(aio.stat(file));
+  assert(error, 'stat() of a removed file succeeded');
+  assertStrictEquals('stat', error.syscall);
+  assertStrictEquals(2 /* ENOENT */, error.errno);
+
+  await testPipe();
+  await testTerminate();
+
+  /* the loop of this thread is created again for new requests */
+  assertStrictEquals(os.S_IFDIR, (await aio.stat(dir)).mode & os.S_IFMT);
+}
+
+main(...scriptArgs.slice(1))
+  .then(() => console.log('SUCCESS'))
+  .catch(error => {
+    console.log(`FAIL: ${error.message}\n${error.stack}`);
+    std.exit(1);
+  });
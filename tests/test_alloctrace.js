@@ -0,0 +1,71 @@
+import * as std from 'std';
+import { aggregate, folded, FREES, FREE, REALLOC, SAMPLE, STACK } from '../lib/alloc-trace.js';
+import { assertStrictEquals } from './tinytest.js';
+
+const EVENT_SIZE = 40,
+  HEADER_SIZE = 80,
+  INTERVAL = 4096;
+
+/* a trace as written by src/alloc-trace.c with ALLOC_TRACE_FREES */
+function trace(events) {
+  const slots = events.reduce((n, e) => n + 1 + (e.text ? Math.ceil(e.text.length / EVENT_SIZE) : 0), 0);
+  const buf = new ArrayBuffer(HEADER_SIZE + slots * EVENT_SIZE);
+  const dv = new DataView(buf),
+    bytes = new Uint8Array(buf);
+  let offset = HEADER_SIZE;
+
+  bytes.set([...'QJSALLOC'].map(c => c.charCodeAt(0)));
+  dv.setUint32(8, 1, true);
+  dv.setUint32(12, EVENT_SIZE, true);
+  dv.setUint32(16, HEADER_SIZE, true);
+  dv.setUint32(20, FREES, true);
+  dv.setUint32(24, INTERVAL, true);
+
+  for(const { type, stack = 0, ptr = 0, size = 0, arg = 0, text } of events) {
+    dv.setUint8(offset, type.charCodeAt(0));
+    dv.setUint32(offset + 4, stack, true);
+    dv.setUint32(offset + 16, ptr, true);
+    dv.setUint32(offset + 24, text ? text.length : size, true);
+    dv.setUint32(offset + 32, arg, true);
+    offset += EVENT_SIZE;
+
+    if(text) {
+      bytes.set([...text].map(c => c.charCodeAt(0)), offset);
+      offset += Math.ceil(text.length / EVENT_SIZE) * EVENT_SIZE;
+    }
+  }
+
+  return buf;
+}
+
+function main() {
+  const result = aggregate(
+    trace([
+      { type: STACK, stack: 1, text: 'main;grow' },
+      { type: STACK, stack: 2, text: 'main;temp' },
+      /* resized in place, then moved, then sampled again */
+      { type: SAMPLE, stack: 1, ptr: 0x1000, size: 100, arg: INTERVAL },
+      { type: REALLOC, ptr: 0x1000, size: 200, arg: 0x1000 },
+      { type: REALLOC, ptr: 0x3000, size: 5000, arg: 0x1000 },
+      { type: SAMPLE, stack: 1, ptr: 0x3000, size: 5000, arg: INTERVAL },
+      /* a failed realloc() keeps the block */
+      { type: REALLOC, ptr: 0, size: 1 << 30, arg: 0x3000 },
+      /* freed before the end */
+      { type: SAMPLE, stack: 2, ptr: 0x2000, size: 64, arg: INTERVAL },
+      { type: REALLOC, ptr: 0x4000, size: 128, arg: 0x2000 },
+      { type: FREE, ptr: 0x4000, size: 128 },
+    ]),
+  );
+
+  assertStrictEquals(3, result.totals.samples);
+  assertStrictEquals(`main;grow ${2 * INTERVAL}\nmain;temp ${INTERVAL}\n`, folded(result));
+  assertStrictEquals(`main;grow ${2 * INTERVAL}\n`, folded(result, true));
+}
+
+try {
+  main(...scriptArgs.slice(1));
+  console.log('SUCCESS');
+} catch(error) {
+  console.log(`FAIL: ${error.message}\n${error.stack}`);
+  std.exit(1);
+}
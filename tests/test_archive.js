@@ -0,0 +1,218 @@
+import * as os from 'os';
+import * as std from 'std';
+import { Archive, ArchiveEntry } from 'archive';
+import { toString } from 'misc';
+import { assert, assertStrictEquals } from './tinytest.js';
+
+const FILES = {
+  'a.txt': 'first file\n',
+  'b.txt': 'second file, a bit longer\n',
+  'c.txt': '',
+};
+
+const tmpname = ext => `/tmp/test_archive-${Date.now()}-${Math.floor(Math.random() * 1e6)}${ext}`;
+
+/* string values are file contents, { hardlink } values hard links */
+function writeEntries(ar, files = FILES) {
+  for(const [pathname, value] of Object.entries(files)) {
+    const text = typeof value == 'string' ? value : '';
+    const entry = new ArchiveEntry(pathname, text.length);
+
+    entry.type = 'file';
+    entry.perm = 0o644;
+
+    if(value.hardlink) {
+      entry.hardlink = value.hardlink;
+      ar.write(entry);
+    } else {
+      ar.write(entry, text);
+    }
+  }
+
+  ar.close();
+}
+
+function writeTar(file, files = FILES) {
+  writeEntries(Archive.write(file), files);
+  return file;
+}
+
+async function readAll(ar) {
+  const contents = {};
+
+  for await(const { entry, data } of ar.iterate()) {
+    if(data === null) contents[entry.pathname] ??= '';
+    else contents[entry.pathname] += toString(data);
+  }
+
+  return JSON.stringify(contents);
+}
+
+function readFile(file) {
+  const f = std.open(file, 'rb');
+  const buf = new ArrayBuffer(os.stat(file)[0].size);
+
+  f.read(buf, 0, buf.byteLength);
+  f.close();
+  return buf;
+}
+
+async function* chunks(buf, size) {
+  for(let i = 0; i < buf.byteLength; i += size) yield buf.slice(i, i + size);
+}
+
+async function testFd(tar) {
+  const out = tmpname('.tar');
+  let fd = os.open(out, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644);
+
+  writeEntries(Archive.write(fd, '.tar'));
+  os.close(fd);
+
+  fd = os.open(out, os.O_RDONLY);
+  assertStrictEquals(JSON.stringify(FILES), await readAll(Archive.read(fd)));
+  os.close(fd);
+  os.remove(out);
+}
+
+async function testStream(tar) {
+  /* stream input is read by the background thread through a socket pair */
+  const ar = Archive.read(chunks(readFile(tar), 1000));
+  assertStrictEquals(JSON.stringify(FILES), await readAll(ar));
+
+  /* stream output goes to a WritableStream-like writer */
+  const written = [];
+  const sink = {
+    getWriter: () => ({
+      ready: Promise.resolve(),
+      write: chunk => (written.push(chunk.slice()), Promise.resolve()),
+      close: () => Promise.resolve(),
+    }),
+  };
+
+  const out = Archive.write(sink, '.tar');
+  await out.ready;
+  writeEntries(out);
+
+  const buf = new Uint8Array(written.reduce((n, chunk) => n + chunk.byteLength, 0));
+  written.reduce((pos, chunk) => (buf.set(chunk, pos), pos + chunk.byteLength), 0);
+
+  const input = new Archive();
+  input.open(buf.buffer);
+  assertStrictEquals(JSON.stringify(FILES), await readAll(input));
+
+  assert(!('pending' in ar) && !('stream' in ar) && !('writer' in out), 'no internal state on the objects');
+}
+
+function writeFile(file, text) {
+  const f = std.open(file, 'w');
+
+  f.puts(text);
+  f.close();
+}
+
+async function extractError(tar, dest) {
+  try {
+    await Archive.read(tar).extractAll(dest);
+  } catch(e) {
+    return e;
+  }
+}
+
+async function testExtractAll() {
+  const base = tmpname('');
+  const victim = `${base}/victim`;
+
+  os.mkdir(base);
+  os.mkdir(`${base}/sub`);
+  writeFile(victim, 'untouched\n');
+
+  /* a destination with '..' in it still works, hard links are created inside it */
+  const good = writeTar(tmpname('.tar'), { 'a.txt': 'linked\n', 'b.txt': { hardlink: 'a.txt' } });
+
+  assertStrictEquals(2, await Archive.read(good).extractAll(`${base}/sub/../dest`, { threads: 2 }));
+  assertStrictEquals(os.stat(`${base}/dest/a.txt`)[0].ino, os.stat(`${base}/dest/b.txt`)[0].ino);
+  assertStrictEquals('linked\n', toString(readFile(`${base}/dest/b.txt`)));
+
+  /* hard links leaving the destination are rejected before touching the disk */
+  const hostile = [
+    writeTar(tmpname('.tar'), { evil: { hardlink: '../victim' } }),
+    writeTar(tmpname('.tar'), { evil: { hardlink: victim } }),
+    writeTar(tmpname('.tar'), { '../evil': { hardlink: 'a.txt' } }),
+  ];
+
+  for(const tar of hostile) {
+    const error = await extractError(tar, `${base}/dest`);
+
+    assert(error, 'hostile hard link rejected');
+    assert(/escapes/.test(error.message), error.message);
+    os.remove(tar);
+  }
+
+  assertStrictEquals(1, os.stat(victim)[0].nlink);
+  assertStrictEquals('untouched\n', toString(readFile(victim)));
+  assert(os.stat(`${base}/dest/evil`)[1] != 0, 'no link created in the destination');
+  assert(os.stat(`${base}/evil`)[1] != 0, 'no link created next to the destination');
+
+  for(const file of ['dest/a.txt', 'dest/b.txt', 'dest', 'victim', 'sub', '']) os.remove(`${base}/${file}`);
+  os.remove(good);
+}
+
+async function testIterate(file) {
+  const ar = Archive.read(file);
+  const contents = {};
+  let headers = 0;
+
+  for await(const { entry, data } of ar.iterate({ highWaterMark: 2 })) {
+    /* the getters read a snapshot instead of the archive the reader thread uses */
+    assertStrictEquals('number', typeof ar.errno);
+    assertStrictEquals('string', typeof ar.format);
+    assertStrictEquals('none', ar.compression);
+    assert(Array.isArray(ar.filters), 'ar.filters is an array');
+    assert(ar.fileCount >= 1, `fileCount ${ar.fileCount}`);
+
+    delete ar.errno;
+
+    let error;
+    try {
+      ar.errno;
+    } catch(e) {
+      error = e;
+    }
+    assert(error instanceof InternalError, 'getter throws while iterating');
+
+    if(data === null) {
+      headers++;
+      contents[entry.pathname] ??= '';
+    } else {
+      contents[entry.pathname] += toString(data);
+    }
+  }
+
+  assertStrictEquals(Object.keys(FILES).length, headers);
+  assertStrictEquals(JSON.stringify(FILES), JSON.stringify(contents));
+
+  /* back in READ mode the getters read the archive itself */
+  assertStrictEquals(headers, ar.fileCount);
+  assertStrictEquals(0, ar.errno);
+  ar.close();
+}
+
+async function main(...args) {
+  const tar = writeTar(tmpname('.tar'));
+
+  try {
+    await testIterate(tar);
+    await testFd(tar);
+    await testStream(tar);
+    await testExtractAll();
+  } finally {
+    os.remove(tar);
+  }
+}
+
+main(...scriptArgs.slice(1))
+  .then(() => console.log('SUCCESS'))
+  .catch(error => {
+    console.log(`FAIL: ${error.message}\n${error.stack}`);
+    std.exit(1);
+  });
@@ -0,0 +1,58 @@
+import { Directory, walk } from 'directory';
+import * as std from 'std';
+import Console from 'console';
+import { assert } from './tinytest.js';
+
+async function main(...args) {
+  globalThis.console = new Console({ inspectOptions: { compact: 2 } });
+
+  const root = args[0] ?? '.';
+  let batches = 0,
+    files = 0,
+    dirs = 0;
+
+  for await(const batch of walk(root, { exclude: ['.git', 'node_modules'], batchSize: 256 })) {
+    batches++;
+
+    for(const [path, type] of batch) {
+      if(type == Directory.TYPE_DIR) dirs++;
+      else files++;
+    }
+  }
+
+  console.log('walk', root, { batches, files, dirs });
+
+  const sources = [];
+
+  const options = { include: '*.c', types: Directory.TYPE_REG, maxDepth: 1, flags: Directory.NAME };
+
+  for await(const batch of walk(root, options)) sources.push(...batch);
+
+  assert(sources.length > 0, `no *.c files in ${root}`);
+  assert(
+    sources.every(name => name.endsWith('.c') && name.slice(root.length + 1).indexOf('/') == -1),
+    `entries below maxDepth 1 or not matching '*.c': ${sources}`,
+  );
+
+  /* stop early, the remaining batches are dropped */
+  for await(const batch of walk(root, { batchSize: 1 })) break;
+
+  let error;
+
+  try {
+    for await(const batch of walk(`${root}/nonexistent-${Date.now()}`));
+  } catch(e) {
+    error = e;
+  }
+
+  if(!error) throw new Error('walk() of a missing directory succeeded');
+
+  console.log('error', error.message);
+}
+
+main(...scriptArgs.slice(1))
+  .then(() => console.log('SUCCESS'))
+  .catch(error => {
+    console.log(`FAIL: ${error.message}\n${error.stack}`);
+    std.exit(1);
+  });
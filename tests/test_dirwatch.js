@@ -0,0 +1,73 @@
+import { watch } from 'directory';
+import * as os from 'os';
+import * as std from 'std';
+import Console from 'console';
+import { assert } from './tinytest.js';
+
+const IN_CLOSE_WRITE = 0x8;
+const IN_CREATE = 0x100;
+const TIMEOUT = 5000;
+
+function fail(error) {
+  console.log(`FAIL: ${error.message}\n${error.stack}`);
+  std.exit(1);
+}
+
+function main(...args) {
+  globalThis.console = new Console({ inspectOptions: { compact: 2 } });
+
+  const root = args[0] ?? `/tmp/test_dirwatch-${Date.now()}`;
+
+  os.mkdir(root);
+
+  /* a change set that never arrives fails the test instead of hanging */
+  const timer = os.setTimeout(() => fail(new Error(`no changes within ${TIMEOUT}ms`)), TIMEOUT);
+
+  /* only IN_CLOSE_WRITE is asked for, the new subdirectory is still followed */
+  const w = watch(
+    root,
+    (changes, overflow) => {
+      try {
+        console.log('changes', changes.length, { overflow });
+
+        assert(
+          changes.every(([path, mask]) => mask & IN_CLOSE_WRITE && !(mask & IN_CREATE)),
+          `events outside the mask reported: ${JSON.stringify(changes)}`,
+        );
+        assert(
+          changes.some(([path]) => path == `${root}/sub/file.txt`),
+          `file in new subdirectory not reported: ${JSON.stringify(changes)}`,
+        );
+
+        console.log('watches', w.watches);
+        w.close();
+        os.clearTimeout(timer);
+
+        os.remove(`${root}/sub/file.txt`);
+        os.remove(`${root}/sub`);
+        os.remove(root);
+        console.log('SUCCESS');
+      } catch(error) {
+        fail(error);
+      }
+    },
+    { delay: 100, mask: IN_CLOSE_WRITE },
+  );
+
+  os.mkdir(`${root}/sub`);
+
+  /* the file is written once the subdirectory is watched, its creation alone is not reported */
+  (function write() {
+    if(w.watches < 2) return os.setTimeout(write, 10);
+
+    const f = std.open(`${root}/sub/file.txt`, 'w');
+    f.puts('test\n');
+    f.close();
+  })();
+}
+
+try {
+  main(...scriptArgs.slice(1));
+} catch(error) {
+  fail(error);
+}
@@ -1,4 +1,6 @@
 import { List } from 'list';
+import { assert, assertStrictEquals } from './tinytest.js';
+
 let l = new List([6, 5, 4, 3, 2, 1]);
 
 let letter = 'a';
@@ -44,3 +46,131 @@ console.log('it', it);
 
 //insert();
 //console.log('l', l);
+
+let people = List.of({ name: 'eve', age: 31 }, { name: 'bob', age: 25 }, { name: 'amy', age: 31 });
+const names = list => [...list].map(p => p.name).join(',');
+
+/* stable: eve stays ahead of amy */
+assertStrictEquals('eve,amy,bob', names(people.sort({ key: 'age', descending: true })));
+assertStrictEquals('amy,bob,eve', names(people.sort({ key: p => p.name, type: 'string' })));
+
+/* NaN and undefined keys go last, in their original order, in either direction */
+people = List.of({ name: 'nan', age: NaN }, { name: 'eve', age: 31 }, { name: 'none' }, { name: 'bob', age: 25 });
+assertStrictEquals('bob,eve,nan,none', names(people.sort({ key: 'age' })));
+assertStrictEquals('eve,bob,nan,none', names(people.sort({ key: 'age', descending: true })));
+assertStrictEquals('eve,bob,nan,none', names(people.sort({ key: 'age', type: 'auto', descending: true })));
+assertStrictEquals('none,nan,eve,bob', names(people.sort({ key: p => p.name, type: 'string', descending: true })));
+assertStrictEquals('bob,eve,nan,none', names(people.sort({ key: p => (p.name == 'none' ? undefined : p.name), type: 'string' })));
+
+/* an iterator positioned at index i */
+function iterAt(list, i) {
+  const it = list.begin();
+
+  while(i-- > 0) it.next();
+  return it;
+}
+
+/* compares every position (and a few negative ones) against the array model */
+function check(list, model, what) {
+  assertStrictEquals(model.length, list.length);
+
+  for(let i = 0; i < model.length; i++) if(list.at(i) !== model[i]) throw new Error(`${what}: at(${i}) = ${list.at(i)}, expected ${model[i]}`);
+
+  for(let i = 1; i <= Math.min(3, model.length); i++) assertStrictEquals(model[model.length - i], list.at(-i));
+
+  assertStrictEquals(undefined, list.at(model.length));
+  assertStrictEquals(model.join(','), [...list].join(','));
+}
+
+/* at() against an Array model while the list is edited through ends, iterators and splice() */
+function testIndex(indexed) {
+  const list = new List();
+  const model = [];
+  let seed = 7,
+    value = 0;
+
+  const random = n => ((seed = (seed * 1103515245 + 12345) & 0x7fffffff), seed % n);
+
+  list.indexed = indexed;
+  assertStrictEquals(indexed, list.indexed);
+
+  for(let i = 0; i < 40; i++) list.push(value), model.push(value++);
+  check(list, model, 'push');
+
+  const ops = {
+    push() {
+      list.push(value);
+      model.push(value++);
+    },
+    unshift() {
+      list.unshift(value);
+      model.unshift(value++);
+    },
+    pop() {
+      assertStrictEquals(model.pop(), list.pop());
+    },
+    shift() {
+      assertStrictEquals(model.shift(), list.shift());
+    },
+    insert() {
+      const i = random(model.length);
+
+      list.insert(iterAt(list, i), value, value + 1);
+      model.splice(i + 1, 0, value, value + 1);
+      value += 2;
+    },
+    insertBefore() {
+      const i = random(model.length);
+
+      list.insertBefore(iterAt(list, i), value);
+      model.splice(i, 0, value++);
+    },
+    erase() {
+      const i = random(model.length);
+
+      list.erase(iterAt(list, i));
+      model.splice(i, 1);
+    },
+    splice() {
+      const i = random(model.length),
+        j = i + random(model.length - i);
+      const removed = list.splice(iterAt(list, i), iterAt(list, j), value, value + 1);
+
+      assertStrictEquals(model.splice(i, j - i, value, value + 1).join(','), [...removed].join(','));
+      value += 2;
+    },
+    rotate() {
+      const i = random(model.length);
+
+      list.rotate(iterAt(list, i));
+      model.push(...model.splice(0, i));
+    },
+    reverse() {
+      list.reverse();
+      model.reverse();
+    },
+  };
+  const names = Object.keys(ops);
+
+  for(let n = 0; n < 400; n++) {
+    const name = names[random(names.length)];
+
+    /* keeps the list around the size where the index kicks in */
+    if(model.length < 20) ops.push();
+    else if(model.length > 80) ops.shift();
+    else ops[name]();
+
+    /* a warm index must not survive the edit above */
+    check(list, model, `${name} #${n}`);
+  }
+
+  /* turning the index off and on again keeps the positions */
+  list.indexed = !indexed;
+  check(list, model, 'toggled');
+  list.indexed = indexed;
+  check(list, model, 'restored');
+}
+
+testIndex(true);
+testIndex(false);
+assert(new List().indexed, 'lists are indexed by default');
@@ -1,9 +1,122 @@
 import * as os from 'os';
 import Console from '../lib/console.js';
-import { MAP_PRIVATE, mmap, munmap, PROT_READ } from 'mmap';
+import { advise, MAP_PRIVATE, mapFile, MappedFile, mmap, munmap, PROT_READ } from 'mmap';
 import * as std from 'std';
+import { assert, assertStrictEquals } from './tinytest.js';
+
+const TEXT = 'hello mapFile\n';
+
+function writeText(file, text) {
+  const f = std.open(file, 'w');
+
+  f.puts(text);
+  f.close();
+}
+
+function testMapFile() {
+  const file = `/tmp/test_mmap-${Date.now()}.txt`;
+
+  writeText(file, TEXT);
+
+  /* the default mode maps copy-on-write: a store changes the buffer, not the file */
+  const map = mapFile(file, { advise: 'sequential' });
+  assertStrictEquals(TEXT, ArrayBufToString(map));
+
+  new Uint8Array(map)[0] = 'j'.charCodeAt(0);
+  assertStrictEquals('jello mapFile\n', ArrayBufToString(map));
+  assertStrictEquals(TEXT, std.loadFile(file));
+
+  assertStrictEquals(0, advise(map, 'willneed'));
+  assertStrictEquals(0, advise(map, [0, 4], 'random'));
+  assertStrictEquals(0, advise(map, [4, 0], 'dontneed'));
+  munmap(map);
+
+  /* 'r+' writes through to the file */
+  const shared = mapFile(file, { mode: 'r+' });
+  new Uint8Array(shared)[0] = 'J'.charCodeAt(0);
+  munmap(shared);
+  assertStrictEquals('Jello mapFile\n', std.loadFile(file));
+
+  let error;
+  try {
+    advise(new ArrayBuffer(16), 'normal');
+  } catch(e) {
+    error = e;
+  }
+  assert(error instanceof TypeError, 'advise() rejects a malloc()ed ArrayBuffer');
+
+  error = undefined;
+  try {
+    mapFile(file, { mode: 'w' });
+  } catch(e) {
+    error = e;
+  }
+  assert(error instanceof RangeError, 'mapFile() rejects an unknown mode');
+
+  os.remove(file);
+}
+
+function syscallOf(fn) {
+  try {
+    fn();
+  } catch(e) {
+    return e.syscall;
+  }
+}
+
+function testMappedFile() {
+  const file = `/tmp/test_mappedfile-${Date.now()}.bin`;
+  const out = new MappedFile(file, { writable: true, window: 1 });
+  const w = out.window;
+
+  assert(w > 0 && w % 4096 == 0, `window ${w} is rounded to pages`);
+
+  /* three windows, every byte holding its window's number */
+  for(let i = 1; i <= 3; i++) assertStrictEquals(w, out.write(new Uint8Array(w).fill(i).buffer));
+
+  assertStrictEquals(3 * w, out.length);
+  assertStrictEquals(3 * w, out.position);
+  assert(os.stat(file)[0].size >= 3 * w, 'the file grew while writing');
+
+  out.close();
+  assertStrictEquals(3 * w, os.stat(file)[0].size);
+
+  const input = new MappedFile(file, { window: w });
+
+  input.seek(w + 10);
+  const view = input.view(16);
+  assertStrictEquals(w, input.start);
+  assertStrictEquals(16, view.byteLength);
+  assertStrictEquals(2, new Uint8Array(view)[0]);
+
+  /* moving the window detaches the views into the old one */
+  input.seek(-2, std.SEEK_END);
+  const tail = input.read();
+  assertStrictEquals(2 * w, input.start);
+  assertStrictEquals(0, view.byteLength);
+  assertStrictEquals(2, tail.byteLength);
+  assertStrictEquals(3, new Uint8Array(tail)[1]);
+  assertStrictEquals(null, input.read());
+  input.close();
+
+  /* failures carry the syscall that failed */
+  let fd = os.open(file, os.O_RDONLY);
+  const readonly = new MappedFile(fd, { writable: true });
+  readonly.seek(0, std.SEEK_END);
+  assertStrictEquals('ftruncate', syscallOf(() => readonly.write('more')));
+  os.close(fd);
+
+  fd = os.open(file, os.O_WRONLY);
+  assertStrictEquals('mmap', syscallOf(() => new MappedFile(fd).view()));
+  os.close(fd);
+
+  os.remove(file);
+}
 
 async function main(...args) {
+  testMapFile();
+  testMappedFile();
+
   globalThis.console = new Console({
     inspectOptions: {
       depth: 5,
@@ -0,0 +1,87 @@
+import * as os from 'os';
+import * as std from 'std';
+import { getExecutable } from 'misc';
+import { assert, assertStrictEquals } from './tinytest.js';
+
+const qjsm = getExecutable() ?? 'qjsm';
+
+function writeFile(file, text) {
+  const f = std.open(file, 'w');
+
+  f.puts(text);
+  f.close();
+}
+
+/* runs main.js with module loader debugging, returns its output and how dep.js was compiled */
+function run(dir, options = `--cache mtime --cache-dir ${dir}/cache`) {
+  const f = std.popen(`cd ${dir} && DEBUG=modules,modules ${qjsm} ${options} main.js 2>&1`, 'r');
+  const output = f.readAsString();
+
+  f.close();
+
+  const line = output.split('\n').find(line => line.includes('dep.js') && line.includes('(cache '));
+  const [, from] = /\(cache (\w+)\)/.exec(line ?? '') ?? [];
+
+  return { value: (/value=(\d+)/.exec(output) ?? [])[1], from };
+}
+
+function cacheFiles(dir) {
+  const [names] = os.readdir(`${dir}/cache`);
+
+  return names.filter(name => name != '.' && name != '..');
+}
+
+/* a startup image entry is only used while its source is unchanged */
+function testImage(dir) {
+  const image = `--cache off --image ${dir}/startup.img`;
+
+  writeFile(`${dir}/dep.js`, `export const value = 3;\n`);
+
+  assertStrictEquals(JSON.stringify({ value: '3', from: 'miss' }), JSON.stringify(run(dir, `${image} --save-image`)));
+  assert(os.stat(`${dir}/startup.img`)[1] == 0, 'startup image saved');
+  assertStrictEquals(JSON.stringify({ value: '3', from: 'image' }), JSON.stringify(run(dir, image)));
+
+  writeFile(`${dir}/dep.js`, `export const value = 333;\n`);
+  assertStrictEquals(JSON.stringify({ value: '333', from: 'miss' }), JSON.stringify(run(dir, image)));
+}
+
+function main(...args) {
+  const dir = `/tmp/test_modulecache-${Date.now()}-${Math.floor(Math.random() * 1e6)}`;
+
+  os.mkdir(dir);
+  writeFile(`${dir}/main.js`, `import { value } from './dep.js';\nconsole.log('value=' + value);\n`);
+  writeFile(`${dir}/dep.js`, `export const value = 1;\n`);
+
+  try {
+    assertStrictEquals(JSON.stringify({ value: '1', from: 'miss' }), JSON.stringify(run(dir)));
+    assertStrictEquals(JSON.stringify({ value: '1', from: 'hit' }), JSON.stringify(run(dir)));
+
+    /* rewritten with the same content: the hash still matches */
+    writeFile(`${dir}/dep.js`, `export const value = 1;\n`);
+    assertStrictEquals(JSON.stringify({ value: '1', from: 'hit' }), JSON.stringify(run(dir)));
+
+    /* a changed source invalidates the entry */
+    writeFile(`${dir}/dep.js`, `export const value = 22;\n`);
+    assertStrictEquals(JSON.stringify({ value: '22', from: 'miss' }), JSON.stringify(run(dir)));
+    assertStrictEquals(JSON.stringify({ value: '22', from: 'hit' }), JSON.stringify(run(dir)));
+
+    /* entries are replaced through uniquely named temporary files that never remain */
+    const files = cacheFiles(dir);
+
+    assert(files.length >= 1, `cache entries: ${files}`);
+    assert(files.every(name => name.endsWith('.jsc')), `stray files in cache: ${files}`);
+
+    testImage(dir);
+  } finally {
+    for(const name of cacheFiles(dir)) os.remove(`${dir}/cache/${name}`);
+    for(const name of ['cache', 'startup.img', 'main.js', 'dep.js', '']) os.remove(`${dir}/${name}`);
+  }
+}
+
+try {
+  main(...scriptArgs.slice(1));
+  console.log('SUCCESS');
+} catch(error) {
+  console.log(`FAIL: ${error.message}\n${error.stack}`);
+  std.exit(1);
+}
@@ -191,6 +191,23 @@ tests({
     eq(path.toArray('/tmp/test.obj').join('/'), '/tmp/test.obj');
     eq(path.toArray('./../../..') + '', '.,..,..,..');
   },
+  'GlobSet'() {
+    const set = new path.GlobSet(['src/**/*.{c,h}', '*.md'], ['build', 'test_*']);
+
+    assert(set.match('src/a/b/quickjs-path.c'));
+    assert(set.match('src/glob-set.h'));
+    assert(set.match('doc/README.md'));
+    assert(!set.match('src/test_glob.c'));
+    assert(!set.match('build/src/glob-set.c'));
+    assert(!set.match('lib/fs.js'));
+    eq(set.test('lib'), path.GlobSet.DESCEND);
+    eq(new path.GlobSet('src/*.c').test('lib'), 0);
+    eq(set.test('src'), path.GlobSet.DESCEND);
+    eq(set.test('build'), path.GlobSet.EXCLUDED);
+    eq(set.filter(['README.md', 'src/x.c', 'src/x.js', 'build/README.md']) + '', 'README.md,src/x.c');
+    eq(set.add('*.js').includes, 3);
+    assert(set.match('lib/fs.js'));
+  },
   'offsets()'() {},
   'lengths()'() {},
   'ranges()'() {},
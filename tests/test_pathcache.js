@@ -0,0 +1,46 @@
+import * as os from 'os';
+import * as std from 'std';
+import { assert, assertStrictEquals } from './tinytest.js';
+
+const delay = ms => new Promise(resolve => os.setTimeout(resolve, ms));
+
+function writeFile(file, text) {
+  const f = std.open(file, 'w');
+
+  f.puts(text);
+  f.close();
+}
+
+async function importError(file) {
+  try {
+    await import(file);
+  } catch(e) {
+    return e;
+  }
+}
+
+async function main(...args) {
+  const file = `/tmp/test_pathcache-${Date.now()}-${Math.floor(Math.random() * 1e6)}.js`;
+
+  /* the failed lookup is cached as a negative entry */
+  assert(await importError(file), `${file} does not exist yet`);
+
+  writeFile(file, `export const value = 42;\n`);
+
+  try {
+    /* without --watch-modules the entry expires after PATH_CACHE_TTL (100ms) */
+    await delay(250);
+
+    const { value } = await import(file);
+    assertStrictEquals(42, value);
+  } finally {
+    os.remove(file);
+  }
+}
+
+main(...scriptArgs.slice(1))
+  .then(() => console.log('SUCCESS'))
+  .catch(error => {
+    console.log(`FAIL: ${error.message}\n${error.stack}`);
+    std.exit(1);
+  });
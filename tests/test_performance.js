@@ -1,4 +1,6 @@
 import { performance } from 'perf_hooks';
+import * as std from 'std';
+import { assert, assertStrictEquals } from './tinytest.js';
 
 function waitFor(msecs) {
   return new Promise((resolve, reject) => {
@@ -14,6 +16,51 @@ async function main(...args) {
   await waitFor(1000);
   console.log('now()', performance.now());
 
+  const { createHistogram, monitorEventLoopDelay } = await import('perf_hooks');
+
+  performance.mark('a');
+  await waitFor(50);
+  performance.mark('b');
+  const m = performance.measure('a-b', 'a', 'b');
+  assertStrictEquals('a-b', m.name);
+  assert(m.duration >= 45 && m.duration < 1000, `measure duration ${m.duration}`);
+  /* sorted, the measure starts with mark a */
+  const entries = () =>
+    performance
+      .getEntries()
+      .map(e => `${e.entryType}:${e.name}`)
+      .sort()
+      .join(',');
+  assertStrictEquals('mark:a,mark:b,measure:a-b', entries());
+  performance.clearMarks();
+  assertStrictEquals('measure:a-b', entries());
+
+  /* values below 2048 are exact with 3 significant figures */
+  const h = createHistogram();
+  for(let i = 1; i <= 1000; i++) h.record(i);
+  assertStrictEquals(1000, h.count);
+  assertStrictEquals(1, h.min);
+  assertStrictEquals(1000, h.max);
+  assertStrictEquals(500.5, h.mean);
+  assertStrictEquals(500, h.percentile(50));
+  assertStrictEquals(990, h.percentile(99));
+  assertStrictEquals(1000, h.percentile(100));
+
+  let error;
+  try {
+    h.record(2 ** 64);
+  } catch(e) {
+    error = e;
+  }
+  assert(error instanceof RangeError, 'record(2 ** 64) throws a RangeError');
+
+  const eld = monitorEventLoopDelay({ resolution: 5 });
+  eld.enable();
+  await waitFor(100);
+  eld.disable();
+  assert(eld.count > 0, 'event loop delay recorded no samples');
+  assert(eld.min >= 1 && eld.max >= eld.min, `event loop delay min ${eld.min} max ${eld.max}`);
+
   try {
     const obs = new (await import('perf_hooks')).PerformanceObserver(list => {
       console.log('function duration', list.getEntries()[0].duration);
@@ -25,10 +72,9 @@ async function main(...args) {
   } catch(e) {}
 }
 
-try {
-  main(...process.argv.slice(2));
-} catch(error) {
-  console.log(`FAIL: ${error.message}\n${error.stack}`);
-} finally {
-  console.log('SUCCESS');
-}
+main(...scriptArgs.slice(1))
+  .then(() => console.log('SUCCESS'))
+  .catch(error => {
+    console.log(`FAIL: ${error.message}\n${error.stack}`);
+    std.exit(1);
+  });
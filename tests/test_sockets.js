@@ -1,10 +1,164 @@
 import * as os from 'os';
+import * as std from 'std';
 import Console from 'console';
 import inspect from 'inspect';
 import { error, quote, randi, srand, toString } from 'misc';
-import { AF_INET, AsyncSocket, fd_set, IPPROTO_TCP, SO_BROADCAST, SO_DEBUG, SO_DONTROUTE, SO_ERROR, SO_KEEPALIVE, SO_OOBINLINE, SO_RCVBUF, SO_REUSEADDR, SO_REUSEPORT, SO_SNDBUF, SOCK_STREAM, SockAddr, Socket, socklen_t, SOL_SOCKET, } from 'sockets';
+import { listen } from 'cluster';
+import { assert, assertStrictEquals } from './tinytest.js';
+import { AF_INET, AF_UNIX, AsyncSocket, MessageBatch, MSG_DONTWAIT, SOCK_DGRAM, socketpair, splice, fd_set, IPPROTO_TCP, SO_BROADCAST, SO_DEBUG, SO_DONTROUTE, SO_ERROR, SO_KEEPALIVE, SO_OOBINLINE, SO_RCVBUF, SO_REUSEADDR, SO_REUSEPORT, SO_SNDBUF, SOCK_STREAM, SockAddr, Socket, socklen_t, SOL_SOCKET, } from 'sockets';
+
+function receive(fd, length) {
+  const buf = new ArrayBuffer(length);
+  let n = 0, r;
+
+  while(n < length && (r = os.read(fd, buf, n, length - n)) > 0) n += r;
+
+  return toString(buf, 0, n);
+}
+
+function testSendFileSplice() {
+  const text = 'sendFile() and splice() test data\n';
+  const fds = [];
+
+  assertStrictEquals(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  const sock = Socket.adopt(fds[0]);
+  const file = std.tmpfile();
+
+  file.puts(text);
+  file.flush();
+
+  assertStrictEquals(text.length, sock.sendFile(file.fileno(), 0, text.length));
+  assertStrictEquals(text, receive(fds[1], text.length));
+  file.close();
+
+  const [rd, wr] = os.pipe();
+
+  os.write(wr, new Uint8Array([...text].map(c => c.charCodeAt(0))).buffer, 0, text.length);
+  assertStrictEquals(text.length, sock.splice(rd, text.length));
+  assertStrictEquals(text, receive(fds[1], text.length));
+
+  let error;
+  try {
+    splice(rd);
+  } catch(e) {
+    error = e;
+  }
+  assertStrictEquals(true, error instanceof TypeError);
+
+  os.close(rd);
+  os.close(wr);
+  os.close(fds[0]);
+  os.close(fds[1]);
+}
+
+/* sends slots 2, 3 and 0 of a batch, receives them into slots 3, 0 and 1 of another */
+function testMessageBatch() {
+  const fds = [];
+
+  assertStrictEquals(0, socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+
+  const a = Socket.adopt(fds[0]),
+    b = Socket.adopt(fds[1]);
+  const out = new MessageBatch(4, 16),
+    input = new MessageBatch(4, 16);
+
+  assertStrictEquals(out.lengths, out.lengths);
+  assertStrictEquals(out.buffer, out.buffer);
+
+  for(const [slot, text] of [
+    [2, 'two'],
+    [3, 'three'],
+    [0, 'zero'],
+  ]) {
+    new Uint8Array(out.buffer, slot * 16, 16).set([...text].map(c => c.charCodeAt(0)));
+    out.lengths[slot] = text.length;
+  }
+
+  assertStrictEquals(3, a.sendmmsg(out, 0, 3, 2));
+  assertStrictEquals(3, b.recvmmsg(input, MSG_DONTWAIT, undefined, 3));
+
+  assertStrictEquals('two,three,zero', [3, 0, 1].map(slot => toString(input.slot(slot).slice().buffer)).join(','));
+  assertStrictEquals('3,5,4', [3, 0, 1].map(slot => input.lengths[slot]).join(','));
+
+  os.close(fds[0]);
+  os.close(fds[1]);
+}
+
+const O_NONBLOCK = 0o4000; /* Linux */
+
+function loopback() {
+  return new SockAddr(AF_INET, '127.0.0.1', 20000 + (randi() & 0x3fff));
+}
+
+async function connectAll(addr, count) {
+  const clients = Array.from({ length: count }, () => new AsyncSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+
+  await Promise.all(clients.map(client => client.connect(addr)));
+  return clients;
+}
+
+/* connections(max, flags) hands both arguments on to every acceptMany() */
+async function testConnections() {
+  const addr = loopback();
+  const listener = new AsyncSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+  listener.setsockopt(SOL_SOCKET, SO_REUSEADDR, [1]);
+  listener.bind(addr);
+  listener.listen(8);
+
+  const clients = await connectAll(addr, 3);
+  const accepted = [];
+
+  for await(const batch of listener.connections(2, 0)) {
+    assert(batch.length >= 1 && batch.length <= 2, `batch of ${batch.length}`);
+    accepted.push(...batch);
+    if(accepted.length >= clients.length) break;
+  }
+
+  assertStrictEquals(3, accepted.length);
+
+  /* flags = 0 overrides the SOCK_NONBLOCK default of a non-blocking listener */
+  for(const conn of accepted) {
+    assertStrictEquals(0, conn.mode & O_NONBLOCK);
+    conn.close();
+  }
+
+  for(const client of clients) client.close();
+  listener.close();
+}
+
+/* every connection is answered by one of the cluster workers with its id */
+async function testCluster() {
+  const addr = loopback();
+  const [cwd] = os.getcwd();
+  let script = scriptArgs[0].replace(/[^/]*$/, 'cluster_worker.js');
+
+  if(script[0] != '/') script = `${cwd}/${script}`;
+
+  const workers = listen(addr, script, { workers: 2 });
+  assertStrictEquals(2, workers.length);
+
+  const ids = new Set();
+
+  for(const client of await connectAll(addr, 8)) {
+    const buf = new ArrayBuffer(16);
+    const n = await client.recv(buf);
+
+    ids.add(toString(buf, 0, n));
+    client.close();
+  }
+
+  assert(ids.size >= 1, 'at least one worker answered');
+  assert([...ids].every(id => id == '0' || id == '1'), `worker ids ${[...ids]}`);
+}
 
 async function main() {
+  testSendFileSplice();
+  testMessageBatch();
+  await testConnections();
+  await testCluster();
+
   globalThis.console = new Console({
     inspectOptions: {
       compact: true,
@@ -0,0 +1,113 @@
+import * as os from 'os';
+import * as std from 'std';
+import { getExecutable } from 'misc';
+import { assert, assertStrictEquals } from './tinytest.js';
+
+const qjsm = getExecutable() ?? 'qjsm';
+
+/* 20 ticks that each queue a job and keep some memory alive, then prints getRuntimeStats() twice */
+const SCRIPT = `import * as os from 'os';
+const keep = [];
+let n = 0;
+
+function tick() {
+  keep.push(Array.from({ length: 1000 }, (v, i) => ({ i })));
+  Promise.resolve().then(() => n++);
+
+  if(n < 20) {
+    os.setTimeout(tick, 5);
+  } else {
+    console.log('stats=' + JSON.stringify(getRuntimeStats(true)));
+    console.log('reset=' + JSON.stringify(getRuntimeStats()));
+  }
+}
+
+os.setTimeout(tick, 5);
+`;
+
+function writeFile(file, text) {
+  const f = std.open(file, 'w');
+
+  f.puts(text);
+  f.close();
+}
+
+/* returns the getRuntimeStats() results and the JSON lines written to the --stats-fd */
+function run(file, options) {
+  const f = std.popen(`${qjsm} ${options} ${file}`, 'r');
+  const lines = f.readAsString().split('\n');
+  const result = { dumps: [] };
+
+  f.close();
+
+  for(const line of lines) {
+    const [, name, json] = /^(stats|reset)=(.*)/.exec(line) ?? [];
+
+    if(name) result[name] = JSON.parse(json);
+    else if(line.startsWith('{')) result.dumps.push(JSON.parse(line));
+  }
+
+  return result;
+}
+
+function testStats(file) {
+  const { stats, reset, dumps } = run(file, '--stats --stats-fd 1 --stats-interval 10');
+  const tick = stats.handlers.find(h => h.type == 'timer' && h.name == 'tick');
+
+  assert(tick, `tick in ${JSON.stringify(stats.handlers)}`);
+  assertStrictEquals(20, tick.count);
+  assert(tick.time > 0 && tick.max > 0 && tick.max <= tick.time, `tick times ${tick.time} ${tick.max}`);
+
+  assert(stats.jobs.count >= 20, `jobs.count ${stats.jobs.count}`);
+  assert(stats.jobs.drains >= 20, `jobs.drains ${stats.jobs.drains}`);
+
+  /* the automatic GC ran on its own as the kept objects grew */
+  assert(stats.gc.runs >= 1, `gc.runs ${stats.gc.runs}`);
+  assert(stats.gc.threshold > 0, `gc.threshold ${stats.gc.threshold}`);
+  assert(!('time' in stats.gc), 'GC pauses are not timed');
+
+  assert(stats.memory.mallocSize > 0, `memory.mallocSize ${stats.memory.mallocSize}`);
+  assert(stats.memory.delta.objCount > 0, `memory.delta.objCount ${stats.memory.delta.objCount}`);
+
+  /* getRuntimeStats(true) reset the counters */
+  assertStrictEquals(0, reset.handlers.find(h => h.name == 'tick').count);
+  assertStrictEquals(0, reset.jobs.count);
+  assertStrictEquals(0, reset.gc.runs);
+
+  assert(dumps.length >= 2, `${dumps.length} lines on the --stats-fd`);
+
+  for(let i = 0; i < dumps.length; i++) {
+    assert(Array.isArray(dumps[i].handlers) && dumps[i].jobs && dumps[i].gc && dumps[i].memory.delta, `line ${i}`);
+    assert(i == 0 || dumps[i].uptime > dumps[i - 1].uptime, `uptime on line ${i}`);
+  }
+}
+
+function testNoStats(file) {
+  const { stats, dumps } = run(file, '');
+
+  assert(stats.uptime > 0, `uptime ${stats.uptime}`);
+  assert(stats.memory.mallocSize > 0, `memory.mallocSize ${stats.memory.mallocSize}`);
+  assert(!('handlers' in stats) && !('jobs' in stats) && !('gc' in stats), 'only memory without --stats');
+  assertStrictEquals(0, dumps.length);
+}
+
+function main(...args) {
+  const file = `/tmp/test_stats-${Date.now()}-${Math.floor(Math.random() * 1e6)}.js`;
+
+  writeFile(file, SCRIPT);
+
+  try {
+    testStats(file);
+    testNoStats(file);
+  } finally {
+    os.remove(file);
+  }
+}
+
+try {
+  main(...scriptArgs.slice(1));
+  console.log('SUCCESS');
+} catch(error) {
+  console.log(`FAIL: ${error.message}\n${error.stack}`);
+  std.exit(1);
+}
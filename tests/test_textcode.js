@@ -2,6 +2,7 @@ import { concat } from 'util';
 import { Console } from 'console';
 import * as std from 'std';
 import { TextDecoder, TextEncoder } from 'textcode';
+import { assertStrictEquals } from './tinytest.js';
 
 function Decode(encoding, ...chunks) {
   let decoder = new TextDecoder(encoding),
@@ -44,6 +45,48 @@ function Encode(encoding, ...chunks) {
   return result;
 }
 
+/* decodes each chunk separately, then flushes with end() */
+function DecodeBytes(encoding, ...chunks) {
+  const decoder = new TextDecoder(encoding);
+
+  return chunks.map(bytes => decoder.decode(new Uint8Array(bytes))).join('') + (decoder.end() ?? '');
+}
+
+function TestInvalid() {
+  const cases = [
+    ['utf-8', '\ufffd', [0xff]],
+    ['utf-8', 'a\ufffdb', [0x61, 0xff, 0x62]],
+    ['utf-8', '\ufffd(', [0xc3, 0x28]],
+    ['utf-8', '\ufffd\ufffd', [0xc0, 0xaf]],
+    ['utf-8', '\ufffdA', [0xe2, 0x82, 0x41]],
+    ['utf-8', 'a\ufffd', [0x61, 0xe2, 0x82]],
+    ['utf-8', '€', [0xe2, 0x82], [0xac]],
+    ['utf-8', '\ufffd', [0xed, 0xa0, 0x80]],
+    ['utf-16le', '\ufffdA', [0x00, 0xdc, 0x41, 0x00]],
+    ['utf-16le', '\ufffdA', [0x3d, 0xd8, 0x41, 0x00]],
+    ['utf-16le', 'A\ufffd', [0x41, 0x00, 0x3d, 0xd8]],
+    ['utf-16le', 'A\ufffd', [0x41, 0x00, 0x42]],
+    ['utf-16le', '😀', [0x3d, 0xd8], [0x00, 0xde]],
+    ['utf-16be', '\ufffdA', [0xdc, 0x00, 0x00, 0x41]],
+    ['utf-16be', 'A\ufffd', [0x00, 0x41, 0xd8, 0x3d]],
+    ['utf-16be', '😀', [0xd8, 0x3d], [0xde, 0x00]],
+    ['utf-32le', '\ufffdA', [0x00, 0x00, 0x11, 0x00, 0x41, 0x00, 0x00, 0x00]],
+    ['utf-32le', '\ufffd', [0x00, 0xd8, 0x00, 0x00]],
+    ['utf-32le', 'A\ufffd', [0x41, 0x00, 0x00, 0x00, 0x42, 0x00]],
+    ['utf-32le', '😀', [0x00, 0xf6], [0x01, 0x00]],
+    ['utf-32be', '\ufffdA', [0x00, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x41]],
+    ['utf-32be', '\ufffd', [0x00, 0x00, 0xdc, 0x00]],
+    ['utf-32be', 'A\ufffd', [0x00, 0x00, 0x00, 0x41, 0x00]],
+  ];
+
+  for(const [encoding, expected, ...chunks] of cases) {
+    const result = DecodeBytes(encoding, ...chunks);
+
+    console.log(`DecodeBytes('${encoding}', ${chunks.map(c => `[${c}]`).join(', ')})`, JSON.stringify(result));
+    assertStrictEquals(JSON.stringify(expected), JSON.stringify(result));
+  }
+}
+
 function main(...args) {
   globalThis.console = new Console({
     inspectOptions: {
@@ -72,6 +115,8 @@ function main(...args) {
     Encode('utf-32be', s);
   }
 
+  TestInvalid();
+
   //Decode('utf-8', u8);
   //Decode('utf-16', u16);
   //Decode('utf-32le', u32.buffer.slice(0, -1), u32.buffer.slice(-1));
@@ -86,6 +131,36 @@ function main(...args) {
   const encoder = new TextEncoder();
   const view = encoder.encode('€');
   console.log(`encoder.encode('€')`, view); // Uint8Array(3) [226, 130, 172]
+  assertStrictEquals('226,130,172', [...view] + '');
+
+  TestEncodeInto();
+}
+
+function TestEncodeInto() {
+  const cases = [
+    /* encoding, input, destination size, read, written, bytes */
+    ['utf-8', 'a€😀', 8, 4, 8, [0x61, 0xe2, 0x82, 0xac, 0xf0, 0x9f, 0x98, 0x80]],
+    ['utf-8', 'a€😀', 10, 4, 8, [0x61, 0xe2, 0x82, 0xac, 0xf0, 0x9f, 0x98, 0x80, 0, 0]],
+    ['utf-8', 'a€😀', 5, 2, 4, [0x61, 0xe2, 0x82, 0xac, 0]],
+    ['utf-8', 'a€😀', 2, 1, 1, [0x61, 0]],
+    ['utf-8', 'a😀', 3, 1, 1, [0x61, 0, 0]],
+    ['utf-8', 'a😀', 0, 0, 0, []],
+    ['utf-16le', 'a😀', 6, 3, 6, [0x61, 0x00, 0x3d, 0xd8, 0x00, 0xde]],
+    ['utf-16le', 'a😀', 4, 1, 2, [0x61, 0x00, 0, 0]],
+    ['utf-16be', 'a😀', 6, 3, 6, [0x00, 0x61, 0xd8, 0x3d, 0xde, 0x00]],
+    ['utf-32le', 'a😀', 8, 3, 8, [0x61, 0, 0, 0, 0x00, 0xf6, 0x01, 0x00]],
+    ['utf-32le', 'a😀', 7, 1, 4, [0x61, 0, 0, 0, 0, 0, 0]],
+  ];
+
+  for(const [encoding, input, size, read, written, bytes] of cases) {
+    const target = new Uint8Array(size);
+    const result = new TextEncoder(encoding).encodeInto(input, target);
+
+    console.log(`TextEncoder('${encoding}').encodeInto('${input}', Uint8Array(${size}))`, result, target);
+    assertStrictEquals(read, result.read);
+    assertStrictEquals(written, result.written);
+    assertStrictEquals(bytes + '', [...target] + '');
+  }
 }
 
 try {
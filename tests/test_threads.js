@@ -0,0 +1,105 @@
+import * as os from 'os';
+import * as std from 'std';
+import { Worker, WorkerPool, availableParallelism } from 'worker_threads';
+import { assert, assertStrictEquals } from './tinytest.js';
+
+const once = (emitter, event) => new Promise(resolve => emitter.once(event, resolve));
+const delay = ms => new Promise(resolve => os.setTimeout(resolve, ms));
+
+async function main(...args) {
+  assert(availableParallelism() >= 1, 'availableParallelism() >= 1');
+
+  const flag = new Int32Array(new SharedArrayBuffer(4));
+  const worker = new Worker(
+    `import { parentPort, workerData } from 'worker_threads';
+     const flag = new Int32Array(workerData.sab);
+     parentPort.on('message', buf => {
+       parentPort.postMessage('waiting');
+       const result = Atomics.wait(flag, 0, 0);
+       parentPort.postMessage({ result, sum: new Uint8Array(buf).reduce((a, b) => a + b, 0) });
+       parentPort.close();
+     });`,
+    { eval: true, workerData: { sab: flag.buffer } },
+  );
+  const exit = once(worker, 'exit');
+  let message = once(worker, 'message');
+
+  const buf = new Uint8Array([1, 2, 3, 4]).buffer;
+  worker.postMessage(buf, [buf]);
+  assertStrictEquals(0, buf.byteLength);
+
+  assertStrictEquals('waiting', await message);
+  message = once(worker, 'message');
+
+  /* wakes the worker only once it is really blocked in Atomics.wait() */
+  let woken;
+  while(!(woken = Atomics.notify(flag, 0, 1))) await delay(10);
+  assertStrictEquals(1, woken);
+
+  const { result, sum } = await message;
+  assertStrictEquals('ok', result);
+  assertStrictEquals(10, sum);
+  assertStrictEquals(0, await exit);
+
+  /* a worker that only has timers still ends on terminate() */
+  const ticker = new Worker(
+    `import { parentPort } from 'worker_threads';
+     (function tick() {
+       os.setTimeout(tick, 10);
+     })();
+     parentPort.postMessage('ticking');`,
+    { eval: true },
+  );
+
+  assertStrictEquals('ticking', await once(ticker, 'message'));
+  assertStrictEquals(1, await ticker.terminate());
+
+  /* without a message listener a worker ends once its own timers ran or were cleared */
+  const timers = new Worker(
+    `import { parentPort } from 'worker_threads';
+     import { setTimeout, clearTimeout } from 'os';
+     let n = 0;
+     clearTimeout(setTimeout(() => parentPort.postMessage('not cleared'), 10000));
+     (function tick() {
+       if(++n < 5) setTimeout(tick, 50);
+       else parentPort.postMessage(n);
+     })();`,
+    { eval: true },
+  );
+  const timersExit = once(timers, 'exit');
+
+  assertStrictEquals(5, await once(timers, 'message'));
+  assertStrictEquals(0, await Promise.race([timersExit, delay(3000).then(() => 'still running')]));
+
+  const pool = new WorkerPool(
+    `import { handleTasks } from 'worker_threads';
+     handleTasks(n => {
+       if(n < 0) throw new RangeError('negative');
+       return n * n;
+     });`,
+    { eval: true, size: 2 },
+  );
+
+  const squares = await Promise.all([1, 2, 3, 4, 5, 6, 7, 8].map(n => pool.run(n)));
+  assertStrictEquals('1,4,9,16,25,36,49,64', squares.join(','));
+
+  let error;
+  try {
+    await pool.run(-1);
+  } catch(e) {
+    error = e;
+  }
+
+  assert(error, 'pool.run(-1) rejects');
+  assertStrictEquals('RangeError', error.name);
+  assertStrictEquals('negative', error.message);
+
+  pool.close();
+}
+
+main(...scriptArgs.slice(1))
+  .then(() => console.log('SUCCESS'))
+  .catch(error => {
+    console.log(`FAIL: ${error.message}\n${error.stack}`);
+    std.exit(1);
+  });